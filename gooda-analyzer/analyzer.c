@@ -22,6 +22,7 @@ limitations under the License.
 #include <sys/types.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <err.h>
 #include <string.h>
 #include <math.h>
@@ -39,10 +40,12 @@ limitations under the License.
 #include <time.h>
 #include <limits.h>
 #include <malloc.h>
+#include <pthread.h>
 #include "perf_event.h"
 #include "gooda.h"
 #include "perf_gooda.h"
 #include "gooda_util.h"
+#include "gooda_log.h"
 #include "asm_2_src.h"
 
 
@@ -54,8 +57,10 @@ void printf_rva(sample_struc_ptr, function_struc_ptr, process_struc_ptr);
 
 int first_module = 0;
 
-char* old_module_path=NULL;
-int asm_2_src_status;
+//	per thread, hot_list workers each keep their own asm_2_src module open
+__thread char* old_module_path=NULL;
+__thread int asm_2_src_status;
+static pthread_mutex_t report_count_lock = PTHREAD_MUTEX_INITIALIZER;
 
 #define BAD 0xFFFFFFFFFFFFFFFF
 #define DMGL_ANSI	(1 << 1)
@@ -79,7 +84,7 @@ typedef struct branch_type_struc{
 	int indirect_jmp;
 	}branch_type_data;
 
-static struct branch_type_struc branch_type;
+static __thread struct branch_type_struc branch_type;
 
 // simple string to hash index
 int
@@ -240,250 +245,6 @@ module_binsearch(uint64_t address, functionlist_struc_ptr func_list)
 	return NULL;
 }
 
-void 
-qs64(uint64_t *data, int left, int right) 
-{
-
-	int l_old, r_old, piv_index;
-	uint64_t piv;
-
-        l_old = left;
-        r_old = right;
-        piv = data[left];
-
-        while(left < right)
-                {
-                while( (data[right] >= piv) && (left < right))
-                        right--;
-                if(left != right)
-                        {
-                        data[left] = data[right];
-                        left++;
-                        }
-                while( ( data[left] <= piv) && (left < right))
-                        left++;
-                if(left != right)
-                        {
-                        data[right] = data[left];
-                        right--;
-                        }
-                }
-        data[left] = piv;
-        piv_index = left;
-        left = l_old;
-        right = r_old;
-        if(left < piv_index)
-                qs64(data, left, piv_index-1);
-        if(right > piv_index)
-                qs64(data, piv_index+1, right);
-}
-void
-quickSort64(uint64_t *arr, int elements)
-{
-	qs64(arr, 0, elements-1);
-}
-
-void 
-qs2(pointer_data *data, int left, int right) 
-{
-
-	int l_old, r_old, piv_index;
-	uint64_t piv;
-	sample_struc_ptr ptr;
-
-        l_old = left;
-        r_old = right;
-        piv = data[left].val;
-	ptr = data[left].ptr;
-        while(left < right)
-                {
-                while( (data[right].val >= piv) && (left < right))
-                        right--;
-                if(left != right)
-                        {
-                        data[left].val = data[right].val;
-                        data[left].ptr = data[right].ptr;
-                        left++;
-                        }
-                while( ( data[left].val <= piv) && (left < right))
-                        left++;
-                if(left != right)
-                        {
-                        data[right].val = data[left].val;
-                        data[right].ptr = data[left].ptr;
-                        right--;
-                        }
-                }
-        data[left].val = piv;
-        data[left].ptr = ptr;
-        piv_index = left;
-        left = l_old;
-        right = r_old;
-        if(left < piv_index)
-                qs2(data, left, piv_index-1);
-        if(right > piv_index)
-                qs2(data, piv_index+1, right);
-}
-
-void
-quickSort2(pointer_data *arr, int elements)
-{
-	qs2( arr, 0, elements-1);
-}
-
-void 
-qsloc(function_loc_data *data, int left, int right) 
-{
-
-	int l_old, r_old, piv_index;
-	uint64_t piv;
-	char *name, *bind;
-	uint32_t len;
-
-        l_old = left;
-        r_old = right;
-        piv = data[left].base;
-	len = data[left].len;
-	name = data[left].name;
-	bind = data[left].bind;
-        while(left < right)
-                {
-                while( (data[right].base >= piv) && (left < right))
-                        right--;
-                if(left != right)
-                        {
-                        data[left].base = data[right].base;
-                        data[left].len = data[right].len;
-                        data[left].name = data[right].name;
-                        data[left].bind = data[right].bind;
-                        left++;
-                        }
-                while( ( data[left].base <= piv) && (left < right))
-                        left++;
-                if(left != right)
-                        {
-                        data[right].base = data[left].base;
-                        data[right].len = data[left].len;
-                        data[right].name = data[left].name;
-                        data[right].bind = data[left].bind;
-                        right--;
-                        }
-                }
-        data[left].base = piv;
-        data[left].len = len;
-        data[left].name = name;
-        data[left].bind = bind;
-        piv_index = left;
-        left = l_old;
-        right = r_old;
-        if(left < piv_index)
-                qsloc(data, left, piv_index-1);
-        if(right > piv_index)
-                qsloc(data, piv_index+1, right);
-}
-
-void
-quickSort_loc(function_loc_data *arr, int elements)
-{
-	qsloc( arr, 0, elements-1);
-}
-
-void 
-qs3(line_data *data, int left, int right) 
-{
-
-	int l_old, r_old, piv_index;
-	int piv;
-	uint64_t address;
-
-        l_old = left;
-        r_old = right;
-        piv = data[left].sample_count;
-	address = data[left].address;
-        while(left < right)
-                {
-                while( (data[right].sample_count >= piv) && (left < right))
-                        right--;
-                if(left != right)
-                        {
-                        data[left].sample_count = data[right].sample_count;
-                        data[left].address = data[right].address;
-                        left++;
-                        }
-                while( ( data[left].sample_count <= piv) && (left < right))
-                        left++;
-                if(left != right)
-                        {
-                        data[right].sample_count = data[left].sample_count;
-                        data[right].address = data[left].address;
-                        right--;
-                        }
-                }
-        data[left].sample_count = piv;
-        data[left].address = address;
-        piv_index = left;
-        left = l_old;
-        right = r_old;
-        if(left < piv_index)
-                qs3(data, left, piv_index-1);
-        if(right > piv_index)
-                qs3(data, piv_index+1, right);
-}
-
-void
-quickSort3(line_data *arr, int elements)
-{
-	qs3( arr, 0, elements-1);
-}
-
-void 
-qslink(linkpairs_data *data, int left, int right) 
-{
-
-	int l_old, r_old, piv_index;
-	uint64_t piv;
-	int index;
-
-        l_old = left;
-        r_old = right;
-        piv = data[left].src_trg;
-	index = data[left].index;
-        while(left < right)
-                {
-                while( (data[right].src_trg >= piv) && (left < right))
-                        right--;
-                if(left != right)
-                        {
-                        data[left].src_trg = data[right].src_trg;
-                        data[left].index = data[right].index;
-                        left++;
-                        }
-                while( ( data[left].src_trg <= piv) && (left < right))
-                        left++;
-                if(left != right)
-                        {
-                        data[right].src_trg = data[left].src_trg;
-                        data[right].index = data[left].index;
-                        right--;
-                        }
-                }
-        data[left].src_trg = piv;
-        data[left].index = index;
-        piv_index = left;
-        left = l_old;
-        right = r_old;
-        if(left < piv_index)
-                qslink(data, left, piv_index-1);
-        if(right > piv_index)
-                qslink(data, piv_index+1, right);
-}
-
-void
-quickSort_link(linkpairs_data *arr, int elements)
-{
-	qslink( arr, 0, elements-1);
-}
-
 void
 printf_rva(sample_struc_ptr this_rva, function_struc_ptr this_function, process_struc_ptr this_process)
 {
@@ -491,7 +252,7 @@ printf_rva(sample_struc_ptr this_rva, function_struc_ptr this_function, process_
 	fprintf(stderr,"printf_RVA address = 0x%"PRIx64", total_sample_count = %d, function  %s, module %s \n",
 		 this_rva->rva, this_rva->total_sample_count, this_function->function_name, this_process->name);
 	fprintf(stderr,"Sample array  ");
-	for(i=0;i<num_events;i++)fprintf(stderr," %d,",this_rva->sample_count[num_events*(num_cores + num_sockets) + i]);
+	for(i=0;i<num_events;i++)fprintf(stderr," %d,",sample_count_get(this_rva, num_events*(num_cores + num_sockets) + i));
 	fprintf(stderr,"\n");
 }
 
@@ -687,7 +448,7 @@ reorder_process(void)
 #ifdef DBUG
 	fprintf(stderr,"about to call quicksort in reorder_process\n");
 #endif
-	quickSort2(process_list, num_process_with_data);
+	sort_pointer(process_list, num_process_with_data);
 #ifdef DBUG
 	fprintf(stderr,"back from quicksort in reorder_process\n");
 #endif
@@ -832,7 +593,7 @@ reorder_module(process_struc_ptr this_process)
 #ifdef DBUG
 	fprintf(stderr,"call quicksort in reorder_module\n");
 #endif
-	quickSort2(module_list, num_module_with_data);
+	sort_pointer(module_list, num_module_with_data);
 #ifdef DBUG
 	fprintf(stderr,"back from quicksort in reorder_module\n");
 #endif
@@ -941,7 +702,7 @@ reorder_rva(module_struc_ptr this_module, process_struc_ptr this_process)
 	fprintf(stderr,"call quicksort in reorder_rva, i = %d, rva_count = %d\n",i,rva_count);
 #endif
 //	for(j=0;j<rva_count;j++)fprintf(stderr," ptr = %lp, val = 0x%"PRIx64"\n",this_module->rva_list[j].ptr,this_module->rva_list[j].val);
-	quickSort2(this_module->rva_list,rva_count);
+	sort_pointer(this_module->rva_list,rva_count);
 // recreate linked list in reverse order so list starts at smallest rva
 	this_module->rva_count = rva_count;
 	this_module->first_sample = this_module->rva_list[rva_count-1].ptr;
@@ -978,196 +739,18 @@ reorder_rva(module_struc_ptr this_module, process_struc_ptr this_process)
 	return sample_sum;
 }
 
-void
-PPC_elf_fix(char * local_path, function_loc_data * func_data_buffer, int num_func_in_file )
-{
-	int i,j,k;
-	int local_len,ppc_cmd1_len;
-	int ppc_line_count,data_line_count,redirect_count;
-	FILE *fileppc;
-	char line_buf[1024], pntr_field[20],addr_field[20];
-	int line_buf_len, buf_len;
-	char ppc_cmd1[] = "readelf -x .opd ";
-	char *ppc_cmd, *endpntr;
-	typedef struct redirect_struc * redirect_struc_ptr;
-	typedef struct redirect_struc {
-		redirect_struc_ptr	next;
-		redirect_struc_ptr	previous;
-		uint64_t		pntr;
-		uint64_t		address;
-		} redirect_data;
-	redirect_struc_ptr redirect_stack, this_redirect, redirect_array;
-	uint64_t new_base, base_redirect, last_redirect;
-
-	local_len = strlen(local_path);
-	ppc_cmd1_len = strlen(ppc_cmd1);
-	line_buf_len = strlen(line_buf);
-
-//		ppc_cmd = malloc(ppc_cmd1_len + ppc_cmd2_len + ppc_cmd3_len + local_len + sizeof(uint64_t) + 2);
-	ppc_cmd = malloc(ppc_cmd1_len + local_len + 2);
-	if(ppc_cmd == NULL)
-		err(1, "failed to malloc buffer for ppc_cmd");
-	sprintf(ppc_cmd,"%s%s\0",ppc_cmd1,local_path);
-#ifdef DBUG
-	fprintf(stderr," ppc_cmd = %s\n",ppc_cmd);
-#endif
-	fileppc = popen(ppc_cmd, "r");
-//	fprintf(stderr," returned from popen, fileppc = %ld\n",(uint64_t)fileppc);
-	ppc_line_count = 0;
-	data_line_count = 0;
-	redirect_count = 0;
-	redirect_stack = NULL;
-	while(fgets(line_buf,line_buf_len,fileppc) != NULL)
-		{
-		buf_len = strlen(line_buf);
-		if(buf_len != 66)continue;
-		ppc_line_count++;
-#ifdef DBUG
-		fprintf(stderr," readelf -x len = %d, line_count = %d, line = %s",buf_len,ppc_line_count,line_buf);
-#endif
-//			skip first 2 lines
-//		if(ppc_line_count < 3)continue;
-
-		data_line_count++;
-//			skip every third line as they have no address data
-		if(data_line_count == 3)data_line_count = 0;
-		if(data_line_count == 0)continue;
-
-		i = 2;
-		while(line_buf[i] != ' ')
-			{
-			pntr_field[i-2] = line_buf[i];
-			i++;
-			}
-		pntr_field[i-1] = '\0';
-
-		i++;
-//		decode the data fields, keeping only the first of the triplet which has the address
-//		there are 2 data fields per line so there is an alternating pattern of which to keep
-		if(data_line_count == 2) i += 18;
-		k = 0;
-		for(j=0; j<17; j++)
-			if(line_buf[i+j] != ' ')
-				{
-				addr_field[k] = line_buf[i+j];
-				k++;
-				}
-		addr_field[k] = '\0';
-//		fprintf(stderr,"pntr_field = %s, addr_field = %s, redirect_count = %d\n",
-//			pntr_field, addr_field,redirect_count);
-		redirect_count++;
-//		malloc structure for linked list to keep pntr_field and addr_field
-		this_redirect = (redirect_struc_ptr)malloc(sizeof(redirect_data));
-		if(this_redirect == NULL)
-			err(1,"malloc of redirect struc failed for struc %d for module %s",redirect_count,local_path);
-		this_redirect->address = strtoll(addr_field,&endpntr,16);
-		this_redirect->pntr = strtoll(pntr_field,&endpntr,16);
-		if(data_line_count == 2)this_redirect->pntr += 8;
-		last_redirect = this_redirect->pntr;
-		this_redirect->next = NULL;
-		this_redirect->previous = NULL;
-#ifdef DBUG
-		fprintf(stderr,"pntr = 0x%"PRIx64", address = 0x%"PRIx64", redirect_count = %d\n",
-			this_redirect->pntr,this_redirect->address,redirect_count);
-#endif
-		if(redirect_stack == NULL)
-			{
-			redirect_stack = this_redirect;
-			base_redirect = this_redirect->pntr;
-			}
-		else
-			{
-			this_redirect->next = redirect_stack;
-			redirect_stack->previous = this_redirect;
-			redirect_stack = this_redirect;
-			}
-		}
-//	fprintf(stderr," finished while loop in PPC_fix, ppc_line_count = %d, data_line_count = %d, redirect_count = %d\n",
-//		 ppc_line_count, data_line_count, redirect_count);
-	redirect_array = (redirect_struc_ptr)malloc(redirect_count*sizeof(redirect_data));
-	if(redirect_array == NULL)
-		err(1,"failed to malloc redirect array of size %d for module %s",redirect_count,local_path);
-	i = 0;
-	while(redirect_stack != NULL)
-		{
-		redirect_array[i].address = redirect_stack->address;
-		redirect_array[i].pntr = redirect_stack->pntr;
-		i++;
-		this_redirect = redirect_stack;
-		redirect_stack = redirect_stack->next;
-		free(this_redirect);
-		}
-
-//	fprintf(stderr,"finished loading array and freeing stack, i = %d, base_redirect = 0x%"PRIx64", last redirect = 0x%"PRIx64"\n",
-//		i,base_redirect,last_redirect);
-
-	for(i=0; i<num_func_in_file; i++)
-		{
-		k = func_data_buffer[i].base - base_redirect;
-		j = k/24;
-		j = redirect_count - j - 1;
-		if(j < 0)j = 0;
-		if(j > redirect_count-1)j= redirect_count-1;
-//		fprintf(stderr," i = %d, j = %d, k = %d, func_data_buffer[i].base = 0x%"PRIx64"\n",
-//			i,j,k,func_data_buffer[i].base);
-		if(func_data_buffer[i].base > last_redirect)continue;
-		new_base = redirect_array[j].address;
-		if(redirect_array[j].pntr != func_data_buffer[i].base)
-			{
-#ifdef DBUG
-			fprintf(stderr,"bad redirect for module %s, i = %d base = 0x%"PRIx64", name = %s ",
-			local_path,i,func_data_buffer[i].base,func_data_buffer[i].name);
-			fprintf(stderr," j = %d, redirect_pntr = 0x%"PRIx64", addr = 0x%"PRIx64"\n",
-			j,redirect_array[j].pntr,redirect_array[j].address);
-#endif
-//			err(1,"bad redirect pntr");
-			}
-		else
-			{
-
-#ifdef DBUG
-//			fprintf(stderr," new_base = 0x%lx\n",new_base);
-#endif
-			func_data_buffer[i].base = new_base;
-			}
-//	fclose(fileppc);
-		}
-}
-
 functionlist_struc_ptr 
 get_functionlist(module_struc_ptr this_module)
 {
-	char line_buf[1024], local_bin_dir[] = "./binaries/",  cmd[] = "readelf -s -W ", FUNC[] = "FUNC";
-	char machine_cmd[] = "readelf -e ", machine_cmd2[] = " | grep -i ";
-	char *module_arch_cmd;
-	int module_arch_cmd_len, machine_len, machine_cmd_len=10, machine_cmd2_len=11;
-	char *endptr;
-	char demangle[] = "c++filt ";
-	char field[9][1024], space = ' ', colon = ':';
-	char *full_path_cmd, *funcname, *local_name, *local_cmd, *funcname_cmd;
-	uint64_t first_ip, previous_func_ip, previous_func_end, new_base;
+	char *local_name;
 	function_loc_data * func_data_buffer, *cleaned_func_data_buffer;
 	functionlist_struc_ptr this_functionlist;
-	function_location_stack_ptr function_loc_stack, this_location;
-	uint32_t func_len, previous_func_len, module_len, module_name_len, num_func_in_file, num_func, local_name_len;
-	size_t  funcname_len, funcbind_len, local_len = 11, cmd_len = 14, demangle_len = 8;
-	int i,j,k, lines_in_file, field_count, char_count;
-	FILE *file, *filt, *grep_out;
-	char *grep_out_val;
+	uint32_t module_len, module_name_len, num_func_in_file;
+	size_t  local_len;
+	int i,j;
 	int access_status;
-	int line_buf_len, buf_len, local_flag,free_count, func_count,len_sum = 0;
-	int ppc_cmd1_len, ppc_cmd2_len, ppc_cmd3_len;
-
-	num_func_in_file = 0;
-	num_func = 0;
-	function_loc_stack = NULL;
-	local_flag = 0;
-	local_len = strlen(local_bin_dir);
-	cmd_len = strlen(cmd);
-	machine_len = strlen(machine);
-	machine_cmd_len = strlen(machine_cmd);
-	machine_cmd2_len = strlen(machine_cmd2);
-	demangle_len = strlen(demangle);
+
+	local_len = strlen(local_bin_dir) + 1;
 
 	if(first_module != 2)first_module = 1;
 
@@ -1191,7 +774,7 @@ get_functionlist(module_struc_ptr this_module)
 	if((strcmp(this_module->module_name,"triad") == 0) && (first_module == 1))
 		{
 		first_module = 0;
-		fprintf(stderr,"this is vmlinux\n");
+		gooda_log(GLOG_DEBUG,"this is vmlinux\n");
 		}
 
 //	check local bin directory first
@@ -1201,7 +784,8 @@ get_functionlist(module_struc_ptr this_module)
 		fprintf(stderr," failed to malloc buffer for module local_name, path = %s\n",this_module->path);
 		err(1, "failed to malloc buffer for module local_name");
 		}
-	for(j=0; j< local_len; j++)local_name[j] = local_bin_dir[j];
+	for(j=0; j< local_len - 1; j++)local_name[j] = local_bin_dir[j];
+	local_name[local_len - 1] = '/';
 	for(j=0; j< module_name_len; j++)local_name[j+local_len] = this_module->module_name[j];
 	local_name[local_len+module_name_len] = '\0';
 #ifdef DBUG
@@ -1210,38 +794,12 @@ get_functionlist(module_struc_ptr this_module)
 	access_status = access(local_name, R_OK);
 	if(access_status == 0)
 		{
-		local_flag = 1;
-		this_module->local_path = (char*) malloc((local_len+module_name_len + 1)*sizeof(char));
-		if(this_module->local_path == NULL)
-			{
-			fprintf(stderr," failed to malloc buffer for local_path, path = %s\n",this_module->path);
-			err(1, "failed to malloc buffer for module local_path");
-			}
-		module_len = local_len+module_name_len -1;
-		for(j=0; j< local_len+module_name_len; j++)this_module->local_path[j] = local_name[j];
-
-		local_cmd = (char*) malloc(cmd_len + local_len + module_name_len + 1);
-		if(local_cmd == NULL)
-			{
-			fprintf(stderr," failed to malloc buffer for local_cmd, path = %s\n",this_module->path);
-			err(1, "failed to malloc buffer for module local_cmd");
-			}
-		for(j=0; j< cmd_len; j++)local_cmd[j] = cmd[j];
-		for(j=0; j< local_len + module_name_len; j++)local_cmd[j+cmd_len] = local_name[j];
-		local_cmd[cmd_len + local_len + module_name_len] = '\0';
-#ifdef DBUG
-	fprintf(stderr," module local cmd = %s, val = %p\n",local_cmd, local_cmd);
-#endif
-		file = popen(local_cmd, "r");
-		if(file == NULL)
-			{
-			fprintf(stderr," file returned 0 for access but readelf -s failed for %s, module path %s\n",local_name,this_module->path);
-			err(1, "readelf failed");
-			}
+		this_module->local_path = local_name;
 		}
 	else
 		{
 //	binary file is not in ./binaries directory so search original path
+		free(local_name);
 #ifdef DBUG
 	fprintf(stderr," module full name = %s\n",this_module->path);
 #endif
@@ -1261,194 +819,29 @@ get_functionlist(module_struc_ptr this_module)
 			}
 		for(j=0; j< module_len; j++)this_module->local_path[j] = this_module->path[j];
 		this_module->local_path[module_len] = '\0';
-		full_path_cmd = (char*) malloc((module_len+cmd_len+1)*sizeof(char));
-		if(full_path_cmd == NULL)
-			{
-			fprintf(stderr," failed to malloc buffer for full_path_cmd, path = %s\n",this_module->path);
-			err(1, "failed to malloc buffer for module full_path__cmd");
-			}
-		for(j=0; j< cmd_len; j++)full_path_cmd[j] = cmd[j];
-		for(j=0; j< module_len; j++)full_path_cmd[j+cmd_len] = this_module->path[j];
-		full_path_cmd[module_len+cmd_len] = '\0';
-#ifdef DBUG
-	fprintf(stderr," module full_path cmd = %s\n",full_path_cmd);
-#endif
-		file = popen(full_path_cmd, "r");
-		if(file == NULL)
-			{
-			fprintf(stderr," failed to find module for full_path_cmd, path = %s\n",this_module->path);
-//			err(1, "failed to find_module for module full_path__cmd");
-			return NULL;
-			}
-		}
-//	found module
-// 	check architecture
-	fprintf(stderr," machine_cmd_len = %d, module_len = %d, machine_cmd2_len = %d, machine_len = %d\n",
-		machine_cmd_len, module_len, machine_cmd2_len, machine_len);
-	fprintf(stderr," machine_cmd = %s, module = %s, machine_cmd2 = %s, machine = %s\n",
-		machine_cmd,this_module->local_path,machine_cmd2,machine);
-	module_arch_cmd = (char *)malloc(machine_cmd_len + module_len + machine_cmd2_len + machine_len + 1);
-	for(j=0; j< machine_cmd_len; j++)module_arch_cmd[j] = machine_cmd[j];
-	for(j=0; j< module_len; j++)module_arch_cmd[machine_cmd_len + j] = this_module->local_path[j];
-	for(j=0; j< machine_cmd2_len; j++)module_arch_cmd[machine_cmd_len + module_len + j] = machine_cmd2[j];
-	for(j=0; j< machine_len; j++)module_arch_cmd[machine_cmd_len + module_len + machine_cmd2_len + j] = machine[j];
-	module_arch_cmd[machine_cmd_len + module_len + machine_cmd2_len + machine_len] = '\0';
-	fprintf(stderr," module %s, machine_arch cmd = %s\n", this_module->local_path, module_arch_cmd);
-	grep_out = popen(module_arch_cmd, "r");
-        if(grep_out == NULL)
-                {
-                fprintf(stderr," failed to get a pipe for module_arch_cmd, path = %s\n",this_module->path);
-                return NULL;
-                }
-	lines_in_file = 0;
-	line_buf_len = 1024;
-	grep_out_val = fgets(line_buf,line_buf_len,grep_out);
-	if(grep_out_val == NULL)
-		{
-#ifdef DBUG
-		fprintf(stderr," grep_out_val was NULL for %s\n",module_arch_cmd);
-#endif
-		free(module_arch_cmd);
-		return NULL;
-		}
-		else
-		{
-#ifdef DBUG
-		fprintf(stderr," grep out line_buff was %s\n",line_buf);
-#endif
-		free(module_arch_cmd);
-		}
-
-//	read lines of readelf -s output, skip first 3, remove zero length entries
-//	and create a stack
-	lines_in_file = 0;
-	line_buf_len = 1024;
-#ifdef DBUG
-		fprintf(stderr," readelf -s output for module %s\n",this_module->path);
-#endif
-	while(fgets(line_buf,line_buf_len,file) != NULL)
-		{
-		buf_len = strlen(line_buf);
-#ifdef DBUG
-		fprintf(stderr," readelf -s len = %d, line = %s",buf_len,line_buf);
-#endif
-		if(first_module == 0)
-			{
-			fprintf(stderr," readelf -s len = %d, line = %s",buf_len,line_buf);
-			}
-//		process the fields
-		lines_in_file++;
-//		skip first three lines
-		if(lines_in_file <= 3) continue;
-                field_count = 0;
-                char_count = 0;
-//  this code limits the function name to around 950 characters
-                for(i=0; i< buf_len; i++)
-                        {
-#ifdef DBUG
-				if(field_count >= 9)fprintf(stderr,"field_count too big = %d\n",field_count);
-#endif
-			if(field_count >= 9)continue;
-                        if(line_buf[i] != space)
-                                {
-				field[field_count][char_count] = line_buf[i];
-                                if((field_count == 0) && (line_buf[i] == colon))
-                                        field[field_count][char_count] = '\0';
-                                if(line_buf[i] == '\n') field[field_count][char_count] = '\0';
-                                char_count++;
-                                }
-                        else
-                                {
-                                if(char_count !=0)
-                                        {
-                                        field[field_count][char_count] = '\0';
-                                        field_count++;
-                                        }
-                                char_count = 0;
-                                }
-                        }
-		if(field_count >= 9)continue;
-		func_len = atoi(field[2]);
-		if(func_len == 0)
-			{
-			func_len = strtol(field[2], (char **) NULL, 16);
-			if(func_len == 0)continue;
-			}
-		if(strcmp(field[3], FUNC) != 0)continue;
-		num_func_in_file++;
-
-		this_location = function_location_stack_create();
-		if(this_location == NULL)
-			err(1,"failed to create function_location struc in get_functionlist");
-		this_location->next = function_loc_stack;
-		if(function_loc_stack != NULL) function_loc_stack->previous = this_location;
-		function_loc_stack = this_location;
-		this_location->base = hex_to_ll(field[1]);
-		this_location->base = (this_location->base & addr_mask);
-		this_location->len = func_len;
-
-		funcname_len = strlen(field[7]);
-		this_location->name = (char*) malloc((funcname_len+1)*sizeof(char));
-		if(this_location->name == NULL)
-			{
-			fprintf(stderr," failed to malloc buffer for function name %s, module %s\n",field[7],this_module->path);
-			err(1,"malloc failed for function name");
-			}
-		for(i=0; i<funcname_len; i++)this_location->name[i] = field[7][i];
-		this_location->name[funcname_len] = '\0';
-
-		funcbind_len = strlen(field[4]);
-		this_location->bind = (char*) malloc((funcbind_len+1)*sizeof(char));
-		if(this_location->bind == NULL)
-			{
-			fprintf(stderr," failed to malloc buffer for function bind %s, module %s\n",field[4],this_module->path);
-			err(1,"malloc failed for function bind");
-			}
-		for(i=0; i<funcbind_len; i++)this_location->bind[i] = field[4][i];
-		this_location->bind[funcbind_len] = '\0';
-
-		for(i=0; i<9; i++)field[i][0] = '\0';
 		}
-#ifdef DBUG
-	fprintf(stderr," lines_in_file = %d, samples in module = %d\n",lines_in_file,this_module->total_sample_count);
-#endif
-	if((lines_in_file == 0) || (num_func_in_file == 0))
-		{
-		free(local_name);
-		if(local_flag == 1)free(local_cmd);
-		if(local_flag == 0)free(full_path_cmd);
+//	found module, a binary seen by an earlier run comes from the symbol cache
+	this_module->buildid = elf_build_id(this_module->local_path);
+	symcache_check_build_id(this_module->path, this_module->buildid);
+	this_functionlist = symcache_load_functions(this_module->buildid);
+	if(this_functionlist != NULL)
+		return this_functionlist;
+
+//	otherwise read the sized FUNC symbols of .symtab and .dynsym
+//	elf_function_list checks the ELF machine against the perf.data arch
+//	and resolves PPC64 .opd descriptors to entry addresses
+	num_func_in_file = elf_function_list(this_module->local_path, &func_data_buffer);
+#ifdef DBUG
+	fprintf(stderr," functions in module %s = %d, samples in module = %d\n",
+		this_module->local_path,num_func_in_file,this_module->total_sample_count);
+#endif
+	if(num_func_in_file == 0)
 		return NULL;
-		}
-//	create an array from the linked list and sort it by base
-	func_data_buffer = (function_loc_data*)malloc(num_func_in_file*sizeof(function_loc_data));
-	if(func_data_buffer == NULL)
-		{
-		fprintf(stderr," failed to malloc buffer for func_data_buffer, module path = %s\n",this_module->path);
-		err(1, "failed to malloc buffer for module func_data_buffer");
-		}
-	this_location = function_loc_stack;
-	i = 0;
-//	fprintf(stderr," READELF -s -W output for FUNC in %s\n",this_module->local_path);
-	while(this_location != NULL)
-		{
-		func_data_buffer[i].name = this_location->name;	
-		func_data_buffer[i].bind = this_location->bind;	
-		func_data_buffer[i].base = this_location->base;	
-		func_data_buffer[i].len = this_location->len;	
-//		fprintf(stderr,"i = %d base = 0x%"PRIx64", len = 0x%"PRIx64", name = %s\n",
-//			i,func_data_buffer[i].base,func_data_buffer[i].len,func_data_buffer[i].name);
-		i++;
-		this_location = this_location->next;
-		}
-
-//		fix up of this_location->base needed for PPC64
-	if((arch_type_flag == 2) && (this_module->bin_type = 64))
-		PPC_elf_fix(this_module->local_path, func_data_buffer,num_func_in_file);
 
 #ifdef DBUG
 	fprintf(stderr," calling quicksort_loc for module %s\n",this_module->path);
 #endif
-	quickSort_loc(func_data_buffer,num_func_in_file);
+	sort_loc(func_data_buffer,num_func_in_file);
 //	walk through the sorted list and do not copy entries where base < base_prev+len_prev
 	cleaned_func_data_buffer = (function_loc_data*)calloc(1, num_func_in_file*sizeof(function_loc_data));
 	if(cleaned_func_data_buffer == NULL)
@@ -1477,7 +870,7 @@ get_functionlist(module_struc_ptr this_module)
 			}
 		if(first_module == 0)
 			{
-			fprintf(stderr," addr = 0x%lx, len = %d, %s,  %s\n",func_data_buffer[i].base,func_data_buffer[i].len,func_data_buffer[i].bind,func_data_buffer[i].name);
+			gooda_log(GLOG_DEBUG," addr = 0x%lx, len = %d, %s,  %s\n",func_data_buffer[i].base,func_data_buffer[i].len,func_data_buffer[i].bind,func_data_buffer[i].name);
 			}
 
 
@@ -1502,10 +895,10 @@ get_functionlist(module_struc_ptr this_module)
 
 	if(first_module == 0)
 		{
-		fprintf(stderr," cleaned Functionlist\n");
+		gooda_log(GLOG_DEBUG," cleaned Functionlist\n");
 		for(i=0; i<j+1; i++)
 			{
-			fprintf(stderr," addr = 0x%lx, len = %d, %s,  %s\n",
+			gooda_log(GLOG_DEBUG," addr = 0x%lx, len = %d, %s,  %s\n",
 				cleaned_func_data_buffer[i].base,cleaned_func_data_buffer[i].len,
 				cleaned_func_data_buffer[i].bind,cleaned_func_data_buffer[i].name);
 			}
@@ -1518,48 +911,8 @@ get_functionlist(module_struc_ptr this_module)
 		}
 */
 
-//	fprintf(stderr," module local name = %s, num_func_in_file = %d\n",local_name, num_func_in_file);
 	free(func_data_buffer);
-//	fprintf(stderr, "freed func_data_buffer module path = %s\n",this_module->path);
-//	fprintf(stderr," module local name = %s, val = %lx\n",local_name, local_name);
-#ifdef DBUG
-	fprintf(stderr, "freed func_data_buffer module path = %s\n",this_module->path);
-	fprintf(stderr," module local name = %s, val = %p\n",local_name, local_name);
-#endif
-	free(local_name);
-//	fprintf(stderr, "freed local_name module path = %s\n",this_module->path);
-//	if(local_flag == 1)fprintf(stderr," module local cmd = %s, val = %lx\n",local_cmd, local_cmd);
-#ifdef DBUG
-	fprintf(stderr, "freed local_name module path = %s\n",this_module->path);
-	if(local_flag == 1)fprintf(stderr," module local cmd = %s, val = %p\n",local_cmd, local_cmd);
-#endif
-	if(local_flag == 1)free(local_cmd);
-//	if(local_flag == 1)fprintf(stderr, "freed local_cmd module path = %s\n",this_module->path);
-//	fprintf(stderr," module full cmd = %s, val = %lx\n",full_path_cmd, full_path_cmd);
-#ifdef DBUG
-	fprintf(stderr, "freed local_cmd module path = %s\n",this_module->path);
-	if(local_flag == 0)fprintf(stderr," module full cmd = %s, val = %p\n",full_path_cmd, full_path_cmd);
-#endif
-	if(local_flag == 0)free(full_path_cmd);
-//	if(local_flag == 0)fprintf(stderr, "freed full_path_cmd module path = %s, number of functions = %d\n",this_module->path,num_func_in_file);
-#ifdef DBUG
-	if(local_flag == 0)fprintf(stderr, "freed full_path_cmd module path = %s\n",this_module->path);
-#endif
-	this_location = function_loc_stack;
-	free_count = 0;
-	while(this_location != NULL)
-		{
-		function_loc_stack = this_location->next;
-		free(this_location);
-		free_count++;
-		this_location = function_loc_stack;
-		}
-//	fprintf(stderr, "freed this_location from stack %d times for module path = %s\n",free_count,this_module->path);
-#ifdef DBUG
-	fprintf(stderr, "freed this_location from stack %d times for module path = %s\n",free_count,this_module->path);
-#endif
-	pclose(file);
-
+	symcache_store_functions(this_module->buildid, this_functionlist);
 	return this_functionlist;
 }
 void
@@ -1653,173 +1006,254 @@ branch_accumulate(func_branch_struc_ptr * this_link, branch_struc_ptr this_branc
 //	fprintf(stderr,"branch_accumulate: *this_link = %p\n",*this_link);
 }
 
+//	function_accumulate joins the module's rva list, sorted by reorder_rva, with
+//	its sorted function list. The rvas and the function bounds are copied into
+//	flat arrays first so the join is one pass over two arrays, then each run of
+//	rvas falling in one function is summed into that function. The per core
+//	counters of a function are contiguous for each event, so the event totals
+//	and the cycle count are added up from those blocks once per function
+//	instead of once per rva. Rvas outside every function go to one [unknown]
+//	function per module, function_length 0, rather than being dropped. It is
+//	listed in the hotspot table without a report index, and is left out of the
+//	in-function totals and the cutoffs, which count only real functions.
+
+static char unknown_function_name[] = "[unknown]";
+
+static inline int
+function_is_unknown(function_struc_ptr this_function)
+{
+	return this_function->function_mangled_name == unknown_function_name;
+}
+
+//	lowest position of global_func_list holding its hottest limit functions,
+//	[unknown] buckets do not take a place
+static int
+hot_func_floor(pointer_data * global_func_list, int limit)
+{
+	int i;
+
+	for(i = global_func_count - 1; (i >= 0) && (limit > 0); i--)
+		if(!function_is_unknown((function_struc_ptr) global_func_list[i].ptr))
+			limit--;
+	return i + 1;
+}
+
+static function_struc_ptr
+function_start(module_struc_ptr this_module, process_struc_ptr this_process, char *name,
+		uint64_t base, int len, sample_struc_ptr first_rva)
+{
+	function_struc_ptr this_function;
+
+	this_function = function_struc_create();
+	if(this_function == NULL)
+		{
+		fprintf(stderr," failed to create function struc in function allocate for module = %s\n",this_module->path);
+		err(1,"failed to create function struc");
+		}
+	this_function->function_name = name;
+	this_function->function_mangled_name = name;
+	this_function->function_length = len;
+	this_function->function_rva_start = base;
+	this_function->first_rva = first_rva;
+	this_function->this_module = this_module;
+	this_function->this_process = this_process;
+	this_function->next = global_func_stack;
+	if(global_func_stack != NULL)global_func_stack->previous = this_function;
+	global_func_stack = this_function;
+	global_func_count++;
+	return this_function;
+}
+
+//	per core counters to the event totals and cycle count of a finished function
+static void
+function_rollup(function_struc_ptr this_function)
+{
+	int event, core, sum, *block;
+
+	for(event = 0; event < num_events; event++)
+		{
+		block = &this_function->sample_count[event*num_cores];
+		sum = 0;
+		for(core = 0; core < num_cores; core++)
+			sum += block[core];
+		this_function->sample_count[num_events*(num_cores + num_sockets) + event] += sum;
+//		the cycle count has always been summed once per event
+		if(event == 0)
+			this_function->cycle_count += num_events*sum;
+		}
+}
+
+static void
+function_add_rva(function_struc_ptr this_function, sample_struc_ptr loop_sample, int *event_total)
+{
+	branch_struc_ptr this_branch;
+	int event, pos, index, count, srctrg;
+
+//	increment the per core counters of the function and the rva totals, only the
+//	nonzero counters of the rva are visited and its totals are added after the
+//	walk so the counter list is not changed under it
+	pos = 0;
+	while(sample_count_next(loop_sample, &pos, &index, &count) && (index < num_events*num_cores))
+		{
+		event = index/num_cores;
+		event_total[event] += count;
+		this_function->sample_count[index] += count;
+//		per socket accumulation missing at this time due to lack of topology
+		}
+	for(event = 0; event < num_events; event++)
+		{
+		if(event_total[event] == 0)
+			continue;
+		sample_count_add(loop_sample, num_events*(num_cores + num_sockets) + event, event_total[event]);
+		event_total[event] = 0;
+		}
+//	aggregate the derived events
+	if(source_index != 0)
+		this_function->sample_count[source_index] += sample_count_get(loop_sample, source_index);
+	if(target_index != 0)
+		this_function->sample_count[target_index] += sample_count_get(loop_sample, target_index);
+	if(next_taken_index != 0)
+		this_function->sample_count[next_taken_index] += sample_count_get(loop_sample, next_taken_index);
+//	and the load latency / data source profile
+	if(loop_sample->mem != NULL)
+		mem_stats_merge(&this_function->mem, loop_sample->mem);
+	this_function->lbr.taken += loop_sample->lbr.taken;
+	this_function->lbr.mispredict += loop_sample->lbr.mispredict;
+	block_cycles_merge(&this_function->cycles, loop_sample->cycles);
+
+//	aggregate return_list into functions sources list
+	this_branch = loop_sample->return_list;
+	if(this_branch != NULL)
+		{
+#ifdef DBUG
+		fprintf(stderr,"return_list non zero for function %s, at address 0x%"PRIx64"\n",
+			this_function->function_name,loop_sample->rva);
+		fprintf(stderr," return_list count = %d from address 0x%"PRIx64"\n",this_branch->count, this_branch->address);
+#endif
+		this_function->total_sources += loop_sample->total_sources;
+		srctrg = 0;
+		branch_accumulate(&this_function->sources, this_branch, loop_sample, this_function, srctrg);
+		}
+
+//	aggregate call_list into functions targets list
+	this_branch = loop_sample->call_list;
+	if(this_branch != NULL)
+		{
+#ifdef DBUG
+		fprintf(stderr,"call_list non zero for function %s, at address 0x%"PRIx64"\n",
+			this_function->function_name,loop_sample->rva);
+		fprintf(stderr," call_list count = %d from address 0x%"PRIx64"\n",this_branch->count, this_branch->address);
+#endif
+		this_function->total_targets += loop_sample->total_targets;
+		srctrg = 1;
+		branch_accumulate(&this_function->targets, this_branch, loop_sample, this_function, srctrg);
+		}
+
+	this_function->total_sample_count += loop_sample->total_sample_count;
+	if(function_is_unknown(this_function))
+		return;
+	total_function_sample_count += loop_sample->total_sample_count;
+	global_sample_count_in_func += loop_sample->total_sample_count;
+}
+
 void 
 function_accumulate(module_struc_ptr this_module, process_struc_ptr this_process)
 {
 
-	function_struc_ptr this_function, function_stack, old_function;
-	sample_struc_ptr loop_sample, sample_tmp;
+	function_struc_ptr this_function, unknown_function;
+	sample_struc_ptr loop_sample, *rva_sample;
 	function_loc_data * this_list;
-	int i,j,k, event, core, function_count, function_with_data_count, rva_count, old_rva_count, total_rva_count;
-	branch_struc_ptr this_branch;
-	int derived_start,srctrg;
-	loop_sample = this_module->first_sample;
+	uint64_t *rva, *func_base, *func_end;
+	int i, k, current, function_count, rva_count, *rva_func, *event_total;
+
 	function_count = this_module->function_list->size;
 	this_list = this_module->function_list->list;
-	i = 0;
 	rva_count = 0;
-	total_rva_count = 0;
-	old_rva_count = 0;
-	this_function = NULL;
-	old_function = this_function;
+	for(loop_sample = this_module->first_sample; loop_sample != NULL; loop_sample = loop_sample->next)
+		rva_count++;
 #ifdef DBUG
-	fprintf(stderr," module = %s, function_count = %d\n",this_module->path,function_count);
+	fprintf(stderr," module = %s, function_count = %d, rva_count = %d\n",this_module->path,function_count,rva_count);
 #endif
+	if(rva_count == 0)
+		return;
+
+	event_total = (int *)calloc(num_events, sizeof(int));
+	rva = (uint64_t *)malloc(rva_count*sizeof(uint64_t));
+	rva_sample = (sample_struc_ptr *)malloc(rva_count*sizeof(sample_struc_ptr));
+	rva_func = (int *)malloc(rva_count*sizeof(int));
+	func_base = (uint64_t *)malloc(function_count*sizeof(uint64_t));
+	func_end = (uint64_t *)malloc(function_count*sizeof(uint64_t));
+	if((event_total == NULL) || (rva == NULL) || (rva_sample == NULL) || (rva_func == NULL) ||
+			(func_base == NULL) || (func_end == NULL))
+		err(1,"failed to allocate join arrays in function_accumulate for %s",this_module->path);
 
-	while(loop_sample != NULL)
+	k = 0;
+	for(loop_sample = this_module->first_sample; loop_sample != NULL; loop_sample = loop_sample->next)
 		{
-		global_rva++;
-//			walk function list until base + len > current RVA
-		while((uint64_t)(this_list[i].base +(uint64_t) this_list[i].len) < loop_sample->rva)
-		
-			{
-			if(i >= function_count -1)
-				{
-				fprintf(stderr," rva is > last function endpoint, rva = 0x%"PRIx64", last base = 0x%"PRIx64", len = 0x%"PRIx64" name = %s, rva_count = %d, module_rva_count = %d, module = %s\n",
-				loop_sample->rva,this_list[i].base,(uint64_t)this_list[i].len,this_list[i].name,total_rva_count,this_module->this_table->entries,this_module->path);
-//				err(1,"rva beyond function range in function_accumulate");
-				return;
-				}
+		rva_sample[k] = loop_sample;
+		rva[k] = loop_sample->rva;
+		k++;
+		}
+	for(i = 0; i < function_count; i++)
+		{
+		func_base[i] = this_list[i].base;
+		func_end[i] = this_list[i].base + (uint64_t)this_list[i].len;
+		}
+
+//	merge join, rva_func[k] is the function holding rva[k] or -1
+	i = 0;
+	for(k = 0; k < rva_count; k++)
+		{
+		while((i < function_count) && (func_end[i] <= rva[k]))
 			i++;
-			this_function = NULL;
-			}
-//			check that current RVA is not < base...if so RVA is not in a function range
-		if(loop_sample->rva < (uint64_t) this_list[i].base)
+		rva_func[k] = ((i < function_count) && (func_base[i] <= rva[k])) ? i : -1;
+		}
+
+	this_function = NULL;
+	unknown_function = NULL;
+	current = -1;
+	for(k = 0; k < rva_count; k++)
+		{
+		global_rva++;
+		i = rva_func[k];
+		if(i < 0)
 			{
 			bad_rva++;
-			bad_sample_count += loop_sample->total_sample_count;
-			total_function_sample_count += loop_sample->total_sample_count;
-			total_rva_count++;
+			bad_sample_count += rva_sample[k]->total_sample_count;
 #ifdef DBUG
-			fprintf(stderr,"Offset 0x%"PRIx64", with %d samples, in module %s\n",loop_sample->rva,loop_sample->total_sample_count,this_module->module_name);
+			fprintf(stderr,"Offset 0x%"PRIx64", with %d samples, in module %s\n",rva[k],rva_sample[k]->total_sample_count,this_module->module_name);
 #endif
-			loop_sample = loop_sample->next;
+			if(unknown_function == NULL)
+				unknown_function = function_start(this_module, this_process, unknown_function_name, rva[k], 0, rva_sample[k]);
+			function_add_rva(unknown_function, rva_sample[k], event_total);
 			continue;
 			}
-//		found the function that includes this RVA
-//		fprintf(stderr," this_function address = 0x%"PRIx64"\n",this_function);
-		if(this_function == NULL)
+		if(i != current)
 			{
-			old_rva_count = rva_count;
-			rva_count = 0;
-			this_function = function_struc_create();
-			if(this_function == NULL)
-				{
-				fprintf(stderr," failed to create function struc in function allocate for module = %s\n",this_module->path);
-				err(1,"failed to create function struc");
-				}
+			if(this_function != NULL)
+				function_rollup(this_function);
+			this_function = function_start(this_module, this_process, this_list[i].name,
+				this_list[i].base, this_list[i].len, rva_sample[k]);
 			this_list[i].this_function = this_function;
-			this_function->function_name = this_list[i].name;
-			this_function->function_mangled_name = this_list[i].name;
-			this_function->function_length = this_list[i].len;
-			this_function->function_rva_start = this_list[i].base;
-			this_function->first_rva = loop_sample;
-			this_function->this_module = this_module;
-			this_function->this_process = this_process;
-			this_function->next = global_func_stack;
-			if(global_func_stack != NULL)global_func_stack->previous = this_function;
-			global_func_stack = this_function;
-			global_func_count++;
-#ifdef DBUG
-			if(old_function != NULL)
-			fprintf(stderr," this_function address = %p, name = %s, len = %ld, rva_count = %d, total_rvas = %d, cycle_samples= %d, total_samples = %d\n",
-				old_function, old_function->function_name,old_function->function_length, old_rva_count,total_rva_count, old_function->cycle_count, old_function->total_sample_count);
-#endif
-			}
-//		increment rva socket, total and module/process sample_count arrays
-		for(event = 0; event < num_events; event++)
-			{
-			for(core = 0; core < num_cores; core++)
-				{
-				this_function->cycle_count += loop_sample->sample_count[core];
-				if(loop_sample->sample_count[event*num_cores + core] != 0)
-					{
-					loop_sample->sample_count[num_events*(num_cores + num_sockets) + event] += 
-							loop_sample->sample_count[event*num_cores + core];
-					this_function->sample_count[num_events*(num_cores + num_sockets) + event] += 
-							loop_sample->sample_count[event*num_cores + core];
-					this_function->sample_count[event*num_cores + core] += loop_sample->sample_count[event*num_cores + core];
-//		per socket accumulation missing at this time due to lack of topology
-//					global_sample_count_in_func += loop_sample->sample_count[event*num_cores + core];
-					}
-				}
+			current = i;
 			}
-#ifdef DBUG
-//      follow a single address through if there are worries about lost samples/rva struc's
-//		if(loop_sample->rva == 0x43e110)fprintf(stderr,"agggregate function for address 0x43e110, cycle count = %d, function name = %s\n",
-//				loop_sample->sample_count[num_events*(num_cores + num_sockets)], this_function->function_name);
-//		if(loop_sample->rva == 0x43e111)fprintf(stderr,"agggregate function for address 0x43e111, cycle count = %d, function name = %s\n",
-//				loop_sample->sample_count[num_events*(num_cores + num_sockets)],this_function->function_name);
-#endif
-//		aggregate the derived events
-		if(source_index != 0)
-			this_function->sample_count[source_index] += loop_sample->sample_count[source_index];
-		if(target_index != 0)
-			this_function->sample_count[target_index] += loop_sample->sample_count[target_index];
-		if(next_taken_index != 0)
-			this_function->sample_count[next_taken_index] += loop_sample->sample_count[next_taken_index];
-
-//			aggregate call_list into functions sources list
-		this_branch = loop_sample->return_list;
-		if(this_branch != NULL)
-			{
-#ifdef DBUG
-			fprintf(stderr,"return_list non zero for function %s, at address 0x%"PRIx64"\n",
-				this_function->function_name,loop_sample->rva);
-			fprintf(stderr," return_list count = %d from address 0x%"PRIx64"\n",this_branch->count, this_branch->address);
-			fprintf(stderr,"function_accumulate: &this_function->sources = %p\n",&this_function->sources);
-#endif
-			this_function->total_sources += loop_sample->total_sources;
-			srctrg = 0;
-			branch_accumulate(&this_function->sources, this_branch, loop_sample, this_function, srctrg);
-#ifdef DBUG
-			fprintf(stderr,"function_accumulate: this_function->sources = %p\n",this_function->sources);
-			fprintf(stderr,"function_accumulate: &this_function->sources = %p\n",&this_function->sources);
-#endif
-			}
-
-//			aggregate call_list into functions sources list
-		this_branch = loop_sample->call_list;
-		if(this_branch != NULL)
-			{
-#ifdef DBUG
-			fprintf(stderr,"call_list non zero for function %s, at address 0x%"PRIx64"\n",
-				this_function->function_name,loop_sample->rva);
-			fprintf(stderr," call_list count = %d from address 0x%"PRIx64"\n",this_branch->count, this_branch->address);
-			fprintf(stderr,"function_accumulate: &this_function->targets = %p\n",&this_function->targets);
-#endif
-			this_function->total_targets += loop_sample->total_targets;
-			srctrg = 1;
-			branch_accumulate(&this_function->targets, this_branch, loop_sample, this_function, srctrg);
-#ifdef DBUG
-			fprintf(stderr,"function_accumulate: this_function->targets = %p\n",this_function->targets);
-			fprintf(stderr,"function_accumulate: &this_function->targets = %p\n",&this_function->targets);
-#endif
-			}
-
-		if(this_function != NULL)this_function->total_sample_count += loop_sample->total_sample_count;
-#ifdef DBUG
-		if(strcmp(this_function->function_name, "context_switch.isra.59") == 0)
-				printf_rva(loop_sample, this_function, this_function->this_process);
-#endif
-		rva_count++;
-		total_rva_count++;
-		total_function_sample_count += loop_sample->total_sample_count;
-		global_sample_count_in_func += loop_sample->total_sample_count;
-		if(rva_count == 1)old_function = this_function;
-		loop_sample = loop_sample->next;
+		function_add_rva(this_function, rva_sample[k], event_total);
 		}
-	return;
+	if(this_function != NULL)
+		function_rollup(this_function);
+	if(unknown_function != NULL)
+		{
+		function_rollup(unknown_function);
+		gooda_log(GLOG_VERBOSE," %d samples outside the functions of %s kept as [unknown]\n",
+			unknown_function->total_sample_count,this_module->path);
+		}
+
+	free(event_total);
+	free(rva);
+	free(rva_sample);
+	free(rva_func);
+	free(func_base);
+	free(func_end);
 }
 
 pointer_data * 
@@ -1832,9 +1266,7 @@ sort_global_func_list(void)
 	module_struc_ptr this_module;
 	process_struc_ptr this_process;
 	char *old_name, *new_name;
-	char demangle[] = "c++filt ";
-	size_t demangle_len = 8, funcname_len, line_buf_len = 1024;
-	char * funcname_cmd, line_buf[1024];
+	size_t funcname_len;
 
 #ifdef DBUG
 	fprintf(stderr," in sort_global_func_list, global_func_count = %d\n",global_func_count);
@@ -1861,20 +1293,22 @@ sort_global_func_list(void)
 		fprintf(stderr," too few functions in linked list i = %d, global_func_count = %d\n",i,global_func_count);
 		err(1,"too few functions in linked list in sort_global_func");
 		}
-	quickSort2(global_func_list,global_func_count);
+	sort_pointer(global_func_list,global_func_count);
 //	print data on up to the hotteest 10 functions to the log
 	func_limit = global_func_count - 10;
 	if(func_limit < 1) func_limit=1;
 	for(i=global_func_count; i >= func_limit; i--)
 		{
 		this_function = (function_struc_ptr) global_func_list[i-1].ptr;
-		fprintf(stderr," function = %s, total_sample_count = %d\n",this_function->function_name,this_function->total_sample_count);
+		gooda_log(GLOG_VERBOSE," function = %s, total_sample_count = %d\n",this_function->function_name,this_function->total_sample_count);
 		}
-//	set each function_struc's funclist_index value
+//	set each function_struc's funclist_index value, [unknown] buckets have no reports and keep -1
+	j = 0;
 	for(i=global_func_count; i>= 1; i--)
 		{
 		this_function = (function_struc_ptr) global_func_list[i-1].ptr;
-		this_function->funclist_index = global_func_count - i;
+		if(!function_is_unknown(this_function))
+			this_function->funclist_index = j++;
 		}
 	total_samples = global_sample_count_in_func + global_branch_sample_count;
 #ifdef DBUG
@@ -1917,7 +1351,8 @@ sort_global_func_list(void)
 			}
 		free(new_name);
 		i--;
-		summed_samples+=this_function->total_sample_count;
+		if(!function_is_unknown(this_function))
+			summed_samples+=this_function->total_sample_count;
 		}
 	return global_func_list;
 }
@@ -1951,7 +1386,7 @@ src_trg_func_list(pointer_data * global_func_list)
 				j++;
 				this_branch = this_branch->next;
 				}
-			quickSort2(branch_array,this_function->func_sources);
+			sort_pointer(branch_array,this_function->func_sources);
 //			going through the array in order will put the linked list into descending order
 			for(j=0; j < this_function->func_sources; j++)
 				{
@@ -1979,7 +1414,7 @@ src_trg_func_list(pointer_data * global_func_list)
 				j++;
 				this_branch = this_branch->next;
 				}
-			quickSort2(branch_array,this_function->func_targets);
+			sort_pointer(branch_array,this_function->func_targets);
 //			going through the array in order will put the linked list into descending order
 			for(j=0; j < this_function->func_targets; j++)
 				{
@@ -2004,6 +1439,112 @@ src_trg_func_list(pointer_data * global_func_list)
 	return;
 }
 
+//	optional columns appended to the function hotspot and asm spreadsheets after
+//	the event columns: the load latency and data source profile when the input
+//	had memory samples, the calling context tree totals when it had callchains,
+//	the LBR taken and mispredicted counts when the LBRs carried prediction bits
+//	and the block latencies when they carried cycles
+#define NUM_MEM_COL	(2 + MEM_LAT_BUCKETS + NUM_MEM_SRC)
+#define NUM_CCT_COL	2
+#define NUM_LBR_COL	3
+#define NUM_CYC_COL	(4 + MEM_LAT_BUCKETS)
+
+static char *mem_src_name[NUM_MEM_SRC] = {"L1", "LFB", "L2", "L3", "Local_DRAM", "Remote", "HITM", "Other"};
+
+static int
+extra_column_count(void)
+{
+	return (mem_sample_count > 0 ? NUM_MEM_COL : 0) + (cct_sample_count > 0 ? NUM_CCT_COL : 0)
+		+ (lbr_outcome_count > 0 ? NUM_LBR_COL : 0) + (lbr_cycles_count > 0 ? NUM_CYC_COL : 0);
+}
+
+static void
+extra_column_names(FILE *sh)
+{
+	int i;
+
+	if(mem_sample_count > 0)
+		{
+		fprintf(sh," \"Mem_Samples\", \"Avg_Latency\",");
+		fprintf(sh," \"Lat_0\",");
+		for(i=1; i < MEM_LAT_BUCKETS - 1; i++)fprintf(sh," \"Lat_%d-%d\",",1 << (i-1), (1 << i) - 1);
+		fprintf(sh," \"Lat_%d+\",",1 << (MEM_LAT_BUCKETS - 2));
+		for(i=0; i < NUM_MEM_SRC; i++)fprintf(sh," \"Src_%s\",",mem_src_name[i]);
+		}
+	if(cct_sample_count > 0)
+//		first event only, cg/cct_functions.csv has every event
+		fprintf(sh," \"CCT_Inclusive %s\", \"CCT_Exclusive %s\",",event_list[0].name,event_list[0].name);
+	if(lbr_outcome_count > 0)
+		fprintf(sh," \"LBR_Taken\", \"LBR_Mispredicted\", \"Mispredict_Rate\",");
+	if(lbr_cycles_count > 0)
+		{
+		fprintf(sh," \"LBR_Blocks\", \"Block_Cycles\", \"Loop_Iterations\", \"Loop_Cycles\",");
+		fprintf(sh," \"Cyc_0\",");
+		for(i=1; i < MEM_LAT_BUCKETS - 1; i++)fprintf(sh," \"Cyc_%d-%d\",",1 << (i-1), (1 << i) - 1);
+		fprintf(sh," \"Cyc_%d+\",",1 << (MEM_LAT_BUCKETS - 2));
+		}
+}
+
+static void
+extra_column_ctrl(FILE *sh, int first_col)
+{
+	int i, n = extra_column_count();
+
+	for(i=0; i < n; i++)fprintf(sh,"\"%d:0\",",first_col + i);
+}
+
+static void
+extra_column_fill(FILE *sh, char *val)
+{
+	int i, n = extra_column_count();
+
+	for(i=0; i < n; i++)fprintf(sh," %s,",val);
+}
+
+//	this_function is NULL for rows without calling context totals
+static void
+extra_column_data(FILE *sh, mem_stats_ptr mem, lbr_outcome_data *lbr, block_cycles_ptr cyc, function_struc_ptr this_function)
+{
+	int i;
+
+	if(mem_sample_count > 0)
+		{
+		if(mem == NULL)
+			{
+			for(i=0; i < NUM_MEM_COL; i++)fprintf(sh," 0,");
+			}
+		else
+			{
+			fprintf(sh," %d, %.1f,",mem->count, mem->count ? (double)mem->lat_sum/(double)mem->count : 0.);
+			for(i=0; i < MEM_LAT_BUCKETS; i++)fprintf(sh," %d,",mem->lat_hist[i]);
+			for(i=0; i < NUM_MEM_SRC; i++)fprintf(sh," %d,",mem->src_count[i]);
+			}
+		}
+	if(cct_sample_count > 0)
+		{
+		if(this_function == NULL)
+			fprintf(sh," 0, 0,");
+		else
+			fprintf(sh," %d, %d,",this_function->cct_inclusive, this_function->cct_exclusive);
+		}
+	if(lbr_outcome_count > 0)
+		fprintf(sh," %d, %d, %.4f,",lbr->taken, lbr->mispredict,
+			lbr->taken ? (double)lbr->mispredict/(double)lbr->taken : 0.);
+	if(lbr_cycles_count > 0)
+		{
+		if(cyc == NULL)
+			{
+			for(i=0; i < NUM_CYC_COL; i++)fprintf(sh," 0,");
+			}
+		else
+			{
+			fprintf(sh," %d, %.1f, %d, %.1f,",cyc->count, cyc->count ? (double)cyc->cyc_sum/(double)cyc->count : 0.,
+				cyc->loop_count, cyc->loop_count ? (double)cyc->loop_cyc_sum/(double)cyc->loop_count : 0.);
+			for(i=0; i < MEM_LAT_BUCKETS; i++)fprintf(sh," %d,",cyc->cyc_hist[i]);
+			}
+		}
+}
+
 void 
 hotspot_function(pointer_data * global_func_list)
 {
@@ -2063,36 +1604,43 @@ hotspot_function(pointer_data * global_func_list)
 	fprintf(sh,"[, , , \"%s\", \"%s\", \"%s\", \"%s\", \"%s\",",function_name,offset,length,module,process);
 //	for(i=0; i < num_events; i++)fprintf(sh," \"%s\",",event_list[i].name);
 	for(i=0; i < num_col; i++)fprintf(sh," \"%s\",",global_event_order->order[i].name);
+	extra_column_names(sh);
 //	fprintf(sh,"null],\n");
 	fprintf(sh," ],\n");
 	fprintf(sh,"[, , , \"0:4\",");
 	for(k=1;k<5;k++)fprintf(sh," \"0_%d:0\",",k);
 	for(k=0;k<num_col;k++)fprintf(sh,"\"%d%s\",",1+global_event_order->order[k].base_col,global_event_order->order[k].ctrl_string);
+	extra_column_ctrl(sh, 2+global_event_order->order[num_col-1].base_col);
 	fprintf(sh," ],\n");
 //	fprintf(sh,"[null,\"MSR Programmings\",null,null,null,null,");
 	fprintf(sh,"[, , , \"MSR Programmings\", null, null, null, null,");
 //	for(i=0; i < num_events; i++)fprintf(sh," \"0x%"PRIx64"\",",global_attrs[i].attr.config);
 //	for(i=0; i < num_col; i++)fprintf(sh," \"0x%"PRIx64"\",",global_event_order->order[i].config);
 	for(i=0; i < num_col; i++)fprintf(sh,"0x%"PRIx64",",global_event_order->order[i].config);
+	extra_column_fill(sh, "0x0");
 //	fprintf(sh,"null],\n");
 	fprintf(sh," ],\n");
 //	fprintf(sh,"[null,\"Period\",null,null,null,null,");
 	fprintf(sh,"[, , , \"Period\", , , , ,");
 //	for(i=0; i < num_events; i++)fprintf(sh," %d,",global_attrs[i].attr.sample.sample_period);
 	for(i=0; i < num_col; i++)fprintf(sh," %ld,",global_event_order->order[i].Period);
+	extra_column_fill(sh, "0");
 //	fprintf(sh,"null],\n");
 	fprintf(sh," ],\n");
 //	fprintf(sh,"[null,\"Multiplex\",null,null,null,null,");
 	fprintf(sh,"[, , , \"Multiplex\", , , , ,");
 //	for(i=0; i < num_events; i++)fprintf(sh," %5.4lf,",global_multiplex_correction[num_events*(num_cores+num_sockets) + i]);
 	for(i=0; i < num_col; i++)fprintf(sh," %5.4lf,",global_event_order->order[i].multiplex);
+	extra_column_fill(sh, "1.0000");
 //	fprintf(sh,"null],\n");
 	fprintf(sh," ],\n");
 	fprintf(sh,"[, , , \"Penalty\", , , , ,");
 	for(k=0; k < num_col; k++)fprintf(sh," %d,",global_event_order->order[k].penalty);
+	extra_column_fill(sh, "0");
 	fprintf(sh," ],\n");
 	fprintf(sh,"[, , , \"Cycles\", , , , ,");
 	for(k=0; k < num_col; k++)fprintf(sh," %d,",global_event_order->order[k].cycle);
+	extra_column_fill(sh, "0");
 	fprintf(sh," ],\n");
 
 	total_samples = global_sample_count_in_func + global_branch_sample_count;
@@ -2104,7 +1652,7 @@ hotspot_function(pointer_data * global_func_list)
 
 	summed_samples = 0.;
 	i = global_func_count - 1;
-	fprintf(stderr,"hotspot_function: global_func_count = %d, func_cutoff = %d\n",global_func_count, func_cutoff);
+	gooda_log(GLOG_VERBOSE,"hotspot_function: global_func_count = %d, func_cutoff = %d\n",global_func_count, func_cutoff);
 	while((i >= 0) && (summed_samples/total_samples < sum_cutoff))
 		{
 		this_function = (function_struc_ptr) global_func_list[i].ptr;
@@ -2137,8 +1685,9 @@ hotspot_function(pointer_data * global_func_list)
 //		this may have been invoked in func_asm
 		if(this_function->called_branch_eval == 0)branch_eval(this_function->sample_count);
 		for(j=0; j<num_col; j++)fprintf(sh," %d,",this_function->sample_count[ global_event_order->order[j].index ]);
+		extra_column_data(sh, this_function->mem, &this_function->lbr, this_function->cycles, this_function);
 		fprintf(sh," ],\n");
-		if(i > global_func_count - func_cutoff)
+		if((this_function->funclist_index >= 0) && (this_function->funclist_index < func_cutoff - 1))
 			{
 //	print out the most active sources and targets
 //		sources first
@@ -2242,7 +1791,8 @@ hotspot_function(pointer_data * global_func_list)
 			}
 #endif
 		i--;
-		summed_samples+=this_function->total_sample_count;
+		if(!function_is_unknown(this_function))
+			summed_samples+=this_function->total_sample_count;
 #ifdef DBUG
 		fprintf(stderr,"hotspot_function: i = %d,summed_samples = %g, total_samples = %g, sum_cutoff = %g\n",
 			i, summed_samples, total_samples, sum_cutoff);
@@ -2264,12 +1814,11 @@ hotspot_call_graph(pointer_data * global_func_list)
 {
 	FILE *dot;
 	int i,j,k,l,m,n,count,max_count=0,node_count,link_count,hot_func_limit, max_sample_count,max_link_count;
-	int fillcolor, penwidth,label,dot_len,svg_len,pos;
+	int fillcolor, penwidth,label,pos;
 	float total_samples,summed_samples;
 	uint64_t address,old_node;
 	char dot_file[]="spreadsheets/cg/0_cg.dot", svg_file[]="spreadsheets/cg/0_cg.svg";
 	char mode[] = "w+";
-	char * svg_cmd;
 	char short_name[13];
 	size_t name_len, max_name_len = 12;
 	process_struc_ptr this_process, main_process;
@@ -2292,15 +1841,14 @@ hotspot_call_graph(pointer_data * global_func_list)
 	total_samples = global_sample_count_in_func + global_branch_sample_count;
 	summed_samples = 0.;
 	main_process = principal_process_stack;
-	fprintf(stderr,"hotspot_call_graph: main process is %s\n",main_process->name);
+	gooda_log(GLOG_VERBOSE,"hotspot_call_graph: main process is %s\n",main_process->name);
 	node_count = 0;
 	link_count = 0;
 	max_sample_count = 0;
 	max_link_count = 0;
 
 	i = global_func_count - 1;
-	hot_func_limit = global_func_count - func_cutoff;
-	if(hot_func_limit < 0) hot_func_limit=0;
+	hot_func_limit = hot_func_floor(global_func_list, func_cutoff);
 
 #ifdef DBUG
 	fprintf(stderr," total_samples = %g, sum_cutoff = %g, func_cutoff = %d, hot_func_limit = %d, initial i = %d\n",
@@ -2311,6 +1859,11 @@ hotspot_call_graph(pointer_data * global_func_list)
 		{
 		this_function = (function_struc_ptr) global_func_list[i].ptr;
 		count = global_func_list[i].val;
+		if(function_is_unknown(this_function))
+			{
+			i--;
+			continue;
+			}
 		summed_samples += count;
 		this_module = this_function->this_module;
 		this_process = this_function->this_process;
@@ -2459,6 +2012,11 @@ hotspot_call_graph(pointer_data * global_func_list)
 		{
 		this_function = (function_struc_ptr) global_func_list[i].ptr;
 		count = global_func_list[i].val;
+		if(function_is_unknown(this_function))
+			{
+			i--;
+			continue;
+			}
 		summed_samples += count;
 		this_module = this_function->this_module;
 		this_process = this_function->this_process;
@@ -2472,7 +2030,7 @@ hotspot_call_graph(pointer_data * global_func_list)
 			continue;
 			}
 		node_list[j].src_trg = (uint64_t)this_function;
-		node_list[j].index = global_func_count - i - 1;
+		node_list[j].index = this_function->funclist_index;
 		j++;
 		this_source = this_function->sources;
 #ifdef DBUG
@@ -2535,8 +2093,8 @@ hotspot_call_graph(pointer_data * global_func_list)
 //	sort the node list
 	if(j != node_count+link_count)
 		err(1,"second loop did not find as many nodes as the first j = %d, node_count + link_count = %d\n",j,node_count+link_count);
-	quickSort_link(node_list,node_count+link_count);
-	quickSort_link(linkpairs,link_count);
+	radix_sort(node_list, node_count+link_count, sizeof(linkpairs_data), offsetof(linkpairs_data, src_trg), RADIX_KEY_U64);
+	radix_sort(linkpairs, link_count, sizeof(linkpairs_data), offsetof(linkpairs_data, src_trg), RADIX_KEY_U64);
 
 #ifdef DBUG
 	fprintf(stderr,"back from sorters\n");
@@ -2666,12 +2224,7 @@ hotspot_call_graph(pointer_data * global_func_list)
 		}
 	fprintf(dot,"}\n");
 	fclose(dot);
-	dot_len = strlen(dot_file);
-	svg_len = strlen(svg_file);
-	svg_cmd = (char*)malloc(20+dot_len+svg_len);
-	sprintf(svg_cmd,"dot -Tsvg %s > %s\0",dot_file,svg_file);
-	ret_val = system(svg_cmd);
-	if(ret_val == -1)fprintf(stderr,"system call of dot -Tsvg failed in hotspot_call_graph");
+	render_dot(dot_file, svg_file);
 	free(link_data);
 	free(linkpairs);
 	free(node_list);
@@ -2894,7 +2447,7 @@ arm32_branch_function_old(char* field2)
 	branch_type.indirect_jmp = 0;
 
 	instruction_len = strlen(field2);
-	fprintf(stderr," encoded instruction length = %d\n",instruction_len);
+	gooda_log(GLOG_DEBUG," encoded instruction length = %d\n",instruction_len);
 
 	// ARM ARM A8.8.18
 	// B branches
@@ -2910,7 +2463,7 @@ arm32_branch_function_old(char* field2)
 			  // B branches
 			  branch_type.branch = 2; /* why 2? */
 	}
-	fprintf(stderr,"test 1 branch_type.branch = %d\n",branch_type.branch);
+	gooda_log(GLOG_DEBUG,"test 1 branch_type.branch = %d\n",branch_type.branch);
 
 	// ARM ARM A8.8.29
 	// CBZ/CBNZ compare and branch
@@ -2921,7 +2474,7 @@ arm32_branch_function_old(char* field2)
 		 // CBZ/CBNZ branches
 		 branch_type.branch = 2;
 	}
-	fprintf(stderr,"test 2 branch_type.branch = %d\n",branch_type.branch);
+	gooda_log(GLOG_DEBUG,"test 2 branch_type.branch = %d\n",branch_type.branch);
 
 	// ARM ARM A8.8.27 & A8.8.28    
 	// BX/BXJ branch and exchange
@@ -2935,7 +2488,7 @@ arm32_branch_function_old(char* field2)
 		 // BX/BXJ branches
 		 branch_type.branch = 2;
 	}
-	fprintf(stderr,"test 3 branch_type.branch = %d\n",branch_type.branch);
+	gooda_log(GLOG_DEBUG,"test 3 branch_type.branch = %d\n",branch_type.branch);
 
 	// ARM ARM A8.8.236
 	// TBB/TBH table branch
@@ -2943,7 +2496,7 @@ arm32_branch_function_old(char* field2)
 	if ( (field2[0] == 'e') && (field2[1] == '8') && (field2[3] == 'd') && ( (field2[6] == '0') ||  (field2[6] == '1') ) ) {
 		 branch_type.branch = 2;
 	}
-	fprintf(stderr,"test 4 branch_type.branch = %d\n",branch_type.branch);
+	gooda_log(GLOG_DEBUG,"test 4 branch_type.branch = %d\n",branch_type.branch);
 
 	// ARM ARM A8.8.25
 	// BL/BLX calls
@@ -2958,7 +2511,7 @@ arm32_branch_function_old(char* field2)
 		 branch_type.call = 1; /* same question why call = 1? */
 		 branch_type.branch = 2;
 	}
-	fprintf(stderr,"test 5 branch_type.branch = %d\n",branch_type.branch);
+	gooda_log(GLOG_DEBUG,"test 5 branch_type.branch = %d\n",branch_type.branch);
 
 	// ARM ARM A8.8.26
 	// BLX reg (T1 encoding 16-bit [0100|0111|1xxx|xxxx])
@@ -2969,7 +2522,7 @@ arm32_branch_function_old(char* field2)
 		 branch_type.call = 1;
 		 branch_type.branch = 2;
 	}
-	fprintf(stderr,"test 6 branch_type.branch = %d\n",branch_type.branch);
+	gooda_log(GLOG_DEBUG,"test 6 branch_type.branch = %d\n",branch_type.branch);
 	// ARM ARM A4.3 (for further explanation)
 	// The following are left for completion, as there may be an easier way to extract r15/pc from 
 	// the objdump rather than decoding all instructions of the following types:
@@ -3201,6 +2754,26 @@ branch_function_init(void)
 	return;
 }
 
+//	ends the taken edge of a CFG basic block. With LBR prediction bits the
+//	edge is labeled mispredicted/taken for the branch ending the block and its
+//	width follows the mispredicts, the LBR never sees the fall through edges
+static void
+cfg_taken_edge(FILE *dot, basic_block_struc_ptr this_bb, int max_mispredict)
+{
+	int penwidth;
+
+	if((lbr_outcome_count == 0) || (this_bb->lbr.taken == 0))
+		{
+		fprintf(dot,";\n");
+		return;
+		}
+	penwidth = 1;
+	if(max_mispredict > 0)
+		penwidth = 9*this_bb->lbr.mispredict/max_mispredict + 1;
+	fprintf(dot," [penwidth = %d, color=%s, label=\"%d/%d\"];\n",penwidth,
+		this_bb->lbr.mispredict > 0 ? "red" : "black", this_bb->lbr.mispredict, this_bb->lbr.taken);
+}
+
 int 
 func_asm(pointer_data * global_func_list, int index)
 {
@@ -3208,7 +2781,7 @@ func_asm(pointer_data * global_func_list, int index)
 	FILE * list, *objout, *dot;
 	char spread[]="./spreadsheets", asmd[]="./spreadsheets/asm/", cfg[]="./spreadsheets/cfg/", src[]="./spreadsheets/src/";
 	char  sheetname[] = "_asm.csv", cfg_name[] = "_cfg.dot", obj1[] = " -d --start-address=0x", obj2[] = " --stop-address=0x";
-	char svg_name[] = "_cfg.svg", *svg_cmd, *svg_file;
+	char svg_name[] = "_cfg.svg", *svg_file;
 	char* spreadsheet,* cfg_file;
 	char null_string[] = " null";
 	int null_string_len=5, filename_len, asmd_len, cfg_len, cfg_name_len;
@@ -3224,7 +2797,7 @@ func_asm(pointer_data * global_func_list, int index)
 	sample_struc_ptr loop_rva;
 	asm_struc_ptr this_asm=NULL, next_asm=NULL, previous_asm=NULL, loop_asm=NULL, old_loop_asm;
 	basic_block_struc_ptr this_bb=NULL, next_bb=NULL, previous_bb=NULL, loop_bb=NULL, target_bb, last_bb_struc;
-	int *sample_count, asm_total_sample_count, asm_cycle_count;
+	int *sample_count, asm_total_sample_count, asm_cycle_count, rva_event_count;
 	float summed_samples, total_samples;
 	size_t base, end;
 	int count, branch, branch_count, call, first_bb, last_bb, bb_count, deadbeef, first_src_bb;
@@ -3237,7 +2810,7 @@ func_asm(pointer_data * global_func_list, int index)
 	int min_file_line, max_file_line, source_line_count, *source_sample_count, sample_count_max, sample_count_line;
 	addr_list_data * bb_addr_list;
 	float color_index;
-	int fillcolor,max_bb_count=0;
+	int fillcolor,max_bb_count=0,max_bb_mispredict=0;
 
 	typedef struct next_taken_struc* next_taken_struc_ptr;
 	typedef struct next_taken_struc{
@@ -3264,7 +2837,6 @@ func_asm(pointer_data * global_func_list, int index)
 	next_taken_stack = NULL;
 
 	i = index;
-	hotspot_index = global_func_count - 1 - index;
 
 	max_file_line = 0;
 	min_file_line = 1000000;
@@ -3279,6 +2851,7 @@ func_asm(pointer_data * global_func_list, int index)
 	last_bb_end = 0;
 		
 	this_function = (function_struc_ptr) global_func_list[i].ptr;
+	hotspot_index = this_function->funclist_index;
 	count = global_func_list[i].val;
 	this_module = this_function->this_module;
 	this_process = this_function->this_process;
@@ -3338,21 +2911,10 @@ func_asm(pointer_data * global_func_list, int index)
 #ifdef DBUG
 	fprintf(stderr," module local_path = %s, asm_2_src_status = %d\n",this_module->local_path,asm_2_src_status);
 #endif
-//	create the objdump command for this module and function
-	module_len = strlen(this_function->this_module->local_path);
-	obj_cmd = (char*)malloc((objdump_len + obj1_len + 16 + obj2_len + 16 + module_len +1)*sizeof(char));
-	if(obj_cmd == NULL)
-		{
-		fprintf(stderr,"failed to malloc obj_cmd for %s, %s\n",filename, this_function->this_module->local_path);
-		err(1,"failed to malloc obj_cmd space");
-		}
+//	objdump output for the function, from the module level pass run by hot_list
 	base = this_function->function_rva_start;
 	end = base + this_function->function_length - 1;
-	sprintf(obj_cmd,"%s%s%"PRIx64"%s%"PRIx64" %s\0",objdump_bin,obj1,base,obj2,end,this_function->this_module->local_path);
-#ifdef DBUG
-	fprintf(stderr," obj command = %s\n",obj_cmd);
-#endif
-	objout = popen(obj_cmd, "r");
+	objout = disasm_open(this_module, base, end);
 	line_count = 0;
 	asm_count = 0;
 	while(fgets(line_buf,line_buf_len,objout) != NULL)
@@ -3788,16 +3350,21 @@ func_asm(pointer_data * global_func_list, int index)
 				asm_cycle_count += this_asm->sample_count[num_events*(num_cores + num_sockets)];
 				for(k=0;k<num_events; k++)
 					{
-					this_asm->sample_count[num_events*(num_cores + num_sockets) + k] += 
-						loop_rva->sample_count[num_events*(num_cores + num_sockets) + k];
-					asm_total_sample_count += loop_rva->sample_count[num_events*(num_cores + num_sockets) + k];
+					rva_event_count = sample_count_get(loop_rva, num_events*(num_cores + num_sockets) + k);
+					this_asm->sample_count[num_events*(num_cores + num_sockets) + k] += rva_event_count;
+					asm_total_sample_count += rva_event_count;
 					}
 				if(source_index != 0)
-					this_asm->sample_count[source_index] += loop_rva->sample_count[source_index];
+					this_asm->sample_count[source_index] += sample_count_get(loop_rva, source_index);
 				if(target_index != 0)
-					this_asm->sample_count[target_index] += loop_rva->sample_count[target_index];
+					this_asm->sample_count[target_index] += sample_count_get(loop_rva, target_index);
 				if(next_taken_index != 0)
-					this_asm->sample_count[next_taken_index] += loop_rva->sample_count[next_taken_index];
+					this_asm->sample_count[next_taken_index] += sample_count_get(loop_rva, next_taken_index);
+				if(loop_rva->mem != NULL)
+					mem_stats_merge(&this_asm->mem, loop_rva->mem);
+				this_asm->lbr.taken += loop_rva->lbr.taken;
+				this_asm->lbr.mispredict += loop_rva->lbr.mispredict;
+				block_cycles_merge(&this_asm->cycles, loop_rva->cycles);
 #ifdef DBUG
 		if(strcmp(this_function->function_name, "context_switch.isra.59") == 0) 
 				printf_rva(loop_rva, this_function, this_function->this_process);
@@ -3965,7 +3532,7 @@ func_asm(pointer_data * global_func_list, int index)
 	fprintf(stderr," last address = 0x%"PRIx64", j = %d\n",branch_address[j],j);
 	fprintf(stderr," calling quicksort64 with %d addresses\n",(j+1) );
 #endif
-	quickSort64(branch_address, j+2);
+	sort_u64(branch_address, j+2);
 #ifdef DBUG
 	fprintf(stderr," base address = 0x%"PRIx64", end = 0x%"PRIx64"\n",base,end);
 	fprintf(stderr,"first branch = 0x%"PRIx64"\n",branch_address[0]);
@@ -4078,11 +3645,13 @@ func_asm(pointer_data * global_func_list, int index)
 				this_bb->sample_count[next_taken_index] += loop_asm->sample_count[next_taken_index];
 			this_bb->total_sample_count += loop_asm->total_sample_count;
 			if(this_bb->total_sample_count > max_bb_count)max_bb_count = this_bb->total_sample_count;
+			block_cycles_merge(&this_bb->cycles, loop_asm->cycles);
 //		these are defined by the last instruction of the block
 			this_bb->end_address = loop_asm->address;
 			this_bb->call = loop_asm->call;
 			this_bb->branch = loop_asm->branch;
 			this_bb->encoding = loop_asm->encoding;
+			this_bb->lbr = loop_asm->lbr;
 #ifdef DBUG
 			fprintf(stderr," this_bb address = 0x%"PRIx64", end_address = 0x%"PRIx64"\n",this_bb->address, this_bb->end_address);
 #endif
@@ -4372,6 +3941,8 @@ func_asm(pointer_data * global_func_list, int index)
 					this_bb->sample_count[next_taken_index] += loop_asm->sample_count[next_taken_index];
 				this_bb->total_sample_count += loop_asm->total_sample_count;
 				if(this_bb->total_sample_count > max_bb_count)max_bb_count = this_bb->total_sample_count;
+				this_bb->lbr = loop_asm->lbr;
+				block_cycles_merge(&this_bb->cycles, loop_asm->cycles);
 				loop_asm = loop_asm->next;
 				}
 			this_bb->end_address = end;
@@ -4431,6 +4002,8 @@ func_asm(pointer_data * global_func_list, int index)
                                         this_bb->sample_count[next_taken_index] += loop_asm->sample_count[next_taken_index];
                                 this_bb->total_sample_count += loop_asm->total_sample_count;
                                 if(this_bb->total_sample_count > max_bb_count)max_bb_count = this_bb->total_sample_count;
+                                this_bb->lbr = loop_asm->lbr;
+                                block_cycles_merge(&this_bb->cycles, loop_asm->cycles);
                                 loop_asm = loop_asm->next;
                                 }
 #ifdef DBUG
@@ -4478,6 +4051,7 @@ func_asm(pointer_data * global_func_list, int index)
 		last_bb_end = this_bb->end_address;
 		if(bb_exec_index != 0)
 			this_function->sample_count[bb_exec_index] += this_bb->sample_count[bb_exec_index];
+		if(this_bb->lbr.mispredict > max_bb_mispredict)max_bb_mispredict = this_bb->lbr.mispredict;
 #ifdef DBUG
 		fprintf(stderr," this_bb %d, address = 0x%"PRIx64", end_address = 0x%"PRIx64", len = 0x%"PRIx64"",k,this_bb->address, this_bb->end_address,bb_addr_list[k].len);
 		if(bb_exec_index != 0)
@@ -4501,12 +4075,14 @@ func_asm(pointer_data * global_func_list, int index)
 #endif
 	if(bb_exec_index != 0)
 		{
+		pthread_mutex_lock(&report_count_lock);
 		this_module->sample_count[bb_exec_index] += this_function->sample_count[bb_exec_index];
 		this_module->sample_count[sw_inst_retired_index] += this_function->sample_count[sw_inst_retired_index];
 		this_process->sample_count[bb_exec_index] += this_function->sample_count[bb_exec_index];
 		this_process->sample_count[sw_inst_retired_index] += this_function->sample_count[sw_inst_retired_index];
 		global_sample_count[bb_exec_index] += this_function->sample_count[bb_exec_index];
 		global_sample_count[sw_inst_retired_index] += this_function->sample_count[sw_inst_retired_index];
+		pthread_mutex_unlock(&report_count_lock);
 		}
 
 //	do the binary search on the targets to connect the BB's by number
@@ -4534,7 +4110,8 @@ func_asm(pointer_data * global_func_list, int index)
 				fprintf(stderr," returned from binsearch, target_bb = 0x%p\n", target_bb);
 				fprintf(stderr,"\t\"Basic Block %d\"->\"Basic Block %d\";\n",j,target_bb->block_count);
 #endif
-				fprintf(dot,"\t\"Basic Block %d\"->\"Basic Block %d\";\n",j,target_bb->block_count);
+				fprintf(dot,"\t\"Basic Block %d\"->\"Basic Block %d\"",j,target_bb->block_count);
+				cfg_taken_edge(dot, this_bb, max_bb_mispredict);
 				}
 			else
 				{
@@ -4542,7 +4119,8 @@ func_asm(pointer_data * global_func_list, int index)
 #ifdef DBUG
 				fprintf(stderr,"\t\"Basic Block %d\"->\"Addr %d\";\n",j,deadbeef);
 #endif
-				fprintf(dot,"\t\"Basic Block %d\"->\"Addr %d\";\n",j,deadbeef);
+				fprintf(dot,"\t\"Basic Block %d\"->\"Addr %d\"",j,deadbeef);
+				cfg_taken_edge(dot, this_bb, max_bb_mispredict);
 				if(this_bb->call != 0)
 					fprintf(dot,"\t\"Addr %d\"->\"Basic Block %d\";\n",deadbeef,this_bb->block_count+1);
 				}
@@ -4559,16 +4137,15 @@ func_asm(pointer_data * global_func_list, int index)
 	fprintf(dot,"}\n");
 	fclose(dot);
 		
-//	create svg command string
-	svg_cmd = (char*)malloc(20 + 2*cfg_len + 2*cfg_name_len);
-	sprintf(svg_cmd,"dot -Tsvg %s%d%s > %s%d%s\0",cfg,hotspot_index,cfg_name,cfg,hotspot_index,svg_name);
-#ifdef DBUG
-	fprintf(stderr," %d svg command = %s\n",i,svg_cmd);
-#endif
+//	queue the svg rendering
 	if(bb_count < max_bb)
 		{
-		ret_val = system(svg_cmd);
-		if(ret_val == -1)fprintf(stderr,"system call of dot -Tsvg failed in func_asm");
+		svg_file = (char*)malloc(20 + cfg_len + cfg_name_len);
+		if(svg_file == NULL)
+			err(1,"failed to malloc svg file name for %s",this_function->function_name);
+		sprintf(svg_file,"%s%d%s",cfg,hotspot_index,svg_name);
+		render_dot(cfg_file, svg_file);
+		free(svg_file);
 		}
 //	deal with single bb case
 
@@ -4581,26 +4158,33 @@ func_asm(pointer_data * global_func_list, int index)
 	fprintf(list,"[\n");
 	fprintf(list,"[,\"bb\",\"Address\",\"Princ_L#\",\"Principal File\",\"Init_L#\",\"Initial File\",\"Disassembly\",");
 	for(k=0; k < num_col; k++)fprintf(list," \"%s\",",global_event_order->order[k].name);
+	extra_column_names(list);
 	fprintf(list," ],\n");
 	fprintf(list,"[,");
 	for(k=0;k<2;k++)fprintf(list,"\"%d:0\",",k);
 	fprintf(list,"\"2:3\",\"2_1:0\",\"2_2:0\",\"2_3:0\",\"3:0\",");
 	for(k=0;k<num_col;k++)fprintf(list,"\"%d%s\",",4+global_event_order->order[k].base_col,global_event_order->order[k].ctrl_string);
+	extra_column_ctrl(list, 5+global_event_order->order[num_col-1].base_col);
 	fprintf(list," ],\n");
 	fprintf(list,"[,,,,,,,\"MSR Programmings\",");
 	for(k=0; k < num_col; k++)fprintf(list," 0x%"PRIx64",",global_event_order->order[k].config);
+	extra_column_fill(list, "0x0");
 	fprintf(list," ],\n");
 	fprintf(list,"[,,,,,,,\"Periods\",");
 	for(k=0; k < num_col; k++)fprintf(list," %ld,",global_event_order->order[k].Period);
+	extra_column_fill(list, "0");
 	fprintf(list," ],\n");
 	fprintf(list,"[,,,,,,,\"Multiplex\",");
 	for(i=0; i < num_col; i++)fprintf(list," %5.4lf,",global_event_order->order[i].multiplex);
+	extra_column_fill(list, "1.0000");
 	fprintf(list," ],\n");
 	fprintf(list,"[,,,,,,,\"Penalty\",");
 	for(k=0; k < num_col; k++)fprintf(list," %d,",global_event_order->order[k].penalty);
+	extra_column_fill(list, "0");
 	fprintf(list," ],\n");
 	fprintf(list,"[,,,,,,,\"Cycles\",");
 	for(k=0; k < num_col; k++)fprintf(list," %d,",global_event_order->order[k].cycle);
+	extra_column_fill(list, "0");
 	fprintf(list," ],\n");
 
 	this_bb = this_function->first_bb;
@@ -4628,6 +4212,7 @@ func_asm(pointer_data * global_func_list, int index)
 		fprintf(list,"[,%d,\"0x%"PRIx64"\",%d,,,, \"%s\",",k+1,this_bb->address, this_bb->source_line, this_bb->text);
 		branch_eval(this_bb->sample_count);
 		for(j=0; j<num_col; j++)fprintf(list," %d,",this_bb->sample_count[ global_event_order->order[j].index]);
+		extra_column_data(list, NULL, &this_bb->lbr, this_bb->cycles, NULL);
 		fprintf(list," ],\n");
 #ifdef DBUG
 		fprintf(stderr," this_bb address = 0x%"PRIx64", loop_asm address = 0x%"PRIx64", k = %d, bb end address = 0x%"PRIx64"\n",
@@ -4677,6 +4262,7 @@ func_asm(pointer_data * global_func_list, int index)
 				}
 			branch_eval(loop_asm->sample_count);
 			for(j=0; j<num_col; j++)fprintf(list," %d,",loop_asm->sample_count[ global_event_order->order[j].index ]);
+			extra_column_data(list, loop_asm->mem, &loop_asm->lbr, loop_asm->cycles, NULL);
 			fprintf(list," ],\n");
 			loop_asm = loop_asm->next;
 			if(loop_asm == NULL)break;
@@ -4705,11 +4291,12 @@ func_asm(pointer_data * global_func_list, int index)
 	fprintf(list,"[,%d,,,,,, \"%s\",",k+1,this_function->function_name);
 //	branch_eval already called from hotlist_function
 	for(j=0; j<num_col; j++)fprintf(list," %d,",this_function->sample_count[ global_event_order->order[j].index ]);
+	extra_column_data(list, this_function->mem, &this_function->lbr, this_function->cycles, this_function);
 	fprintf(list," ],\n");
 	fprintf(list,"]\n");
 
 //  insert */ here
-	pclose(objout);
+	fclose(objout);
 	fclose(list);
 	return this_function->total_sample_count;
 }
@@ -4757,7 +4344,6 @@ func_src(pointer_data * global_func_list, int index)
 	total_samples = global_sample_count_in_func;
 	summed_samples = 0;
 	i = index;
-	hotspot_index = global_func_count - 1 - index;
 
 	branch_count = 0;
 	this_asm = NULL;
@@ -4767,6 +4353,7 @@ func_src(pointer_data * global_func_list, int index)
 	previous_source_line = NULL;
 	
 	this_function = (function_struc_ptr) global_func_list[i].ptr;
+	hotspot_index = this_function->funclist_index;
 	if(this_function->principal_file == NULL)
 		{
 //	no symbols were available
@@ -5122,47 +4709,62 @@ func_src(pointer_data * global_func_list, int index)
 	fclose(list);
 }
 
+//	pool_run item k is the k-th hottest function
+static void
+hot_list_function(int item, void *arg)
+{
+	pointer_data * global_func_list = (pointer_data *)arg;
+	int i = global_func_count - 1 - item;
+
+//	an [unknown] bucket has no code to list
+	if(function_is_unknown((function_struc_ptr) global_func_list[i].ptr))
+		return;
+#ifdef DBUG
+	fprintf(stderr," calling func_asm for element %d, function = %s\n",i,((function_struc_ptr) global_func_list[i].ptr)->function_name);
+#endif
+	func_asm(global_func_list, i);
+	func_src(global_func_list, i);
+}
+
+static void
+hot_list_close(void *arg)
+{
+	if(old_module_path != NULL)asm_2_src_close();
+	old_module_path = NULL;
+}
+
 void * 
 hot_list(pointer_data * global_func_list)
 {
-	int i,j,k,tmp, tmp2, line_count, asm_count, index;
-	FILE * list, *objout;
-	char  spreadsheet[] = "_asm_spreadsheet.csv", obj1[] = "objdump -d --start-address=0x", obj2[] = " --stop-address=0x";
-	char * funcname, *filename, *obj_cmd, line_buf[1024];
-	char mode[] = "w+";
-	char field1[1024], field2[1024],field3[1024],target_address[80];
-	size_t funcname_len, spreadsheet_len = 20, line_buf_len = 1024, buf_len, obj1_len = 29, obj2_len = 18, module_len, asm_len;
+	int i, hot_func_limit;
 	function_struc_ptr this_function;
-	module_struc_ptr this_module;
-	sample_struc_ptr loop_rva;
-	asm_struc_ptr this_asm=NULL, next_asm=NULL, previous_asm=NULL, loop_asm=NULL;
-	basic_block_struc_ptr this_bb=NULL, next_bb=NULL, previous_bb=NULL, loop_bb=NULL;
-	int *sample_count;
 	float summed_samples, total_samples;
-	size_t base, end;
-	int count, branch, branch_count, first_bb, last_bb, bb_count;
-	uint64_t address, old_address, end_address, *branch_address;
-
 
 	total_samples = global_sample_count_in_func;
-	summed_samples = 0;
 
+//	disassemble the modules once for all the functions that will be listed
+	summed_samples = 0;
 	i = global_func_count - 1;
-	j = global_func_count - asm_cutoff;
-//	fprintf(stderr,"first index = %d, last index = %d, cuttof = %f,total_samples = %f\n",i, j, sum_cutoff,total_samples);
-	while((i >= global_func_count - asm_cutoff) && (summed_samples/total_samples < sum_cutoff))
+	hot_func_limit = hot_func_floor(global_func_list, asm_cutoff);
+	while((i >= hot_func_limit) && (summed_samples/total_samples < sum_cutoff))
 		{
 		this_function = (function_struc_ptr) global_func_list[i].ptr;
-#ifdef DBUG
-		fprintf(stderr," calling func_asm for element %d, function = %s\n",i,this_function->function_name);
-#endif
-		summed_samples += (float) func_asm(global_func_list, i);
-		func_src( global_func_list, i);
+		if(function_is_unknown(this_function))
+			{
+			i--;
+			continue;
+			}
+		disasm_add_range(this_function->this_module, this_function->function_rva_start,
+			this_function->function_rva_start + this_function->function_length - 1);
+		summed_samples += (float) this_function->total_sample_count;
 		i--;
-#ifdef DBUG
-		fprintf(stderr,"i = %d, summed_samples = %f, function_sample_count = %d, %d\n",i,summed_samples,this_function->total_sample_count, count);
-#endif
 		}
+	disasm_run();
+
+//	the functions write separate files, so any order gives the same reports
+	pool_run(global_func_count - 1 - i, num_threads, hot_list_function, hot_list_close, global_func_list);
+	disasm_free();
+	line_table_free();
 }
 
 void 
@@ -5198,7 +4800,7 @@ create_dir(void)
 		localtime_r(&t, &tm);
 		strftime(time_str, sizeof(time_str), "%F-%H:%M:%S", &tm);
 		sprintf(path,"%s-%s", spread, time_str);
-		fprintf(stderr,"move spreadsheets to %s\n",path);
+		gooda_log(GLOG_INFO,"move spreadsheets to %s\n",path);
 		sprintf(command,"%s%s",mv_spread, path);
 		ret_val = system(command);
 		if(ret_val == -1)
@@ -5276,14 +4878,14 @@ multiplex_correction(void)
 			sum1 += (double)global_sample_count[num_cores*i + j]*global_multiplex_correction[num_cores*i + j];
 			if(j == 2)
 				{
-		fprintf(stderr," event = %d, core = %d, sample count = %d\n",i,j,global_sample_count[num_cores*i + j]);
-		fprintf(stderr,"global_multiplex_correction for event %d, core - %d  = %g, sum1 = %g\n",i,j,global_multiplex_correction[num_cores*i + j], sum1);
+		gooda_log(GLOG_DEBUG," event = %d, core = %d, sample count = %d\n",i,j,global_sample_count[num_cores*i + j]);
+		gooda_log(GLOG_DEBUG,"global_multiplex_correction for event %d, core - %d  = %g, sum1 = %g\n",i,j,global_multiplex_correction[num_cores*i + j], sum1);
 				}
 			}
 		global_multiplex_correction[num_events*(num_cores + num_sockets) + i] = 1.0;
 		if((sum1 != 0) && (global_sample_count[num_events*(num_cores + num_sockets) + i] != 0))
 		global_multiplex_correction[num_events*(num_cores + num_sockets) + i] = sum1/(double)global_sample_count[num_events*(num_cores + num_sockets) + i];
-		fprintf(stderr,"global_multiplex_correction for event %d = %5.4f, sum1 = %g\n",i,global_multiplex_correction[num_events*(num_cores + num_sockets) + i], sum1);
+		gooda_log(GLOG_VERBOSE,"global_multiplex_correction for event %d = %5.4f, sum1 = %g\n",i,global_multiplex_correction[num_events*(num_cores + num_sockets) + i], sum1);
 		}
 //	set the corrections for the empty event and all the branch and sub branch rows
 	for(i=0; i < global_event_order->num_branch+global_event_order->num_sub_branch + 1; i++)
@@ -5307,11 +4909,11 @@ inst_working_set(module_struc_ptr this_module)
 
 	filename = (char*)malloc(strlen(dir) + strlen(this_module->module_name) + strlen(file) + 6);
 	sprintf(filename,"%s%s%s\0",dir,this_module->module_name,file);
-	fprintf(stderr,"from inst_working_set, file = %s\n",filename);
+	gooda_log(GLOG_VERBOSE,"from inst_working_set, file = %s\n",filename);
 	filename2 = (char*)malloc(strlen(dir) + strlen(this_module->module_name) + strlen(file2) + 6);
 	sprintf(filename2,"%s%s%s\0",dir,this_module->module_name,file2);
-	fprintf(stderr,"from sum256, file = %s\n",filename2);
-	fprintf(stderr,"module = %s, sample_count = %d\n",this_module->path,this_module->total_sample_count);
+	gooda_log(GLOG_VERBOSE,"from sum256, file = %s\n",filename2);
+	gooda_log(GLOG_VERBOSE,"module = %s, sample_count = %d\n",this_module->path,this_module->total_sample_count);
 
 	cachelines = (line_data *) malloc(this_module->rva_count*sizeof(line_data));
 	if(cachelines == NULL)
@@ -5340,7 +4942,7 @@ inst_working_set(module_struc_ptr this_module)
 			loop_rva = this_module->rva_list[i].ptr;
 			this_cacheline_count += loop_rva->total_sample_count;
 			total_count+=loop_rva->total_sample_count;
-			interupt_count+=loop_rva->sample_count[num_events*(num_cores+num_sockets) + event_id];
+			interupt_count+=sample_count_get(loop_rva, num_events*(num_cores+num_sockets) + event_id);
 			cachelines[num_cachelines-1].sample_count = this_cacheline_count;
 			}
 			else
@@ -5350,20 +4952,24 @@ inst_working_set(module_struc_ptr this_module)
 			old_cacheline = this_cacheline;
 			loop_rva = this_module->rva_list[i].ptr;
 			total_count+=loop_rva->total_sample_count;
-			interupt_count+=loop_rva->sample_count[num_events*(num_cores+num_sockets) + event_id];
+			interupt_count+=sample_count_get(loop_rva, num_events*(num_cores+num_sockets) + event_id);
 			this_cacheline_count = loop_rva->total_sample_count;
 			cachelines[num_cachelines-1].sample_count = this_cacheline_count;
 			}
 
 		}
-	fprintf(stderr," total count in rva's = %d, num_cachelines = %d, rva_count = %d\n",total_count,num_cachelines,this_module->rva_count);
-	for(i=num_cachelines-1; i>= 0; i--)
+	gooda_log(GLOG_VERBOSE," working set of %s: total count in rva's = %d, num_cachelines = %d, rva_count = %d\n",
+		this_module->path,total_count,num_cachelines,this_module->rva_count);
+	if(log_enabled(GLOG_DEBUG))
 		{
-		final_count+=cachelines[i].sample_count;
+		for(i=num_cachelines-1; i>= 0; i--)
+			{
+			final_count+=cachelines[i].sample_count;
+			}
+		gooda_log(GLOG_DEBUG," cachelines before sort: final_count = %d, interupt_count = %d\n",final_count,interupt_count);
 		}
-	fprintf(stderr,"final_count = %d, interupt_count = %d\n",final_count,interupt_count);
 	final_count = 0;
-	quickSort3(cachelines,num_cachelines);
+	radix_sort(cachelines, num_cachelines, sizeof(line_data), offsetof(line_data, sample_count), RADIX_KEY_INT);
 	list = fopen(filename,mode);
 	list2 = fopen(filename2,mode);
 	if(list == NULL)
@@ -5387,7 +4993,7 @@ inst_working_set(module_struc_ptr this_module)
 			}
 		}
 	fprintf(list2," %d\n",sum256);
-	fprintf(stderr,"final_count = %d, interupt_count = %d\n",final_count,interupt_count);
+	gooda_log(GLOG_DEBUG," cachelines after sort: final_count = %d, interupt_count = %d\n",final_count,interupt_count);
 	free(filename);
 	free(filename2);
 	free(cachelines);
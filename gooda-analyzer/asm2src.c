@@ -14,7 +14,6 @@ See the License for the specific language governing permissions and
 limitations under the License.
 */
 
-//#include "asm_2_src.h"
 
 #include <sys/types.h>
 #include <stdio.h>
@@ -25,16 +24,30 @@ limitations under the License.
 #include <stdarg.h>
 #include <unistd.h>
 #include <errno.h>
+#include <pthread.h>
 
 #include "bfd.h"
-
-static const char *filename;
-static const char *functionname;
-static unsigned int line;
-static asymbol **syms;
-static bfd_vma ip;
-static bfd_boolean found;
-static bfd *abfd, *dbg_bfd = NULL, *active_bfd;
+#include "asm_2_src.h"
+
+//	hot_list workers each open their own bfd, so the lookup state is per
+//	thread. libbfd itself is not thread safe, every call into it holds bfd_lock
+//	and nothing else does, so one worker decoding a line table does not stall
+//	the others.
+//	When gooda_dwarf.c can decode the module's line table the lookups are
+//	answered from it without the lock, libbfd only sees the addresses the
+//	table has no row for and the symbol table is read the first time that
+//	happens.
+static __thread const char *filename;
+static __thread const char *functionname;
+static __thread unsigned int line;
+static __thread asymbol **syms;
+static __thread bfd_vma ip;
+static __thread bfd_boolean found;
+static __thread bfd *abfd, *dbg_bfd = NULL, *active_bfd;
+static __thread line_table_ptr lines = NULL;
+static __thread line_table_hint hint;
+static __thread int node, from_bfd, syms_read;
+static pthread_mutex_t bfd_lock = PTHREAD_MUTEX_INITIALIZER;
 char rel_path[] = "./debug";
 int rel_len=7;
 
@@ -146,12 +159,14 @@ process_symtab(void)
 	return -1;
 }
 
-int 
-asm_2_src_init(const char *file_name)
+//	open the module, or its ./debug file, with bfd_lock held,
+//	*line_file is the file the line table is read from
+static int
+asm_2_src_open(const char *file_name, const char **line_file)
 {
 	const char *string, *errmsg;
 	bfd_size_type this_size;
-	char* dbg_filename, *full_dbg_filename;
+	char* dbg_filename, *full_dbg_filename = NULL;
 	int access_status,i;
 
 	asection *this_section;
@@ -245,7 +260,34 @@ asm_2_src_init(const char *file_name)
 #ifdef DBUG
 	fprintf(stderr," from process_symtab filename = %s\n",file_name);
 #endif
-	return process_symtab();
+	*line_file = (active_bfd == dbg_bfd) ? full_dbg_filename : file_name;
+	return 0;
+}
+
+//	the line table is decoded without bfd_lock, other workers keep using libbfd meanwhile
+int
+asm_2_src_init(const char *file_name)
+{
+	const char *line_file;
+	int ret;
+
+	pthread_mutex_lock(&bfd_lock);
+	ret = asm_2_src_open(file_name, &line_file);
+	pthread_mutex_unlock(&bfd_lock);
+	if(ret != 0)
+		return ret;
+	lines = line_table_open(line_file);
+	if(lines != NULL)
+		{
+		hint.row = hint.seg = -1;
+		syms_read = 0;
+		return 0;
+		}
+	pthread_mutex_lock(&bfd_lock);
+	syms_read = 1;
+	ret = process_symtab();
+	pthread_mutex_unlock(&bfd_lock);
+	return ret;
 }
 
 void 
@@ -256,8 +298,12 @@ asm_2_src_close(void)
 		syms = NULL;
 	}
 
+	pthread_mutex_lock(&bfd_lock);
 	if(abfd != NULL)bfd_close(abfd);
 	if(dbg_bfd != NULL)bfd_close(dbg_bfd);
+	pthread_mutex_unlock(&bfd_lock);
+	abfd = dbg_bfd = active_bfd = NULL;
+	lines = NULL;
 	line = found = 0;
 }
 
@@ -265,7 +311,14 @@ int
 asm_2_src_inline(const char **file, unsigned *line_nr)
 {
 
-	found = bfd_find_inliner_info (active_bfd, &filename, &functionname, &line);
+	if((lines != NULL) && !from_bfd)
+		found = line_table_caller(lines, &node, &filename, &line);
+	else
+		{
+		pthread_mutex_lock(&bfd_lock);
+		found = bfd_find_inliner_info (active_bfd, &filename, &functionname, &line);
+		pthread_mutex_unlock(&bfd_lock);
+		}
 	*file = filename;
 	*line_nr = line;
 
@@ -274,10 +327,30 @@ asm_2_src_inline(const char **file, unsigned *line_nr)
 
 int asm_2_src(unsigned long addr, const char **file, unsigned *line_nr)
 {
+	const char *row_file;
+	unsigned row_line;
 
+	from_bfd = 0;
+	if((lines != NULL) && line_table_find(lines, addr, &hint, &row_file, &row_line, &node))
+		{
+		filename = row_file;
+		line = row_line;
+		*file = filename;
+		*line_nr = line;
+		return 1;
+		}
+
+	from_bfd = 1;
 	found = 0;
 	ip = addr;
+	pthread_mutex_lock(&bfd_lock);
+	if(!syms_read)
+		{
+		syms_read = 1;
+		process_symtab();
+		}
 	bfd_map_over_sections(active_bfd, locate_function, NULL);
+	pthread_mutex_unlock(&bfd_lock);
 
 	*file = filename;
 	*line_nr = line;
@@ -1,9 +1,24 @@
 #ifndef A2LCG_H_
 #define A2LCG_H_
 
+#include <stdint.h>
+
 int asm_2_src_init(const char *file_name);
 int asm_2_src_inline(const char **file, unsigned *line_nr);
 int asm_2_src(unsigned long addr, const char **file, unsigned *line_nr);
 void asm_2_src_close(void);
 
+//	decoded DWARF line tables, gooda_dwarf.c
+typedef struct line_table_struc * line_table_ptr;
+typedef struct line_table_hint_struc{
+	int	row;
+	int	seg;
+	}line_table_hint;
+
+line_table_ptr line_table_open(const char *path);
+int line_table_find(line_table_ptr this_table, uint64_t address, line_table_hint *hint,
+	const char **file, unsigned *line_nr, int *node);
+int line_table_caller(line_table_ptr this_table, int *node, const char **file, unsigned *line_nr);
+void line_table_free(void);
+
 #endif
@@ -38,54 +38,6 @@ limitations under the License.
 #include "perf_gooda.h"
 #include "gooda_util.h"
 
-void
-qsindex(index_data *data, int left, int right)
-{
-
-        int l_old, r_old, piv_index;
-        int piv,index;
-
-        l_old = left;
-        r_old = right;
-        piv = data[left].val;
-        index = data[left].index;
-
-        while(left < right)
-                {
-                while( (data[right].val >= piv) && (left < right))
-                        right--;
-                if(left != right)
-                        {
-                        data[left].val = data[right].val;
-                        data[left].index = data[right].index;
-                        left++;
-                        }
-                while( ( data[left].val <= piv) && (left < right))
-                        left++;
-                if(left != right)
-                        {
-                        data[right].val = data[left].val;
-                        data[right].index = data[left].index;
-                        right--;
-                        }
-                }
-        data[left].val = piv;
-        data[left].index = index;
-        piv_index = left;
-        left = l_old;
-        right = r_old;
-        if(left < piv_index)
-                qsindex(data, left, piv_index-1);
-        if(right > piv_index)
-                qsindex(data, piv_index+1, right);
-}
-void
-quickSortIndex(index_data *arr, int elements)
-{
-        qsindex(arr, 0, elements-1);
-}
-
-
 void
 init_order(void)
 {
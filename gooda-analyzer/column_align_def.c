@@ -321,7 +321,7 @@ set_order_def(int* sample_count)
 		}
 
 //sort the non-fixed/extra/ordered events
-	quickSortIndex(arr,found_ordered_events);
+	sort_index(arr,found_ordered_events);
 //	fprintf(stderr,"returned from quicksort call in set_order\n");
 	j = 0;
 	index = this_event_order->num_fixed;
@@ -774,7 +774,7 @@ set_order_intel(int* sample_count, int arch_val)
 		}
 
 //sort the non-fixed/extra/ordered events
-	quickSortIndex(arr,found_ordered_events);
+	sort_index(arr,found_ordered_events);
 //	fprintf(stderr,"returned from quicksort call in set_order\n");
 	j = 0;
 	first_ordered_col = fixed_order_data[this_event_order->num_fixed-1].base_col + 1;
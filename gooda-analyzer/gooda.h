@@ -35,8 +35,9 @@ typedef struct branch_struc * branch_struc_ptr;
 typedef struct branch_site_struc * branch_site_struc_ptr;
 typedef struct func_branch_struc * func_branch_struc_ptr;
 typedef struct call_chain_struc * call_chain_struc_ptr;
-typedef struct hash_struc * hash_struc_ptr;
 typedef struct rva_hash_struc * rva_hash_struc_ptr;
+typedef struct branch_edge_struc * branch_edge_ptr;
+typedef struct branch_edge_table_struc * branch_edge_table_ptr;
 typedef struct function_location * function_location_ptr;
 typedef struct function_location_stack * function_location_stack_ptr;
 typedef struct functionlist_struc * functionlist_struc_ptr;
@@ -45,6 +46,9 @@ typedef struct basic_block_struc * basic_block_struc_ptr;
 typedef struct source_line_struc * source_line_struc_ptr;
 typedef struct file_list_struc * file_list_struc_ptr;
 typedef struct addr_list_struc * addr_list_struc_ptr;
+typedef struct mem_stats_struc * mem_stats_ptr;
+typedef struct block_cycles_struc * block_cycles_ptr;
+typedef struct cct_node_struc * cct_node_ptr;
 
 typedef struct mmap_struc * mmap_struc_ptr;
 typedef struct comm_struc * comm_struc_ptr;
@@ -55,6 +59,20 @@ typedef struct pointer_struc{
         uint64_t                val;
         }pointer_data;
 
+typedef struct id_table_struc{
+	uint32_t		*key;
+	void			**value;		/* NULL marks an empty slot */
+	int			size;			/* power of two, 0 until first insert */
+	int			shift;			/* 32 - log2(size) */
+	int			count;
+	}id_table_data;
+
+//	taken outcomes of an LBR branch site and how many of them the hardware
+//	flagged as mispredicted, see increment_branch_outcome
+typedef struct lbr_outcome_struc{
+	int			taken;
+	int			mispredict;
+	}lbr_outcome_data;
 
 typedef struct function_struc{
 	function_struc_ptr	next;
@@ -75,6 +93,9 @@ typedef struct function_struc{
 	module_struc_ptr	this_module;
 	process_struc_ptr	this_process;
 	int*			sample_count;
+	mem_stats_ptr		mem;
+	lbr_outcome_data	lbr;
+	block_cycles_ptr	cycles;
 	void *			sample_order;
 	int			cycle_count;
 	int			inst_count;
@@ -86,6 +107,8 @@ typedef struct function_struc{
 	int			func_targets;
 	int			funclist_index;
 	int			called_branch_eval;
+	int			cct_inclusive;		/* first event, from the calling context tree */
+	int			cct_exclusive;
 	}function_data;
 
 typedef struct source_struc{
@@ -118,6 +141,7 @@ typedef struct module_struc{
 	module_struc_ptr	next;
 	module_struc_ptr	previous;
 	rva_hash_struc_ptr	this_table;
+	branch_edge_table_ptr	edge_table;		/* LBR edges until branch_edge_lists, see increment_rva */
 	sample_struc_ptr	first_sample;
 	pointer_data 		* rva_list;
 	function_struc_ptr	first_function;
@@ -171,9 +195,16 @@ typedef struct process_struc{
 	process_struc_ptr	parent;
 	child_struc_ptr		first_child;
 	thread_struc_ptr	first_thread;
+	id_table_data		thread_table;		/* tid -> thread_struc, see find_thread_struc */
 	module_struc_ptr	first_module;
 	pointer_data 		* module_list;
 	mmap_struc_ptr		first_mmap;
+	mmap_struc_ptr*		mmap_index;		/* first_mmap sorted by addr, see gooda_mmap.c */
+	uint64_t*		mmap_index_end;		/* max segment tree of addr+len over mmap_index */
+	int			mmap_index_len;
+	int			mmap_index_leaves;	/* power of 2 >= mmap_index_len */
+	int			mmap_index_generation;	/* mmap_generation the index was built for */
+	int			mmap_generation;	/* bumped when an mmap is added or resized */
 	comm_struc_ptr		first_comm;
 	module_struc_ptr	current_module;
 	char*			name;
@@ -194,6 +225,46 @@ typedef struct child_struc{
 	process_struc_ptr	parent;
 	} child_data;
 	
+typedef struct count_pair_struc{
+	int			index;
+	int			count;
+	}count_pair_data;
+
+//	load latency (PERF_SAMPLE_WEIGHT) and data source (PERF_SAMPLE_DATA_SRC)
+//	profile of an rva, asm line or function, allocated on the first memory sample
+#define MEM_LAT_BUCKETS	12	/* 0, 1, 2-3, 4-7 ... 512-1023, 1024 and up */
+
+enum mem_src_type {
+	MEM_SRC_L1=0,
+	MEM_SRC_LFB,
+	MEM_SRC_L2,
+	MEM_SRC_L3,
+	MEM_SRC_LOCAL_RAM,
+	MEM_SRC_REMOTE,		/* remote dram or remote cache */
+	MEM_SRC_HITM,		/* snoop hit modified, at any level */
+	MEM_SRC_OTHER,		/* io, uncached, miss or not available */
+	NUM_MEM_SRC,
+	};
+
+typedef struct mem_stats_struc{
+	uint64_t		lat_sum;
+	int			count;
+	int			lat_hist[MEM_LAT_BUCKETS];
+	int			src_count[NUM_MEM_SRC];
+	}mem_stats_data;
+
+//	measured latency of the LBR blocks (branch target to the next taken branch)
+//	starting in an rva, asm line, basic block or function, from the cycles field
+//	of timed LBRs, in the load latency buckets. A block whose ending branch jumps
+//	back to its own start is also counted as one loop iteration
+typedef struct block_cycles_struc{
+	uint64_t		cyc_sum;
+	uint64_t		loop_cyc_sum;
+	int			count;
+	int			loop_count;
+	int			cyc_hist[MEM_LAT_BUCKETS];
+	}block_cycles_data;
+
 typedef struct sample_struc{
 	sample_struc_ptr	next;
         sample_struc_ptr	previous;
@@ -206,7 +277,13 @@ typedef struct sample_struc{
 	branch_struc_ptr	call_list;
 	branch_struc_ptr	next_taken_list;
 	char*			asm_string;
-	int*			sample_count;
+	int*			sample_count;		/* dense counters, NULL until promoted, see sample_count_add */
+	count_pair_data*	count_pair;		/* nonzero counters sorted by index */
+	int			count_len;
+	int			count_max;
+	mem_stats_ptr		mem;
+	lbr_outcome_data	lbr;
+	block_cycles_ptr	cycles;
 	int*			sample_order;
 	float*			ratios;
 	int*			ratio_order;
@@ -230,6 +307,23 @@ typedef struct branch_struc{
 	int			count;
 	}branch_data;
 
+//	one (source rva, target module, target rva) edge of a module during ingest,
+//	its branch_struc is only linked into the rva's list by branch_edge_lists
+typedef struct branch_edge_struc{
+	branch_edge_ptr		next;			/* newest first */
+	sample_struc_ptr	this_sample;
+	int			type;			/* RVA_RETURN, RVA_CALL or RVA_NEXT_TAKEN */
+	branch_data		branch;			/* address, this_module and count */
+	}branch_edge_data;
+
+typedef struct branch_edge_table_struc{
+	branch_edge_ptr	*	slot;			/* NULL marks an empty slot */
+	branch_edge_ptr		first_edge;
+	int			size;			/* power of two */
+	int			shift;			/* 64 - log2(size) */
+	int			entries;
+	}branch_edge_table_data;
+
 typedef struct branch_site_struc{
 	branch_site_struc_ptr	next;
 	uint64_t		address;
@@ -253,16 +347,19 @@ typedef struct call_chain_struc{
 	int			count;
 	}call_chain_data;
 	
-typedef struct hash_struc{
-	sample_struc_ptr 	this_sample;
-	uint64_t 		this_rva;
-	hash_struc_ptr		next;
-	}hash_data;
+typedef struct rva_slot_struc{
+	uint64_t 		rva;
+	sample_struc_ptr 	this_sample;		/* NULL marks an empty slot */
+	}rva_slot_data;
 	
+#define RVA_HASH_MULT	0x9E3779B97F4A7C15ULL	/* 2^64 / golden ratio */
+
+//	open addressing rva -> sample_struc table, fibonacci hash and linear probing
 typedef struct rva_hash_struc{
-	int			size;
+	int			size;			/* power of two */
+	int			shift;			/* 64 - log2(size) */
 	int			entries;
-	hash_data	 *	this_array;
+	rva_slot_data	 *	this_array;
 	}rva_hash_data;
 
 typedef struct function_location_stack{
@@ -274,6 +371,18 @@ typedef struct function_location_stack{
 	uint32_t	len;
 	}function_loc_stack_data;
 
+//	calling context tree node, see gooda_cct.c
+#define CCT_MAX_DEPTH	256	/* callchain frames kept, the outermost are dropped */
+
+typedef struct cct_node_struc{
+	cct_node_ptr		parent;
+	cct_node_ptr		first_child;
+	cct_node_ptr		next_sibling;
+	module_struc_ptr	this_module;	/* NULL for the process roots */
+	uint64_t		key;		/* rva, function_loc_data or principal process address */
+	int*			sample_count;	/* exclusive, one per event */
+	}cct_node_data;
+
 typedef struct function_location{
 	function_struc_ptr	this_function;
 	char*			name;
@@ -303,6 +412,9 @@ typedef struct asm_struc{
 	char *			initial_source_file;
 	char *			initial_source_name;
 	int *			sample_count;
+	mem_stats_ptr		mem;
+	lbr_outcome_data	lbr;
+	block_cycles_ptr	cycles;
 	int			principal_source_line;
 	int			initial_source_line;
 	int			branch;
@@ -321,6 +433,8 @@ typedef struct basic_block_struc{
 	char *		text;
 	char *		encoding;
 	int *		sample_count;
+	lbr_outcome_data	lbr;		/* of the branch ending the block */
+	block_cycles_ptr	cycles;
 	int		source_line;
 	int		block_count;
 	int		branch;
@@ -359,7 +473,25 @@ extern function_struc_ptr global_func_stack;
 extern int * global_sample_count, total_sample_count;
 extern double *global_multiplex_correction, uop_issue_rate;
 extern char *gooda_dir;
-extern int sample_struc_count, asm_struc_count, basic_block_struc_count;
+extern uint64_t sample_count_bytes;
+extern int mem_sample_count, cct_sample_count, lbr_outcome_count, lbr_cycles_count;
+
+//	arenas the *_create functions allocate from, see gooda_create.c
+enum arena_type {
+	ARENA_PROCESS=0,
+	ARENA_MODULE,
+	ARENA_RECORD,
+	ARENA_SAMPLE,
+	ARENA_BRANCH,
+	ARENA_FUNCTION,
+	ARENA_ASM,
+	ARENA_BASIC_BLOCK,
+	ARENA_MEM,
+	ARENA_CCT,
+	NUM_ARENAS,
+	};
+
+#define SAMPLE_INLINE_PAIRS	2	/* counter pairs stored with each sample_struc */
 
 function_struc_ptr function_struc_create();
 source_struc_ptr source_struc_create();
@@ -368,9 +500,19 @@ module_struc_ptr module_struc_create();
 thread_struc_ptr thread_struc_create();
 process_struc_ptr process_struc_create();
 child_struc_ptr child_struc_create();
+void* arena_alloc(int arena, size_t size);
+void arena_reset(int arena);
+void arena_report(void);
 sample_struc_ptr sample_struc_create();
+int sample_count_get(sample_struc_ptr this_sample, int index);
+void sample_count_add(sample_struc_ptr this_sample, int index, int val);
+int sample_count_next(sample_struc_ptr this_sample, int *pos, int *index, int *count);
+int mem_lat_bucket(uint64_t weight);
+void mem_stats_add(mem_stats_ptr *mem, uint64_t weight, int src);
+void mem_stats_merge(mem_stats_ptr *mem, mem_stats_ptr from);
+void block_cycles_add(block_cycles_ptr *cyc, uint64_t cycles, int loop);
+void block_cycles_merge(block_cycles_ptr *cyc, block_cycles_ptr from);
 rva_hash_struc_ptr rva_hash_struc_create(int len);
-hash_struc_ptr hash_struc_create();
 functionlist_struc_ptr functionlist_struc_create(int len);
 asm_struc_ptr asm_struc_create();
 basic_block_struc_ptr basic_block_struc_create();
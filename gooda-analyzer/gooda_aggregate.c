@@ -0,0 +1,724 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	aggregate files for Gooda
+//
+//	--aggregate file saves the profile once the samples are read: the
+//	principal processes, their modules, the rvas with their counters, LBR
+//	branch lists, memory and block latency profiles, and the global counters.
+//	--from-aggregate file loads it in place of reading the samples, so the
+//	analysis and the reports can be redone with other -n, -p, -r or -j
+//	settings in the time the symbol work takes. The boundary is before
+//	reorder_process, as the function lists depend on the binaries found then.
+//	The perf.data header is still read in that mode, it defines the events,
+//	the topology and the column order, and the aggregate records the data
+//	section it was made from so a mismatched pair is refused. A module whose
+//	build-id is not the one this perf.data recorded for its path is refused
+//	too, its functions would be read from the wrong binary.
+//	Calling context trees, time windows and the weight summary are not saved.
+//	The format is described in gooda_aggregate.h, multi_perf merges the files
+//	of many runs.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+#include "gooda_log.h"
+#include "gooda_aggregate.h"
+
+static inline int
+get_count(void)
+{
+	return num_events*(num_cores+num_sockets+1) + num_branch + num_sub_branch + num_derived + 1;
+}
+
+static void *
+agg_calloc(uint64_t entries, size_t size)
+{
+	void *buf;
+
+	buf = calloc(entries ? entries : 1, size);
+	if(buf == NULL)
+		err(1,"failed to allocate %"PRIu64" aggregate entries",entries);
+	return buf;
+}
+
+//	the file counts are 64 bit, the counters of gooda are int
+static int agg_saturated;
+
+static int
+agg_int(int64_t val)
+{
+	if(val > INT_MAX)
+		{
+		agg_saturated++;
+		return INT_MAX;
+		}
+	if(val < INT_MIN)
+		{
+		agg_saturated++;
+		return INT_MIN;
+		}
+	return (int)val;
+}
+
+static void
+agg_counts_save(int64_t *to, int *from, int count)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+		to[i] = from[i];
+}
+
+static void
+agg_counts_load(int *to, int64_t *from, int count)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+		to[i] = agg_int(from[i]);
+}
+
+static void
+agg_mem_save(agg_mem_data *to, mem_stats_ptr from)
+{
+	int i;
+
+	to->lat_sum = from->lat_sum;
+	to->count = from->count;
+	for(i = 0; i < MEM_LAT_BUCKETS; i++)
+		to->lat_hist[i] = from->lat_hist[i];
+	for(i = 0; i < NUM_MEM_SRC; i++)
+		to->src_count[i] = from->src_count[i];
+}
+
+static void
+agg_mem_load(mem_stats_ptr to, agg_mem_data *from)
+{
+	int i;
+
+	to->lat_sum = from->lat_sum;
+	to->count = agg_int(from->count);
+	for(i = 0; i < MEM_LAT_BUCKETS; i++)
+		to->lat_hist[i] = agg_int(from->lat_hist[i]);
+	for(i = 0; i < NUM_MEM_SRC; i++)
+		to->src_count[i] = agg_int(from->src_count[i]);
+}
+
+static void
+agg_cycles_save(agg_cycles_data *to, block_cycles_ptr from)
+{
+	int i;
+
+	to->cyc_sum = from->cyc_sum;
+	to->loop_cyc_sum = from->loop_cyc_sum;
+	to->count = from->count;
+	to->loop_count = from->loop_count;
+	for(i = 0; i < MEM_LAT_BUCKETS; i++)
+		to->cyc_hist[i] = from->cyc_hist[i];
+}
+
+static void
+agg_cycles_load(block_cycles_ptr to, agg_cycles_data *from)
+{
+	int i;
+
+	to->cyc_sum = from->cyc_sum;
+	to->loop_cyc_sum = from->loop_cyc_sum;
+	to->count = agg_int(from->count);
+	to->loop_count = agg_int(from->loop_count);
+	for(i = 0; i < MEM_LAT_BUCKETS; i++)
+		to->cyc_hist[i] = agg_int(from->cyc_hist[i]);
+}
+
+//	FNV-1a of the event names and configs, so runs with different events are
+//	not merged or loaded together
+static uint64_t
+aggregate_event_hash(void)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	unsigned char *p;
+	int i, j;
+
+	for(i = 0; i < num_events; i++)
+		{
+		for(p = (unsigned char *)event_list[i].name; (p != NULL) && (*p != '\0'); p++)
+			hash = (hash ^ *p)*0x100000001b3ULL;
+		for(j = 0; j < 8; j++)
+			hash = (hash ^ ((event_list[i].config >> (8*j)) & 0xff))*0x100000001b3ULL;
+		}
+	return hash;
+}
+
+//	build-id perf recorded for a module path, "" when there is none
+static char *
+agg_buildid(char *path)
+{
+	buildid_struc_ptr this_buildid;
+
+	if(path == NULL)
+		return "";
+	for(this_buildid = build_ll; this_buildid != NULL; this_buildid = this_buildid->next)
+		if(strcmp(this_buildid->filename, path) == 0)
+			return this_buildid->buildid;
+	return "";
+}
+
+//	index of a module in the module table, the table is sorted by address
+static uint32_t
+agg_module_index(pointer_data *sorted, int num, module_struc_ptr this_module)
+{
+	int lo = 0, hi = num, mid;
+
+	if(this_module == NULL)
+		return AGG_NONE;
+	while(lo < hi)
+		{
+		mid = (lo + hi)/2;
+		if(sorted[mid].val < (uint64_t)this_module)
+			lo = mid + 1;
+		else
+			hi = mid;
+		}
+	if((lo < num) && (sorted[lo].val == (uint64_t)this_module))
+		return (uint32_t)(uintptr_t)sorted[lo].ptr;
+	return AGG_NONE;
+}
+
+static void
+agg_column_write(FILE *out, agg_header_data *hdr, int column, void *data, uint64_t entries)
+{
+	static const char pad[8];
+	long pos;
+
+	pos = ftell(out);
+	if(pos & 7)
+		{
+		fwrite(pad, 1, 8 - (pos & 7), out);
+		pos += 8 - (pos & 7);
+		}
+	hdr->column[column].offset = pos;
+	hdr->column[column].entries = entries;
+	if(entries != 0)
+		fwrite(data, agg_column_size[column], entries, out);
+}
+
+static void
+agg_branch_list(branch_struc_ptr this_branch, int type, pointer_data *sorted, int num_modules,
+	uint64_t *branch_addr, agg_branch_data *branch, uint32_t *num_branch)
+{
+	for(; this_branch != NULL; this_branch = this_branch->next)
+		{
+		branch_addr[*num_branch] = this_branch->address;
+		branch[*num_branch].module = agg_module_index(sorted, num_modules, this_branch->this_module);
+		branch[*num_branch].type = type;
+		branch[*num_branch].count = this_branch->count;
+		(*num_branch)++;
+		}
+}
+
+static int
+agg_list_len(branch_struc_ptr this_branch)
+{
+	int len = 0;
+
+	for(; this_branch != NULL; this_branch = this_branch->next)
+		len++;
+	return len;
+}
+
+void
+aggregate_write(char *path, uint64_t data_offset, uint64_t data_size)
+{
+	process_struc_ptr this_process;
+	module_struc_ptr this_module;
+	sample_struc_ptr this_sample;
+	agg_header_data hdr;
+	agg_process_data *process;
+	agg_module_data *module;
+	agg_rva_data *rva;
+	agg_branch_data *branch;
+	agg_pair_data *pair;
+	agg_mem_data *mem;
+	agg_cycles_data *cycles;
+	pointer_data *sorted;
+	uint64_t *rva_addr, *branch_addr;
+	int64_t *global_count, *process_count, *module_count;
+	char *strings, *name;
+	uint32_t np = 0, nm = 0, nr = 0, npair = 0, nb = 0, nmem = 0, ncyc = 0, nstr = 0, num_modules;
+	int count = get_count(), pos, index, val, len;
+	FILE *out;
+
+//	size the columns
+	for(this_process = principal_process_stack; this_process != NULL; this_process = this_process->principal_next)
+		{
+		np++;
+		nstr += strlen(this_process->name != NULL ? this_process->name : "") + 1;
+		for(this_module = this_process->first_module; this_module != NULL; this_module = this_module->next)
+			{
+			nm++;
+			nstr += strlen(this_module->path != NULL ? this_module->path : "") + 1;
+			nstr += strlen(agg_buildid(this_module->path)) + 1;
+			for(this_sample = this_module->first_sample; this_sample != NULL; this_sample = this_sample->next)
+				{
+				nr++;
+				pos = 0;
+				while(sample_count_next(this_sample, &pos, &index, &val))
+					npair++;
+				nb += agg_list_len(this_sample->return_list) + agg_list_len(this_sample->call_list)
+					+ agg_list_len(this_sample->next_taken_list);
+				if(this_sample->mem != NULL)nmem++;
+				if(this_sample->cycles != NULL)ncyc++;
+				}
+			}
+		}
+	num_modules = nm;
+
+	strings = agg_calloc(nstr, sizeof(char));
+	process = agg_calloc(np, sizeof(agg_process_data));
+	global_count = agg_calloc(count, sizeof(int64_t));
+	process_count = agg_calloc((uint64_t)np*count, sizeof(int64_t));
+	module = agg_calloc(nm, sizeof(agg_module_data));
+	module_count = agg_calloc((uint64_t)nm*count, sizeof(int64_t));
+	sorted = agg_calloc(nm, sizeof(pointer_data));
+	rva_addr = agg_calloc(nr, sizeof(uint64_t));
+	rva = agg_calloc(nr, sizeof(agg_rva_data));
+	pair = agg_calloc(npair, sizeof(agg_pair_data));
+	branch_addr = agg_calloc(nb, sizeof(uint64_t));
+	branch = agg_calloc(nb, sizeof(agg_branch_data));
+	mem = agg_calloc(nmem, sizeof(agg_mem_data));
+	cycles = agg_calloc(ncyc, sizeof(agg_cycles_data));
+
+//	module pointer to index, for the branch targets
+	nm = 0;
+	for(this_process = principal_process_stack; this_process != NULL; this_process = this_process->principal_next)
+		for(this_module = this_process->first_module; this_module != NULL; this_module = this_module->next)
+			{
+			sorted[nm].ptr = (sample_struc_ptr)(uintptr_t)nm;
+			sorted[nm].val = (uint64_t)(uintptr_t)this_module;
+			nm++;
+			}
+	sort_pointer(sorted, num_modules);
+
+//	fill them
+	np = nm = nr = npair = nb = nmem = ncyc = nstr = 0;
+	for(this_process = principal_process_stack; this_process != NULL; this_process = this_process->principal_next)
+		{
+		name = this_process->name != NULL ? this_process->name : "";
+		len = strlen(name) + 1;
+		memcpy(&strings[nstr], name, len);
+		process[np].name = nstr;
+		nstr += len;
+		process[np].pid = this_process->pid;
+		process[np].tid_main = this_process->tid_main;
+		process[np].first_module = nm;
+		process[np].total_sample_count = this_process->total_sample_count;
+		agg_counts_save(&process_count[(uint64_t)np*count], this_process->sample_count, count);
+		for(this_module = this_process->first_module; this_module != NULL; this_module = this_module->next)
+			{
+			name = this_module->path != NULL ? this_module->path : "";
+			len = strlen(name) + 1;
+			memcpy(&strings[nstr], name, len);
+			module[nm].path = nstr;
+			nstr += len;
+			name = agg_buildid(this_module->path);
+			len = strlen(name) + 1;
+			memcpy(&strings[nstr], name, len);
+			module[nm].buildid = nstr;
+			nstr += len;
+			module[nm].starting_ip = this_module->starting_ip;
+			module[nm].length = this_module->length;
+			module[nm].first_rva = nr;
+			module[nm].total_sample_count = this_module->total_sample_count;
+			module[nm].total_branches = this_module->total_branches;
+			module[nm].total_sources = this_module->total_sources;
+			module[nm].total_targets = this_module->total_targets;
+			module[nm].is_kernel = this_module->is_kernel;
+			agg_counts_save(&module_count[(uint64_t)nm*count], this_module->sample_count, count);
+			for(this_sample = this_module->first_sample; this_sample != NULL; this_sample = this_sample->next)
+				{
+				rva_addr[nr] = this_sample->rva;
+				rva[nr].first_pair = npair;
+				pos = 0;
+				while(sample_count_next(this_sample, &pos, &index, &val))
+					{
+					pair[npair].index = index;
+					pair[npair].count = val;
+					npair++;
+					}
+				rva[nr].num_pairs = npair - rva[nr].first_pair;
+				rva[nr].first_branch = nb;
+				agg_branch_list(this_sample->return_list, RVA_RETURN, sorted, num_modules, branch_addr, branch, &nb);
+				agg_branch_list(this_sample->call_list, RVA_CALL, sorted, num_modules, branch_addr, branch, &nb);
+				agg_branch_list(this_sample->next_taken_list, RVA_NEXT_TAKEN, sorted, num_modules, branch_addr, branch, &nb);
+				rva[nr].num_branches = nb - rva[nr].first_branch;
+				if(this_sample->mem != NULL)
+					{
+					agg_mem_save(&mem[nmem++], this_sample->mem);
+					rva[nr].mem = nmem;
+					}
+				if(this_sample->cycles != NULL)
+					{
+					agg_cycles_save(&cycles[ncyc++], this_sample->cycles);
+					rva[nr].cycles = ncyc;
+					}
+				rva[nr].total_sample_count = this_sample->total_sample_count;
+				rva[nr].total_sources = this_sample->total_sources;
+				rva[nr].total_targets = this_sample->total_targets;
+				rva[nr].total_taken_branch = this_sample->total_taken_branch;
+				rva[nr].lbr_taken = this_sample->lbr.taken;
+				rva[nr].lbr_mispredict = this_sample->lbr.mispredict;
+				nr++;
+				}
+			module[nm].num_rvas = nr - module[nm].first_rva;
+			nm++;
+			}
+		process[np].num_modules = nm - process[np].first_module;
+		np++;
+		}
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, AGG_MAGIC, sizeof(hdr.magic));
+	hdr.version = AGG_VERSION;
+	hdr.num_columns = NUM_AGG_COLUMNS;
+	hdr.num_events = num_events;
+	hdr.num_cores = num_cores;
+	hdr.num_sockets = num_sockets;
+	hdr.count = count;
+	hdr.data_offset = data_offset;
+	hdr.data_size = data_size;
+	hdr.event_hash = aggregate_event_hash();
+	hdr.scalar[AGG_TOTAL_SAMPLES] = total_sample_count;
+	hdr.scalar[AGG_BRANCH_SAMPLES] = global_branch_sample_count;
+	hdr.scalar[AGG_LBR_RET] = lbr_ret;
+	hdr.scalar[AGG_LBR_ANY] = lbr_any;
+	hdr.scalar[AGG_LBR_ENTRIES] = total_lbr_entries;
+	hdr.scalar[AGG_MEM_SAMPLES] = mem_sample_count;
+	hdr.scalar[AGG_LBR_OUTCOMES] = lbr_outcome_count;
+	hdr.scalar[AGG_LBR_CYCLES] = lbr_cycles_count;
+	agg_counts_save(global_count, global_sample_count, count);
+
+	out = fopen(path, "w");
+	if(out == NULL)
+		err(1,"cannot create aggregate file %s",path);
+//	the header is written again once the column offsets are known
+	fwrite(&hdr, sizeof(hdr), 1, out);
+	agg_column_write(out, &hdr, AGG_STRINGS, strings, nstr);
+	agg_column_write(out, &hdr, AGG_GLOBAL_COUNT, global_count, count);
+	agg_column_write(out, &hdr, AGG_GLOBAL_MULTIPLEX, global_multiplex_correction, count);
+	agg_column_write(out, &hdr, AGG_PROCESS, process, np);
+	agg_column_write(out, &hdr, AGG_PROCESS_COUNT, process_count, (uint64_t)np*count);
+	agg_column_write(out, &hdr, AGG_MODULE, module, nm);
+	agg_column_write(out, &hdr, AGG_MODULE_COUNT, module_count, (uint64_t)nm*count);
+	agg_column_write(out, &hdr, AGG_RVA_ADDR, rva_addr, nr);
+	agg_column_write(out, &hdr, AGG_RVA, rva, nr);
+	agg_column_write(out, &hdr, AGG_PAIR, pair, npair);
+	agg_column_write(out, &hdr, AGG_BRANCH_ADDR, branch_addr, nb);
+	agg_column_write(out, &hdr, AGG_BRANCH, branch, nb);
+	agg_column_write(out, &hdr, AGG_MEM, mem, nmem);
+	agg_column_write(out, &hdr, AGG_CYCLES, cycles, ncyc);
+	rewind(out);
+	fwrite(&hdr, sizeof(hdr), 1, out);
+	if(ferror(out) || (fclose(out) != 0))
+		err(1,"failed to write aggregate file %s",path);
+
+	gooda_log(GLOG_INFO," wrote aggregate %s, %u processes, %u modules, %u rvas, %u branches\n",path,np,nm,nr,nb);
+	free(strings);
+	free(global_count);
+	free(process);
+	free(process_count);
+	free(module);
+	free(module_count);
+	free(sorted);
+	free(rva_addr);
+	free(rva);
+	free(pair);
+	free(branch_addr);
+	free(branch);
+	free(mem);
+	free(cycles);
+}
+
+//	start of a column after checking it lies in the file
+static void *
+agg_column(char *path, char *map, size_t map_len, agg_header_data *hdr, int column)
+{
+	uint64_t offset = hdr->column[column].offset, entries = hdr->column[column].entries;
+
+	if((offset & 7) || (offset < sizeof(agg_header_data)) || (offset > map_len)
+		|| (entries > (map_len - offset)/agg_column_size[column]))
+		errx(1,"aggregate file %s is truncated or corrupt, column %d",path,column);
+	return map + offset;
+}
+
+//	string at offset after checking it is terminated inside the string column
+static char *
+agg_check_string(char *path, char *strings, uint64_t num_strings, uint32_t offset)
+{
+	if((offset >= num_strings) || (memchr(&strings[offset], '\0', num_strings - offset) == NULL))
+		errx(1,"aggregate file %s has a bad string offset %u",path,offset);
+	return &strings[offset];
+}
+
+static char *
+agg_string(char *path, char *strings, uint64_t num_strings, uint32_t offset)
+{
+	char *str;
+
+	str = strdup(agg_check_string(path, strings, num_strings, offset));
+	if(str == NULL)
+		err(1,"failed to copy a string of aggregate %s",path);
+	return str;
+}
+
+static void
+agg_range(char *path, uint32_t first, uint32_t num, uint64_t entries, char *what)
+{
+	if(((uint64_t)first + num) > entries)
+		errx(1,"aggregate file %s has a bad %s range",path,what);
+}
+
+//	recreate the processes, modules and rvas saved by aggregate_write, in
+//	place of parse. The perf.data header must have been read already
+void
+aggregate_read(char *path, uint64_t data_offset, uint64_t data_size)
+{
+	process_struc_ptr this_process, last_process = NULL;
+	module_struc_ptr this_module, last_module, *modules;
+	sample_struc_ptr this_sample;
+	branch_struc_ptr this_branch, last_branch[RVA_NEXT_TAKEN + 1];
+	agg_header_data *hdr;
+	agg_process_data *process;
+	agg_module_data *module;
+	agg_rva_data *rva;
+	agg_branch_data *branch;
+	agg_pair_data *pair;
+	agg_mem_data *mem;
+	agg_cycles_data *cycles;
+	mem_stats_data this_mem;
+	block_cycles_data this_cycles;
+	uint64_t *rva_addr, *branch_addr, num_strings, np, nm, nr;
+	int64_t *process_count, *module_count;
+	char *map, *strings, *module_used, *buildid, *local_buildid;
+	int count = get_count(), fd, type;
+	uint32_t i, j, k, l;
+	struct stat st;
+
+	fd = open(path, O_RDONLY);
+	if(fd == -1)
+		err(1,"cannot open aggregate file %s",path);
+	if(fstat(fd, &st) != 0)
+		err(1,"cannot stat aggregate file %s",path);
+	if((size_t)st.st_size < sizeof(agg_header_data))
+		errx(1,"aggregate file %s is too short",path);
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(map == MAP_FAILED)
+		err(1,"cannot mmap aggregate file %s",path);
+
+	hdr = (agg_header_data *)map;
+	if(memcmp(hdr->magic, AGG_MAGIC, sizeof(hdr->magic)) != 0)
+		errx(1,"%s is not a gooda aggregate file",path);
+	if((hdr->version != AGG_VERSION) || (hdr->num_columns != NUM_AGG_COLUMNS))
+		errx(1,"aggregate file %s has version %u, this gooda reads version %d",path,hdr->version,AGG_VERSION);
+	if((hdr->num_events != num_events) || (hdr->num_cores != num_cores) || (hdr->num_sockets != num_sockets)
+		|| (hdr->count != count) || (hdr->event_hash != aggregate_event_hash())
+		|| (hdr->data_offset != data_offset) || (hdr->data_size != data_size))
+		errx(1,"aggregate file %s was not made from this perf.data",path);
+
+	strings = agg_column(path, map, st.st_size, hdr, AGG_STRINGS);
+	num_strings = hdr->column[AGG_STRINGS].entries;
+	process = agg_column(path, map, st.st_size, hdr, AGG_PROCESS);
+	np = hdr->column[AGG_PROCESS].entries;
+	process_count = agg_column(path, map, st.st_size, hdr, AGG_PROCESS_COUNT);
+	module = agg_column(path, map, st.st_size, hdr, AGG_MODULE);
+	nm = hdr->column[AGG_MODULE].entries;
+	module_count = agg_column(path, map, st.st_size, hdr, AGG_MODULE_COUNT);
+	rva_addr = agg_column(path, map, st.st_size, hdr, AGG_RVA_ADDR);
+	rva = agg_column(path, map, st.st_size, hdr, AGG_RVA);
+	nr = hdr->column[AGG_RVA].entries;
+	pair = agg_column(path, map, st.st_size, hdr, AGG_PAIR);
+	branch_addr = agg_column(path, map, st.st_size, hdr, AGG_BRANCH_ADDR);
+	branch = agg_column(path, map, st.st_size, hdr, AGG_BRANCH);
+	mem = agg_column(path, map, st.st_size, hdr, AGG_MEM);
+	cycles = agg_column(path, map, st.st_size, hdr, AGG_CYCLES);
+	if((hdr->column[AGG_GLOBAL_COUNT].entries != (uint64_t)count) || (hdr->column[AGG_GLOBAL_MULTIPLEX].entries != (uint64_t)count)
+		|| (hdr->column[AGG_PROCESS_COUNT].entries != np*count) || (hdr->column[AGG_MODULE_COUNT].entries != nm*count)
+		|| (hdr->column[AGG_RVA_ADDR].entries != nr) || (hdr->column[AGG_BRANCH_ADDR].entries != hdr->column[AGG_BRANCH].entries))
+		errx(1,"aggregate file %s has inconsistent column sizes",path);
+	agg_saturated = 0;
+	agg_counts_load(global_sample_count, agg_column(path, map, st.st_size, hdr, AGG_GLOBAL_COUNT), count);
+	memcpy(global_multiplex_correction, agg_column(path, map, st.st_size, hdr, AGG_GLOBAL_MULTIPLEX), count*sizeof(double));
+
+//	all modules first, branches can point to the modules of any process
+	modules = agg_calloc(nm, sizeof(module_struc_ptr));
+	module_used = agg_calloc(nm, sizeof(char));
+	for(j = 0; j < nm; j++)
+		{
+		agg_range(path, module[j].first_rva, module[j].num_rvas, nr, "rva");
+		this_module = module_struc_create();
+		if(this_module == NULL)
+			err(1,"failed to create module from aggregate %s",path);
+		this_module->path = agg_string(path, strings, num_strings, module[j].path);
+//		the functions are read from the binaries of this perf.data, a module
+//		multi_perf took from a run of another build would bind to the wrong ones
+		buildid = agg_check_string(path, strings, num_strings, module[j].buildid);
+		local_buildid = agg_buildid(this_module->path);
+		if((buildid[0] != '\0') && (local_buildid[0] != '\0') && (strcmp(buildid, local_buildid) != 0))
+			errx(1,"aggregate file %s has %s with build-id %s, this perf.data and its binaries have %s",
+				path,this_module->path,buildid,local_buildid);
+		this_module->starting_ip = module[j].starting_ip;
+		this_module->length = module[j].length;
+		this_module->total_sample_count = agg_int(module[j].total_sample_count);
+		this_module->total_branches = agg_int(module[j].total_branches);
+		this_module->total_sources = agg_int(module[j].total_sources);
+		this_module->total_targets = agg_int(module[j].total_targets);
+		this_module->is_kernel = module[j].is_kernel;
+		agg_counts_load(this_module->sample_count, &module_count[(uint64_t)j*count], count);
+		modules[j] = this_module;
+		}
+
+	for(i = 0; i < np; i++)
+		{
+		agg_range(path, process[i].first_module, process[i].num_modules, nm, "module");
+		this_process = process_struc_create();
+		if(this_process == NULL)
+			err(1,"failed to create process from aggregate %s",path);
+		this_process->name = agg_string(path, strings, num_strings, process[i].name);
+		this_process->pid = process[i].pid;
+		this_process->tid_main = process[i].tid_main;
+		this_process->principal_process = this_process;
+		this_process->total_sample_count = agg_int(process[i].total_sample_count);
+		agg_counts_load(this_process->sample_count, &process_count[(uint64_t)i*count], count);
+		if(last_process == NULL)
+			principal_process_stack = this_process;
+		else
+			{
+			last_process->principal_next = this_process;
+			this_process->principal_previous = last_process;
+			}
+		last_process = this_process;
+
+		last_module = NULL;
+		for(j = process[i].first_module; j < process[i].first_module + process[i].num_modules; j++)
+			{
+//			a module struc has one process list, module ranges must not overlap
+			if(module_used[j])
+				errx(1,"aggregate file %s lists module %u in more than one process",path,j);
+			module_used[j] = 1;
+			this_module = modules[j];
+			if(last_module == NULL)
+				this_process->first_module = this_module;
+			else
+				{
+				last_module->next = this_module;
+				this_module->previous = last_module;
+				}
+			last_module = this_module;
+			this_process->module_count++;
+
+//			find_rva_sample pushes on first_sample, go backwards to keep the order
+			for(k = module[j].first_rva + module[j].num_rvas; k-- > module[j].first_rva; )
+				{
+				this_sample = find_rva_sample(this_module, rva_addr[k]);
+				agg_range(path, rva[k].first_pair, rva[k].num_pairs, hdr->column[AGG_PAIR].entries, "counter");
+				for(l = rva[k].first_pair; l < rva[k].first_pair + rva[k].num_pairs; l++)
+					{
+					if((pair[l].index < 0) || (pair[l].index >= count))
+						errx(1,"aggregate file %s has a bad counter index %d",path,pair[l].index);
+					sample_count_add(this_sample, pair[l].index, agg_int(pair[l].count));
+					}
+				last_branch[RVA_RETURN] = last_branch[RVA_CALL] = last_branch[RVA_NEXT_TAKEN] = NULL;
+				agg_range(path, rva[k].first_branch, rva[k].num_branches, hdr->column[AGG_BRANCH].entries, "branch");
+				for(l = rva[k].first_branch; l < rva[k].first_branch + rva[k].num_branches; l++)
+					{
+					type = branch[l].type;
+					if((type < RVA_RETURN) || (type > RVA_NEXT_TAKEN)
+						|| ((branch[l].module != AGG_NONE) && (branch[l].module >= nm)))
+						errx(1,"aggregate file %s has a bad branch",path);
+					this_branch = branch_struc_create();
+					if(this_branch == NULL)
+						err(1,"failed to create branch from aggregate %s",path);
+					this_branch->address = branch_addr[l];
+					this_branch->this_module = branch[l].module == AGG_NONE ? NULL : modules[branch[l].module];
+					this_branch->count = agg_int(branch[l].count);
+//					append, the lists keep their order
+					if(last_branch[type] != NULL)
+						{
+						last_branch[type]->next = this_branch;
+						this_branch->previous = last_branch[type];
+						}
+					else if(type == RVA_RETURN)
+						this_sample->return_list = this_branch;
+					else if(type == RVA_CALL)
+						this_sample->call_list = this_branch;
+					else
+						this_sample->next_taken_list = this_branch;
+					last_branch[type] = this_branch;
+					}
+				if(rva[k].mem != 0)
+					{
+					agg_range(path, rva[k].mem - 1, 1, hdr->column[AGG_MEM].entries, "memory profile");
+					agg_mem_load(&this_mem, &mem[rva[k].mem - 1]);
+					mem_stats_merge(&this_sample->mem, &this_mem);
+					}
+				if(rva[k].cycles != 0)
+					{
+					agg_range(path, rva[k].cycles - 1, 1, hdr->column[AGG_CYCLES].entries, "block cycles");
+					agg_cycles_load(&this_cycles, &cycles[rva[k].cycles - 1]);
+					block_cycles_merge(&this_sample->cycles, &this_cycles);
+					}
+				this_sample->total_sample_count = agg_int(rva[k].total_sample_count);
+				this_sample->total_sources = agg_int(rva[k].total_sources);
+				this_sample->total_targets = agg_int(rva[k].total_targets);
+				this_sample->total_taken_branch = agg_int(rva[k].total_taken_branch);
+				this_sample->lbr.taken = agg_int(rva[k].lbr_taken);
+				this_sample->lbr.mispredict = agg_int(rva[k].lbr_mispredict);
+				}
+			}
+		}
+
+	num_process = np;
+	total_sample_count = agg_int(hdr->scalar[AGG_TOTAL_SAMPLES]);
+	global_branch_sample_count = agg_int(hdr->scalar[AGG_BRANCH_SAMPLES]);
+	lbr_ret = agg_int(hdr->scalar[AGG_LBR_RET]);
+	lbr_any = agg_int(hdr->scalar[AGG_LBR_ANY]);
+	total_lbr_entries = agg_int(hdr->scalar[AGG_LBR_ENTRIES]);
+	mem_sample_count = agg_int(hdr->scalar[AGG_MEM_SAMPLES]);
+	lbr_outcome_count = agg_int(hdr->scalar[AGG_LBR_OUTCOMES]);
+	lbr_cycles_count = agg_int(hdr->scalar[AGG_LBR_CYCLES]);
+	if(agg_saturated != 0)
+		gooda_log(GLOG_WARN," aggregate %s: %d counts do not fit in an int and were saturated\n",path,agg_saturated);
+
+	gooda_log(GLOG_INFO," read aggregate %s, %"PRIu64" processes, %"PRIu64" modules, %"PRIu64" rvas\n",path,np,nm,nr);
+	free(modules);
+	free(module_used);
+	munmap(map, st.st_size);
+	close(fd);
+}
@@ -0,0 +1,157 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	aggregate file format, written and read by gooda_aggregate.c and merged
+//	by multi_perf.c
+//
+//	The file is laid out to be mmapped: the header below, then one array per
+//	column, each starting on an 8 byte boundary, all fields little endian as
+//	written by the host. Rows refer to each other by index, processes hold a
+//	range of modules, modules a range of rvas, rvas a range of counter pairs
+//	and branches and optionally one memory and one block latency profile.
+//	Version 2 added the module build-ids and the event hash and made every
+//	count, total and scalar 64 bit, so merging many runs does not overflow;
+//	gooda saturates them to its int counters when it loads the file.
+
+#define AGG_MAGIC	"GOODAAGG"
+#define AGG_VERSION	2
+#define AGG_NONE	0xffffffff	/* no target module */
+
+enum agg_scalar {
+	AGG_TOTAL_SAMPLES = 0,	/* total_sample_count */
+	AGG_BRANCH_SAMPLES,	/* global_branch_sample_count */
+	AGG_LBR_RET,
+	AGG_LBR_ANY,
+	AGG_LBR_ENTRIES,	/* total_lbr_entries */
+	AGG_MEM_SAMPLES,	/* mem_sample_count */
+	AGG_LBR_OUTCOMES,	/* lbr_outcome_count */
+	AGG_LBR_CYCLES,		/* lbr_cycles_count */
+	AGG_NUM_SCALARS,
+	};
+
+enum agg_column {
+	AGG_STRINGS = 0,	/* char, NUL terminated process names, module paths and build-ids */
+	AGG_GLOBAL_COUNT,	/* int64, global_sample_count */
+	AGG_GLOBAL_MULTIPLEX,	/* double, global_multiplex_correction */
+	AGG_PROCESS,		/* agg_process_data, in principal_process_stack order */
+	AGG_PROCESS_COUNT,	/* int64, count per process */
+	AGG_MODULE,		/* agg_module_data, the modules of each process in list order */
+	AGG_MODULE_COUNT,	/* int64, count per module */
+	AGG_RVA_ADDR,		/* uint64, the rvas of each module */
+	AGG_RVA,		/* agg_rva_data */
+	AGG_PAIR,		/* agg_pair_data, the nonzero counters of each rva */
+	AGG_BRANCH_ADDR,	/* uint64, target address of each branch */
+	AGG_BRANCH,		/* agg_branch_data, return, call and next taken lists in list order */
+	AGG_MEM,		/* agg_mem_data */
+	AGG_CYCLES,		/* agg_cycles_data */
+	NUM_AGG_COLUMNS,
+	};
+
+typedef struct agg_process_struc{
+	uint32_t		name;			/* offset in AGG_STRINGS */
+	uint32_t		pid;
+	uint32_t		tid_main;
+	uint32_t		first_module;
+	uint32_t		num_modules;
+	uint32_t		pad;
+	int64_t			total_sample_count;
+	}agg_process_data;
+
+typedef struct agg_module_struc{
+	uint64_t		starting_ip;
+	uint64_t		length;
+	uint32_t		path;			/* offset in AGG_STRINGS */
+	uint32_t		first_rva;
+	uint32_t		num_rvas;
+	int32_t			is_kernel;
+	uint32_t		buildid;		/* offset in AGG_STRINGS, "" when perf.data has none */
+	uint32_t		pad;
+	int64_t			total_sample_count;
+	int64_t			total_branches;
+	int64_t			total_sources;
+	int64_t			total_targets;
+	}agg_module_data;
+
+typedef struct agg_rva_struc{
+	uint32_t		first_pair;
+	uint32_t		num_pairs;
+	uint32_t		first_branch;
+	uint32_t		num_branches;
+	uint32_t		mem;			/* 1 + index in AGG_MEM, 0 for none */
+	uint32_t		cycles;			/* 1 + index in AGG_CYCLES, 0 for none */
+	int64_t			total_sample_count;
+	int64_t			total_sources;
+	int64_t			total_targets;
+	int64_t			total_taken_branch;
+	int64_t			lbr_taken;		/* lbr_outcome_data */
+	int64_t			lbr_mispredict;
+	}agg_rva_data;
+
+typedef struct agg_pair_struc{
+	int32_t			index;
+	uint32_t		pad;
+	int64_t			count;
+	}agg_pair_data;
+
+typedef struct agg_branch_struc{
+	uint32_t		module;			/* index in AGG_MODULE, AGG_NONE */
+	int32_t			type;			/* RVA_RETURN, RVA_CALL or RVA_NEXT_TAKEN */
+	int64_t			count;
+	}agg_branch_data;
+
+//	mem_stats_data and block_cycles_data with 64 bit counts
+typedef struct agg_mem_struc{
+	uint64_t		lat_sum;
+	int64_t			count;
+	int64_t			lat_hist[MEM_LAT_BUCKETS];
+	int64_t			src_count[NUM_MEM_SRC];
+	}agg_mem_data;
+
+typedef struct agg_cycles_struc{
+	uint64_t		cyc_sum;
+	uint64_t		loop_cyc_sum;
+	int64_t			count;
+	int64_t			loop_count;
+	int64_t			cyc_hist[MEM_LAT_BUCKETS];
+	}agg_cycles_data;
+
+typedef struct agg_header_struc{
+	char			magic[8];
+	uint32_t		version;
+	uint32_t		num_columns;
+	int32_t			num_events;
+	int32_t			num_cores;
+	int32_t			num_sockets;
+	int32_t			count;			/* counters per process, module and rva */
+	uint64_t		data_offset;		/* perf.data data section it was made from */
+	uint64_t		data_size;
+	uint64_t		event_hash;		/* of the event names and configs, see aggregate_event_hash */
+	int64_t			scalar[AGG_NUM_SCALARS];
+	struct {
+		uint64_t	offset;
+		uint64_t	entries;
+	}			column[NUM_AGG_COLUMNS];
+	}agg_header_data;
+
+static const size_t agg_column_size[NUM_AGG_COLUMNS] = {
+	sizeof(char), sizeof(int64_t), sizeof(double),
+	sizeof(agg_process_data), sizeof(int64_t),
+	sizeof(agg_module_data), sizeof(int64_t),
+	sizeof(uint64_t), sizeof(agg_rva_data), sizeof(agg_pair_data),
+	sizeof(uint64_t), sizeof(agg_branch_data),
+	sizeof(agg_mem_data), sizeof(agg_cycles_data),
+	};
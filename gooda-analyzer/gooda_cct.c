@@ -0,0 +1,335 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	calling context tree built from PERF_SAMPLE_CALLCHAIN
+//
+//	During ingest every callchain IP is bound with bind_sample and the chain is
+//	walked from the outermost frame in, giving a tree of (module, rva) frames
+//	under one root per principal process. Function lists only exist once the
+//	analysis has run get_functionlist, so cct_report then folds the frame tree
+//	into a tree keyed by (parent, function). Both trees hash-cons their
+//	children in one open addressing table per tree, and each node carries an
+//	exclusive count per event. cct_report then sums the function tree into one
+//	row per (process, module, function), callchain only functions such as main
+//	included, each credited once per path with inclusive and exclusive counts
+//	for every event. It writes those rows to spreadsheets/cg/cct_functions.csv,
+//	copies the first event's counts to the function_struc of sampled functions
+//	for the CCT columns of the hotspot tables, and writes the function tree as
+//	folded stacks of the first event, one "process;outer;...;inner count" line
+//	per leaf, to spreadsheets/cg/cct.folded.
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+#include "gooda_log.h"
+
+typedef struct cct_table_struc{
+	cct_node_ptr	*	slot;		/* NULL marks an empty slot */
+	int			size;
+	int			shift;
+	int			entries;
+	}cct_table_data;
+
+static cct_table_data frame_table, func_table, sum_table;
+static cct_node_data frame_top, func_top, sum_top;	/* their children are the process roots */
+static int cct_lost_frames = 0, cct_truncated = 0;
+
+static inline int
+cct_slot(cct_table_data *this_table, cct_node_ptr parent, module_struc_ptr this_module, uint64_t key)
+{
+	uint64_t h;
+
+	h = (uint64_t)(uintptr_t)parent * 0x9E3779B97F4A7C15ULL;
+	h ^= (uint64_t)(uintptr_t)this_module * 0xC2B2AE3D27D4EB4FULL;
+	h ^= key * 0x165667B19E3779F9ULL;
+	h ^= h >> 29;
+	return (int)((h * 0x9E3779B97F4A7C15ULL) >> this_table->shift);
+}
+
+static void
+cct_grow(cct_table_data *this_table)
+{
+	cct_node_ptr *old_slot = this_table->slot, this_node;
+	int old_size = this_table->size, i, index, mask;
+
+	if(old_size == 0)
+		{
+		this_table->size = 1024;
+		this_table->shift = 54;
+		}
+	else
+		{
+		this_table->size = 2*old_size;
+		this_table->shift--;
+		}
+	this_table->slot = (cct_node_ptr *)calloc(this_table->size, sizeof(cct_node_ptr));
+	if(this_table->slot == NULL)
+		err(1,"failed to allocate calling context table of %d slots",this_table->size);
+	mask = this_table->size - 1;
+	for(i = 0; i < old_size; i++)
+		{
+		this_node = old_slot[i];
+		if(this_node == NULL)
+			continue;
+		index = cct_slot(this_table, this_node->parent, this_node->this_module, this_node->key);
+		while(this_table->slot[index] != NULL)
+			index = (index + 1) & mask;
+		this_table->slot[index] = this_node;
+		}
+	free(old_slot);
+}
+
+//	find or create the child of parent for (this_module, key), new nodes get counts zeroed counters
+static cct_node_ptr
+cct_child(cct_table_data *this_table, cct_node_ptr parent, module_struc_ptr this_module, uint64_t key, int counts)
+{
+	cct_node_ptr this_node;
+	int index, mask;
+
+	if(2*(this_table->entries + 1) > this_table->size)
+		cct_grow(this_table);
+	mask = this_table->size - 1;
+	index = cct_slot(this_table, parent, this_module, key);
+	while((this_node = this_table->slot[index]) != NULL)
+		{
+		if((this_node->parent == parent) && (this_node->this_module == this_module) && (this_node->key == key))
+			return this_node;
+		index = (index + 1) & mask;
+		}
+	this_node = arena_alloc(ARENA_CCT, sizeof(cct_node_data) + counts*sizeof(int));
+	if(this_node == NULL)
+		err(1,"failed to allocate calling context node");
+	this_node->sample_count = (int *)(this_node + 1);
+	this_node->parent = parent;
+	this_node->this_module = this_module;
+	this_node->key = key;
+	this_node->next_sibling = parent->first_child;
+	parent->first_child = this_node;
+	this_table->slot[index] = this_node;
+	this_table->entries++;
+	return this_node;
+}
+
+//	add one sample, chain holds the callchain IPs innermost first with the
+//	PERF_CONTEXT markers already removed
+void
+cct_add(uint32_t pid, uint64_t this_time, uint64_t *chain, int len, int event, process_struc_ptr principal_process)
+{
+	cct_node_ptr this_node;
+	mmap_struc_ptr this_mmap;
+	module_struc_ptr this_module;
+	uint64_t ip;
+	int i;
+
+	if((event < 0) || (event >= num_events) || (principal_process == NULL))
+		return;
+	if(len == CCT_MAX_DEPTH)cct_truncated++;
+	this_node = cct_child(&frame_table, &frame_top, NULL, (uint64_t)(uintptr_t)principal_process, num_events);
+	for(i = len - 1; i >= 0; i--)
+		{
+//		the callers' entries are return addresses, step back into the call
+		ip = (i == 0) ? chain[i] : chain[i] - 1;
+		this_mmap = bind_sample(pid, ip, this_time);
+		if((this_mmap == NULL) && (ip >= base_kern_address))
+			this_mmap = bind_sample(pid_ker, ip, this_time);
+		if(this_mmap == NULL)
+			{
+			cct_lost_frames++;
+			continue;
+			}
+		if(this_mmap->principal_process == NULL)
+			find_principal_process(this_mmap);
+		this_module = this_mmap->this_module;
+		if(this_module == NULL)
+			this_module = bind_mmap(this_mmap);
+		this_node = cct_child(&frame_table, this_node, this_module, ip - this_mmap->addr + this_module->starting_ip, num_events);
+		}
+	this_node->sample_count[event]++;
+	cct_sample_count++;
+}
+
+//	function nodes hold the exclusive counts, then the inclusive counts cct_inclusive fills in
+static void
+cct_fold(cct_node_ptr frame, cct_node_ptr func_node)
+{
+	cct_node_ptr child, func_child;
+	function_loc_data *this_func;
+	int i;
+
+	for(child = frame->first_child; child != NULL; child = child->next_sibling)
+		{
+		this_func = (child->this_module == NULL) ? (function_loc_data *)(uintptr_t)child->key
+			: find_function_loc(child->this_module, child->key);
+		func_child = cct_child(&func_table, func_node, child->this_module, (uint64_t)(uintptr_t)this_func, 2*num_events);
+		for(i = 0; i < num_events; i++)
+			func_child->sample_count[i] += child->sample_count[i];
+		cct_fold(child, func_child);
+		}
+}
+
+//	sum the subtree of this_node into its inclusive counts and credit the
+//	function row under sum_root, each function once per path: a row holds the
+//	inclusive counts, the exclusive counts and the times it is on the current path
+static void
+cct_inclusive(cct_node_ptr this_node, cct_node_ptr sum_root)
+{
+	cct_node_ptr child, this_row;
+	int *inclusive = this_node->sample_count + num_events, *active;
+	int i;
+
+	this_row = cct_child(&sum_table, sum_root, this_node->this_module, this_node->key, 2*num_events + 1);
+	active = &this_row->sample_count[2*num_events];
+	(*active)++;
+	for(i = 0; i < num_events; i++)
+		{
+		inclusive[i] = this_node->sample_count[i];
+		this_row->sample_count[num_events + i] += this_node->sample_count[i];
+		}
+	for(child = this_node->first_child; child != NULL; child = child->next_sibling)
+		{
+		cct_inclusive(child, sum_root);
+		for(i = 0; i < num_events; i++)
+			inclusive[i] += child->sample_count[num_events + i];
+		}
+	(*active)--;
+	if(*active == 0)
+		for(i = 0; i < num_events; i++)
+			this_row->sample_count[i] += inclusive[i];
+}
+
+static void
+cct_frame_name(FILE *out, cct_node_ptr this_node)
+{
+	function_loc_data *this_func;
+
+	if(this_node->this_module == NULL)
+		{
+		fprintf(out,"%s",((process_struc_ptr)(uintptr_t)this_node->key)->name);
+		return;
+		}
+	this_func = (function_loc_data *)(uintptr_t)this_node->key;
+	if(this_func != NULL)
+		fprintf(out,"%s",this_func->name);
+	else
+		fprintf(out,"[%s]",this_node->this_module->module_name);
+}
+
+//	one row per function reached by a callchain, inclusive then exclusive counts per event
+static void
+cct_functions(void)
+{
+	cct_node_ptr sum_root, this_row;
+	process_struc_ptr this_process;
+	function_loc_data *this_func;
+	char function_file[] = "./spreadsheets/cg/cct_functions.csv";
+	FILE *list;
+	int i;
+
+	list = fopen(function_file, "w");
+	if(list == NULL)
+		{
+		fprintf(stderr,"failed to open %s\n",function_file);
+		return;
+		}
+	fprintf(list,"[\n[, \"Function Name\", \"Module\", \"Process\",");
+	for(i = 0; i < num_events; i++)fprintf(list," \"Inclusive %s\",",event_list[i].name);
+	for(i = 0; i < num_events; i++)fprintf(list," \"Exclusive %s\",",event_list[i].name);
+	fprintf(list," ],\n");
+	for(sum_root = sum_top.first_child; sum_root != NULL; sum_root = sum_root->next_sibling)
+		{
+		this_process = (process_struc_ptr)(uintptr_t)sum_root->key;
+		for(this_row = sum_root->first_child; this_row != NULL; this_row = this_row->next_sibling)
+			{
+			fprintf(list,"[, \"");
+			cct_frame_name(list, this_row);
+			fprintf(list,"\", \"%s\", \"%s\",",this_row->this_module->path,this_process->name);
+			for(i = 0; i < 2*num_events; i++)fprintf(list," %d,",this_row->sample_count[i]);
+			fprintf(list," ],\n");
+//			the hotspot tables carry the first event for the functions that have rows there
+			this_func = (function_loc_data *)(uintptr_t)this_row->key;
+			if((this_func != NULL) && (this_func->this_function != NULL))
+				{
+				this_func->this_function->cct_inclusive += this_row->sample_count[0];
+				this_func->this_function->cct_exclusive += this_row->sample_count[num_events];
+				}
+			}
+		}
+	fprintf(list,"]\n");
+	fclose(list);
+}
+
+static void
+cct_folded(FILE *out, cct_node_ptr this_node, cct_node_ptr *path, int depth)
+{
+	cct_node_ptr child;
+	int i;
+
+	path[depth++] = this_node;
+	if(this_node->sample_count[0] != 0)
+		{
+		for(i = 0; i < depth; i++)
+			{
+			if(i > 0)fputc(';',out);
+			cct_frame_name(out, path[i]);
+			}
+		fprintf(out," %d\n",this_node->sample_count[0]);
+		}
+	for(child = this_node->first_child; child != NULL; child = child->next_sibling)
+		cct_folded(out, child, path, depth);
+}
+
+void
+cct_report(void)
+{
+	cct_node_ptr root, child, sum_root, path[CCT_MAX_DEPTH + 2];
+	char folded_file[] = "./spreadsheets/cg/cct.folded";
+	FILE *out;
+
+	if(cct_sample_count == 0)
+		return;
+	cct_fold(&frame_top, &func_top);
+	gooda_log(GLOG_INFO,"calling context tree: %d samples, %d frame nodes, %d function nodes\n",
+		cct_sample_count, frame_table.entries, func_table.entries);
+	if(cct_lost_frames + cct_truncated > 0)
+		gooda_log(GLOG_WARN,"calling context tree: %d frames without an mmap, %d chains cut at %d frames\n",
+			cct_lost_frames, cct_truncated, CCT_MAX_DEPTH);
+	for(root = func_top.first_child; root != NULL; root = root->next_sibling)
+		{
+		sum_root = cct_child(&sum_table, &sum_top, NULL, root->key, 2*num_events + 1);
+		for(child = root->first_child; child != NULL; child = child->next_sibling)
+			cct_inclusive(child, sum_root);
+		}
+	cct_functions();
+
+	out = fopen(folded_file, "w");
+	if(out == NULL)
+		{
+		fprintf(stderr,"failed to open %s\n",folded_file);
+		return;
+		}
+	for(root = func_top.first_child; root != NULL; root = root->next_sibling)
+		cct_folded(out, root, path, 0);
+	fclose(out);
+}
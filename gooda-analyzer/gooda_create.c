@@ -26,7 +26,9 @@ limitations under the License.
 #include <stdio.h>
 #include <string.h>
 #include <err.h>
+#include <inttypes.h>
 #include <malloc.h>
+#include <pthread.h>
 #include "perf_event.h"
 #include "gooda.h"
 #include "perf_gooda.h"
@@ -38,6 +40,139 @@ get_count(void)
 	return num_events*(num_cores+num_sockets+1) + num_branch + num_sub_branch + num_derived + 1;
 }
 
+//	arenas
+//	the strucs are never freed one at a time, so they are carved out of large
+//	zeroed chunks instead of being calloc'd individually. Each thread bumps a
+//	pointer in its own current chunk of an arena, so the ingest shard threads
+//	only take the arena lock to add a chunk. arena_reset releases a whole arena
+//	at once, none of its strucs may be in use by then.
+
+#define ARENA_CHUNK	(1 << 20)	/* bytes per chunk, larger requests get their own */
+#define ARENA_ALIGN	8
+
+typedef struct arena_chunk_struc * arena_chunk_ptr;
+typedef struct arena_chunk_struc{
+	arena_chunk_ptr		next;
+	size_t			size;
+	}arena_chunk_data;
+
+typedef struct arena_struc{
+	const char *		name;
+	pthread_mutex_t		lock;
+	arena_chunk_ptr		first_chunk;
+	uint64_t		chunk_bytes;	/* bytes obtained from calloc */
+	uint64_t		used_bytes;	/* bytes handed out */
+	uint64_t		objects;
+	int			generation;	/* bumped by arena_reset */
+	}arena_data;
+
+typedef struct arena_cursor_struc{
+	char *			next;
+	char *			end;
+	int			generation;
+	}arena_cursor_data;
+
+static arena_data arena_list[NUM_ARENAS] = {
+	{"process", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"module", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"perf record", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"sample", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"branch", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"function", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"asm", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"basic block", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"mem profile", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	{"call context", PTHREAD_MUTEX_INITIALIZER, NULL, 0, 0, 0, 1},
+	};
+
+static __thread arena_cursor_data arena_cursor[NUM_ARENAS];
+
+static int
+arena_refill(arena_data *this_arena, arena_cursor_data *cursor, size_t size)
+{
+	arena_chunk_ptr this_chunk;
+	size_t header, chunk_size;
+
+	header = (sizeof(arena_chunk_data) + 15) & ~(size_t)15;
+	chunk_size = ARENA_CHUNK;
+	if(header + size > chunk_size)
+		chunk_size = header + size;
+	this_chunk = calloc(1, chunk_size);
+	if(this_chunk == NULL)
+		return 0;
+	this_chunk->size = chunk_size;
+	pthread_mutex_lock(&this_arena->lock);
+	this_chunk->next = this_arena->first_chunk;
+	this_arena->first_chunk = this_chunk;
+	this_arena->chunk_bytes += chunk_size;
+	cursor->generation = this_arena->generation;
+	pthread_mutex_unlock(&this_arena->lock);
+	cursor->next = (char *)this_chunk + header;
+	cursor->end = (char *)this_chunk + chunk_size;
+	return 1;
+}
+
+//	zeroed memory for one struc, NULL when out of memory
+void *
+arena_alloc(int arena, size_t size)
+{
+	arena_data *this_arena = &arena_list[arena];
+	arena_cursor_data *cursor = &arena_cursor[arena];
+	char *ptr;
+
+	size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if((cursor->generation != this_arena->generation) || (size > (size_t)(cursor->end - cursor->next)))
+		{
+		if(arena_refill(this_arena, cursor, size) == 0)
+			return NULL;
+		}
+	ptr = cursor->next;
+	cursor->next += size;
+	__sync_fetch_and_add(&this_arena->used_bytes, (uint64_t)size);
+	__sync_fetch_and_add(&this_arena->objects, 1);
+	return ptr;
+}
+
+void
+arena_reset(int arena)
+{
+	arena_data *this_arena = &arena_list[arena];
+	arena_chunk_ptr this_chunk;
+
+	pthread_mutex_lock(&this_arena->lock);
+	while(this_arena->first_chunk != NULL)
+		{
+		this_chunk = this_arena->first_chunk;
+		this_arena->first_chunk = this_chunk->next;
+		free(this_chunk);
+		}
+	this_arena->chunk_bytes = 0;
+	this_arena->used_bytes = 0;
+	this_arena->objects = 0;
+	this_arena->generation++;
+	pthread_mutex_unlock(&this_arena->lock);
+}
+
+//	bytes held by each arena, plus the sample counters that outgrew their struc
+void
+arena_report(void)
+{
+	uint64_t chunk_total = 0, used_total = 0;
+	int i;
+
+	fprintf(stderr," arena            objects    used bytes   chunk bytes\n");
+	for(i = 0; i < NUM_ARENAS; i++)
+		{
+		fprintf(stderr," %-12s %11"PRIu64" %13"PRIu64" %13"PRIu64"\n",arena_list[i].name,
+			arena_list[i].objects, arena_list[i].used_bytes, arena_list[i].chunk_bytes);
+		chunk_total += arena_list[i].chunk_bytes;
+		used_total += arena_list[i].used_bytes;
+		}
+	fprintf(stderr," %-12s %11s %13"PRIu64" %13"PRIu64"\n","total","",used_total,chunk_total);
+	fprintf(stderr," sample counters moved out of the sample arena use %"PRIu64" bytes, dense arrays would use %"PRIu64"\n",
+		sample_count_bytes, arena_list[ARENA_SAMPLE].objects*sizeof(int)*get_count());
+}
+
 function_struc_ptr 
 function_struc_create(void)
 {
@@ -73,15 +208,11 @@ function_struc_create(void)
 	this_struc->total_targets = 0;
 	this_struc->total_sources = 0;
 */
-	this_struc = calloc(1, sizeof(function_data));
+	this_struc = arena_alloc(ARENA_FUNCTION, sizeof(function_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
 	this_struc->funclist_index = -1;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
 	return this_struc;
 }
 
@@ -105,14 +236,10 @@ source_struc_create(void)
         this_struc->inst_count = 0;
         this_struc->total_sample_count = 0;
 */
-	this_struc = calloc(1, sizeof(source_data));
+	this_struc = arena_alloc(ARENA_FUNCTION, sizeof(source_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
 
         return this_struc;
 }
@@ -137,14 +264,10 @@ principal_file_struc_create(void)
         this_struc->inst_count = 0;
         this_struc->total_sample_count = 0;
 */
-	this_struc = calloc(1, sizeof(principal_file_data));
+	this_struc = arena_alloc(ARENA_PROCESS, sizeof(principal_file_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
 
         return this_struc;
 }
@@ -186,14 +309,10 @@ module_struc_create(void)
         this_struc->local_calls = 0;
         this_struc->remote_calls = 0;
 */
-	this_struc = calloc(1, sizeof(module_data));
+	this_struc = arena_alloc(ARENA_MODULE, sizeof(module_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
 
         return this_struc;
 }
@@ -217,15 +336,11 @@ thread_struc_create(void)
         this_struc->total_sample_count = 0;
 */
 
-	this_struc = calloc(1, sizeof(thread_data));
+	this_struc = arena_alloc(ARENA_PROCESS, sizeof(thread_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
 	this_struc->tid = -1;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
         return this_struc;
 }
 
@@ -260,14 +375,10 @@ process_struc_create(void)
         this_struc->inst_count = 0;
         this_struc->total_sample_count = 0;
 */
-	this_struc = calloc(1, sizeof(process_data));
+	this_struc = arena_alloc(ARENA_PROCESS, sizeof(process_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
 
         return this_struc;
 }
@@ -284,7 +395,7 @@ child_struc_create(void)
         this_struc->this_process = NULL;
         this_struc->parent = NULL;
 */
-	this_struc = calloc(1, sizeof(child_data));
+	this_struc = arena_alloc(ARENA_PROCESS, sizeof(child_data));
         return this_struc;
 }
 
@@ -314,24 +425,267 @@ sample_struc_create(void)
         this_struc->compilation_file_line = 0;
         this_struc->total_sample_count = 0;
 */
-	this_struc = calloc(1, sizeof(sample_data));
+	this_struc = arena_alloc(ARENA_SAMPLE, sizeof(sample_data) + SAMPLE_INLINE_PAIRS*sizeof(count_pair_data));
 	if(this_struc == NULL)return this_struc;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
-	if(this_struc != NULL)sample_struc_count++;
+//	the first counter pairs follow the struc in the same allocation,
+//	sample_count_add moves them out when more are needed
+	this_struc->count_pair = (count_pair_data*)(this_struc + 1);
+	this_struc->count_max = SAMPLE_INLINE_PAIRS;
         return this_struc;
 }
 
+//	per rva counters
+//	most rva's only see a handful of (event, core) combinations, so the counters
+//	start as a sorted list of (index, count) pairs and are promoted to the dense
+//	get_count() array once the list would take half of its space.
+//	The first SAMPLE_INLINE_PAIRS pairs live right behind the struc in the sample
+//	arena, sample_count_bytes tracks the memory used by the lists and arrays
+//	that outgrow them.
+
+static int
+sample_count_find(sample_struc_ptr this_sample, int index)
+{
+	int lo = 0, hi = this_sample->count_len, mid;
+
+//	first pair with pair.index >= index
+	while(lo < hi)
+		{
+		mid = (lo + hi)/2;
+		if(this_sample->count_pair[mid].index < index)
+			lo = mid + 1;
+		else
+			hi = mid;
+		}
+	return lo;
+}
+
+static inline int
+sample_count_inline(sample_struc_ptr this_sample)
+{
+	return this_sample->count_pair == (count_pair_data*)(this_sample + 1);
+}
+
+static void
+sample_count_promote(sample_struc_ptr this_sample)
+{
+	int i, len = get_count();
+
+	this_sample->sample_count = calloc(len, sizeof(int));
+	if(this_sample->sample_count == NULL)
+		err(1,"failed to promote sample counters for rva 0x%"PRIx64,this_sample->rva);
+	for(i = 0; i < this_sample->count_len; i++)
+		this_sample->sample_count[this_sample->count_pair[i].index] = this_sample->count_pair[i].count;
+	__sync_fetch_and_add(&sample_count_bytes, (uint64_t)len*sizeof(int));
+	if(!sample_count_inline(this_sample))
+		{
+		__sync_fetch_and_sub(&sample_count_bytes, (uint64_t)this_sample->count_max*sizeof(count_pair_data));
+		free(this_sample->count_pair);
+		}
+	this_sample->count_pair = NULL;
+	this_sample->count_len = 0;
+	this_sample->count_max = 0;
+}
+
+int
+sample_count_get(sample_struc_ptr this_sample, int index)
+{
+	int pos;
+
+	if(this_sample->sample_count != NULL)
+		return this_sample->sample_count[index];
+	pos = sample_count_find(this_sample, index);
+	if((pos < this_sample->count_len) && (this_sample->count_pair[pos].index == index))
+		return this_sample->count_pair[pos].count;
+	return 0;
+}
+
+void
+sample_count_add(sample_struc_ptr this_sample, int index, int val)
+{
+	count_pair_data *new_pair;
+	int pos, new_max;
+
+	if(this_sample->sample_count != NULL)
+		{
+		this_sample->sample_count[index] += val;
+		return;
+		}
+	pos = sample_count_find(this_sample, index);
+	if((pos < this_sample->count_len) && (this_sample->count_pair[pos].index == index))
+		{
+		this_sample->count_pair[pos].count += val;
+		return;
+		}
+	if(val == 0)
+		return;
+	if(this_sample->count_len == this_sample->count_max)
+		{
+		new_max = 2*this_sample->count_max;
+		if(2*new_max >= get_count())
+			{
+			sample_count_promote(this_sample);
+			this_sample->sample_count[index] += val;
+			return;
+			}
+		if(sample_count_inline(this_sample))
+			{
+			new_pair = (count_pair_data *)malloc(new_max*sizeof(count_pair_data));
+			if(new_pair != NULL)
+				memcpy(new_pair, this_sample->count_pair, this_sample->count_len*sizeof(count_pair_data));
+			__sync_fetch_and_add(&sample_count_bytes, (uint64_t)new_max*sizeof(count_pair_data));
+			}
+		else
+			{
+			new_pair = (count_pair_data *)realloc(this_sample->count_pair, new_max*sizeof(count_pair_data));
+			__sync_fetch_and_add(&sample_count_bytes, (uint64_t)(new_max - this_sample->count_max)*sizeof(count_pair_data));
+			}
+		if(new_pair == NULL)
+			err(1,"failed to grow sample counters for rva 0x%"PRIx64,this_sample->rva);
+		this_sample->count_pair = new_pair;
+		this_sample->count_max = new_max;
+		}
+	if(pos < this_sample->count_len)
+		memmove(&this_sample->count_pair[pos+1], &this_sample->count_pair[pos],
+			(this_sample->count_len - pos)*sizeof(count_pair_data));
+	this_sample->count_pair[pos].index = index;
+	this_sample->count_pair[pos].count = val;
+	this_sample->count_len++;
+}
+
+//	walk the nonzero counters in index order, *pos starts at 0, returns 0 at the end
+int
+sample_count_next(sample_struc_ptr this_sample, int *pos, int *index, int *count)
+{
+	int len;
+
+	if(this_sample->sample_count != NULL)
+		{
+		len = get_count();
+		while(*pos < len)
+			{
+			*index = (*pos)++;
+			*count = this_sample->sample_count[*index];
+			if(*count != 0)
+				return 1;
+			}
+		return 0;
+		}
+	if(*pos >= this_sample->count_len)
+		return 0;
+	*index = this_sample->count_pair[*pos].index;
+	*count = this_sample->count_pair[*pos].count;
+	(*pos)++;
+	return 1;
+}
+
+//	log2 latency bucket, 0 for a zero weight, the last bucket takes the tail
+int
+mem_lat_bucket(uint64_t weight)
+{
+	int bucket;
+
+	if(weight == 0)
+		return 0;
+	bucket = 64 - __builtin_clzll(weight);
+	if(bucket >= MEM_LAT_BUCKETS)
+		bucket = MEM_LAT_BUCKETS - 1;
+	return bucket;
+}
+
+static mem_stats_ptr
+mem_stats_create(void)
+{
+	mem_stats_ptr this_struc;
+
+	this_struc = arena_alloc(ARENA_MEM, sizeof(mem_stats_data));
+	if(this_struc == NULL)
+		err(1,"failed to allocate mem profile");
+	return this_struc;
+}
+
+void
+mem_stats_add(mem_stats_ptr *mem, uint64_t weight, int src)
+{
+	mem_stats_ptr this_mem = *mem;
+
+	if(this_mem == NULL)
+		this_mem = *mem = mem_stats_create();
+	this_mem->count++;
+	this_mem->lat_sum += weight;
+	this_mem->lat_hist[mem_lat_bucket(weight)]++;
+	this_mem->src_count[src]++;
+}
+
+void
+mem_stats_merge(mem_stats_ptr *mem, mem_stats_ptr from)
+{
+	mem_stats_ptr this_mem = *mem;
+	int i;
+
+	if(from == NULL)
+		return;
+	if(this_mem == NULL)
+		this_mem = *mem = mem_stats_create();
+	this_mem->count += from->count;
+	this_mem->lat_sum += from->lat_sum;
+	for(i = 0; i < MEM_LAT_BUCKETS; i++)
+		this_mem->lat_hist[i] += from->lat_hist[i];
+	for(i = 0; i < NUM_MEM_SRC; i++)
+		this_mem->src_count[i] += from->src_count[i];
+}
+
+static block_cycles_ptr
+block_cycles_create(void)
+{
+	block_cycles_ptr this_struc;
+
+	this_struc = arena_alloc(ARENA_BRANCH, sizeof(block_cycles_data));
+	if(this_struc == NULL)
+		err(1,"failed to allocate block cycles profile");
+	return this_struc;
+}
+
+void
+block_cycles_add(block_cycles_ptr *cyc, uint64_t cycles, int loop)
+{
+	block_cycles_ptr this_cyc = *cyc;
+
+	if(this_cyc == NULL)
+		this_cyc = *cyc = block_cycles_create();
+	this_cyc->count++;
+	this_cyc->cyc_sum += cycles;
+	this_cyc->cyc_hist[mem_lat_bucket(cycles)]++;
+	if(loop)
+		{
+		this_cyc->loop_count++;
+		this_cyc->loop_cyc_sum += cycles;
+		}
+}
+
+void
+block_cycles_merge(block_cycles_ptr *cyc, block_cycles_ptr from)
+{
+	block_cycles_ptr this_cyc = *cyc;
+	int i;
+
+	if(from == NULL)
+		return;
+	if(this_cyc == NULL)
+		this_cyc = *cyc = block_cycles_create();
+	this_cyc->count += from->count;
+	this_cyc->cyc_sum += from->cyc_sum;
+	this_cyc->loop_count += from->loop_count;
+	this_cyc->loop_cyc_sum += from->loop_cyc_sum;
+	for(i = 0; i < MEM_LAT_BUCKETS; i++)
+		this_cyc->cyc_hist[i] += from->cyc_hist[i];
+}
+
 
 branch_struc_ptr
 branch_struc_create(void)
 {
 	branch_struc_ptr this_struc;
-	this_struc = calloc(1,sizeof(branch_data));
+	this_struc = arena_alloc(ARENA_BRANCH, sizeof(branch_data));
 	return this_struc;
 }
 
@@ -339,14 +693,11 @@ func_branch_struc_ptr
 func_branch_struc_create(void)
 {
 	func_branch_struc_ptr this_struc;
-	this_struc = calloc(1,sizeof(func_branch_struc_data));
-	if(this_struc == NULL)return;
-	this_struc->this_branch_target = calloc(1,sizeof(branch_data));
+	this_struc = arena_alloc(ARENA_BRANCH, sizeof(func_branch_struc_data));
+	if(this_struc == NULL)return NULL;
+	this_struc->this_branch_target = arena_alloc(ARENA_BRANCH, sizeof(branch_data));
 	if(this_struc->this_branch_target == NULL)
-		{
-		free(this_struc);
 		return NULL;
-		}
 	return this_struc;
 }
 
@@ -354,7 +705,7 @@ branch_site_struc_ptr
 branch_site_struc_create(void)
 {
 	branch_site_struc_ptr this_struc;
-	this_struc = calloc(1,sizeof(branch_site_data));
+	this_struc = arena_alloc(ARENA_BRANCH, sizeof(branch_site_data));
 	return this_struc;
 }
 
@@ -362,19 +713,19 @@ rva_hash_struc_ptr
 rva_hash_struc_create(int len)
 {
 	rva_hash_struc_ptr this_struc;
-/*
-	this_struc = (rva_hash_struc_ptr) malloc(sizeof(rva_hash_data));
-        if(this_struc == NULL)return this_struc;
-	this_struc->size = len;
-	this_struc->entries = 0;
-	this_struc->this_array = (hash_data *)malloc(len*sizeof(hash_data));
-	if(this_struc->this_array == NULL)return NULL;
-	memset((void *)this_struc->this_array, 0, (size_t)(len*sizeof(hash_data)) );
-*/
+	int size = 16, shift = 60;
+
+//	round the requested length up to a power of two
+	while(size < len)
+		{
+		size = 2*size;
+		shift--;
+		}
 	this_struc = calloc(1, sizeof(rva_hash_data));
 	if(this_struc == NULL)return this_struc;
-	this_struc->size = len;
-	this_struc->this_array = calloc(len, sizeof(hash_data));
+	this_struc->size = size;
+	this_struc->shift = shift;
+	this_struc->this_array = calloc(size, sizeof(rva_slot_data));
 	if(this_struc->this_array == NULL)
 		{
 		free(this_struc);
@@ -384,21 +735,6 @@ rva_hash_struc_create(int len)
 	return this_struc;
 }
 
-hash_struc_ptr 
-hash_struc_create(void)
-{
-	hash_struc_ptr this_struc;
-/*
-	this_struc = (hash_struc_ptr) malloc(sizeof(hash_data));
-        if(this_struc == NULL)return this_struc;
-	this_struc->this_sample = NULL;
-	this_struc->this_rva = 0;
-	this_struc->next = NULL;
-*/
-	this_struc = calloc(1, sizeof(hash_data));
-	return this_struc;
-}
-
 functionlist_struc_ptr 
 functionlist_struc_create(int len)
 {
@@ -466,16 +802,10 @@ asm_struc_create(void)
         this_struc->call = 0;
 	this_struc->total_sample_count = 0;
 */
-	this_struc = calloc(1, sizeof(asm_data));
+	this_struc = arena_alloc(ARENA_ASM, sizeof(asm_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
-
-	if(this_struc != NULL)asm_struc_count++;
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
         return this_struc;
 }
 
@@ -503,16 +833,10 @@ basic_block_struc_create(void)
 	this_struc->call = 0;
 	this_struc->total_sample_count=0;
 */
-	this_struc = calloc(1, sizeof(basic_block_data));
+	this_struc = arena_alloc(ARENA_BASIC_BLOCK, sizeof(basic_block_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
-
-	if(this_struc != NULL)basic_block_struc_count++;
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
         return this_struc;
 }
 
@@ -531,14 +855,10 @@ source_line_create(void)
         this_struc->source_text = NULL;
 	this_struc->line = 0;
 */
-	this_struc = calloc(1, sizeof(source_line_data));
+	this_struc = arena_alloc(ARENA_FUNCTION, sizeof(source_line_data) + get_count()*sizeof(int));
 	if(this_struc == NULL)return this_struc;
-	this_struc->sample_count = calloc(get_count(), sizeof(int));
-	if(this_struc->sample_count == NULL)
-		{
-		free(this_struc);
-		return NULL;
-		}	
+//	the counters follow the struc in the same allocation
+	this_struc->sample_count = (int*)(this_struc + 1);
 
 	return this_struc;
 }
@@ -556,7 +876,7 @@ file_list_create(void)
 	this_struc->principal_source_name = NULL;
 	this_struc->count = 0;
 */
-	this_struc = calloc(1, sizeof(source_line_data));
+	this_struc = arena_alloc(ARENA_FUNCTION, sizeof(file_list_data));
 	return this_struc;
 }
 
@@ -570,7 +890,7 @@ addr_list_create(void)
 	this_struc->len = 0;
 	this_struc->struc_ptr = NULL;
 */
-	this_struc = calloc(1, sizeof(source_line_data));
+	this_struc = arena_alloc(ARENA_FUNCTION, sizeof(addr_list_data));
 	return this_struc;
 }
 
@@ -0,0 +1,330 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	module level objdump stage for func_asm
+//
+//	hot_list registers the address range of every function it will list with
+//	disasm_add_range, then disasm_run sorts the ranges of each module, merges
+//	ranges less than DISASM_GAP apart into clusters and runs one objdump -d per
+//	cluster instead of one per function. A cluster stops growing at
+//	DISASM_SPAN bytes, so hot functions spread over a large binary do not pull
+//	most of its listing into memory at once, a longer function is a cluster of
+//	its own. The output is kept in memory with an index of instruction start
+//	addresses. disasm_open hands func_asm a stream of the objdump lines for the
+//	instructions starting in a function, so the line parsing in func_asm is
+//	unchanged. A range that was not registered gets a cluster of its own.
+//	Cluster ends get one extra byte because objdump stops before
+//	--stop-address, which used to cut the last instruction of every function
+//	short. hot_list workers call disasm_open concurrently, disasm_lock covers
+//	the cluster lists, cluster contents never change once they are built.
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <err.h>
+#include <pthread.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+#include "gooda_log.h"
+
+#define DISASM_GAP	0x10000		/* merge hot ranges closer than this */
+#define DISASM_SPAN	0x100000	/* but keep one objdump run to this many bytes of text */
+
+typedef struct disasm_range_struc{
+	uint64_t	base;
+	uint64_t	end;
+	}disasm_range_data;
+
+//	one objdump run, text holds its whole output
+typedef struct disasm_cluster_struc * disasm_cluster_ptr;
+typedef struct disasm_cluster_struc{
+	disasm_cluster_ptr	next;
+	uint64_t		base;
+	uint64_t		end;
+	char *			text;
+	size_t			text_len;
+	uint64_t *		addr;		/* instruction start addresses, increasing */
+	size_t *		offset;		/* where each instruction's line starts in text */
+	int			num_inst;
+	}disasm_cluster_data;
+
+typedef struct disasm_module_struc * disasm_module_ptr;
+typedef struct disasm_module_struc{
+	disasm_module_ptr	next;
+	module_struc_ptr	this_module;
+	disasm_range_data *	range;
+	int			num_range;
+	int			max_range;
+	disasm_cluster_ptr	first_cluster;
+	}disasm_module_data;
+
+static disasm_module_ptr disasm_modules = NULL;
+static int disasm_runs = 0, disasm_ranges = 0;
+static char disasm_empty[] = "\n";
+static pthread_mutex_t disasm_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static disasm_module_ptr
+disasm_module(module_struc_ptr this_module)
+{
+	disasm_module_ptr this_dm;
+
+	for(this_dm = disasm_modules; this_dm != NULL; this_dm = this_dm->next)
+		if(this_dm->this_module == this_module)
+			return this_dm;
+	this_dm = (disasm_module_ptr) calloc(1, sizeof(disasm_module_data));
+	if(this_dm == NULL)
+		err(1,"failed to malloc disasm module struc for %s",this_module->path);
+	this_dm->this_module = this_module;
+	this_dm->next = disasm_modules;
+	disasm_modules = this_dm;
+	return this_dm;
+}
+
+void
+disasm_add_range(module_struc_ptr this_module, uint64_t base, uint64_t end)
+{
+	disasm_module_ptr this_dm;
+
+	if((this_module == NULL) || (this_module->local_path == NULL) || (end <= base))
+		return;
+	this_dm = disasm_module(this_module);
+	if(this_dm->num_range == this_dm->max_range)
+		{
+		this_dm->max_range = this_dm->max_range ? 2*this_dm->max_range : 16;
+		this_dm->range = (disasm_range_data *) realloc(this_dm->range, this_dm->max_range*sizeof(disasm_range_data));
+		if(this_dm->range == NULL)
+			err(1,"failed to grow disasm range list for %s",this_module->path);
+		}
+	this_dm->range[this_dm->num_range].base = base;
+	this_dm->range[this_dm->num_range].end = end;
+	this_dm->num_range++;
+	disasm_ranges++;
+}
+
+static int
+disasm_range_cmp(const void *a, const void *b)
+{
+	const disasm_range_data *ra = a, *rb = b;
+
+	if(ra->base < rb->base)return -1;
+	if(ra->base > rb->base)return 1;
+	return 0;
+}
+
+//	leading "  addr:\t" of an objdump line, 1 if the line is the start of an
+//	instruction, continuation lines of long encodings have no second tab
+static int
+disasm_line_addr(char *line, char *line_end, uint64_t *addr)
+{
+	char *p = line, *endp;
+
+	while((p < line_end) && (*p == ' '))p++;
+	*addr = strtoull(p, &endp, 16);
+	if((endp == p) || (endp + 1 >= line_end) || (endp[0] != ':') || (endp[1] != '\t'))
+		return 0;
+	return memchr(endp + 2, '\t', line_end - endp - 2) != NULL;
+}
+
+static disasm_cluster_ptr
+disasm_cluster(disasm_module_ptr this_dm, uint64_t base, uint64_t end)
+{
+	disasm_cluster_ptr this_cluster;
+	char *cmd, *line, *line_end, *text_end;
+	FILE *objout;
+	size_t len, n, max_text, max_inst;
+	uint64_t addr;
+
+	this_cluster = (disasm_cluster_ptr) calloc(1, sizeof(disasm_cluster_data));
+	if(this_cluster == NULL)
+		err(1,"failed to malloc disasm cluster for %s",this_dm->this_module->path);
+	this_cluster->base = base;
+	this_cluster->end = end;
+
+	len = strlen(objdump_bin) + strlen(this_dm->this_module->local_path) + 80;
+	cmd = (char *) malloc(len);
+	if(cmd == NULL)
+		err(1,"failed to malloc objdump command for %s",this_dm->this_module->path);
+	snprintf(cmd, len, "%s -d --start-address=0x%"PRIx64" --stop-address=0x%"PRIx64" %s",
+		objdump_bin, base, end + 1, this_dm->this_module->local_path);
+	gooda_log(GLOG_DEBUG," obj command = %s\n",cmd);
+	objout = popen(cmd, "r");
+	if(objout == NULL)
+		err(1,"failed to run %s",cmd);
+	max_text = 1 << 16;
+	this_cluster->text = (char *) malloc(max_text);
+	if(this_cluster->text == NULL)
+		err(1,"failed to malloc objdump output buffer for %s",this_dm->this_module->path);
+	while((n = fread(this_cluster->text + this_cluster->text_len, 1, max_text - this_cluster->text_len, objout)) > 0)
+		{
+		this_cluster->text_len += n;
+		if(this_cluster->text_len == max_text)
+			{
+			max_text *= 2;
+			this_cluster->text = (char *) realloc(this_cluster->text, max_text);
+			if(this_cluster->text == NULL)
+				err(1,"failed to grow objdump output buffer for %s",this_dm->this_module->path);
+			}
+		}
+	pclose(objout);
+	free(cmd);
+	disasm_runs++;
+
+//	index the instruction lines
+	max_inst = 1024;
+	this_cluster->addr = (uint64_t *) malloc(max_inst*sizeof(uint64_t));
+	this_cluster->offset = (size_t *) malloc(max_inst*sizeof(size_t));
+	if((this_cluster->addr == NULL) || (this_cluster->offset == NULL))
+		err(1,"failed to malloc objdump index for %s",this_dm->this_module->path);
+	text_end = this_cluster->text + this_cluster->text_len;
+	for(line = this_cluster->text; line < text_end; line = line_end + 1)
+		{
+		line_end = memchr(line, '\n', text_end - line);
+		if(line_end == NULL)
+			line_end = text_end;
+		if(!disasm_line_addr(line, line_end, &addr))
+			continue;
+		if(this_cluster->num_inst == max_inst)
+			{
+			max_inst *= 2;
+			this_cluster->addr = (uint64_t *) realloc(this_cluster->addr, max_inst*sizeof(uint64_t));
+			this_cluster->offset = (size_t *) realloc(this_cluster->offset, max_inst*sizeof(size_t));
+			if((this_cluster->addr == NULL) || (this_cluster->offset == NULL))
+				err(1,"failed to grow objdump index for %s",this_dm->this_module->path);
+			}
+		this_cluster->addr[this_cluster->num_inst] = addr;
+		this_cluster->offset[this_cluster->num_inst] = line - this_cluster->text;
+		this_cluster->num_inst++;
+		}
+
+	this_cluster->next = this_dm->first_cluster;
+	this_dm->first_cluster = this_cluster;
+	return this_cluster;
+}
+
+//	one objdump per group of registered ranges
+void
+disasm_run(void)
+{
+	disasm_module_ptr this_dm;
+	uint64_t base, end;
+	int i;
+
+	for(this_dm = disasm_modules; this_dm != NULL; this_dm = this_dm->next)
+		{
+		if(this_dm->num_range == 0)
+			continue;
+		qsort(this_dm->range, this_dm->num_range, sizeof(disasm_range_data), disasm_range_cmp);
+		base = this_dm->range[0].base;
+		end = this_dm->range[0].end;
+		for(i = 1; i < this_dm->num_range; i++)
+			{
+			if((this_dm->range[i].base <= end + DISASM_GAP)
+				&& ((this_dm->range[i].end <= end) || (this_dm->range[i].end - base < DISASM_SPAN)))
+				{
+				if(this_dm->range[i].end > end)end = this_dm->range[i].end;
+				continue;
+				}
+			disasm_cluster(this_dm, base, end);
+			base = this_dm->range[i].base;
+			end = this_dm->range[i].end;
+			}
+		disasm_cluster(this_dm, base, end);
+		this_dm->num_range = 0;
+		}
+	gooda_log(GLOG_VERBOSE," disassembled %d hot functions with %d objdump runs\n",disasm_ranges,disasm_runs);
+}
+
+//	first instruction at or above address
+static int
+disasm_lower_bound(disasm_cluster_ptr this_cluster, uint64_t address)
+{
+	int lo = 0, hi = this_cluster->num_inst, mid;
+
+	while(lo < hi)
+		{
+		mid = (lo + hi)/2;
+		if(this_cluster->addr[mid] < address)
+			lo = mid + 1;
+		else
+			hi = mid;
+		}
+	return lo;
+}
+
+//	objdump -d output for the instructions of this_module starting in base..end,
+//	end included, close it with fclose
+FILE *
+disasm_open(module_struc_ptr this_module, uint64_t base, uint64_t end)
+{
+	disasm_module_ptr this_dm;
+	disasm_cluster_ptr this_cluster;
+	size_t first, last;
+	int lo, hi;
+	FILE *objout;
+
+	pthread_mutex_lock(&disasm_lock);
+	this_dm = disasm_module(this_module);
+	for(this_cluster = this_dm->first_cluster; this_cluster != NULL; this_cluster = this_cluster->next)
+		if((this_cluster->base <= base) && (end <= this_cluster->end))
+			break;
+	if(this_cluster == NULL)
+		this_cluster = disasm_cluster(this_dm, base, end);
+	pthread_mutex_unlock(&disasm_lock);
+
+	lo = disasm_lower_bound(this_cluster, base);
+	hi = disasm_lower_bound(this_cluster, end + 1);
+	if(lo >= hi)
+		objout = fmemopen(disasm_empty, 1, "r");
+	else
+		{
+		first = this_cluster->offset[lo];
+		last = (hi < this_cluster->num_inst) ? this_cluster->offset[hi] : this_cluster->text_len;
+		objout = fmemopen(this_cluster->text + first, last - first, "r");
+		}
+	if(objout == NULL)
+		err(1,"failed to open disassembly of 0x%"PRIx64" in %s",base,this_module->path);
+	return objout;
+}
+
+void
+disasm_free(void)
+{
+	disasm_module_ptr this_dm;
+	disasm_cluster_ptr this_cluster;
+
+	while(disasm_modules != NULL)
+		{
+		this_dm = disasm_modules;
+		disasm_modules = this_dm->next;
+		while(this_dm->first_cluster != NULL)
+			{
+			this_cluster = this_dm->first_cluster;
+			this_dm->first_cluster = this_cluster->next;
+			free(this_cluster->text);
+			free(this_cluster->addr);
+			free(this_cluster->offset);
+			free(this_cluster);
+			}
+		free(this_dm->range);
+		free(this_dm);
+		}
+}
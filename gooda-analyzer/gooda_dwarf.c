@@ -0,0 +1,1701 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	address to source line tables for asm_2_src
+//
+//	asm_2_src used to ask libbfd for every disassembled instruction, walking
+//	the DWARF of the module each time, and then asked again for every inline
+//	frame. line_table_open decodes .debug_line and the inlined subroutine DIEs
+//	of a module once into
+//		rows	sorted start addresses, each with an interned file name and
+//			line that hold up to the next row, LINE_NO_FILE for gaps
+//		segs	sorted start addresses, each with the innermost inlined call
+//			covering it up to the next seg, or -1
+//		nodes	the inlined calls, call file, call line and the enclosing
+//			inlined call, -1 when the caller is the function itself and
+//			-2 when there is none
+//	File names are built the way libbfd builds them so the reports do not
+//	change. func_asm looks up the instructions of a function in increasing
+//	order, so the lookups take a hint and usually just step to the next row.
+//	Tables of files with a build-id are kept in the symbol cache as
+//	<build-id>/lines and mapped in place on later runs. Anything the decoder
+//	does not handle makes line_table_open return NULL and asm_2_src uses
+//	libbfd as before, addresses without a row still go to libbfd one by one.
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <err.h>
+#include <pthread.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+#include "gooda_log.h"
+#include "asm_2_src.h"
+
+#define LINE_NO_FILE		0xFFFFFFFF
+#define LINE_CACHE_MAGIC	0x314e4c41444f4f47ULL	/* "GOODALN1" */
+#define LINE_CACHE_VERSION	1
+
+#define DW_TAG_entry_point		0x03
+#define DW_TAG_compile_unit		0x11
+#define DW_TAG_inlined_subroutine	0x1d
+#define DW_TAG_subprogram		0x2e
+#define DW_TAG_partial_unit		0x3c
+
+#define DW_AT_low_pc			0x11
+#define DW_AT_high_pc			0x12
+#define DW_AT_stmt_list			0x10
+#define DW_AT_comp_dir			0x1b
+#define DW_AT_ranges			0x55
+#define DW_AT_call_file			0x58
+#define DW_AT_call_line			0x59
+#define DW_AT_str_offsets_base		0x72
+#define DW_AT_addr_base			0x73
+#define DW_AT_rnglists_base		0x74
+
+#define DW_FORM_addr			0x01
+#define DW_FORM_block2			0x03
+#define DW_FORM_block4			0x04
+#define DW_FORM_data2			0x05
+#define DW_FORM_data4			0x06
+#define DW_FORM_data8			0x07
+#define DW_FORM_string			0x08
+#define DW_FORM_block			0x09
+#define DW_FORM_block1			0x0a
+#define DW_FORM_data1			0x0b
+#define DW_FORM_flag			0x0c
+#define DW_FORM_sdata			0x0d
+#define DW_FORM_strp			0x0e
+#define DW_FORM_udata			0x0f
+#define DW_FORM_ref_addr		0x10
+#define DW_FORM_ref1			0x11
+#define DW_FORM_ref2			0x12
+#define DW_FORM_ref4			0x13
+#define DW_FORM_ref8			0x14
+#define DW_FORM_ref_udata		0x15
+#define DW_FORM_indirect		0x16
+#define DW_FORM_sec_offset		0x17
+#define DW_FORM_exprloc			0x18
+#define DW_FORM_flag_present		0x19
+#define DW_FORM_strx			0x1a
+#define DW_FORM_addrx			0x1b
+#define DW_FORM_ref_sup4		0x1c
+#define DW_FORM_strp_sup		0x1d
+#define DW_FORM_data16			0x1e
+#define DW_FORM_line_strp		0x1f
+#define DW_FORM_ref_sig8		0x20
+#define DW_FORM_implicit_const		0x21
+#define DW_FORM_loclistx		0x22
+#define DW_FORM_rnglistx		0x23
+#define DW_FORM_ref_sup8		0x24
+#define DW_FORM_strx1			0x25
+#define DW_FORM_strx2			0x26
+#define DW_FORM_strx3			0x27
+#define DW_FORM_strx4			0x28
+#define DW_FORM_addrx1			0x29
+#define DW_FORM_addrx2			0x2a
+#define DW_FORM_addrx3			0x2b
+#define DW_FORM_addrx4			0x2c
+#define DW_FORM_GNU_ref_alt		0x1f20
+#define DW_FORM_GNU_strp_alt		0x1f21
+
+#define DW_LNS_copy			1
+#define DW_LNS_advance_pc		2
+#define DW_LNS_advance_line		3
+#define DW_LNS_set_file			4
+#define DW_LNS_const_add_pc		8
+#define DW_LNS_fixed_advance_pc		9
+#define DW_LNE_end_sequence		1
+#define DW_LNE_set_address		2
+#define DW_LNE_define_file		3
+#define DW_LNCT_path			1
+#define DW_LNCT_directory_index		2
+
+#define DW_RLE_end_of_list		0
+#define DW_RLE_base_addressx		1
+#define DW_RLE_startx_endx		2
+#define DW_RLE_startx_length		3
+#define DW_RLE_offset_pair		4
+#define DW_RLE_base_address		5
+#define DW_RLE_start_end		6
+#define DW_RLE_start_length		7
+
+typedef struct line_row_struc{
+	uint64_t	address;
+	uint32_t	file;		/* offset in names or LINE_NO_FILE */
+	uint32_t	line;
+	}line_row_data;
+
+typedef struct line_seg_struc{
+	uint64_t	address;
+	int32_t		node;
+	uint32_t	pad;
+	}line_seg_data;
+
+typedef struct line_node_struc{
+	uint32_t	call_file;
+	uint32_t	call_line;
+	int32_t		parent;
+	uint32_t	pad;
+	}line_node_data;
+
+typedef struct line_cache_header_struc{
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	num_row;
+	uint32_t	num_seg;
+	uint32_t	num_node;
+	uint64_t	names_len;
+	}line_cache_header;
+
+struct line_table_struc{
+	line_table_ptr		next;
+	char *			path;
+	line_row_data *		row;
+	line_seg_data *		seg;
+	line_node_data *	node;
+	char *			names;
+	int			num_row;
+	int			num_seg;
+	int			num_node;
+	uint64_t		names_len;
+	void *			map;		/* symbol cache mapping the arrays point into */
+	size_t			map_len;
+	};
+
+//	state while decoding one module
+typedef struct dwarf_reader_struc{
+	unsigned char *		p;
+	unsigned char *		end;
+	int			bad;
+	}dwarf_reader;
+
+typedef struct dwarf_value_struc{
+	uint64_t		u;
+	const char *		s;
+	int			form;
+	}dwarf_value;
+
+typedef struct dwarf_abbrev_struc{
+	uint64_t		tag;
+	int			children;
+	int			first_spec;
+	int			num_spec;
+	}dwarf_abbrev;
+
+typedef struct dwarf_spec_struc{
+	uint64_t		attr;
+	uint64_t		form;
+	int64_t			implicit;
+	}dwarf_spec;
+
+typedef struct dwarf_range_struc{
+	uint64_t		low;
+	uint64_t		high;
+	int			node;
+	}dwarf_range;
+
+typedef struct dwarf_build_struc{
+	elf_debug_data		dbg;
+//	current unit
+	int			version;
+	int			offset_size;
+	int			addr_size;
+	uint64_t		base_address;
+	uint64_t		addr_base;
+	uint64_t		str_offsets_base;
+	uint64_t		rnglists_base;
+	const char *		comp_dir;
+	uint32_t *		unit_file;	/* interned names of the unit's line table files */
+	int			num_unit_file;
+	int			max_unit_file;
+	int			unit_file_0;	/* DWARF 5 numbers files and dirs from 0 */
+	const char **		dir;
+	int			num_dir;
+	int			max_dir;
+//	abbrevs of the current unit, indexed by code
+	uint64_t		abbrev_offset;
+	dwarf_abbrev *		abbrev;
+	int			num_abbrev;
+	dwarf_spec *		spec;
+	int			num_spec;
+	int			max_spec;
+//	results
+	line_row_data *		row;
+	uint8_t *		row_end;	/* row ends a sequence */
+	int			num_row;
+	int			max_row;
+	dwarf_range *		range;
+	int			num_range;
+	int			max_range;
+	line_node_data *	node;
+	int			num_node;
+	int			max_node;
+	char *			names;
+	uint64_t		names_len;
+	uint64_t		max_names;
+	uint32_t *		name_hash;
+	int			hash_size;
+	int			hash_entries;
+	}dwarf_build;
+
+static line_table_ptr line_tables = NULL;
+static pthread_mutex_t line_table_lock = PTHREAD_MUTEX_INITIALIZER;
+static int line_tables_built = 0, line_tables_cached = 0, line_tables_failed = 0;
+
+static void *
+dwarf_grow(void *array, int *max, size_t size, int need)
+{
+	if(need <= *max)
+		return array;
+	while(*max < need)
+		*max = *max ? 2*(*max) : 256;
+	array = realloc(array, (size_t)(*max)*size);
+	if(array == NULL)
+		err(1,"failed to grow line table to %d entries",*max);
+	return array;
+}
+
+//	reading
+
+static uint64_t
+dwarf_bytes(dwarf_reader *r, int n)
+{
+	uint64_t val = 0;
+	int i;
+
+	if((r->bad) || (r->end - r->p < n))
+		{
+		r->bad = 1;
+		return 0;
+		}
+	for(i = 0; i < n; i++)
+		val |= (uint64_t)r->p[i] << (8*i);
+	r->p += n;
+	return val;
+}
+
+static uint64_t
+dwarf_uleb(dwarf_reader *r)
+{
+	uint64_t val = 0;
+	int shift = 0;
+	unsigned char b;
+
+	do
+		{
+		if(r->p >= r->end)
+			{
+			r->bad = 1;
+			return 0;
+			}
+		b = *r->p++;
+		if(shift < 64)
+			val |= (uint64_t)(b & 0x7f) << shift;
+		shift += 7;
+		}
+	while(b & 0x80);
+	return val;
+}
+
+static int64_t
+dwarf_sleb(dwarf_reader *r)
+{
+	int64_t val = 0;
+	int shift = 0;
+	unsigned char b;
+
+	do
+		{
+		if(r->p >= r->end)
+			{
+			r->bad = 1;
+			return 0;
+			}
+		b = *r->p++;
+		if(shift < 64)
+			val |= (int64_t)(b & 0x7f) << shift;
+		shift += 7;
+		}
+	while(b & 0x80);
+	if((shift < 64) && (b & 0x40))
+		val |= -((int64_t)1 << shift);
+	return val;
+}
+
+static const char *
+dwarf_cstr(dwarf_reader *r)
+{
+	unsigned char *s = r->p;
+
+	while((r->p < r->end) && (*r->p != '\0'))
+		r->p++;
+	if(r->p >= r->end)
+		{
+		r->bad = 1;
+		return NULL;
+		}
+	r->p++;
+	return (const char *)s;
+}
+
+static void
+dwarf_skip(dwarf_reader *r, uint64_t n)
+{
+	if((r->bad) || ((uint64_t)(r->end - r->p) < n))
+		{
+		r->bad = 1;
+		return;
+		}
+	r->p += n;
+}
+
+//	'\0' terminated string at offset of section k
+static const char *
+dwarf_string(dwarf_build *b, int k, uint64_t offset)
+{
+	if((b->dbg.data[k] == NULL) || (offset >= b->dbg.size[k]))
+		return NULL;
+	if(memchr(b->dbg.data[k] + offset, '\0', b->dbg.size[k] - offset) == NULL)
+		return NULL;
+	return (const char *)b->dbg.data[k] + offset;
+}
+
+static const char *
+dwarf_strx(dwarf_build *b, uint64_t index)
+{
+	dwarf_reader r;
+	uint64_t o = b->str_offsets_base + index*b->offset_size;
+
+	if((b->dbg.data[DWARF_STR_OFFSETS] == NULL) || (o + b->offset_size > b->dbg.size[DWARF_STR_OFFSETS]))
+		return NULL;
+	r.p = b->dbg.data[DWARF_STR_OFFSETS] + o;
+	r.end = b->dbg.data[DWARF_STR_OFFSETS] + b->dbg.size[DWARF_STR_OFFSETS];
+	r.bad = 0;
+	return dwarf_string(b, DWARF_STR, dwarf_bytes(&r, b->offset_size));
+}
+
+static int
+dwarf_addrx(dwarf_build *b, uint64_t index, uint64_t *addr)
+{
+	dwarf_reader r;
+	uint64_t o = b->addr_base + index*b->addr_size;
+
+	if((b->dbg.data[DWARF_ADDR] == NULL) || (o + b->addr_size > b->dbg.size[DWARF_ADDR]))
+		return -1;
+	r.p = b->dbg.data[DWARF_ADDR] + o;
+	r.end = b->dbg.data[DWARF_ADDR] + b->dbg.size[DWARF_ADDR];
+	r.bad = 0;
+	*addr = dwarf_bytes(&r, b->addr_size);
+	return 0;
+}
+
+//	read one attribute value, strings are resolved except strx forms whose
+//	base may not be known yet, those keep the index in u
+static void
+dwarf_form(dwarf_build *b, dwarf_reader *r, uint64_t form, int64_t implicit, dwarf_value *v)
+{
+	uint64_t len;
+
+	v->u = 0;
+	v->s = NULL;
+	v->form = (int)form;
+	switch(form) {
+	case DW_FORM_addr:		v->u = dwarf_bytes(r, b->addr_size); break;
+	case DW_FORM_data1:
+	case DW_FORM_ref1:
+	case DW_FORM_flag:
+	case DW_FORM_strx1:
+	case DW_FORM_addrx1:		v->u = dwarf_bytes(r, 1); break;
+	case DW_FORM_data2:
+	case DW_FORM_ref2:
+	case DW_FORM_strx2:
+	case DW_FORM_addrx2:		v->u = dwarf_bytes(r, 2); break;
+	case DW_FORM_strx3:
+	case DW_FORM_addrx3:		v->u = dwarf_bytes(r, 3); break;
+	case DW_FORM_data4:
+	case DW_FORM_ref4:
+	case DW_FORM_ref_sup4:
+	case DW_FORM_strx4:
+	case DW_FORM_addrx4:		v->u = dwarf_bytes(r, 4); break;
+	case DW_FORM_data8:
+	case DW_FORM_ref8:
+	case DW_FORM_ref_sig8:
+	case DW_FORM_ref_sup8:		v->u = dwarf_bytes(r, 8); break;
+	case DW_FORM_data16:		dwarf_skip(r, 16); break;
+	case DW_FORM_sdata:		v->u = (uint64_t)dwarf_sleb(r); break;
+	case DW_FORM_udata:
+	case DW_FORM_ref_udata:
+	case DW_FORM_strx:
+	case DW_FORM_addrx:
+	case DW_FORM_loclistx:
+	case DW_FORM_rnglistx:		v->u = dwarf_uleb(r); break;
+	case DW_FORM_string:		v->s = dwarf_cstr(r); break;
+	case DW_FORM_strp:
+		v->u = dwarf_bytes(r, b->offset_size);
+		v->s = dwarf_string(b, DWARF_STR, v->u);
+		break;
+	case DW_FORM_line_strp:
+		v->u = dwarf_bytes(r, b->offset_size);
+		v->s = dwarf_string(b, DWARF_LINE_STR, v->u);
+		break;
+	case DW_FORM_ref_addr:		v->u = dwarf_bytes(r, (b->version <= 2) ? b->addr_size : b->offset_size); break;
+	case DW_FORM_sec_offset:
+	case DW_FORM_strp_sup:
+	case DW_FORM_GNU_ref_alt:
+	case DW_FORM_GNU_strp_alt:	v->u = dwarf_bytes(r, b->offset_size); break;
+	case DW_FORM_flag_present:	v->u = 1; break;
+	case DW_FORM_implicit_const:	v->u = (uint64_t)implicit; break;
+	case DW_FORM_block1:		len = dwarf_bytes(r, 1); dwarf_skip(r, len); break;
+	case DW_FORM_block2:		len = dwarf_bytes(r, 2); dwarf_skip(r, len); break;
+	case DW_FORM_block4:		len = dwarf_bytes(r, 4); dwarf_skip(r, len); break;
+	case DW_FORM_block:
+	case DW_FORM_exprloc:		len = dwarf_uleb(r); dwarf_skip(r, len); break;
+	case DW_FORM_indirect:
+		form = dwarf_uleb(r);
+		if((form == DW_FORM_indirect) || (form == DW_FORM_implicit_const))
+			r->bad = 1;
+		else
+			dwarf_form(b, r, form, 0, v);
+		break;
+	default:
+		r->bad = 1;
+	}
+}
+
+static int
+dwarf_is_strx(int form)
+{
+	return (form == DW_FORM_strx) || ((form >= DW_FORM_strx1) && (form <= DW_FORM_strx4));
+}
+
+static int
+dwarf_is_addrx(int form)
+{
+	return (form == DW_FORM_addrx) || ((form >= DW_FORM_addrx1) && (form <= DW_FORM_addrx4));
+}
+
+//	address class value, 0 if it cannot be resolved
+static int
+dwarf_address(dwarf_build *b, dwarf_value *v, uint64_t *addr)
+{
+	if(v->form == DW_FORM_addr)
+		{
+		*addr = v->u;
+		return 0;
+		}
+	if(dwarf_is_addrx(v->form))
+		return dwarf_addrx(b, v->u, addr);
+	return -1;
+}
+
+//	names
+
+static uint32_t
+dwarf_name_hash(const char *s, size_t len)
+{
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	for(i = 0; i < len; i++)
+		h = (h ^ (unsigned char)s[i]) * 16777619u;
+	return h;
+}
+
+//	offset of the interned copy of s
+static uint32_t
+dwarf_intern(dwarf_build *b, const char *s)
+{
+	size_t len = strlen(s);
+	uint32_t *old_hash, index, i;
+	int old_size;
+
+	if(2*(b->hash_entries + 1) > b->hash_size)
+		{
+		old_hash = b->name_hash;
+		old_size = b->hash_size;
+		b->hash_size = old_size ? 2*old_size : 1024;
+		b->name_hash = (uint32_t *)malloc(b->hash_size*sizeof(uint32_t));
+		if(b->name_hash == NULL)
+			err(1,"failed to grow line table name hash");
+		memset(b->name_hash, 0xff, b->hash_size*sizeof(uint32_t));
+		for(i = 0; i < (uint32_t)old_size; i++)
+			{
+			if(old_hash[i] == LINE_NO_FILE)
+				continue;
+			index = dwarf_name_hash(b->names + old_hash[i], strlen(b->names + old_hash[i])) & (b->hash_size - 1);
+			while(b->name_hash[index] != LINE_NO_FILE)
+				index = (index + 1) & (b->hash_size - 1);
+			b->name_hash[index] = old_hash[i];
+			}
+		free(old_hash);
+		}
+	index = dwarf_name_hash(s, len) & (b->hash_size - 1);
+	while(b->name_hash[index] != LINE_NO_FILE)
+		{
+		if(strcmp(b->names + b->name_hash[index], s) == 0)
+			return b->name_hash[index];
+		index = (index + 1) & (b->hash_size - 1);
+		}
+	if(b->names_len + len + 1 > b->max_names)
+		{
+		while(b->names_len + len + 1 > b->max_names)
+			b->max_names = b->max_names ? 2*b->max_names : 1 << 16;
+		b->names = (char *)realloc(b->names, b->max_names);
+		if(b->names == NULL)
+			err(1,"failed to grow line table names to %"PRIu64" bytes",b->max_names);
+		}
+	memcpy(b->names + b->names_len, s, len + 1);
+	b->name_hash[index] = (uint32_t)b->names_len;
+	b->hash_entries++;
+	b->names_len += len + 1;
+	return b->name_hash[index];
+}
+
+//	file name of a line table file entry, put together the way libbfd does
+static uint32_t
+dwarf_file_name(dwarf_build *b, const char *name, uint64_t dir)
+{
+	const char *dir_name = NULL, *subdir_name = NULL;
+	char *path;
+	size_t len;
+	uint32_t offset;
+
+	if(name == NULL)
+		return dwarf_intern(b, "<unknown>");
+	if(name[0] == '/')
+		return dwarf_intern(b, name);
+	if(!b->unit_file_0)
+		dir--;
+	if(dir < (uint64_t)b->num_dir)
+		subdir_name = b->dir[dir];
+	if((subdir_name == NULL) || (subdir_name[0] != '/'))
+		dir_name = b->comp_dir;
+	if(dir_name == NULL)
+		{
+		dir_name = subdir_name;
+		subdir_name = NULL;
+		}
+	if(dir_name == NULL)
+		return dwarf_intern(b, name);
+	len = strlen(dir_name) + strlen(name) + 3 + (subdir_name ? strlen(subdir_name) : 0);
+	path = (char *)malloc(len);
+	if(path == NULL)
+		err(1,"failed to malloc source file name");
+	if(subdir_name != NULL)
+		snprintf(path, len, "%s/%s/%s", dir_name, subdir_name, name);
+	else
+		snprintf(path, len, "%s/%s", dir_name, name);
+	offset = dwarf_intern(b, path);
+	free(path);
+	return offset;
+}
+
+static void
+dwarf_add_file(dwarf_build *b, const char *name, uint64_t dir)
+{
+	b->unit_file = dwarf_grow(b->unit_file, &b->max_unit_file, sizeof(uint32_t), b->num_unit_file + 1);
+	b->unit_file[b->num_unit_file++] = dwarf_file_name(b, name, dir);
+}
+
+static uint32_t
+dwarf_unit_file(dwarf_build *b, uint64_t file)
+{
+	if(!b->unit_file_0)
+		{
+		if(file == 0)
+			return dwarf_intern(b, "<unknown>");
+		file--;
+		}
+	if(file >= (uint64_t)b->num_unit_file)
+		return dwarf_intern(b, "<unknown>");
+	return b->unit_file[file];
+}
+
+//	line programs
+
+static void
+dwarf_add_row(dwarf_build *b, uint64_t address, uint32_t file, uint32_t line, int end_sequence, int first)
+{
+	int n = b->num_row;
+
+//	libbfd never returns a row followed by one at the same address in its
+//	sequence, keep the last one
+	if(!first && (n > 0) && (b->row[n-1].address == address))
+		n--;
+	else
+		{
+		b->row = dwarf_grow(b->row, &b->max_row, sizeof(line_row_data), n + 1);
+		b->row_end = (uint8_t *)realloc(b->row_end, b->max_row);
+		if(b->row_end == NULL)
+			err(1,"failed to grow line table");
+		b->num_row++;
+		}
+	b->row[n].address = address;
+	b->row[n].file = file;
+	b->row[n].line = line;
+	b->row_end[n] = (uint8_t)end_sequence;
+}
+
+//	DWARF 5 directory and file name tables
+static int
+dwarf_entry_table(dwarf_build *b, dwarf_reader *r, int files)
+{
+	uint64_t format[2*16], count, i, dir;
+	int num_format, k;
+	dwarf_value v;
+	const char *name;
+
+	num_format = (int)dwarf_bytes(r, 1);
+	if(num_format > 16)
+		return -1;
+	for(k = 0; k < 2*num_format; k++)
+		format[k] = dwarf_uleb(r);
+	count = dwarf_uleb(r);
+	for(i = 0; (i < count) && !r->bad; i++)
+		{
+		name = NULL;
+		dir = 0;
+		for(k = 0; k < num_format; k++)
+			{
+			dwarf_form(b, r, format[2*k+1], 0, &v);
+			if(dwarf_is_strx(v.form))
+				v.s = dwarf_strx(b, v.u);
+			if(format[2*k] == DW_LNCT_path)
+				name = v.s;
+			else if(format[2*k] == DW_LNCT_directory_index)
+				dir = v.u;
+			}
+		if(files)
+			dwarf_add_file(b, name, dir);
+		else
+			{
+			b->dir = dwarf_grow(b->dir, &b->max_dir, sizeof(char *), b->num_dir + 1);
+			b->dir[b->num_dir++] = name;
+			}
+		}
+	return r->bad ? -1 : 0;
+}
+
+static int
+dwarf_line_program(dwarf_build *b, uint64_t offset)
+{
+	dwarf_reader r, prog;
+	uint64_t length, header_length, address = 0, file = 1, op;
+	int64_t line = 1;
+	int version, offset_size = 4, min_inst, line_base, line_range, opcode_base, i, first = 1;
+	unsigned char std_len[256];
+	uint64_t len, dir;
+	const char *name;
+	unsigned char *ext_end;
+
+	b->num_unit_file = 0;
+	b->num_dir = 0;
+	if(offset >= b->dbg.size[DWARF_LINE])
+		return -1;
+	r.p = b->dbg.data[DWARF_LINE] + offset;
+	r.end = b->dbg.data[DWARF_LINE] + b->dbg.size[DWARF_LINE];
+	r.bad = 0;
+	length = dwarf_bytes(&r, 4);
+	if(length == 0xffffffff)
+		{
+		offset_size = 8;
+		length = dwarf_bytes(&r, 8);
+		}
+	if(r.bad || (length > (uint64_t)(r.end - r.p)))
+		return -1;
+	r.end = r.p + length;
+	version = (int)dwarf_bytes(&r, 2);
+	if((version < 2) || (version > 5))
+		return -1;
+	if(version >= 5)
+		{
+		if(dwarf_bytes(&r, 1) != (uint64_t)b->addr_size)
+			return -1;
+		dwarf_bytes(&r, 1);
+		}
+	header_length = dwarf_bytes(&r, offset_size);
+	if(r.bad || (header_length > (uint64_t)(r.end - r.p)))
+		return -1;
+	prog.p = r.p + header_length;
+	prog.end = r.end;
+	prog.bad = 0;
+	min_inst = (int)dwarf_bytes(&r, 1);
+	if(version >= 4)
+		dwarf_bytes(&r, 1);
+	dwarf_bytes(&r, 1);
+	line_base = (int)(int8_t)dwarf_bytes(&r, 1);
+	line_range = (int)dwarf_bytes(&r, 1);
+	opcode_base = (int)dwarf_bytes(&r, 1);
+	if(r.bad || (line_range == 0) || (opcode_base == 0))
+		return -1;
+	for(i = 1; i < opcode_base; i++)
+		std_len[i] = (unsigned char)dwarf_bytes(&r, 1);
+
+	b->unit_file_0 = (version >= 5);
+	if(version >= 5)
+		{
+		i = b->offset_size;
+		b->offset_size = offset_size;
+		if((dwarf_entry_table(b, &r, 0) != 0) || (dwarf_entry_table(b, &r, 1) != 0))
+			{
+			b->offset_size = i;
+			return -1;
+			}
+		b->offset_size = i;
+		}
+	else
+		{
+		while(!r.bad && (r.p < r.end) && (*r.p != '\0'))
+			{
+			name = dwarf_cstr(&r);
+			b->dir = dwarf_grow(b->dir, &b->max_dir, sizeof(char *), b->num_dir + 1);
+			b->dir[b->num_dir++] = name;
+			}
+		dwarf_skip(&r, 1);
+		while(!r.bad && (r.p < r.end) && (*r.p != '\0'))
+			{
+			name = dwarf_cstr(&r);
+			dir = dwarf_uleb(&r);
+			dwarf_uleb(&r);
+			dwarf_uleb(&r);
+			dwarf_add_file(b, name, dir);
+			}
+		}
+	if(r.bad)
+		return -1;
+
+//	libbfd starts every DWARF 5 sequence in file 0, not the file 1 of the spec
+	file = b->unit_file_0 ? 0 : 1;
+	while((prog.p < prog.end) && !prog.bad)
+		{
+		op = dwarf_bytes(&prog, 1);
+		if(op >= (uint64_t)opcode_base)
+			{
+			op -= opcode_base;
+			address += (op / line_range)*min_inst;
+			line += line_base + (int)(op % line_range);
+			dwarf_add_row(b, address, dwarf_unit_file(b, file), (uint32_t)line, 0, first);
+			first = 0;
+			continue;
+			}
+		switch(op) {
+		case 0:
+			len = dwarf_uleb(&prog);
+			if(prog.bad || (len == 0) || (len > (uint64_t)(prog.end - prog.p)))
+				return -1;
+			ext_end = prog.p + len;
+			op = dwarf_bytes(&prog, 1);
+			switch(op) {
+			case DW_LNE_end_sequence:
+				dwarf_add_row(b, address, LINE_NO_FILE, 0, 1, first);
+				address = 0;
+				file = b->unit_file_0 ? 0 : 1;
+				line = 1;
+				first = 1;
+				break;
+			case DW_LNE_set_address:
+				address = dwarf_bytes(&prog, (int)(len - 1));
+				break;
+			case DW_LNE_define_file:
+				name = dwarf_cstr(&prog);
+				dir = dwarf_uleb(&prog);
+				dwarf_add_file(b, name, dir);
+				break;
+			}
+			prog.p = ext_end;
+			break;
+		case DW_LNS_copy:
+			dwarf_add_row(b, address, dwarf_unit_file(b, file), (uint32_t)line, 0, first);
+			first = 0;
+			break;
+		case DW_LNS_advance_pc:
+			address += dwarf_uleb(&prog)*min_inst;
+			break;
+		case DW_LNS_advance_line:
+			line += dwarf_sleb(&prog);
+			break;
+		case DW_LNS_set_file:
+			file = dwarf_uleb(&prog);
+			break;
+		case DW_LNS_const_add_pc:
+			address += ((255 - opcode_base) / line_range)*min_inst;
+			break;
+		case DW_LNS_fixed_advance_pc:
+			address += dwarf_bytes(&prog, 2);
+			break;
+		default:
+			for(i = 0; i < std_len[op]; i++)
+				dwarf_uleb(&prog);
+		}
+		}
+	return prog.bad ? -1 : 0;
+}
+
+//	debug info
+
+static int
+dwarf_abbrevs(dwarf_build *b, uint64_t offset)
+{
+	dwarf_reader r;
+	uint64_t code, attr, form;
+	int64_t implicit;
+	int first_spec, old_num;
+	unsigned char children;
+	uint64_t tag;
+
+	if((b->abbrev != NULL) && (b->abbrev_offset == offset))
+		return 0;
+	if(offset >= b->dbg.size[DWARF_ABBREV])
+		return -1;
+	r.p = b->dbg.data[DWARF_ABBREV] + offset;
+	r.end = b->dbg.data[DWARF_ABBREV] + b->dbg.size[DWARF_ABBREV];
+	r.bad = 0;
+	b->abbrev_offset = offset;
+	b->num_spec = 0;
+	if(b->abbrev != NULL)
+		memset(b->abbrev, 0, b->num_abbrev*sizeof(dwarf_abbrev));
+	while(!r.bad)
+		{
+		code = dwarf_uleb(&r);
+		if(code == 0)
+			break;
+		if(code > (1 << 20))
+			return -1;
+		tag = dwarf_uleb(&r);
+		children = (unsigned char)dwarf_bytes(&r, 1);
+		first_spec = b->num_spec;
+		for(;;)
+			{
+			attr = dwarf_uleb(&r);
+			form = dwarf_uleb(&r);
+			implicit = (form == DW_FORM_implicit_const) ? dwarf_sleb(&r) : 0;
+			if(r.bad || ((attr == 0) && (form == 0)))
+				break;
+			b->spec = dwarf_grow(b->spec, &b->max_spec, sizeof(dwarf_spec), b->num_spec + 1);
+			b->spec[b->num_spec].attr = attr;
+			b->spec[b->num_spec].form = form;
+			b->spec[b->num_spec].implicit = implicit;
+			b->num_spec++;
+			}
+		if((int)code >= b->num_abbrev)
+			{
+			old_num = b->num_abbrev;
+			b->num_abbrev = (int)code + 64;
+			b->abbrev = (dwarf_abbrev *)realloc(b->abbrev, b->num_abbrev*sizeof(dwarf_abbrev));
+			if(b->abbrev == NULL)
+				err(1,"failed to grow DWARF abbrev table");
+			memset(b->abbrev + old_num, 0, (b->num_abbrev - old_num)*sizeof(dwarf_abbrev));
+			}
+		b->abbrev[code].tag = tag ? tag : 0xffffffff;
+		b->abbrev[code].children = children;
+		b->abbrev[code].first_spec = first_spec;
+		b->abbrev[code].num_spec = b->num_spec - first_spec;
+		}
+	return r.bad ? -1 : 0;
+}
+
+static void
+dwarf_add_range(dwarf_build *b, uint64_t low, uint64_t high, int node)
+{
+	if(low >= high)
+		return;
+	b->range = dwarf_grow(b->range, &b->max_range, sizeof(dwarf_range), b->num_range + 1);
+	b->range[b->num_range].low = low;
+	b->range[b->num_range].high = high;
+	b->range[b->num_range].node = node;
+	b->num_range++;
+}
+
+//	DW_AT_ranges of an inlined call
+static int
+dwarf_ranges(dwarf_build *b, dwarf_value *v, int node)
+{
+	dwarf_reader r;
+	uint64_t offset = v->u, base = b->base_address, start, end, kind;
+
+	if(b->version < 5)
+		{
+		if(offset >= b->dbg.size[DWARF_RANGES])
+			return -1;
+		r.p = b->dbg.data[DWARF_RANGES] + offset;
+		r.end = b->dbg.data[DWARF_RANGES] + b->dbg.size[DWARF_RANGES];
+		r.bad = 0;
+		while(!r.bad)
+			{
+			start = dwarf_bytes(&r, b->addr_size);
+			end = dwarf_bytes(&r, b->addr_size);
+			if((start == 0) && (end == 0))
+				break;
+			if(start == ((b->addr_size == 8) ? ~0ULL : 0xffffffffULL))
+				{
+				base = end;
+				continue;
+				}
+			dwarf_add_range(b, base + start, base + end, node);
+			}
+		return r.bad ? -1 : 0;
+		}
+
+	if(v->form == DW_FORM_rnglistx)
+		{
+		start = b->rnglists_base + offset*b->offset_size;
+		if(start + b->offset_size > b->dbg.size[DWARF_RNGLISTS])
+			return -1;
+		r.p = b->dbg.data[DWARF_RNGLISTS] + start;
+		r.end = b->dbg.data[DWARF_RNGLISTS] + b->dbg.size[DWARF_RNGLISTS];
+		r.bad = 0;
+		offset = b->rnglists_base + dwarf_bytes(&r, b->offset_size);
+		}
+	if(offset >= b->dbg.size[DWARF_RNGLISTS])
+		return -1;
+	r.p = b->dbg.data[DWARF_RNGLISTS] + offset;
+	r.end = b->dbg.data[DWARF_RNGLISTS] + b->dbg.size[DWARF_RNGLISTS];
+	r.bad = 0;
+	while(!r.bad)
+		{
+		kind = dwarf_bytes(&r, 1);
+		switch(kind) {
+		case DW_RLE_end_of_list:
+			return 0;
+		case DW_RLE_base_addressx:
+			if(dwarf_addrx(b, dwarf_uleb(&r), &base) != 0)
+				return -1;
+			break;
+		case DW_RLE_startx_endx:
+			if((dwarf_addrx(b, dwarf_uleb(&r), &start) != 0) || (dwarf_addrx(b, dwarf_uleb(&r), &end) != 0))
+				return -1;
+			dwarf_add_range(b, start, end, node);
+			break;
+		case DW_RLE_startx_length:
+			if(dwarf_addrx(b, dwarf_uleb(&r), &start) != 0)
+				return -1;
+			dwarf_add_range(b, start, start + dwarf_uleb(&r), node);
+			break;
+		case DW_RLE_offset_pair:
+			start = dwarf_uleb(&r);
+			end = dwarf_uleb(&r);
+			dwarf_add_range(b, base + start, base + end, node);
+			break;
+		case DW_RLE_base_address:
+			base = dwarf_bytes(&r, b->addr_size);
+			break;
+		case DW_RLE_start_end:
+			start = dwarf_bytes(&r, b->addr_size);
+			end = dwarf_bytes(&r, b->addr_size);
+			dwarf_add_range(b, start, end, node);
+			break;
+		case DW_RLE_start_length:
+			start = dwarf_bytes(&r, b->addr_size);
+			dwarf_add_range(b, start, start + dwarf_uleb(&r), node);
+			break;
+		default:
+			return -1;
+		}
+		}
+	return -1;
+}
+
+//	the compile unit DIE, its strx and addrx attributes can only be resolved
+//	once the bases, which may come later, are known
+static int
+dwarf_unit_die(dwarf_build *b, dwarf_reader *r, dwarf_abbrev *abbrev)
+{
+	dwarf_value v, comp_dir, low_pc;
+	uint64_t stmt_list = ~0ULL;
+	int i;
+	dwarf_spec *spec;
+
+	comp_dir.form = 0;
+	low_pc.form = 0;
+	for(i = 0; i < abbrev->num_spec; i++)
+		{
+		spec = &b->spec[abbrev->first_spec + i];
+		dwarf_form(b, r, spec->form, spec->implicit, &v);
+		switch(spec->attr) {
+		case DW_AT_stmt_list:		stmt_list = v.u; break;
+		case DW_AT_comp_dir:		comp_dir = v; break;
+		case DW_AT_low_pc:		low_pc = v; break;
+		case DW_AT_addr_base:		b->addr_base = v.u; break;
+		case DW_AT_str_offsets_base:	b->str_offsets_base = v.u; break;
+		case DW_AT_rnglists_base:	b->rnglists_base = v.u; break;
+		}
+		}
+	if(r->bad)
+		return -1;
+	b->comp_dir = (comp_dir.form != 0) ? (dwarf_is_strx(comp_dir.form) ? dwarf_strx(b, comp_dir.u) : comp_dir.s) : NULL;
+	b->base_address = 0;
+	if(low_pc.form != 0)
+		dwarf_address(b, &low_pc, &b->base_address);
+	if(stmt_list == ~0ULL)
+		{
+		b->num_unit_file = 0;
+		b->num_dir = 0;
+		return 0;
+		}
+	return dwarf_line_program(b, stmt_list);
+}
+
+//	walk the DIEs of one unit, recording the inlined calls
+static int
+dwarf_unit_dies(dwarf_build *b, dwarf_reader *r)
+{
+	dwarf_abbrev *abbrev;
+	dwarf_spec *spec;
+	dwarf_value v, low_pc, high_pc, ranges;
+	uint64_t code, call_file, call_line, low, high;
+	int *caller = NULL, max_depth = 0, depth = 0, this_caller, node, i, is_func;
+
+//	caller[depth] is the innermost enclosing inlined call of the DIEs at
+//	depth, -1 inside an ordinary function and -2 outside any function
+	caller = dwarf_grow(caller, &max_depth, sizeof(int), 2);
+	caller[0] = -2;
+	while((r->p < r->end) && !r->bad)
+		{
+		code = dwarf_uleb(r);
+		if(code == 0)
+			{
+			if(depth > 0)depth--;
+			continue;
+			}
+		if((code >= (uint64_t)b->num_abbrev) || (b->abbrev[code].tag == 0))
+			{
+			free(caller);
+			return -1;
+			}
+		abbrev = &b->abbrev[code];
+		is_func = (abbrev->tag == DW_TAG_subprogram) || (abbrev->tag == DW_TAG_entry_point) ||
+			(abbrev->tag == DW_TAG_inlined_subroutine);
+		this_caller = caller[depth];
+		if(!is_func)
+			{
+			for(i = 0; i < abbrev->num_spec; i++)
+				{
+				spec = &b->spec[abbrev->first_spec + i];
+				dwarf_form(b, r, spec->form, spec->implicit, &v);
+				}
+			}
+		else if(abbrev->tag != DW_TAG_inlined_subroutine)
+			{
+			for(i = 0; i < abbrev->num_spec; i++)
+				{
+				spec = &b->spec[abbrev->first_spec + i];
+				dwarf_form(b, r, spec->form, spec->implicit, &v);
+				}
+			this_caller = -1;
+			}
+		else
+			{
+			low_pc.form = high_pc.form = ranges.form = 0;
+			call_file = call_line = 0;
+			for(i = 0; i < abbrev->num_spec; i++)
+				{
+				spec = &b->spec[abbrev->first_spec + i];
+				dwarf_form(b, r, spec->form, spec->implicit, &v);
+				switch(spec->attr) {
+				case DW_AT_low_pc:	low_pc = v; break;
+				case DW_AT_high_pc:	high_pc = v; break;
+				case DW_AT_ranges:	ranges = v; break;
+				case DW_AT_call_file:	call_file = v.u; break;
+				case DW_AT_call_line:	call_line = v.u; break;
+				}
+				}
+			if(r->bad)
+				break;
+			node = b->num_node;
+			b->node = dwarf_grow(b->node, &b->max_node, sizeof(line_node_data), node + 1);
+			b->node[node].call_file = dwarf_unit_file(b, call_file);
+			b->node[node].call_line = (uint32_t)call_line;
+			b->node[node].parent = caller[depth];
+			b->node[node].pad = 0;
+			b->num_node++;
+			if((low_pc.form != 0) && (high_pc.form != 0) && (dwarf_address(b, &low_pc, &low) == 0))
+				{
+				if(dwarf_address(b, &high_pc, &high) != 0)
+					high = low + high_pc.u;
+				dwarf_add_range(b, low, high, node);
+				}
+			else if(ranges.form != 0)
+				{
+				if(dwarf_ranges(b, &ranges, node) != 0)
+					{
+					free(caller);
+					return -1;
+					}
+				}
+			this_caller = node;
+			}
+		if(abbrev->children)
+			{
+			depth++;
+			caller = dwarf_grow(caller, &max_depth, sizeof(int), depth + 1);
+			caller[depth] = this_caller;
+			}
+		}
+	free(caller);
+	return r->bad ? -1 : 0;
+}
+
+static int
+dwarf_units(dwarf_build *b)
+{
+	dwarf_reader r, unit;
+	uint64_t length, abbrev_offset, code;
+	int unit_type;
+
+	r.p = b->dbg.data[DWARF_INFO];
+	r.end = r.p + b->dbg.size[DWARF_INFO];
+	r.bad = 0;
+	while((r.end - r.p >= 4) && !r.bad)
+		{
+		b->offset_size = 4;
+		length = dwarf_bytes(&r, 4);
+		if(length == 0xffffffff)
+			{
+			b->offset_size = 8;
+			length = dwarf_bytes(&r, 8);
+			}
+		if(r.bad || (length > (uint64_t)(r.end - r.p)))
+			return -1;
+		unit.p = r.p;
+		unit.end = r.p + length;
+		unit.bad = 0;
+		r.p = unit.end;
+		b->version = (int)dwarf_bytes(&unit, 2);
+		if((b->version < 2) || (b->version > 5))
+			return -1;
+		unit_type = 1;
+		if(b->version >= 5)
+			{
+			unit_type = (int)dwarf_bytes(&unit, 1);
+			b->addr_size = (int)dwarf_bytes(&unit, 1);
+			abbrev_offset = dwarf_bytes(&unit, b->offset_size);
+			}
+		else
+			{
+			abbrev_offset = dwarf_bytes(&unit, b->offset_size);
+			b->addr_size = (int)dwarf_bytes(&unit, 1);
+			}
+//		only full and partial units have code, type and split units are skipped
+		if((unit_type != 1) && (unit_type != 3))
+			continue;
+		if(unit.bad || ((b->addr_size != 4) && (b->addr_size != 8)))
+			return -1;
+		if(dwarf_abbrevs(b, abbrev_offset) != 0)
+			return -1;
+		b->addr_base = 0;
+		b->str_offsets_base = 0;
+		b->rnglists_base = 0;
+		code = dwarf_uleb(&unit);
+		if(code == 0)
+			continue;
+		if((code >= (uint64_t)b->num_abbrev) || (b->abbrev[code].tag == 0))
+			return -1;
+		if((b->abbrev[code].tag != DW_TAG_compile_unit) && (b->abbrev[code].tag != DW_TAG_partial_unit))
+			continue;
+		if(dwarf_unit_die(b, &unit, &b->abbrev[code]) != 0)
+			return -1;
+		if(b->abbrev[code].children && (dwarf_unit_dies(b, &unit) != 0))
+			return -1;
+		}
+	return 0;
+}
+
+//	tables
+
+typedef struct dwarf_row_key_struc{
+	uint64_t	address;
+	int		real;		/* sequence ends sort first */
+	int		index;
+	}dwarf_row_key;
+
+static int
+dwarf_row_cmp(const void *a, const void *b)
+{
+	const dwarf_row_key *ka = a, *kb = b;
+
+	if(ka->address != kb->address)return (ka->address < kb->address) ? -1 : 1;
+	if(ka->real != kb->real)return ka->real - kb->real;
+	return ka->index - kb->index;
+}
+
+//	sort the rows of all sequences, keep the last row at each address, so a
+//	sequence starting where another ends wins over the end, and drop rows
+//	repeating the line of the row before
+static void
+dwarf_finish_rows(dwarf_build *b)
+{
+	dwarf_row_key *key;
+	line_row_data *row;
+	int i, k, n = 0;
+
+	key = (dwarf_row_key *)malloc((b->num_row + 1)*sizeof(dwarf_row_key));
+	row = (line_row_data *)malloc((b->num_row + 1)*sizeof(line_row_data));
+	if((key == NULL) || (row == NULL))
+		err(1,"failed to malloc %d line rows",b->num_row);
+	for(i = 0; i < b->num_row; i++)
+		{
+		key[i].address = b->row[i].address;
+		key[i].real = !b->row_end[i];
+		key[i].index = i;
+		}
+	qsort(key, b->num_row, sizeof(dwarf_row_key), dwarf_row_cmp);
+	for(i = 0; i < b->num_row; i++)
+		{
+		if((i + 1 < b->num_row) && (key[i+1].address == key[i].address))
+			continue;
+		k = key[i].index;
+		if((n > 0) && (row[n-1].file == b->row[k].file) && (row[n-1].line == b->row[k].line))
+			continue;
+		row[n++] = b->row[k];
+		}
+	free(key);
+	free(b->row);
+	b->row = row;
+	b->num_row = n;
+}
+
+static int
+dwarf_range_cmp(const void *a, const void *b)
+{
+	const dwarf_range *ra = a, *rb = b;
+
+	if(ra->low < rb->low)return -1;
+	if(ra->low > rb->low)return 1;
+	return 0;
+}
+
+static int
+dwarf_u64_cmp(const void *a, const void *b)
+{
+	const uint64_t *ua = a, *ub = b;
+
+	if(*ua < *ub)return -1;
+	if(*ua > *ub)return 1;
+	return 0;
+}
+
+//	1 if range a is the better match, libbfd picks the shortest range and on
+//	a tie the later DIE
+static int
+dwarf_range_better(dwarf_range *a, dwarf_range *b)
+{
+	if(a->high - a->low != b->high - b->low)
+		return a->high - a->low < b->high - b->low;
+	return a->node > b->node;
+}
+
+static void
+dwarf_heap_push(dwarf_range **heap, int *n, dwarf_range *this_range)
+{
+	int i = (*n)++, parent;
+
+	while(i > 0)
+		{
+		parent = (i - 1)/2;
+		if(!dwarf_range_better(this_range, heap[parent]))
+			break;
+		heap[i] = heap[parent];
+		i = parent;
+		}
+	heap[i] = this_range;
+}
+
+static void
+dwarf_heap_pop(dwarf_range **heap, int *n)
+{
+	dwarf_range *last = heap[--(*n)];
+	int i = 0, child;
+
+	while((child = 2*i + 1) < *n)
+		{
+		if((child + 1 < *n) && dwarf_range_better(heap[child + 1], heap[child]))
+			child++;
+		if(!dwarf_range_better(heap[child], last))
+			break;
+		heap[i] = heap[child];
+		i = child;
+		}
+	if(*n > 0)
+		heap[i] = last;
+}
+
+//	cut the inlined call ranges into segments with their best match
+static line_seg_data *
+dwarf_segments(dwarf_build *b, int *num_seg)
+{
+	uint64_t *point;
+	dwarf_range **heap;
+	line_seg_data *seg;
+	int num_point, i, next, heap_n = 0, n = 0, node;
+
+	*num_seg = 0;
+	if(b->num_range == 0)
+		return NULL;
+//	qsort of ranges with equal low may reorder DIEs, node numbers keep the DIE order
+	qsort(b->range, b->num_range, sizeof(dwarf_range), dwarf_range_cmp);
+	point = (uint64_t *)malloc(2*b->num_range*sizeof(uint64_t));
+	heap = (dwarf_range **)malloc(b->num_range*sizeof(dwarf_range *));
+	seg = (line_seg_data *)malloc(2*b->num_range*sizeof(line_seg_data));
+	if((point == NULL) || (heap == NULL) || (seg == NULL))
+		err(1,"failed to malloc inline segments for %d ranges",b->num_range);
+	for(i = 0; i < b->num_range; i++)
+		{
+		point[2*i] = b->range[i].low;
+		point[2*i+1] = b->range[i].high;
+		}
+	qsort(point, 2*b->num_range, sizeof(uint64_t), dwarf_u64_cmp);
+	num_point = 0;
+	for(i = 0; i < 2*b->num_range; i++)
+		if((num_point == 0) || (point[num_point-1] != point[i]))
+			point[num_point++] = point[i];
+	next = 0;
+	for(i = 0; i < num_point; i++)
+		{
+		while((next < b->num_range) && (b->range[next].low == point[i]))
+			dwarf_heap_push(heap, &heap_n, &b->range[next++]);
+		while((heap_n > 0) && (heap[0]->high <= point[i]))
+			dwarf_heap_pop(heap, &heap_n);
+		node = (heap_n > 0) ? heap[0]->node : -1;
+		if((n > 0) && (seg[n-1].node == node))
+			continue;
+		seg[n].address = point[i];
+		seg[n].node = node;
+		seg[n].pad = 0;
+		n++;
+		}
+	free(point);
+	free(heap);
+	*num_seg = n;
+	return seg;
+}
+
+static void
+dwarf_build_free(dwarf_build *b)
+{
+	elf_debug_release(&b->dbg);
+	free(b->unit_file);
+	free(b->dir);
+	free(b->abbrev);
+	free(b->spec);
+	free(b->row);
+	free(b->row_end);
+	free(b->range);
+	free(b->node);
+	free(b->names);
+	free(b->name_hash);
+}
+
+static line_table_ptr
+line_table_decode(const char *path)
+{
+	dwarf_build b;
+	line_table_ptr this_table;
+
+	memset(&b, 0, sizeof(b));
+	if(elf_debug_sections((char *)path, &b.dbg) != 0)
+		return NULL;
+	if((dwarf_units(&b) != 0) || (b.num_row == 0))
+		{
+		dwarf_build_free(&b);
+		return NULL;
+		}
+	dwarf_finish_rows(&b);
+	this_table = (line_table_ptr)calloc(1, sizeof(struct line_table_struc));
+	if(this_table == NULL)
+		err(1,"failed to malloc line table for %s",path);
+	this_table->seg = dwarf_segments(&b, &this_table->num_seg);
+	this_table->row = b.row;
+	this_table->num_row = b.num_row;
+	this_table->node = b.node;
+	this_table->num_node = b.num_node;
+	this_table->names = b.names;
+	this_table->names_len = b.names_len;
+	b.row = NULL;
+	b.node = NULL;
+	b.names = NULL;
+	dwarf_build_free(&b);
+	return this_table;
+}
+
+//	symbol cache
+
+//	1 if the rows, segments and inlined calls of a cached table only refer
+//	to names and calls inside it, and every call chain ends
+static int
+line_cache_valid(line_table_ptr this_table)
+{
+	int i;
+
+	for(i = 0; i < this_table->num_row; i++)
+		if((this_table->row[i].file != LINE_NO_FILE) && (this_table->row[i].file >= this_table->names_len))
+			return 0;
+	for(i = 0; i < this_table->num_seg; i++)
+		if((this_table->seg[i].node < -1) || (this_table->seg[i].node >= this_table->num_node))
+			return 0;
+//	the decoder creates a caller before its inlined calls
+	for(i = 0; i < this_table->num_node; i++)
+		if((this_table->node[i].call_file >= this_table->names_len) ||
+			(this_table->node[i].parent < -2) || (this_table->node[i].parent >= i))
+			return 0;
+	return 1;
+}
+
+static line_table_ptr
+line_table_load(char *buildid)
+{
+	line_table_ptr this_table;
+	line_cache_header *hdr;
+	unsigned char *map;
+	size_t len;
+	uint64_t want;
+
+	map = symcache_map(buildid, "lines", &len);
+	if(map == NULL)
+		return NULL;
+	hdr = (line_cache_header *)map;
+	want = 0;
+	if(len >= sizeof(line_cache_header))
+		want = sizeof(line_cache_header) + (uint64_t)hdr->num_row*sizeof(line_row_data) +
+			(uint64_t)hdr->num_seg*sizeof(line_seg_data) + (uint64_t)hdr->num_node*sizeof(line_node_data) + hdr->names_len;
+	if((want == 0) || (hdr->magic != LINE_CACHE_MAGIC) || (hdr->version != LINE_CACHE_VERSION) ||
+		(want != len) || (hdr->names_len == 0) || (hdr->num_row > INT_MAX) || (hdr->num_seg > INT_MAX) ||
+		(hdr->num_node > INT_MAX) || (map[len - 1] != '\0'))
+		{
+		gooda_log(GLOG_VERBOSE," ignoring stale line cache entry for build-id %s\n", buildid);
+		munmap(map, len);
+		return NULL;
+		}
+	this_table = (line_table_ptr)calloc(1, sizeof(struct line_table_struc));
+	if(this_table == NULL)
+		err(1,"failed to malloc line table for build-id %s",buildid);
+	this_table->map = map;
+	this_table->map_len = len;
+	this_table->num_row = hdr->num_row;
+	this_table->num_seg = hdr->num_seg;
+	this_table->num_node = hdr->num_node;
+	this_table->names_len = hdr->names_len;
+	this_table->row = (line_row_data *)(map + sizeof(line_cache_header));
+	this_table->seg = (line_seg_data *)(this_table->row + hdr->num_row);
+	this_table->node = (line_node_data *)(this_table->seg + hdr->num_seg);
+	this_table->names = (char *)(this_table->node + hdr->num_node);
+	if(!line_cache_valid(this_table))
+		{
+		gooda_log(GLOG_VERBOSE," ignoring corrupt line cache entry for build-id %s\n", buildid);
+		munmap(map, len);
+		free(this_table);
+		return NULL;
+		}
+	return this_table;
+}
+
+static void
+line_table_store(char *buildid, line_table_ptr this_table)
+{
+	line_cache_header hdr;
+	FILE *out;
+	char *tmp_name;
+	int ok;
+
+	out = symcache_create(buildid, "lines", &tmp_name);
+	if(out == NULL)
+		return;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = LINE_CACHE_MAGIC;
+	hdr.version = LINE_CACHE_VERSION;
+	hdr.num_row = this_table->num_row;
+	hdr.num_seg = this_table->num_seg;
+	hdr.num_node = this_table->num_node;
+	hdr.names_len = this_table->names_len;
+	ok = (fwrite(&hdr, sizeof(hdr), 1, out) == 1);
+	if(ok && (this_table->num_row > 0))
+		ok = (fwrite(this_table->row, sizeof(line_row_data), this_table->num_row, out) == (size_t)this_table->num_row);
+	if(ok && (this_table->num_seg > 0))
+		ok = (fwrite(this_table->seg, sizeof(line_seg_data), this_table->num_seg, out) == (size_t)this_table->num_seg);
+	if(ok && (this_table->num_node > 0))
+		ok = (fwrite(this_table->node, sizeof(line_node_data), this_table->num_node, out) == (size_t)this_table->num_node);
+	if(ok)
+		ok = (fwrite(this_table->names, 1, this_table->names_len, out) == this_table->names_len);
+	symcache_commit(buildid, "lines", tmp_name, out, ok);
+}
+
+//	line table of the ELF file path, NULL if libbfd has to be used
+line_table_ptr
+line_table_open(const char *path)
+{
+	line_table_ptr this_table;
+	char *buildid;
+
+	pthread_mutex_lock(&line_table_lock);
+	for(this_table = line_tables; this_table != NULL; this_table = this_table->next)
+		if(strcmp(this_table->path, path) == 0)
+			break;
+	if(this_table != NULL)
+		{
+		pthread_mutex_unlock(&line_table_lock);
+		return (this_table->num_row > 0) ? this_table : NULL;
+		}
+
+	buildid = elf_build_id((char *)path);
+	this_table = (buildid != NULL) ? line_table_load(buildid) : NULL;
+	if(this_table != NULL)
+		line_tables_cached++;
+	else
+		{
+		this_table = line_table_decode(path);
+		if(this_table != NULL)
+			{
+			line_tables_built++;
+			if(buildid != NULL)
+				line_table_store(buildid, this_table);
+			}
+		else
+			{
+//			remember the failure so the next function of the module goes straight to libbfd
+			line_tables_failed++;
+			this_table = (line_table_ptr)calloc(1, sizeof(struct line_table_struc));
+			if(this_table == NULL)
+				err(1,"failed to malloc line table for %s",path);
+			}
+		}
+	free(buildid);
+	this_table->path = strdup(path);
+	if(this_table->path == NULL)
+		err(1,"failed to malloc line table path");
+	this_table->next = line_tables;
+	line_tables = this_table;
+	gooda_log(GLOG_VERBOSE," line table for %s: %d rows, %d inline segments, %d inlined calls\n",
+		path, this_table->num_row, this_table->num_seg, this_table->num_node);
+	pthread_mutex_unlock(&line_table_lock);
+	return (this_table->num_row > 0) ? this_table : NULL;
+}
+
+//	the start address of entry i of a row or seg array
+static inline uint64_t
+line_address(const void *array, size_t stride, int i)
+{
+	return *(const uint64_t *)((const char *)array + (size_t)i*stride);
+}
+
+//	set *hint to the last entry at or below address in a sorted row or seg
+//	array, -1 if there is none, trying the entry at and after *hint first
+static void
+line_search(const void *array, size_t stride, int num, uint64_t address, int *hint)
+{
+	int lo, hi, mid, h = *hint;
+
+	if((h >= 0) && (h < num) && (line_address(array, stride, h) <= address))
+		{
+		if((h + 1 == num) || (address < line_address(array, stride, h + 1)))
+			return;
+		if((h + 2 == num) || (address < line_address(array, stride, h + 2)))
+			{
+			*hint = h + 1;
+			return;
+			}
+		}
+	lo = 0;
+	hi = num;
+	while(lo < hi)
+		{
+		mid = (lo + hi)/2;
+		if(line_address(array, stride, mid) <= address)
+			lo = mid + 1;
+		else
+			hi = mid;
+		}
+	*hint = lo - 1;
+}
+
+//	source line of address and the innermost inlined call covering it,
+//	1 if the address has a line
+int
+line_table_find(line_table_ptr this_table, uint64_t address, line_table_hint *hint,
+	const char **file, unsigned *line_nr, int *node)
+{
+	line_row_data *this_row;
+
+	*node = -1;
+	if(this_table->num_seg > 0)
+		{
+		line_search(this_table->seg, sizeof(line_seg_data), this_table->num_seg, address, &hint->seg);
+		if(hint->seg >= 0)
+			*node = this_table->seg[hint->seg].node;
+		}
+	line_search(this_table->row, sizeof(line_row_data), this_table->num_row, address, &hint->row);
+	if(hint->row < 0)
+		return 0;
+	this_row = &this_table->row[hint->row];
+	if(this_row->file == LINE_NO_FILE)
+		return 0;
+	*file = this_table->names + this_row->file;
+	*line_nr = this_row->line;
+	return 1;
+}
+
+//	call site of inlined call *node, moving *node to its caller, 0 at the function
+int
+line_table_caller(line_table_ptr this_table, int *node, const char **file, unsigned *line_nr)
+{
+	line_node_data *this_node;
+
+	if((*node < 0) || (*node >= this_table->num_node))
+		return 0;
+	this_node = &this_table->node[*node];
+//	libbfd only reports calls it found a caller for
+	if(this_node->parent == -2)
+		return 0;
+	*file = this_table->names + this_node->call_file;
+	*line_nr = this_node->call_line;
+	*node = this_node->parent;
+	return 1;
+}
+
+void
+line_table_free(void)
+{
+	line_table_ptr this_table;
+
+	pthread_mutex_lock(&line_table_lock);
+	if(line_tables_built + line_tables_cached + line_tables_failed > 0)
+		gooda_log(GLOG_VERBOSE," line tables: %d decoded, %d from the symbol cache, %d left to libbfd\n",
+			line_tables_built, line_tables_cached, line_tables_failed);
+	while(line_tables != NULL)
+		{
+		this_table = line_tables;
+		line_tables = this_table->next;
+		if(this_table->map != NULL)
+			munmap(this_table->map, this_table->map_len);
+		else
+			{
+			free(this_table->row);
+			free(this_table->seg);
+			free(this_table->node);
+			free(this_table->names);
+			}
+		free(this_table->path);
+		free(this_table);
+		}
+	pthread_mutex_unlock(&line_table_lock);
+}
@@ -0,0 +1,58 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ */
+
+//	rate limited call sites for gooda_log_limit, see gooda_log.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "gooda_log.h"
+
+int log_level = GLOG_INFO;
+
+//	sites that have fired at least once, pushed on first use
+static log_limit_ptr log_sites = NULL;
+
+int
+log_limit_hit(log_limit_ptr this_site)
+{
+	int count;
+	log_limit_ptr head;
+
+	count = __sync_add_and_fetch(&this_site->count, 1);
+	if(count == 1)
+		{
+		do
+			{
+			head = log_sites;
+			this_site->next = head;
+			}
+		while(!__sync_bool_compare_and_swap(&log_sites, head, this_site));
+		}
+	return count <= this_site->max;
+}
+
+void
+log_report(void)
+{
+	log_limit_ptr this_site;
+
+	if(log_level < GLOG_WARN)
+		return;
+	for(this_site = log_sites; this_site != NULL; this_site = this_site->next)
+		if(this_site->count > this_site->max)
+			fprintf(stderr,"%s:%d: %d further messages suppressed, %d in total\n",
+				this_site->file, this_site->line, this_site->count - this_site->max, this_site->count);
+}
@@ -0,0 +1,70 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+ */
+
+//	leveled diagnostics for Gooda
+//
+//	gooda_log(level, ...) prints to stderr when level <= log_level.
+//	log_level starts at GLOG_INFO, each -q lowers it and each -d raises it.
+//	Levels above GLOG_COMPILED are dropped by the compiler, arguments and all,
+//	so GLOG_DEBUG messages in the sample path are only built in with -DDBUG.
+//	gooda_log_limit(level, max, ...) prints the first max messages from one
+//	call site and afterwards only counts them, log_report lists the counts.
+//	Hard failures still go through err/errx.
+
+enum gooda_log_level {
+	GLOG_ERROR = 0,
+	GLOG_WARN,
+	GLOG_INFO,
+	GLOG_VERBOSE,
+	GLOG_DEBUG,
+};
+
+#ifndef GLOG_COMPILED
+#ifdef DBUG
+#define GLOG_COMPILED	GLOG_DEBUG
+#else
+#define GLOG_COMPILED	GLOG_VERBOSE
+#endif
+#endif
+
+extern int log_level;
+
+#define log_enabled(level)	(((level) <= GLOG_COMPILED) && ((level) <= log_level))
+
+#define gooda_log(level, ...)						\
+	do {								\
+		if(log_enabled(level))					\
+			fprintf(stderr, __VA_ARGS__);			\
+	} while(0)
+
+typedef struct log_limit_struc * log_limit_ptr;
+typedef struct log_limit_struc{
+	log_limit_ptr		next;
+	const char *		file;
+	int			line;
+	int			max;
+	int			count;
+	}log_limit_data;
+
+#define gooda_log_limit(level, limit, ...)				\
+	do {								\
+		static log_limit_data log_site_ = {NULL, __FILE__, __LINE__, (limit), 0}; \
+		if(log_enabled(level) && log_limit_hit(&log_site_))	\
+			fprintf(stderr, __VA_ARGS__);			\
+	} while(0)
+
+int log_limit_hit(log_limit_ptr this_site);
+void log_report(void);
@@ -0,0 +1,158 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	address index of a process mmap stack, used by bind_sample
+//
+//	mmap_index holds the mmaps of first_mmap sorted by addr. mmap_index_end is
+//	a max segment tree over it: leaf mmap_index_leaves + i holds addr + len of
+//	mmap_index[i], padding leaves hold 0, and node k the larger end of nodes 2k
+//	and 2k + 1. A lookup binary searches the last mmap starting below ip, then
+//	descends only into the subtrees of that prefix whose largest end is past
+//	ip, so a large low mapping such as the heap costs one path of the tree,
+//	not a walk over every mmap above it. Among the covering mmaps older than
+//	the sample the one nearest the top of the stack (largest stamp) wins, the
+//	mmap the linear walk of first_mmap returned.
+//	mmap_index_bench.c checks it against that walk and times both.
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+
+#define MMAP_INDEX_SCAN	16	/* a prefix this short is checked directly, not through the tree */
+
+static int
+mmap_addr_compare(const void *a, const void *b)
+{
+	uint64_t addr_a = (*(mmap_struc_ptr *)a)->addr;
+	uint64_t addr_b = (*(mmap_struc_ptr *)b)->addr;
+
+	if(addr_a < addr_b)return -1;
+	if(addr_a > addr_b)return 1;
+	return 0;
+}
+
+//	rebuild the addr sorted index of the process mmap stack
+//	only needed when an mmap was added or its length changed,
+//	stack reordering and time updates are read live from the mmap_struc
+static void
+build_mmap_index(process_struc_ptr this_process)
+{
+	mmap_struc_ptr this_mmap;
+	uint64_t *tree;
+	int i, len, leaves;
+
+	len = 0;
+	for(this_mmap = this_process->first_mmap; this_mmap != NULL; this_mmap = this_mmap->next)len++;
+	for(leaves = 1; leaves < len; leaves *= 2);
+
+	if(leaves > this_process->mmap_index_leaves)
+		{
+		free(this_process->mmap_index);
+		free(this_process->mmap_index_end);
+		this_process->mmap_index = (mmap_struc_ptr *) malloc(leaves*sizeof(mmap_struc_ptr));
+		this_process->mmap_index_end = (uint64_t *) malloc(2*leaves*sizeof(uint64_t));
+		if((this_process->mmap_index == NULL) || (this_process->mmap_index_end == NULL))
+			err(1,"failed to malloc mmap index of %d entries for pid %d",len,this_process->pid);
+		}
+	this_process->mmap_index_len = len;
+	this_process->mmap_index_leaves = leaves;
+
+	i = 0;
+	for(this_mmap = this_process->first_mmap; this_mmap != NULL; this_mmap = this_mmap->next)
+		this_process->mmap_index[i++] = this_mmap;
+	qsort(this_process->mmap_index, len, sizeof(mmap_struc_ptr), mmap_addr_compare);
+
+	tree = this_process->mmap_index_end;
+	for(i=0; i<leaves; i++)
+		tree[leaves + i] = (i < len) ? this_process->mmap_index[i]->addr + this_process->mmap_index[i]->len : 0;
+	for(i=leaves-1; i>0; i--)
+		tree[i] = (tree[2*i] > tree[2*i+1]) ? tree[2*i] : tree[2*i+1];
+	this_process->mmap_index_generation = this_process->mmap_generation;
+#ifdef DBUG
+	fprintf(stderr," rebuilt mmap index for pid %d, %d entries\n",this_process->pid,len);
+#endif
+}
+
+static inline void
+mmap_index_check(mmap_struc_ptr this_mmap, uint32_t pid, uint64_t ip, uint64_t new_time, mmap_struc_ptr *best_mmap)
+{
+	if(this_mmap->pid != pid)return;
+	if(this_mmap->len <= ip - this_mmap->addr)return;
+	if(this_mmap->time >= new_time)return;
+	if((*best_mmap == NULL) || (this_mmap->stamp > (*best_mmap)->stamp))*best_mmap = this_mmap;
+}
+
+//	the covering mmaps below limit in the subtree of node, which spans
+//	width leaves from first
+static void
+mmap_index_search(process_struc_ptr this_process, int node, int first, int width, int limit,
+	uint32_t pid, uint64_t ip, uint64_t new_time, mmap_struc_ptr *best_mmap)
+{
+	if((first >= limit) || (this_process->mmap_index_end[node] <= ip))
+		return;
+	if(width == 1)
+		{
+		mmap_index_check(this_process->mmap_index[first], pid, ip, new_time, best_mmap);
+		return;
+		}
+	width /= 2;
+	mmap_index_search(this_process, 2*node, first, width, limit, pid, ip, new_time, best_mmap);
+	mmap_index_search(this_process, 2*node + 1, first + width, width, limit, pid, ip, new_time, best_mmap);
+}
+
+//   note:   if the OS unloads a module and then reloads it within the period of one cores collection buffer filling
+//		AND the old and new load addresses overlap we still get it right
+//		BECAUSE: the time check reverts to the old mmap record
+//	there may still be a problem if the new addr exactly equals the old addr
+mmap_struc_ptr
+mmap_index_find(process_struc_ptr this_process, uint32_t pid, uint64_t ip, uint64_t new_time)
+{
+	mmap_struc_ptr *index, best_mmap;
+	int lo, hi, mid, i;
+
+	if((this_process->mmap_index == NULL) || (this_process->mmap_index_generation != this_process->mmap_generation))
+		build_mmap_index(this_process);
+	index = this_process->mmap_index;
+
+//	find the first index entry with addr >= ip, every candidate lies below it
+	lo = 0;
+	hi = this_process->mmap_index_len;
+	while(lo < hi)
+		{
+		mid = (lo + hi)/2;
+		if(index[mid]->addr < ip)
+			lo = mid + 1;
+		else
+			hi = mid;
+		}
+
+	best_mmap = NULL;
+	if(lo <= MMAP_INDEX_SCAN)
+		{
+		for(i = 0; i < lo; i++)
+			mmap_index_check(index[i], pid, ip, new_time, &best_mmap);
+		return best_mmap;
+		}
+	mmap_index_search(this_process, 1, 0, this_process->mmap_index_leaves, lo, pid, ip, new_time, &best_mmap);
+	return best_mmap;
+}
@@ -0,0 +1,209 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	graphviz rendering of the call graph and cfg .dot files
+//
+//	hotspot_call_graph and func_asm used to run dot -Tsvg in line, once per
+//	graph, and on large cfgs dot took most of the run. They now hand the file
+//	pair to render_dot. With -r async, the default, a queue is drained by
+//	-j threads running dot while the analysis carries on, and render_finish
+//	waits for the queue before gooda exits. -r defer writes the commands to
+//	spreadsheets/render.sh for later, with paths relative to the script's own
+//	directory, so it still works after create_dir has renamed spreadsheets.
+//	-r none only leaves the .dot files. Graphs bigger than render_max_bytes are
+//	left as .dot in every mode, dot can run for minutes on those.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <err.h>
+#include <pthread.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+#include "gooda_log.h"
+
+typedef struct render_job_struc * render_job_ptr;
+typedef struct render_job_struc{
+	render_job_ptr		next;
+	char *			cmd;
+	}render_job_data;
+
+int render_mode = RENDER_ASYNC;
+long render_max_bytes = 4 << 20;
+
+static pthread_mutex_t render_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t render_cond = PTHREAD_COND_INITIALIZER;
+static render_job_ptr render_head = NULL, render_tail = NULL;
+static pthread_t *render_threads = NULL;
+static int num_render_threads = 0, render_done = 0;
+static int render_queued = 0, render_failed = 0, render_skipped = 0;
+static FILE *render_script = NULL;
+static char render_script_file[] = "./spreadsheets/render.sh";
+static char render_dir[] = "spreadsheets/";
+
+//	path as seen from the directory of render.sh
+static const char *
+render_rel(const char *path)
+{
+	size_t len = strlen(render_dir);
+
+	if(strncmp(path, "./", 2) == 0)
+		path += 2;
+	if(strncmp(path, render_dir, len) == 0)
+		return path + len;
+	return path;
+}
+
+static void *
+render_worker(void *arg)
+{
+	render_job_ptr this_job;
+	int ret_val;
+
+	for(;;)
+		{
+		pthread_mutex_lock(&render_lock);
+		while((render_head == NULL) && (render_done == 0))
+			pthread_cond_wait(&render_cond, &render_lock);
+		this_job = render_head;
+		if(this_job == NULL)
+			{
+			pthread_mutex_unlock(&render_lock);
+			return NULL;
+			}
+		render_head = this_job->next;
+		if(render_head == NULL)render_tail = NULL;
+		pthread_mutex_unlock(&render_lock);
+
+		gooda_log(GLOG_DEBUG," svg command = %s\n",this_job->cmd);
+		ret_val = system(this_job->cmd);
+		if(ret_val != 0)
+			{
+			__sync_fetch_and_add(&render_failed, 1);
+			gooda_log_limit(GLOG_WARN, 1," %s failed with status %d, is graphviz installed?\n",this_job->cmd,ret_val);
+			}
+		free(this_job->cmd);
+		free(this_job);
+		}
+}
+
+static void
+render_start(void)
+{
+	int i, ret;
+
+	num_render_threads = (num_threads > 1) ? num_threads : 1;
+	render_threads = (pthread_t *)malloc(num_render_threads*sizeof(pthread_t));
+	if(render_threads == NULL)
+		err(1,"failed to allocate %d render threads",num_render_threads);
+	for(i = 0; i < num_render_threads; i++)
+		{
+		ret = pthread_create(&render_threads[i], NULL, render_worker, NULL);
+		if(ret != 0)
+			errx(1,"failed to create render thread %d, error %d",i,ret);
+		}
+}
+
+//	render dot_file into svg_file according to render_mode
+void
+render_dot(char *dot_file, char *svg_file)
+{
+	render_job_ptr this_job;
+	struct stat st;
+	size_t len;
+
+	if(render_mode == RENDER_NONE)
+		return;
+	if((stat(dot_file, &st) == 0) && (st.st_size > (off_t)render_max_bytes))
+		{
+		gooda_log(GLOG_VERBOSE," %s is %ld bytes, not rendering it\n",dot_file,(long)st.st_size);
+		__sync_fetch_and_add(&render_skipped, 1);
+		return;
+		}
+	this_job = (render_job_ptr)malloc(sizeof(render_job_data));
+	len = strlen(dot_file) + strlen(svg_file) + 20;
+	if(this_job != NULL)
+		this_job->cmd = (char *)malloc(len);
+	if((this_job == NULL) || (this_job->cmd == NULL))
+		err(1,"failed to malloc render command for %s",dot_file);
+	snprintf(this_job->cmd, len, "dot -Tsvg %s > %s", dot_file, svg_file);
+	this_job->next = NULL;
+
+	pthread_mutex_lock(&render_lock);
+	render_queued++;
+	if(render_mode == RENDER_DEFER)
+		{
+		if(render_script == NULL)
+			{
+			render_script = fopen(render_script_file, "w");
+			if(render_script == NULL)
+				fprintf(stderr,"failed to open %s\n",render_script_file);
+			else
+				fprintf(render_script,"#!/bin/sh\n# render the gooda graphs\ncd \"$(dirname \"$0\")\" || exit 1\n");
+			}
+		if(render_script != NULL)
+			fprintf(render_script,"dot -Tsvg %s > %s\n",render_rel(dot_file),render_rel(svg_file));
+		pthread_mutex_unlock(&render_lock);
+		free(this_job->cmd);
+		free(this_job);
+		return;
+		}
+	if(render_threads == NULL)
+		render_start();
+	if(render_tail != NULL)
+		render_tail->next = this_job;
+	else
+		render_head = this_job;
+	render_tail = this_job;
+	pthread_cond_signal(&render_cond);
+	pthread_mutex_unlock(&render_lock);
+}
+
+//	wait for the queued graphs
+void
+render_finish(void)
+{
+	int i;
+
+	if(render_script != NULL)
+		{
+		fclose(render_script);
+		render_script = NULL;
+		chmod(render_script_file, 0755);
+		gooda_log(GLOG_INFO," %d graphs left to render with %s\n",render_queued,render_script_file);
+		}
+	if(render_threads != NULL)
+		{
+		pthread_mutex_lock(&render_lock);
+		render_done = 1;
+		pthread_cond_broadcast(&render_cond);
+		pthread_mutex_unlock(&render_lock);
+		for(i = 0; i < num_render_threads; i++)
+			pthread_join(render_threads[i], NULL);
+		free(render_threads);
+		render_threads = NULL;
+		gooda_log(GLOG_VERBOSE," rendered %d graphs with %d threads, %d failed\n",
+			render_queued - render_failed, num_render_threads, render_failed);
+		}
+	if(render_skipped > 0)
+		gooda_log(GLOG_INFO," %d graphs larger than %ld bytes were left as .dot files\n",render_skipped,render_max_bytes);
+}
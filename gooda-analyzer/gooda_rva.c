@@ -0,0 +1,134 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	per module rva -> sample_struc table
+//
+//	every sample bound to a module goes through find_rva_sample, so the table
+//	is open addressing with linear probing in one array: a fibonacci hash of
+//	the rva picks the first slot and the table doubles at half load.
+//	rva_hash_bench.c links this file and times it against the chained table
+//	it replaced.
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+
+static inline int
+rva_hash_index(rva_hash_struc_ptr this_table, uint64_t rva)
+{
+	return (int)((rva * RVA_HASH_MULT) >> this_table->shift);
+}
+
+//	double the module table and reinsert the entries, called at half load
+static void
+grow_rva_table(module_struc_ptr this_module)
+{
+	rva_hash_struc_ptr old_table, new_table;
+	rva_slot_data *old_slot, *new_slot;
+	int i, index, mask;
+
+	old_table = this_module->this_table;
+#ifdef DBUG
+	fprintf(stderr,"creating larger table for module %s with entries %d\n",this_module->path,old_table->entries);
+#endif
+	new_table = rva_hash_struc_create(2*old_table->size);
+	if(new_table == NULL)
+		{
+		fprintf(stderr,"failed to create bigger hash table for module %s\n",this_module->path);
+		err(1,"failed to extend hash table");
+		}
+	mask = new_table->size - 1;
+	for(i = 0; i < old_table->size; i++)
+		{
+		old_slot = &old_table->this_array[i];
+		if(old_slot->this_sample == NULL)
+			continue;
+		index = rva_hash_index(new_table, old_slot->rva);
+		while(new_table->this_array[index].this_sample != NULL)
+			index = (index + 1) & mask;
+		new_slot = &new_table->this_array[index];
+		new_slot->rva = old_slot->rva;
+		new_slot->this_sample = old_slot->this_sample;
+		}
+	new_table->entries = old_table->entries;
+	this_module->this_table = new_table;
+	free(old_table->this_array);
+	free(old_table);
+}
+
+/*
+ * return the sample_struc for rva in this_module, creating it
+ * (and growing the module hash table) when it is not there yet
+ */
+sample_struc_ptr
+find_rva_sample(module_struc_ptr this_module, uint64_t rva)
+{
+	sample_struc_ptr this_sample;
+	rva_hash_struc_ptr this_table;
+	rva_slot_data *this_slot;
+	int index, mask;
+
+	if(this_module->this_table == NULL)
+		this_module->this_table = rva_hash_struc_create(default_hash_length);
+	if(this_module->this_table == NULL)
+		{
+		fprintf(stderr, " failed to create initial hash table, module = %s\n",this_module->path);
+		err(1, "failed to create initial hash table");
+		}
+	this_table = this_module->this_table;
+
+	mask = this_table->size - 1;
+	index = rva_hash_index(this_table, rva);
+	for(;;)
+		{
+		this_slot = &this_table->this_array[index];
+		if(this_slot->this_sample == NULL)
+			break;
+		if(this_slot->rva == rva)
+			return this_slot->this_sample;
+		index = (index + 1) & mask;
+		}
+
+//	fill the empty slot
+	this_sample = sample_struc_create();
+	if(this_sample == NULL)
+		{
+		fprintf(stderr," failed to create sample entry for module %s, rva = 0x%"PRIx64"\n",this_module->path,rva);
+		err(1, "failed to create sample entry");
+		}
+	this_slot->rva = rva;
+	this_slot->this_sample = this_sample;
+	this_sample->next = this_module->first_sample;
+	this_sample->rva = rva;
+	if(this_module->first_sample != NULL)
+		this_module->first_sample->previous = this_sample;
+	this_module->first_sample = this_sample;
+	this_table->entries++;
+#ifdef DBUG
+	fprintf(stderr," new sample, incremented table entries\n");
+#endif
+	if(2*this_table->entries > this_table->size)
+		grow_rva_table(this_module);
+	return this_sample;
+}
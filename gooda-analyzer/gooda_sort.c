@@ -0,0 +1,330 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	sorting for the analyzer's arrays
+//
+//	analyzer.c and column_align.c each had a recursive quicksort per record
+//	type with the first element as pivot. Symbol tables and rva lists often
+//	arrive sorted already, which made those O(n^2) with a recursion as deep
+//	as the array. radix_sort is a stable LSD radix sort, RADIX_BITS of the key
+//	per pass, on the 64, 32 bit unsigned or int key at key_offset of records
+//	of any size, so one routine covers pointer_data, function_loc_data,
+//	linkpairs_data and the rest. Only the key bits that differ between
+//	records are sorted, and one read of the keys counts all the digits so a
+//	pass where every key has the same digit is skipped. Arrays of at least
+//	RADIX_PARALLEL_MIN records with num_threads > 1 are split in chunks, one
+//	thread per chunk counts and scatters its chunk in each pass, chunk order
+//	in the output keeps the sort stable. Equal keys keep their input order,
+//	the quicksorts left them in no particular order.
+//	sort_bench.c times it against the old quicksort and qsort.
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <err.h>
+#include <pthread.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+
+#define RADIX_BITS		11
+#define RADIX_SIZE		(1 << RADIX_BITS)
+#define RADIX_MAX_PASS		((64 + RADIX_BITS - 1)/RADIX_BITS)
+#define RADIX_PARALLEL_MIN	(1 << 20)
+#define RADIX_MAX_THREADS	64
+
+typedef struct radix_sort_struc{
+	char *		src;
+	char *		dst;
+	size_t		size;
+	size_t		key_offset;
+	int		key_type;
+	int		count;
+	int		num_chunk;
+	int		shift;
+	int		(*hist)[RADIX_SIZE];	/* per chunk digit counts, then output offsets */
+	}radix_sort_data;
+
+typedef struct radix_chunk_struc{
+	radix_sort_data *	sort;
+	int			chunk;
+	int			phase;
+	}radix_chunk_data;
+
+static inline uint64_t
+radix_key(const char *rec, size_t key_offset, int key_type)
+{
+	switch(key_type) {
+	case RADIX_KEY_U32:
+		return *(const uint32_t *)(rec + key_offset);
+	case RADIX_KEY_INT:
+//		flip the sign bit so negative values sort first
+		return (uint32_t)*(const int *)(rec + key_offset) ^ 0x80000000U;
+	default:
+		return *(const uint64_t *)(rec + key_offset);
+	}
+}
+
+static inline void
+radix_copy(char *dst, const char *src, size_t size)
+{
+	size_t i;
+
+	if((size & 7) == 0)
+		{
+		for(i = 0; i < size; i += 8)
+			*(uint64_t *)(dst + i) = *(const uint64_t *)(src + i);
+		return;
+		}
+	memcpy(dst, src, size);
+}
+
+static void
+radix_chunk_bounds(radix_sort_data *this_sort, int chunk, int *first, int *last)
+{
+	long per_chunk = ((long)this_sort->count + this_sort->num_chunk - 1)/this_sort->num_chunk;
+
+	*first = (int)(chunk*per_chunk);
+	*last = (int)((chunk + 1)*per_chunk);
+	if(*first > this_sort->count)*first = this_sort->count;
+	if(*last > this_sort->count)*last = this_sort->count;
+}
+
+//	phase 0 counts the digits of a chunk, phase 1 scatters it
+static void *
+radix_chunk(void *arg)
+{
+	radix_chunk_data *this_chunk = (radix_chunk_data *)arg;
+	radix_sort_data *this_sort = this_chunk->sort;
+	int *hist = this_sort->hist[this_chunk->chunk];
+	size_t size = this_sort->size;
+	const char *rec;
+	int first, last, i, digit;
+
+	radix_chunk_bounds(this_sort, this_chunk->chunk, &first, &last);
+	for(i = first; i < last; i++)
+		{
+		rec = this_sort->src + (size_t)i*size;
+		digit = (int)(radix_key(rec, this_sort->key_offset, this_sort->key_type) >> this_sort->shift) & (RADIX_SIZE - 1);
+		if(this_chunk->phase == 0)
+			hist[digit]++;
+		else
+			radix_copy(this_sort->dst + (size_t)(hist[digit]++)*size, rec, size);
+		}
+	return NULL;
+}
+
+static void
+radix_run(radix_sort_data *this_sort, radix_chunk_data *chunk, pthread_t *threads, int phase)
+{
+	int i, ret;
+
+	for(i = 0; i < this_sort->num_chunk; i++)
+		{
+		chunk[i].phase = phase;
+		if(this_sort->num_chunk == 1)
+			{
+			radix_chunk(&chunk[i]);
+			continue;
+			}
+		ret = pthread_create(&threads[i], NULL, radix_chunk, &chunk[i]);
+		if(ret != 0)
+			errx(1,"failed to create sort thread %d, error %d",i,ret);
+		}
+	if(this_sort->num_chunk > 1)
+		for(i = 0; i < this_sort->num_chunk; i++)
+			pthread_join(threads[i], NULL);
+}
+
+//	stable sort of the records on key bits lo_bit up to hi_bit, tmp holds count records
+static void
+radix_records(char *base, char *tmp, int count, size_t size, size_t key_offset, int key_type,
+		int lo_bit, int hi_bit, int threads)
+{
+	radix_sort_data this_sort;
+	radix_chunk_data chunk[RADIX_MAX_THREADS];
+	pthread_t thread_id[RADIX_MAX_THREADS];
+	int (*hist)[RADIX_SIZE];
+	int (*digit_count)[RADIX_SIZE];
+	int num_pass, pass, i, c, digit, sum, skip;
+	char *rec;
+	uint64_t key;
+
+	num_pass = (hi_bit - lo_bit + RADIX_BITS - 1)/RADIX_BITS;
+	if(num_pass <= 0)
+		return;
+	if(threads > RADIX_MAX_THREADS)threads = RADIX_MAX_THREADS;
+	if((threads < 2) || (count < RADIX_PARALLEL_MIN))threads = 1;
+	digit_count = (int (*)[RADIX_SIZE])calloc(num_pass, sizeof(*digit_count));
+	hist = (int (*)[RADIX_SIZE])malloc(threads*sizeof(*hist));
+	if((digit_count == NULL) || (hist == NULL))
+		err(1,"failed to allocate radix sort histograms");
+
+//	one read of the keys counts every digit, a digit all keys share needs no pass
+	for(i = 0; i < count; i++)
+		{
+		key = radix_key(base + (size_t)i*size, key_offset, key_type) >> lo_bit;
+		for(pass = 0; pass < num_pass; pass++)
+			digit_count[pass][(key >> (pass*RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+		}
+
+	this_sort.src = base;
+	this_sort.dst = tmp;
+	this_sort.size = size;
+	this_sort.key_offset = key_offset;
+	this_sort.key_type = key_type;
+	this_sort.count = count;
+	this_sort.num_chunk = threads;
+	this_sort.hist = hist;
+	for(c = 0; c < threads; c++)
+		{
+		chunk[c].sort = &this_sort;
+		chunk[c].chunk = c;
+		}
+
+	for(pass = 0; pass < num_pass; pass++)
+		{
+		skip = 0;
+		for(digit = 0; digit < RADIX_SIZE; digit++)
+			if(digit_count[pass][digit] == count)skip = 1;
+		if(skip)
+			continue;
+		this_sort.shift = lo_bit + pass*RADIX_BITS;
+		if(threads == 1)
+			memcpy(hist[0], digit_count[pass], sizeof(hist[0]));
+		else
+			{
+			memset(hist, 0, threads*sizeof(*hist));
+			radix_run(&this_sort, chunk, thread_id, 0);
+			}
+//		digit counts to output offsets, digit major then chunk order
+		sum = 0;
+		for(digit = 0; digit < RADIX_SIZE; digit++)
+			for(c = 0; c < threads; c++)
+				{
+				i = hist[c][digit];
+				hist[c][digit] = sum;
+				sum += i;
+				}
+		radix_run(&this_sort, chunk, thread_id, 1);
+		rec = this_sort.src;
+		this_sort.src = this_sort.dst;
+		this_sort.dst = rec;
+		}
+	if(this_sort.src != base)
+		memcpy(base, this_sort.src, (size_t)count*size);
+	free(digit_count);
+	free(hist);
+}
+
+//	sort count records of size bytes on the key at key_offset, with up to
+//	threads threads. Records bigger than a key are not moved in every pass,
+//	the varying key bits and the record index are packed in one word when
+//	they fit, those words are sorted and the records are moved once.
+void
+radix_sort_threads(void *base, int count, size_t size, size_t key_offset, int key_type, int threads)
+{
+	uint64_t *packed, *tmp, key, first_key, diff, mask;
+	char *rec_tmp;
+	int i, key_bits, index_bits;
+
+	if(count < 2)
+		return;
+	first_key = radix_key((char *)base, key_offset, key_type);
+	diff = 0;
+	for(i = 1; i < count; i++)
+		diff |= radix_key((char *)base + (size_t)i*size, key_offset, key_type) ^ first_key;
+	if(diff == 0)
+		return;
+	key_bits = 64 - __builtin_clzll(diff);
+	index_bits = 32 - __builtin_clz((unsigned)(count - 1));
+
+	if((size == sizeof(uint64_t)) && (key_type == RADIX_KEY_U64))
+		{
+		tmp = (uint64_t *)malloc((size_t)count*sizeof(uint64_t));
+		if(tmp == NULL)
+			err(1,"failed to allocate radix sort buffer for %d records",count);
+		radix_records((char *)base, (char *)tmp, count, size, 0, RADIX_KEY_U64, 0, key_bits, threads);
+		free(tmp);
+		return;
+		}
+	if(key_bits + index_bits > 64)
+		{
+		rec_tmp = (char *)malloc((size_t)count*size);
+		if(rec_tmp == NULL)
+			err(1,"failed to allocate radix sort buffer for %d records",count);
+		radix_records((char *)base, rec_tmp, count, size, key_offset, key_type, 0, key_bits, threads);
+		free(rec_tmp);
+		return;
+		}
+
+	packed = (uint64_t *)malloc((size_t)count*sizeof(uint64_t));
+	tmp = (uint64_t *)malloc((size_t)count*sizeof(uint64_t));
+	rec_tmp = (char *)malloc((size_t)count*size);
+	if((packed == NULL) || (tmp == NULL) || (rec_tmp == NULL))
+		err(1,"failed to allocate radix sort buffers for %d records",count);
+	mask = (key_bits == 64) ? ~0ULL : (1ULL << key_bits) - 1;
+	for(i = 0; i < count; i++)
+		{
+		key = radix_key((char *)base + (size_t)i*size, key_offset, key_type) & mask;
+		packed[i] = (key << index_bits) | (uint64_t)i;
+		}
+//	the index bits are in input order already, only the key bits are sorted
+	radix_records((char *)packed, (char *)tmp, count, sizeof(uint64_t), 0, RADIX_KEY_U64,
+		index_bits, index_bits + key_bits, threads);
+	mask = (1ULL << index_bits) - 1;
+	for(i = 0; i < count; i++)
+		radix_copy(rec_tmp + (size_t)i*size, (char *)base + (size_t)(packed[i] & mask)*size, size);
+	memcpy(base, rec_tmp, (size_t)count*size);
+	free(packed);
+	free(tmp);
+	free(rec_tmp);
+}
+
+void
+radix_sort(void *base, int count, size_t size, size_t key_offset, int key_type)
+{
+	radix_sort_threads(base, count, size, key_offset, key_type, num_threads);
+}
+
+void
+sort_u64(uint64_t *arr, int elements)
+{
+	radix_sort(arr, elements, sizeof(uint64_t), 0, RADIX_KEY_U64);
+}
+
+void
+sort_pointer(pointer_data *arr, int elements)
+{
+	radix_sort(arr, elements, sizeof(pointer_data), offsetof(pointer_data, val), RADIX_KEY_U64);
+}
+
+void
+sort_loc(function_loc_data *arr, int elements)
+{
+	radix_sort(arr, elements, sizeof(function_loc_data), offsetof(function_loc_data, base), RADIX_KEY_U64);
+}
+
+void
+sort_index(index_data *arr, int elements)
+{
+	radix_sort(arr, elements, sizeof(index_data), offsetof(index_data, val), RADIX_KEY_INT);
+}
@@ -0,0 +1,363 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	on disk cache of per module data, keyed by the GNU build-id of the binary
+//
+//	<cache_dir>/<build-id>/functions holds the cleaned, sorted function list
+//	get_functionlist builds for a module, <build-id>/lines the line table of
+//	gooda_dwarf.c. The functions entry is
+//		symcache_header
+//		num_func symcache_entry, sorted by base
+//		names_len bytes of '\0' terminated names
+//	It is loaded with one mmap that stays mapped for the rest of the run,
+//	the names are used in place. The cache directory is -c dir, otherwise
+//	$XDG_CACHE_HOME/gooda or $HOME/.cache/gooda, and -c none turns it off.
+//	Entries are written to a temporary file and renamed, so concurrent
+//	gooda runs sharing the directory only ever see complete files.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+#include "gooda_log.h"
+
+#define SYMCACHE_MAGIC		0x314e4641444f4f47ULL	/* "GOODAFN1" */
+#define SYMCACHE_VERSION	1
+#define SYMCACHE_NO_BIND	0xFFFFFFFF
+
+typedef struct symcache_header_struc{
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	num_func;
+	uint64_t	addr_mask;	/* bases were masked with this */
+	uint64_t	names_len;
+	}symcache_header;
+
+typedef struct symcache_entry_struc{
+	uint64_t	base;
+	uint32_t	len;
+	uint32_t	name;		/* offset into the name block */
+	uint32_t	bind;		/* index into symcache_bind or SYMCACHE_NO_BIND */
+	uint32_t	pad;
+	}symcache_entry;
+
+static char *symcache_bind[] = {"LOCAL", "GLOBAL", "WEAK", "UNIQUE", "OTHER"};
+#define NUM_SYMCACHE_BIND	(sizeof(symcache_bind)/sizeof(symcache_bind[0]))
+
+char *symcache_dir = NULL;
+static int symcache_state = 0;		/* 0 not set up yet, 1 on, -1 off */
+static int symcache_hits = 0, symcache_misses = 0;
+
+static int
+symcache_init(void)
+{
+	char *base;
+	size_t len;
+
+	if(symcache_state != 0)
+		return symcache_state;
+	symcache_state = -1;
+	if((symcache_dir != NULL) && (strcmp(symcache_dir, "none") == 0))
+		return symcache_state;
+	if(symcache_dir == NULL)
+		{
+		base = getenv("XDG_CACHE_HOME");
+		if((base != NULL) && (base[0] != '\0'))
+			{
+			len = strlen(base) + strlen("/gooda") + 1;
+			symcache_dir = (char *)malloc(len);
+			if(symcache_dir == NULL)
+				err(1,"failed to malloc symbol cache path");
+			snprintf(symcache_dir, len, "%s/gooda", base);
+			}
+		else
+			{
+			base = getenv("HOME");
+			if((base == NULL) || (base[0] == '\0'))
+				return symcache_state;
+			len = strlen(base) + strlen("/.cache/gooda") + 1;
+			symcache_dir = (char *)malloc(len);
+			if(symcache_dir == NULL)
+				err(1,"failed to malloc symbol cache path");
+			snprintf(symcache_dir, len, "%s/.cache/gooda", base);
+			}
+		}
+	symcache_state = 1;
+	gooda_log(GLOG_VERBOSE," symbol cache in %s\n", symcache_dir);
+	return symcache_state;
+}
+
+//	mkdir -p for the cache entry directory
+static int
+symcache_mkdir(char *path)
+{
+	char *p;
+
+	for(p = path + 1; *p != '\0'; p++)
+		{
+		if(*p != '/')
+			continue;
+		*p = '\0';
+		if((mkdir(path, 0755) != 0) && (errno != EEXIST))
+			{
+			*p = '/';
+			return -1;
+			}
+		*p = '/';
+		}
+	if((mkdir(path, 0755) != 0) && (errno != EEXIST))
+		return -1;
+	return 0;
+}
+
+//	map <build-id>/entry read only, NULL if the cache is off or has no such entry
+void *
+symcache_map(char *buildid, char *entry, size_t *len)
+{
+	char *file_name;
+	size_t name_len;
+	struct stat st;
+	void *map;
+	int fd;
+
+	if((buildid == NULL) || (symcache_init() != 1))
+		return NULL;
+	name_len = strlen(symcache_dir) + strlen(buildid) + strlen(entry) + 3;
+	file_name = (char *)malloc(name_len);
+	if(file_name == NULL)
+		err(1,"failed to malloc symbol cache file name");
+	snprintf(file_name, name_len, "%s/%s/%s", symcache_dir, buildid, entry);
+	fd = open(file_name, O_RDONLY);
+	free(file_name);
+	if(fd == -1)
+		return NULL;
+	if((fstat(fd, &st) == -1) || (st.st_size == 0))
+		{
+		close(fd);
+		return NULL;
+		}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(map == MAP_FAILED)
+		return NULL;
+	*len = st.st_size;
+	return map;
+}
+
+//	open a temporary file for <build-id>/entry, hand it to symcache_commit
+FILE *
+symcache_create(char *buildid, char *entry, char **tmp_name)
+{
+	char *dir_name;
+	size_t len;
+	FILE *out;
+
+	*tmp_name = NULL;
+	if((buildid == NULL) || (symcache_init() != 1))
+		return NULL;
+	len = strlen(symcache_dir) + strlen(buildid) + strlen(entry) + 32;
+	dir_name = (char *)malloc(len);
+	*tmp_name = (char *)malloc(len);
+	if((dir_name == NULL) || (*tmp_name == NULL))
+		err(1,"failed to malloc symbol cache file name");
+	snprintf(dir_name, len, "%s/%s", symcache_dir, buildid);
+	snprintf(*tmp_name, len, "%s/%s.%d", dir_name, entry, (int)getpid());
+	out = NULL;
+	if(symcache_mkdir(dir_name) != 0)
+		gooda_log_limit(GLOG_WARN, 1," cannot create symbol cache directory %s, not caching symbols\n", dir_name);
+	else
+		out = fopen(*tmp_name, "w");
+	free(dir_name);
+	if(out == NULL)
+		{
+		free(*tmp_name);
+		*tmp_name = NULL;
+		}
+	return out;
+}
+
+//	close the temporary file and, if ok, rename it over <build-id>/entry
+void
+symcache_commit(char *buildid, char *entry, char *tmp_name, FILE *out, int ok)
+{
+	char *file_name;
+	size_t len;
+
+	if(fclose(out) != 0)
+		ok = 0;
+	len = strlen(symcache_dir) + strlen(buildid) + strlen(entry) + 3;
+	file_name = (char *)malloc(len);
+	if(file_name == NULL)
+		err(1,"failed to malloc symbol cache file name");
+	snprintf(file_name, len, "%s/%s/%s", symcache_dir, buildid, entry);
+	if(!ok || (rename(tmp_name, file_name) != 0))
+		unlink(tmp_name);
+	free(file_name);
+	free(tmp_name);
+}
+
+//	warn when the binary found locally is not the one perf recorded
+void
+symcache_check_build_id(char *path, char *buildid)
+{
+	buildid_struc_ptr this_buildid;
+
+	if(buildid == NULL)
+		return;
+	for(this_buildid = build_ll; this_buildid != NULL; this_buildid = this_buildid->next)
+		{
+		if(strcmp(this_buildid->filename, path) != 0)
+			continue;
+		if(strncmp(this_buildid->buildid, buildid, strlen(buildid)) != 0)
+			gooda_log_limit(GLOG_WARN, 10," %s has build-id %s but perf.data recorded %s, symbols may not match the samples\n",
+				path, buildid, this_buildid->buildid);
+		return;
+		}
+}
+
+functionlist_struc_ptr
+symcache_load_functions(char *buildid)
+{
+	unsigned char *map;
+	symcache_header *hdr;
+	symcache_entry *entry;
+	functionlist_struc_ptr this_functionlist;
+	function_loc_data *list;
+	char *names;
+	size_t map_len;
+	uint32_t i;
+
+	map = symcache_map(buildid, "functions", &map_len);
+	if(map == NULL)
+		{
+		if((buildid != NULL) && (symcache_state == 1))
+			symcache_misses++;
+		return NULL;
+		}
+	if(map_len < sizeof(symcache_header))
+		{
+		munmap(map, map_len);
+		symcache_misses++;
+		return NULL;
+		}
+	hdr = (symcache_header *)map;
+	if((hdr->magic != SYMCACHE_MAGIC) || (hdr->version != SYMCACHE_VERSION) || (hdr->addr_mask != addr_mask) ||
+		(hdr->num_func == 0) || (hdr->names_len == 0) ||
+		((uint64_t)map_len != sizeof(symcache_header) + (uint64_t)hdr->num_func*sizeof(symcache_entry) + hdr->names_len))
+		{
+		gooda_log(GLOG_VERBOSE," ignoring stale symbol cache entry for build-id %s\n", buildid);
+		munmap(map, map_len);
+		symcache_misses++;
+		return NULL;
+		}
+	entry = (symcache_entry *)(map + sizeof(symcache_header));
+	names = (char *)(entry + hdr->num_func);
+	if(names[hdr->names_len - 1] != '\0')
+		{
+		munmap(map, map_len);
+		symcache_misses++;
+		return NULL;
+		}
+
+	list = (function_loc_data *)calloc(hdr->num_func, sizeof(function_loc_data));
+	this_functionlist = (functionlist_struc_ptr) malloc(sizeof(functionlist_data));
+	if((list == NULL) || (this_functionlist == NULL))
+		err(1,"failed to malloc cached function list of %d entries",hdr->num_func);
+	for(i = 0; i < hdr->num_func; i++)
+		{
+		if(entry[i].name >= hdr->names_len)
+			{
+			free(list);
+			free(this_functionlist);
+			munmap(map, map_len);
+			symcache_misses++;
+			return NULL;
+			}
+		list[i].name = names + entry[i].name;
+		list[i].bind = (entry[i].bind < NUM_SYMCACHE_BIND) ? symcache_bind[entry[i].bind] : NULL;
+		list[i].base = entry[i].base;
+		list[i].len = entry[i].len;
+		}
+	this_functionlist->list = list;
+	this_functionlist->size = hdr->num_func;
+	symcache_hits++;
+	return this_functionlist;
+}
+
+void
+symcache_store_functions(char *buildid, functionlist_struc_ptr this_functionlist)
+{
+	char *tmp_name;
+	FILE *out;
+	symcache_header hdr;
+	symcache_entry entry;
+	function_loc_data *list;
+	uint32_t i, k;
+	int ok;
+
+	if((this_functionlist == NULL) || (this_functionlist->size <= 0))
+		return;
+	out = symcache_create(buildid, "functions", &tmp_name);
+	if(out == NULL)
+		return;
+	list = this_functionlist->list;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = SYMCACHE_MAGIC;
+	hdr.version = SYMCACHE_VERSION;
+	hdr.num_func = this_functionlist->size;
+	hdr.addr_mask = addr_mask;
+	for(i = 0; i < hdr.num_func; i++)
+		hdr.names_len += strlen(list[i].name) + 1;
+	ok = (fwrite(&hdr, sizeof(hdr), 1, out) == 1);
+	memset(&entry, 0, sizeof(entry));
+	entry.name = 0;
+	for(i = 0; ok && (i < hdr.num_func); i++)
+		{
+		entry.base = list[i].base;
+		entry.len = list[i].len;
+		entry.bind = SYMCACHE_NO_BIND;
+		for(k = 0; (list[i].bind != NULL) && (k < NUM_SYMCACHE_BIND); k++)
+			if(strcmp(list[i].bind, symcache_bind[k]) == 0)
+				entry.bind = k;
+		ok = (fwrite(&entry, sizeof(entry), 1, out) == 1);
+		entry.name += strlen(list[i].name) + 1;
+		}
+	for(i = 0; ok && (i < hdr.num_func); i++)
+		ok = (fwrite(list[i].name, strlen(list[i].name) + 1, 1, out) == 1);
+	symcache_commit(buildid, "functions", tmp_name, out, ok);
+}
+
+void
+symcache_report(void)
+{
+	if(symcache_state == 1)
+		gooda_log(GLOG_VERBOSE," symbol cache: %d modules loaded from %s, %d read from the binary\n",
+			symcache_hits, symcache_dir, symcache_misses);
+}
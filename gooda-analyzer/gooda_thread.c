@@ -0,0 +1,302 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	parallel sample ingest for Gooda
+//
+//	parse() stays serial: record decoding, the mmap/comm/fork bookkeeping,
+//	bind_sample and the process/module/thread totals all depend on record order.
+//	The per RVA work (hash lookup, sample_struc creation, table growth and the
+//	LBR branch lists) is what dominates ingest and it only touches data owned
+//	by one module. So every module is assigned to one shard, parse() appends
+//	the RVA updates to that shard's current batch and a worker thread per shard
+//	applies them with increment_rva. Updates for a module are applied in the
+//	same order as the serial code would, so the resulting tables are identical.
+//	shard_finish drains and joins the workers before the analysis starts,
+//	shard_sync only drains them, for the streaming snapshots.
+//
+//	pool_run is the report side: a fixed set of threads pulling item numbers
+//	from a shared counter, used by hot_list to write the per function reports.
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <err.h>
+#include <pthread.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+#include "gooda_log.h"
+
+#define SHARD_BATCH		16384	/* updates per batch */
+#define SHARD_MAX_QUEUED	8	/* batches queued per shard before parse() waits */
+
+typedef struct shard_item_struc{
+	module_struc_ptr	this_module;
+	module_struc_ptr	target_module;
+	uint64_t		rva;
+	uint64_t		target_rva;
+	int			index;
+	int			type;
+	}shard_item;
+
+typedef struct shard_batch_struc * shard_batch_ptr;
+typedef struct shard_batch_struc{
+	shard_batch_ptr		next;
+	int			count;
+	shard_item		item[SHARD_BATCH];
+	}shard_batch;
+
+typedef struct shard_struc{
+	pthread_t		thread;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+	shard_batch_ptr		head;		/* batches waiting for the worker */
+	shard_batch_ptr		tail;
+	shard_batch_ptr		fill;		/* batch being filled by parse() */
+	int			queued;
+	int			busy;		/* worker is applying a batch */
+	int			done;
+	}shard_data;
+
+static shard_data *shards = NULL;
+static int num_shards = 0;
+
+static inline int
+shard_index(module_struc_ptr this_module)
+{
+	uint64_t key = (uint64_t)(uintptr_t)this_module >> 4;
+
+	return (int)((uint32_t)((key * 0x9E3779B97F4A7C15ULL) >> 32) % (uint32_t)num_shards);
+}
+
+static void *
+shard_worker(void *arg)
+{
+	shard_data *this_shard = (shard_data *)arg;
+	shard_batch_ptr this_batch;
+	shard_item *this_item;
+	int i;
+
+	for(;;)
+		{
+		pthread_mutex_lock(&this_shard->lock);
+		while((this_shard->head == NULL) && (this_shard->done == 0))
+			pthread_cond_wait(&this_shard->cond, &this_shard->lock);
+		this_batch = this_shard->head;
+		if(this_batch == NULL)
+			{
+			pthread_mutex_unlock(&this_shard->lock);
+			return NULL;
+			}
+		this_shard->head = this_batch->next;
+		if(this_shard->head == NULL)this_shard->tail = NULL;
+		this_shard->queued--;
+		this_shard->busy = 1;
+		pthread_cond_broadcast(&this_shard->cond);
+		pthread_mutex_unlock(&this_shard->lock);
+
+		for(i = 0; i < this_batch->count; i++)
+			{
+			this_item = &this_batch->item[i];
+			increment_rva(this_item->this_module, this_item->rva, this_item->index,
+				this_item->type, this_item->target_module, this_item->target_rva);
+			}
+		free(this_batch);
+
+		pthread_mutex_lock(&this_shard->lock);
+		this_shard->busy = 0;
+		pthread_cond_broadcast(&this_shard->cond);
+		pthread_mutex_unlock(&this_shard->lock);
+		}
+}
+
+static void
+shard_queue(shard_data *this_shard)
+{
+	shard_batch_ptr this_batch = this_shard->fill;
+
+	this_shard->fill = NULL;
+	if((this_batch == NULL) || (this_batch->count == 0))
+		{
+		free(this_batch);
+		return;
+		}
+	pthread_mutex_lock(&this_shard->lock);
+	while(this_shard->queued >= SHARD_MAX_QUEUED)
+		pthread_cond_wait(&this_shard->cond, &this_shard->lock);
+	if(this_shard->tail != NULL)
+		this_shard->tail->next = this_batch;
+	else
+		this_shard->head = this_batch;
+	this_shard->tail = this_batch;
+	this_shard->queued++;
+	pthread_cond_broadcast(&this_shard->cond);
+	pthread_mutex_unlock(&this_shard->lock);
+}
+
+void
+shard_init(int n)
+{
+	int i, ret;
+
+	num_shards = n;
+	shards = (shard_data *)calloc(n, sizeof(shard_data));
+	if(shards == NULL)
+		err(1,"failed to allocate %d ingest shards",n);
+	for(i = 0; i < n; i++)
+		{
+		pthread_mutex_init(&shards[i].lock, NULL);
+		pthread_cond_init(&shards[i].cond, NULL);
+		ret = pthread_create(&shards[i].thread, NULL, shard_worker, &shards[i]);
+		if(ret != 0)
+			errx(1,"failed to create ingest thread %d, error %d",i,ret);
+		}
+	gooda_log(GLOG_INFO,"ingesting samples with %d worker threads\n",n);
+}
+
+void
+shard_push(module_struc_ptr this_module, uint64_t rva, int index, int type, module_struc_ptr target_module, uint64_t target_rva)
+{
+	shard_data *this_shard;
+	shard_item *this_item;
+
+	this_shard = &shards[shard_index(this_module)];
+	if(this_shard->fill == NULL)
+		{
+		this_shard->fill = (shard_batch_ptr)malloc(sizeof(shard_batch));
+		if(this_shard->fill == NULL)
+			err(1,"failed to allocate ingest batch");
+		this_shard->fill->next = NULL;
+		this_shard->fill->count = 0;
+		}
+	this_item = &this_shard->fill->item[this_shard->fill->count++];
+	this_item->this_module = this_module;
+	this_item->target_module = target_module;
+	this_item->rva = rva;
+	this_item->target_rva = target_rva;
+	this_item->index = index;
+	this_item->type = type;
+	if(this_shard->fill->count == SHARD_BATCH)
+		shard_queue(this_shard);
+}
+
+//	flush the partial batches and wait until every worker has applied its queue,
+//	the workers stay up. Used before a streaming snapshot forks, so the child
+//	sees complete tables and no worker is inside increment_rva.
+void
+shard_sync(void)
+{
+	int i;
+
+	if(shards == NULL)
+		return;
+	for(i = 0; i < num_shards; i++)
+		{
+		shard_queue(&shards[i]);
+		pthread_mutex_lock(&shards[i].lock);
+		while((shards[i].head != NULL) || (shards[i].busy != 0))
+			pthread_cond_wait(&shards[i].cond, &shards[i].lock);
+		pthread_mutex_unlock(&shards[i].lock);
+		}
+}
+
+//	flush the partial batches, let the workers drain their queues and join them
+void
+shard_finish(void)
+{
+	int i;
+
+	if(shards == NULL)
+		return;
+	for(i = 0; i < num_shards; i++)
+		{
+		shard_queue(&shards[i]);
+		pthread_mutex_lock(&shards[i].lock);
+		shards[i].done = 1;
+		pthread_cond_broadcast(&shards[i].cond);
+		pthread_mutex_unlock(&shards[i].lock);
+		}
+	for(i = 0; i < num_shards; i++)
+		{
+		pthread_join(shards[i].thread, NULL);
+		pthread_mutex_destroy(&shards[i].lock);
+		pthread_cond_destroy(&shards[i].cond);
+		}
+	free(shards);
+	shards = NULL;
+	num_shards = 0;
+}
+
+typedef struct pool_struc{
+	void			(*work)(int item, void *arg);
+	void			(*finish)(void *arg);
+	void *			arg;
+	int			count;
+	int			next;
+	}pool_data;
+
+static void *
+pool_worker(void *arg)
+{
+	pool_data *this_pool = (pool_data *)arg;
+	int item;
+
+	while((item = __sync_fetch_and_add(&this_pool->next, 1)) < this_pool->count)
+		this_pool->work(item, this_pool->arg);
+	if(this_pool->finish != NULL)
+		this_pool->finish(this_pool->arg);
+	return NULL;
+}
+
+//	call work(item, arg) for item 0..count-1 on up to n threads, items are
+//	started in increasing order, finish(arg) runs on each thread once it is out
+//	of work. With n == 1 everything runs on the calling thread.
+void
+pool_run(int count, int n, void (*work)(int item, void *arg), void (*finish)(void *arg), void *arg)
+{
+	pool_data this_pool;
+	pthread_t *threads;
+	int i, ret;
+
+	this_pool.work = work;
+	this_pool.finish = finish;
+	this_pool.arg = arg;
+	this_pool.count = count;
+	this_pool.next = 0;
+	if(n > count)n = count;
+	if(n <= 1)
+		{
+		pool_worker(&this_pool);
+		return;
+		}
+	threads = (pthread_t *)malloc(n*sizeof(pthread_t));
+	if(threads == NULL)
+		err(1,"failed to allocate %d report threads",n);
+	for(i = 0; i < n; i++)
+		{
+		ret = pthread_create(&threads[i], NULL, pool_worker, &this_pool);
+		if(ret != 0)
+			errx(1,"failed to create report thread %d, error %d",i,ret);
+		}
+	for(i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
@@ -28,6 +28,7 @@ limitations under the License.
 #include "gooda.h"
 #include "perf_gooda.h"
 #include "gooda_util.h"
+#include "gooda_log.h"
 
 thread_struc_ptr base_thread;
 process_struc_ptr process_minus_one = NULL;
@@ -37,6 +38,106 @@ char vmlinux[]="/vmlinux";
 int max_print=20;
 int print_rva=0;
 uint64_t fourk_align=0xFFFFFFFFFFFFF000UL;
+static uint64_t mmap_stamp=0;
+
+//	an mmap put on top of a process mmap stack gets a new, larger stamp
+//	so the stack order can be recovered from the addr sorted mmap_index
+static inline void
+mmap_push_stamp(mmap_struc_ptr this_mmap)
+{
+	this_mmap->stamp = ++mmap_stamp;
+}
+
+//	open addressing pid -> process_struc table, the process_stack list is kept for walking
+static id_table_data pid_table;
+
+#define ID_TABLE_MIN	16
+
+static inline uint32_t
+id_table_slot(id_table_data *table, uint32_t id)
+{
+//	fibonacci hashing, the top bits of the product are the best mixed
+	return (uint32_t)(id * 2654435769U) >> table->shift;
+}
+
+static void *
+id_table_find(id_table_data *table, uint32_t id)
+{
+	uint32_t i, mask;
+
+	if(table->size == 0)
+		return NULL;
+	mask = (uint32_t)table->size - 1;
+	i = id_table_slot(table, id);
+	while(table->value[i] != NULL)
+		{
+		if(table->key[i] == id)
+			return table->value[i];
+		i = (i + 1) & mask;
+		}
+	return NULL;
+}
+
+static void
+id_table_grow(id_table_data *table)
+{
+	uint32_t *old_key = table->key;
+	void **old_value = table->value;
+	int old_size = table->size;
+	uint32_t i, j, mask;
+
+	if(old_size == 0)
+		{
+		table->size = ID_TABLE_MIN;
+		table->shift = 28;
+		}
+	else
+		{
+		table->size = 2*old_size;
+		table->shift--;
+		}
+	table->key = (uint32_t *)calloc(table->size, sizeof(uint32_t));
+	table->value = (void **)calloc(table->size, sizeof(void *));
+	if((table->key == NULL) || (table->value == NULL))
+		err(1,"failed to grow id table to %d entries",table->size);
+	mask = (uint32_t)table->size - 1;
+	for(j = 0; j < (uint32_t)old_size; j++)
+		{
+		if(old_value[j] == NULL)
+			continue;
+		i = id_table_slot(table, old_key[j]);
+		while(table->value[i] != NULL)
+			i = (i + 1) & mask;
+		table->key[i] = old_key[j];
+		table->value[i] = old_value[j];
+		}
+	free(old_key);
+	free(old_value);
+}
+
+//	an id that is already present is rebound to the new value, lookups return the most recent struc
+static void
+id_table_insert(id_table_data *table, uint32_t id, void *value)
+{
+	uint32_t i, mask;
+
+	if(2*(table->count + 1) > table->size)
+		id_table_grow(table);
+	mask = (uint32_t)table->size - 1;
+	i = id_table_slot(table, id);
+	while(table->value[i] != NULL)
+		{
+		if(table->key[i] == id)
+			{
+			table->value[i] = value;
+			return;
+			}
+		i = (i + 1) & mask;
+		}
+	table->key[i] = id;
+	table->value[i] = value;
+	table->count++;
+}
 
 mmap_struc_ptr 
 mmap_copy(mmap_struc_ptr mmap_orig, uint32_t new_pid, uint64_t new_time)
@@ -76,8 +177,6 @@ init(void)
 	uint64_t tzero = 0;
 	int last, i;
 	
-	sqrt_five = sqrt(5.0);
-
 
 //	create comm structure for PID = -1
 //		since perf does not
@@ -123,6 +222,7 @@ init(void)
 	process_stack = base_proc;
 	base_proc->pid = base_pid;
 	base_proc->name = base_name;
+	id_table_insert(&pid_table, base_proc->pid, base_proc);
 	base_thread = thread_struc_create();
 	if(base_thread == NULL)
 		{
@@ -131,6 +231,7 @@ init(void)
 		}
 	base_thread->tid = 0;
 	base_proc->first_thread = base_thread;
+	id_table_insert(&base_proc->thread_table, base_thread->tid, base_thread);
 	return;
 }
 
@@ -219,9 +320,11 @@ initialize_mmap_stack(process_struc_ptr this_process,uint32_t pid,uint64_t time)
 		if(this_process->first_mmap != NULL) this_process->first_mmap->previous = this_mmap;
 		this_process->first_mmap = this_mmap;
 		this_mmap->this_process = this_process;
+		mmap_push_stamp(this_mmap);
 
 		loop_mmap = loop_mmap->next;
 		}
+	this_process->mmap_generation++;
 	return this_process->first_mmap;
 }
 
@@ -430,82 +533,31 @@ find_mmap(mmap_struc_ptr pid_mmap_stack, mm_struc_ptr this_mm, char* filename, u
 thread_struc_ptr 
 find_thread_struc(process_struc_ptr this_process, uint32_t tid)
 {
-	thread_struc_ptr this_thread, thread_tmp;
+	thread_struc_ptr this_thread;
 
-	thread_tmp = this_process->first_thread;
-	while(thread_tmp !=NULL)
-		{
-		if(thread_tmp->tid == tid)
-			{
-			this_thread = thread_tmp;
-//	pop this thread to the top of stack
-			if(this_thread != this_process->first_thread)
-				{
-				this_thread->previous->next = this_thread->next;
-				if(this_thread->next != NULL)
-					this_thread->next->previous = this_thread->previous;
-				this_process->first_thread->previous = this_thread;
-				this_thread->next = this_process->first_thread;
-				this_process->first_thread = this_thread;
-				}
-			return this_thread;
-			}
-		thread_tmp = thread_tmp->next;
-		}
+	this_thread = (thread_struc_ptr)id_table_find(&this_process->thread_table, tid);
 #ifdef DBUG
-	fprintf(stderr, " could not find thread tid = %d in stack for process pid = %d, address of thread_tmp = %p\n",tid,this_process->pid, thread_tmp);
+	if(this_thread == NULL)
+		fprintf(stderr, " could not find thread tid = %d in table for process pid = %d\n",tid,this_process->pid);
 #endif
 //	err(1, " could not find tid in stack");
-	return thread_tmp;
+	return this_thread;
 }
 
 process_struc_ptr 
 find_process_struc(uint32_t pid)
 {
-	process_struc_ptr this_process, process_tmp;
-#ifdef DBUG
-	fprintf(stderr," entering find_process  pid = %d, process_stack_pid = %d\n",pid, process_stack->pid);
-#endif
-	process_tmp = process_stack;
-	while(process_tmp !=NULL)
-		{
-#ifdef DBUG
-		fprintf(stderr," process_tmp->pid = %d, need pid = %d\n",process_tmp->pid, pid);
-#endif
-		if(process_tmp->pid == pid)
-			{
-			this_process = process_tmp;
-//	pop this process to the top of stack
-			if(this_process != process_stack)
-				{
-#ifdef DBUG
-	fprintf(stderr," change process_stack old_pid = %d, new_pid =%d\n",process_stack->pid,this_process->pid);
-#endif
-				this_process->previous->next = this_process->next;
-				if(this_process->next != NULL)
-					this_process->next->previous = this_process->previous;
-				process_stack->previous = this_process;
-				this_process->next = process_stack;
-				this_process->previous = NULL;
-				process_stack = this_process;
-				}
-#ifdef DBUG
-	fprintf(stderr," found process pid = %d, struc address =%p\n",process_stack->pid,this_process);
-#endif
-			return this_process;
-			}
-//		fprintf(stderr," in find_process while, pid = %d\n",process_tmp->pid);
-		process_tmp = process_tmp->next;
-		}
+	process_struc_ptr this_process;
+
+	this_process = (process_struc_ptr)id_table_find(&pid_table, pid);
 #ifdef DBUG
-//		fprintf(stderr,"kernel_mmap filename = %s, kernel_mmap filename address = %lp\n",kernel_mmap->filename,kernel_mmap->filename);
-	fprintf(stderr," could not find process in stack pid = %d, process_stack_pid = %d\n",pid, process_stack->pid);
-//		fprintf(stderr," base_thread->sample_count address = %lp\n",base_thread->sample_count);
-//		fprintf(stderr," base_thread->sample_count address = %lp\n",base_thread->sample_count);
+	if(this_process == NULL)
+		fprintf(stderr," could not find process in table pid = %d\n",pid);
+	else
+		fprintf(stderr," found process pid = %d, struc address =%p\n",pid,this_process);
 #endif
-//	printf(" could not find process in stack pid = %X, process_stack_pid = %X\n",pid, process_stack->pid);
 //	err(1, " could not find pid in stack");
-	return process_tmp;
+	return this_process;
 }
 
 module_struc_ptr 
@@ -531,10 +583,9 @@ uint64_t
 find_load_addr(char* this_path)
 {
 	char *local_name;
-	char local_bin_dir[] = "./binaries";
 	char local_linux[] = "/vmlinux";
 	int is_linux, linux_offset;
-	int local_bin_len=10;
+	int local_bin_len = strlen(local_bin_dir);
 	int access_status;
 	int i,j,k,len,module_len,ret_val;
 	uint64_t load_addr;
@@ -713,6 +764,7 @@ insert_mmap(mm_struc_ptr this_mm, char* filename, uint64_t new_time)
 				if(previous_mmap->last_pgoff >= this_mm->pgoff)return previous_mmap;
 				previous_mmap->len += this_mm->len;
 				previous_mmap->last_pgoff = this_mm->pgoff;
+				if(previous_mmap->this_process != NULL)previous_mmap->this_process->mmap_generation++;
 //	comment this out as this module gets set when events appear
 //				previous_mmap->this_module->length += this_mm->len;
 				return previous_mmap;
@@ -820,6 +872,8 @@ insert_mmap(mm_struc_ptr this_mm, char* filename, uint64_t new_time)
 		pid_mmap_stack = this_struc;
 		this_process->first_mmap = pid_mmap_stack;
 		this_struc->previous = NULL;
+		mmap_push_stamp(this_struc);
+		this_process->mmap_generation++;
 		}
 //	mmap already known, time does not need to be updated
 	else if(this_struc != pid_mmap_stack)
@@ -848,6 +902,8 @@ insert_mmap(mm_struc_ptr this_mm, char* filename, uint64_t new_time)
 		pid_mmap_stack = this_struc;
 		this_process->first_mmap = pid_mmap_stack;
 		this_struc->previous = NULL;
+//	addr and len are unchanged so the index stays valid, only the stack order moves
+		mmap_push_stamp(this_struc);
 		}
 #ifdef DBUG
 	fprintf(stderr,"returning mmap struc for %s starting at 0x%"PRIx64", len = 0x%"PRIx64", with time 0x%"PRIx64"\n",this_struc->filename,this_struc->addr,this_struc->len,this_struc->time);
@@ -859,98 +915,23 @@ mmap_struc_ptr
 bind_sample(uint32_t pid, uint64_t ip, uint64_t new_time)
 {
 	process_struc_ptr this_process;
-	mmap_struc_ptr this_mmap, mmap_tmp, pid_mmap_stack;
-	module_struc_ptr this_module;
+	mmap_struc_ptr best_mmap;
 
-	this_mmap = NULL;	
-	if(global_flag1 == 0)
-		{
-//		dump_process_stack();
-		global_flag1++;
-		}
-#ifdef DBUG
-//		fprintf(stderr,"kernel_mmap filename = %s, kernel_mmap filename address = %lp\n",kernel_mmap->filename,kernel_mmap->filename);
-//		fprintf(stderr," base_thread->sample_count address = %lp\n",base_thread->sample_count);
-#endif
-	this_process = process_stack;
-	if(this_process->pid != pid)
-		this_process = find_process_struc(pid);
-#ifdef DBUG
-		if(this_process != NULL)
-			{
-			fprintf(stderr," from bind bind sample find_process_struc returned  = %p, %s\np - 0x%"PRIx64"",
-				this_process, this_process->name,ip);
-//			dump_mmstack(this_process->first_mmap);
-			}
-		else
-			{
-			fprintf(stderr," from bind bind sample find_process_struc returned  = %p\n",this_process);
-			}
-
-#endif
+	this_process = find_process_struc(pid);
 	if(this_process == NULL)
 		{
 #ifdef DBUG
 		fprintf(stderr," from bind bind sample failed to find process for pid = %d\n",pid);
-//		err(1," failed to find process in bind_sample");
 #endif
-		return this_mmap;
+		return NULL;
 		}
-	pid_mmap_stack = this_process->first_mmap;
-	this_mmap = pid_mmap_stack;
-	while(this_mmap != NULL)
-		{
-		if( this_mmap->pid == pid)
-		  {
-#ifdef DBUG
-		fprintf(stderr,"this_mmap != NULL, right pid, ip = 0x%"PRIx64", name = %s\n",this_mmap->addr, this_mmap->filename);
-#endif
-		  if(this_mmap->addr < ip)
-		    {
-#ifdef DBUG
-		fprintf(stderr,"this_mmap != NULL, right pid, above start ip = 0x%"PRIx64", name = %s\n",this_mmap->addr, this_mmap->filename);
-#endif
-		    if(this_mmap->len > ip - this_mmap->addr)
-		      {
-#ifdef DBUG
-		fprintf(stderr,"this_mmap != NULL, right pid, in addr range, ip = 0x%"PRIx64", name = %s\n",this_mmap->addr, this_mmap->filename);
-		fprintf(stderr," ip in addr range for %s, new time = 0x%"PRIx64", this_mmap->time = 0x%"PRIx64"\n",this_mmap->filename,new_time,this_mmap->time);
-#endif
-		      if(this_mmap->time < new_time)
-			{
-//	found appropriate mmap record, pop it to the top of stack
-//   note:   if the OS unloads a module and then reloads it within the period of one cores collection buffer filling
-//		AND the old and new load addresses overlap we still get it right
-//		BECAUSE: we revert to the old mmap record and push it up in the stack  
-//		and when the new mmap record on this core comes along, it gets pushed to the top
-//	there may still be a problem if the new addr exactly equals the old addr
-/*             
-			if(pid_mmap_stack != this_mmap)
-				{
-				this_mmap->previous->next = this_mmap->next;
-				if(this_mmap->next != NULL)this_mmap->next->previous = this_mmap->previous;
-				pid_mmap_stack->previous = this_mmap;
-				this_mmap->previous = NULL;
-				this_mmap->next = pid_mmap_stack;
-				pid_mmap_stack = this_mmap;
-				this_process->first_mmap = pid_mmap_stack;
-				}
-*/
+
+	best_mmap = mmap_index_find(this_process, pid, ip, new_time);
 #ifdef DBUG
-		fprintf(stderr," from bind  this_mmap->filename = %s\n",this_mmap->filename);
-//		fprintf(stderr,"kernel_mmap filename = %s, kernel_mmap filename address = %lp\n",kernel_mmap->filename,kernel_mmap->filename);
-//		fprintf(stderr," base_thread->sample_count address = %lp\n",base_thread->sample_count);
+	if(best_mmap != NULL)
+		fprintf(stderr," from bind  this_mmap->filename = %s\n",best_mmap->filename);
 #endif
-			return this_mmap;
-			}
-		      }
-		    }
-		  }
-		this_mmap = this_mmap->next;
-		}
-//	this might be an error
-//	err(1,"no found mmap");
-	return NULL;
+	return best_mmap;
 }
 
 process_struc_ptr 
@@ -1103,6 +1084,7 @@ insert_comm(comm_struc_ptr local_comm)
 		process_stack = this_process;
 		this_process->pid = local_comm->pid;
 		this_process->tid_main = local_comm->tid;
+		id_table_insert(&pid_table, this_process->pid, this_process);
 #ifdef DBUG
 		fprintf(stderr," change process_stack old_pid = %d, new_pid =%d\n",process_stack->pid,this_process->pid);
 //		fprintf(stderr,"kernel_mmap filename = %s, kernel_mmap filename address = %lp\n",kernel_mmap->filename,kernel_mmap->filename);
@@ -1137,15 +1119,7 @@ insert_comm(comm_struc_ptr local_comm)
 		fprintf(stderr," failed to create kernel mmap in insert_comm for pid = %d\n",local_comm->pid);
 		err(1," failed to create copy of kernel_mmap in insert_comm");
 		}
-//	pop to top of stack
-	if(process_stack != this_process)
-		{
-		process_stack->previous = this_process;
-		this_process->next = process_stack;
-//		fprintf(stderr," change process_stack old_pid = %d, new_pid =%d\n",process_stack->pid,this_process->pid);
-		process_stack = this_process;
-		}
-	
+
 //	create and add thread_struc to process_struc linked list
 	this_thread = find_thread_struc(this_process,local_comm->tid);
 #ifdef DBUG
@@ -1159,6 +1133,7 @@ insert_comm(comm_struc_ptr local_comm)
 		err(1, "insert_comm cannot create thread struc");
 		}
 	this_thread->tid = local_comm->tid;
+	id_table_insert(&this_process->thread_table, this_thread->tid, this_thread);
 	if(this_process->first_thread !=NULL)
 				this_process->first_thread->previous = this_thread;
 	this_thread->next = this_process->first_thread;
@@ -1225,6 +1200,7 @@ insert_fork(fork_struc_ptr f)
 			err(1, "insert_fork cannot create child struc");
 			}
 		this_process->pid = f->pid;
+		id_table_insert(&pid_table, this_process->pid, this_process);
 		this_process->parent = old_process;
 		this_process->name = old_process->name;
 		this_child->parent = old_process;
@@ -1264,8 +1240,10 @@ insert_fork(fork_struc_ptr f)
 			if(this_process->first_mmap != NULL) this_process->first_mmap->previous = this_mmap;
 			this_process->first_mmap = this_mmap;
 			this_mmap->this_process = this_process;
+			mmap_push_stamp(this_mmap);
 			loop_mmap = loop_mmap->previous;
 			}
+		this_process->mmap_generation++;
 #ifdef DBUG
 //		fprintf(stderr," base_thread->sample_count address = %lp\n",base_thread->sample_count);
 //		dump_process(this_process); 
@@ -1288,6 +1266,7 @@ insert_fork(fork_struc_ptr f)
 		err(1, "insert_fork cannot create thread struc for new pid");
 		}
 	this_thread->tid = f->tid;
+	id_table_insert(&this_process->thread_table, this_thread->tid, this_thread);
 	if(this_process->first_thread == NULL)
 		{
 		this_process->first_thread = this_thread;
@@ -1301,143 +1280,227 @@ insert_fork(fork_struc_ptr f)
 	return this_process;
 }
 
-hash_struc_ptr 
-find_hash_entry(hash_struc_ptr this_hash, uint64_t rva, rva_hash_struc_ptr this_table, module_struc_ptr this_module)
+//	function list entry holding rva, NULL if the module has no list or no entry covers it
+function_loc_data *
+find_function_loc(module_struc_ptr this_module, uint64_t rva)
 {
-	hash_struc_ptr this_hash_entry, tmp_entry;
-	sample_struc_ptr this_sample;
+	function_loc_data *list;
+	int lo, hi, mid;
+
+	if((this_module->function_list == NULL) || (this_module->function_list->size == 0))
+		return NULL;
+	list = this_module->function_list->list;
+	lo = 0;
+	hi = this_module->function_list->size;
+	while(lo < hi)
+		{
+		mid = (lo + hi)/2;
+		if(list[mid].base <= rva)
+			lo = mid + 1;
+		else
+			hi = mid;
+		}
+	if(lo == 0)
+		return NULL;
+	if(rva >= list[lo-1].base + (uint64_t)list[lo-1].len)
+		return NULL;
+	return &list[lo-1];
+}
+
+static inline int
+branch_edge_index(branch_edge_table_ptr this_table, sample_struc_ptr this_sample, int type, module_struc_ptr target_module, uint64_t target_rva)
+{
+	uint64_t h;
 
-	tmp_entry = this_hash;
-	while(this_hash != NULL)
+	h = (uint64_t)(uintptr_t)this_sample * RVA_HASH_MULT;
+	h ^= (uint64_t)(uintptr_t)target_module * 0xC2B2AE3D27D4EB4FULL;
+	h ^= (target_rva + (uint64_t)type) * 0x165667B19E3779F9ULL;
+	h ^= h >> 29;
+	return (int)((h * RVA_HASH_MULT) >> this_table->shift);
+}
+
+//	double the module edge table and reinsert the edges, called at 3/4 load
+static void
+grow_branch_edge_table(branch_edge_table_ptr this_table)
+{
+	branch_edge_ptr this_edge;
+	int index, mask;
+
+	free(this_table->slot);
+	if(this_table->size == 0)
 		{
-		if(this_hash->this_rva == rva)
-			{
-			return this_hash;
-			}
-		tmp_entry = this_hash;
-		this_hash = this_hash->next;
+		this_table->size = 256;
+		this_table->shift = 56;
 		}
-	this_hash = hash_struc_create();
-	if(this_hash == NULL)
+	else
 		{
-		fprintf(stderr," failed to create hash element in linked list finder for address 0x%"PRIx64"\n",rva);
-		err(1, "failed to create hash entry in linked list");
+		this_table->size *= 2;
+		this_table->shift--;
 		}
-	this_table->entries++;
-	tmp_entry->next = this_hash;
-	this_hash->this_rva = rva;
-	this_sample = sample_struc_create();
-	if(this_sample == NULL)
+	this_table->slot = (branch_edge_ptr *)calloc(this_table->size, sizeof(branch_edge_ptr));
+	if(this_table->slot == NULL)
+		err(1,"failed to allocate branch edge table of %d slots",this_table->size);
+	mask = this_table->size - 1;
+	for(this_edge = this_table->first_edge; this_edge != NULL; this_edge = this_edge->next)
 		{
-		fprintf(stderr," failed to create sample struc element in linked list finder for address 0x%"PRIx64"\n",rva);
-		err(1, "failed to create sample entry in linked list");
+		index = branch_edge_index(this_table, this_edge->this_sample, this_edge->type,
+			this_edge->branch.this_module, this_edge->branch.address);
+		while(this_table->slot[index] != NULL)
+			index = (index + 1) & mask;
+		this_table->slot[index] = this_edge;
 		}
-	this_hash->this_sample = this_sample;
-	this_module->first_sample->previous = this_sample;
-	this_sample->next = this_module->first_sample;
-	this_sample->rva = rva;
-	this_module->first_sample = this_sample;
-#ifdef DBUG
-//	follow a single address through if there are worries about lost samples/rva struc's
-//	if(rva == 0x43e110)fprintf(stderr,"creating sample struc in find_hash_create for address 0x43e110\n");
-#endif
-	return this_hash;
 }
 
-rva_hash_struc_ptr 
-create_big_table(module_struc_ptr this_module)
+/*
+ * count one LBR edge of this_sample in the module edge table, keyed by
+ * (source rva, type, target module, target rva). The edge is created with
+ * its branch_struc the first time, the rva's return, call or next taken list
+ * is only built from the table by branch_edge_lists
+ */
+static void
+increment_branch_edge(module_struc_ptr this_module, sample_struc_ptr this_sample, int type, module_struc_ptr target_module, uint64_t target_rva)
 {
-	int new_size, old_size, old_index, new_index;
-	double val;
-	uint64_t rva, this_rva, old_rva, len;
-	rva_hash_struc_ptr new_table;
-	hash_struc_ptr this_hash_entry, old_hash_entry, tmp_entry;
-	hash_data *new_array, *old_array;
-	sample_struc_ptr this_sample;
+	branch_edge_table_ptr this_table;
+	branch_edge_ptr this_edge;
+	int index, mask;
 
-	fprintf(stderr,"creating larger table for module %s with entries %d\n",this_module->path,this_module->this_table->entries);
-	len = this_module->length;
-	old_size = this_module->this_table->size;
-	old_array = this_module->this_table->this_array;
-	new_size = 10*old_size;
-	new_table = rva_hash_struc_create(new_size);
-	if(new_table == NULL)
+	this_table = this_module->edge_table;
+	if(this_table == NULL)
 		{
-		fprintf(stderr,"failed to create bigger hash table for module %s\n",this_module->path);
-		err(1,"failed to extend hash table");
+		this_table = (branch_edge_table_ptr)calloc(1, sizeof(branch_edge_table_data));
+		if(this_table == NULL)
+			err(1,"failed to allocate branch edge table for module %s",this_module->path);
+		this_module->edge_table = this_table;
 		}
-	new_array = new_table->this_array;
-#ifdef DBUG
-	fprintf(stderr,"starting loop over old entries, old_size = %d, new size = %d, old_array address = %p\n",old_size,new_size,old_array);
-#endif
-	for(old_index = 0; old_index < old_size; old_index++)
+	if(4*(this_table->entries + 1) > 3*this_table->size)
+		grow_branch_edge_table(this_table);
+
+	mask = this_table->size - 1;
+	index = branch_edge_index(this_table, this_sample, type, target_module, target_rva);
+	while((this_edge = this_table->slot[index]) != NULL)
 		{
-		rva = old_array[old_index].this_rva;
-#ifdef DBUG
-		fprintf(stderr,"rva = 0x%"PRIx64"\n",rva);
-#endif
-		if(rva != 0)
+		if((this_edge->this_sample == this_sample) && (this_edge->branch.address == target_rva)
+			&& (this_edge->branch.this_module == target_module) && (this_edge->type == type))
+			{
+			this_edge->branch.count++;
+			return;
+			}
+		index = (index + 1) & mask;
+		}
+
+	this_edge = arena_alloc(ARENA_BRANCH, sizeof(branch_edge_data));
+	if(this_edge == NULL)
+		err(1,"could not allocate branch edge for module %s",this_module->path);
+	this_edge->this_sample = this_sample;
+	this_edge->type = type;
+	this_edge->branch.address = target_rva;
+	this_edge->branch.this_module = target_module;
+	this_edge->branch.count = 1;
+	this_edge->next = this_table->first_edge;
+	this_table->first_edge = this_edge;
+	this_table->slot[index] = this_edge;
+	this_table->entries++;
+	if(type == RVA_RETURN)
+		this_sample->total_sources++;
+	else if(type == RVA_CALL)
+		this_sample->total_targets++;
+	else
+		this_sample->total_taken_branch++;
+}
+
+/*
+ * move the LBR edges of every module into the return, call and next taken
+ * lists of their rvas, in the order the edges were first seen, and drop the
+ * edge tables. Called once ingest is done, before anything reads the lists
+ */
+void
+branch_edge_lists(void)
+{
+	process_struc_ptr this_process;
+	module_struc_ptr this_module;
+	branch_edge_ptr this_edge;
+	branch_struc_ptr *list;
+	int edges = 0;
+
+	for(this_process = principal_process_stack; this_process != NULL; this_process = this_process->principal_next)
+		for(this_module = this_process->first_module; this_module != NULL; this_module = this_module->next)
 			{
-			old_hash_entry = &old_array[old_index];
-			while(old_hash_entry != NULL)
+			if(this_module->edge_table == NULL)
+				continue;
+//			the edges are newest first, pushing each on its list leaves the lists oldest first
+			for(this_edge = this_module->edge_table->first_edge; this_edge != NULL; this_edge = this_edge->next)
 				{
-				old_rva = old_hash_entry->this_rva;
-				val = sqrt_five*(double)(old_rva & 0x7FFFFFFF);
-				new_index = (int)(val) & 0x7FFFFFFF;
-				new_index = (new_index & 0x7FFFFFFF)%new_size;
-#ifdef DBUG
-				fprintf(stderr," val = %g, old_rva = 0x%"PRIx64", index = %d\n",val, old_rva, new_index);
-#endif
+				if(this_edge->type == RVA_RETURN)
+					list = &this_edge->this_sample->return_list;
+				else if(this_edge->type == RVA_CALL)
+					list = &this_edge->this_sample->call_list;
+				else
+					list = &this_edge->this_sample->next_taken_list;
+				this_edge->branch.next = *list;
+				if(*list != NULL)
+					(*list)->previous = &this_edge->branch;
+				*list = &this_edge->branch;
+				edges++;
+				}
+			free(this_module->edge_table->slot);
+			free(this_module->edge_table);
+			this_module->edge_table = NULL;
+			}
+	gooda_log(GLOG_VERBOSE," %d LBR branch edges\n",edges);
+}
 
-				this_hash_entry = &new_array[new_index];
-				tmp_entry = this_hash_entry;
-				if(this_hash_entry->next != NULL)
-					{
-					while(this_hash_entry !=NULL)
-						{
-						tmp_entry = this_hash_entry;
-						this_hash_entry = this_hash_entry->next;
-						}
-					this_hash_entry = hash_struc_create();
-					if(this_hash_entry == NULL)
-						{
-						fprintf(stderr," failed to create hash element in create_big_table for address 0x%"PRIx64"\n",old_rva);
-						err(1, "failed to create hash entry in create_big_table");
-						}
-					tmp_entry->next = this_hash_entry;
-					}
-				this_hash_entry->this_rva = old_rva;
-				this_hash_entry->this_sample = old_hash_entry->this_sample;
-				new_table->entries++;
-#ifdef DBUG
-//	follow a single address through if there are worries about lost samples/rva struc's
-//				if(old_rva == 0x43e110)fprintf(stderr," creating new hash in table expanding for address 0x43e110\n");
-#endif
-				old_hash_entry = old_hash_entry->next;
-				}    //while old
-			}    //if
-		}	// for				
-	this_module->this_table = new_table;
-#ifdef DBUG
-	fprintf(stderr,"finished making larger table\n");
-#endif
-	return new_table;
+/*
+ * per RVA part of the increment_* functions. Only touches data
+ * owned by this_module, so the ingest shards can run it concurrently
+ * as long as each module is handled by a single thread.
+ * Branches are counted in the module edge table, see increment_branch_edge
+ */
+void
+increment_rva(module_struc_ptr this_module, uint64_t rva, int index, int type, module_struc_ptr target_module, uint64_t target_rva)
+{
+	sample_struc_ptr this_sample;
+
+	this_sample = find_rva_sample(this_module, rva);
+	if(type == RVA_MEM)
+		{
+		mem_stats_add(&this_sample->mem, target_rva, index);
+		return;
+		}
+	if(type == RVA_BRANCH)
+		{
+		this_sample->lbr.taken++;
+		this_sample->lbr.mispredict += index;
+		return;
+		}
+	if(type == RVA_CYCLES)
+		{
+		block_cycles_add(&this_sample->cycles, target_rva, index);
+		return;
+		}
+	sample_count_add(this_sample, index, 1);
+	this_sample->total_sample_count++;
+	if(type == RVA_SAMPLE)
+		return;
+	increment_branch_edge(this_module, this_sample, type, target_module, target_rva);
+}
+
+static inline void
+count_rva(module_struc_ptr this_module, uint64_t rva, int index, int type, module_struc_ptr target_module, uint64_t target_rva)
+{
+	if(num_threads > 1)
+		shard_push(this_module, rva, index, type, target_module, target_rva);
+	else
+		increment_rva(this_module, rva, index, type, target_module, target_rva);
 }
-			
 
 int
-increment_module_struc(uint32_t pid, uint32_t tid, uint64_t ip, int this_event, int this_cpu, mmap_struc_ptr this_mmap, uint64_t time_enabled, uint64_t time_running)
+increment_module_struc(uint32_t pid, uint32_t tid, uint64_t ip, int this_event, int this_cpu, mmap_struc_ptr this_mmap, uint64_t time_enabled, uint64_t time_running, uint64_t weight, int mem_src)
 {
 	module_struc_ptr this_module, module_stack;
 	process_struc_ptr this_process,principal_process;
 	thread_struc_ptr this_thread, thread_stack;
-	sample_struc_ptr this_sample;
-	hash_struc_ptr this_hash_entry, this_hash; 
-	hash_data *this_hash_array;
 
 	uint64_t rva,tmp, four_hundredK = 0x400000, rva1;
-	double val;
-	int index;
 	int offset, size;
 
 	int sample_sum;
@@ -1579,101 +1642,43 @@ increment_module_struc(uint32_t pid, uint32_t tid, uint64_t ip, int this_event,
 		print_rva++;
 		}
 */
-	val = (double) (rva & 0x7FFFFFFF);
-
-	if(this_module->this_table == NULL)
-		this_module->this_table = rva_hash_struc_create(default_hash_length);
-#ifdef DBUG
-	fprintf(stderr," made hash table, len = %d\n", default_hash_length);
-	fprintf(stderr," val = %f\n",val);
-//	fprintf(stderr," sqrt_five = %f\n",sqrt_five);
-#endif
-	if(this_module->this_table == NULL)
+//	the per RVA update is handed to a worker thread when ingesting in parallel
+	count_rva(this_module, rva, num_cores*this_event + this_cpu, RVA_SAMPLE, NULL, 0);
+//	loads and stores with a latency or data source go into the rva's mem profile
+	if(mem_src >= 0)
 		{
-		fprintf(stderr, " increment module failed to create initial hash table, pid = %d, module = %s\n",pid,this_module->path);
-		err(1, "increment module failed to create initial hash table");
+		if(pid != pid_ker)mem_sample_count++;
+		count_rva(this_module, rva, mem_src, RVA_MEM, NULL, weight);
 		}
+	return 0;
+}
 
-	val = val*sqrt_five;
-	tmp = (uint64_t) val;
-	index = (int) (tmp & 0x7FFFFFFF);
-//	fprintf(stderr,"index = %x\n",index);
-	index = index%this_module->this_table->size;
-//	fprintf(stderr,"index = %x\n",index);
-	this_hash_array = this_module->this_table->this_array;
-	this_hash_entry = &this_hash_array[index];
-#ifdef DBUG
-	fprintf(stderr," got pointer to hash structure\n");
-#endif
+//	one taken LBR entry with a valid prediction bit, counted at the branch
+//	instruction itself so the mispredict columns have no sampling skid
+int
+increment_branch_outcome(mmap_struc_ptr this_mmap, uint64_t source, int mispredict)
+{
+	module_struc_ptr this_module;
+	uint64_t rva;
 
-	if(this_hash_entry->this_rva != 0)
-		{
-//		fprintf(stderr," base entry exists\n");
-//	base entry exists
-//	find (or create) exact entry;
-//	increment sample struc
-		this_hash = this_hash_entry;
-		if(this_hash_entry->this_rva != rva)
-			{
-#ifdef DBUG
-			fprintf(stderr," hash rva != rva\n");
-#endif
-			this_hash = find_hash_entry(this_hash_entry, rva, this_module->this_table, this_module);
-#ifdef DBUG
-			fprintf(stderr," found hash entry != to hash table[index]\n");
-#endif	
-		}
-#ifdef DBUG
-		if(this_hash == NULL)fprintf(stderr," this_hash = NULL\n");
-#endif
-		this_hash->this_sample->sample_count[num_cores*this_event + this_cpu ]++;
-		this_hash->this_sample->total_sample_count++;
-		}
-	else
-		{
-		
-//	fill the empty array element
-#ifdef DBUG
-		fprintf(stderr," need to make new hash structure for this index\n");
-#endif
-		this_hash_entry->this_rva = rva;
-		this_sample = sample_struc_create();
-		if(this_sample == NULL)
-			{
-			fprintf(stderr," failed to create sample entry for module %s, rva = 0x%"PRIx64"\n",this_module->path,rva);
-			err(1, "failed to create sample entry");
-			}
-#ifdef DBUG
-		fprintf(stderr," first sample at this index\n");
-#endif
-		this_hash_entry->this_sample = this_sample;
-		this_sample->sample_count[num_cores*this_event + this_cpu ]++;
-		this_sample->total_sample_count++;
-		this_sample->next = this_module->first_sample;
-		this_sample->rva = rva;
-		if(this_module->first_sample != NULL)
-			this_module->first_sample->previous = this_sample;
-		this_module->first_sample = this_sample;
-		this_module->this_table->entries ++;
-#ifdef DBUG
-		fprintf(stderr," new sample, incremented table entries\n");
-//	follow a single address through if there are worries about lost samples/rva struc's
-//		if(rva == 0x43e110)fprintf(stderr," increment_module creating sample struc for 0x43e110\n");
-#endif
-		if(this_module->this_table->entries > this_module->this_table->size*max_entry_fraction)
-//			create a new hash table and move all entries to the new table
-			{
-#ifdef DBUG
-			fprintf(stderr,"making a bigger table for module = %s, process %d\n",this_module->path,pid);
-#endif
-			this_module->this_table = create_big_table(this_module);
-			if(this_module->this_table == NULL)
-				{
-				fprintf(stderr," failed to create larger hash table for module %s\n",this_module->path);
-				err(1, "failed to create larger hash");
-				}
-			}
-		}
+	this_module = this_mmap->this_module;
+	rva = source - this_mmap->addr + this_module->starting_ip;
+	lbr_outcome_count++;
+	count_rva(this_module, rva, mispredict != 0, RVA_BRANCH, NULL, 0);
+	return 0;
+}
+
+//	latency of one timed LBR block, counted at the branch target starting it
+int
+increment_block_cycles(mmap_struc_ptr this_mmap, uint64_t start, uint64_t cycles, int loop)
+{
+	module_struc_ptr this_module;
+	uint64_t rva;
+
+	this_module = this_mmap->this_module;
+	rva = start - this_mmap->addr + this_module->starting_ip;
+	lbr_cycles_count++;
+	count_rva(this_module, rva, loop != 0, RVA_CYCLES, NULL, cycles);
 	return 0;
 }
 
@@ -1682,14 +1687,8 @@ increment_return(mmap_struc_ptr this_mmap, uint64_t source, uint64_t destination
 {
 	module_struc_ptr this_module, target_module;
 	process_struc_ptr this_process,principal_process;
-	sample_struc_ptr this_sample;
-	hash_struc_ptr this_hash_entry, this_hash; 
-	hash_data *this_hash_array;
-	branch_struc_ptr this_return;
 
 	uint64_t rva,target_rva,rva1,tmp, four_hundredK = 0x400000;
-	double val;
-	int index;
 	int offset, size;
 
 //	What is called a source or target depends on the usage.
@@ -1718,6 +1717,7 @@ increment_return(mmap_struc_ptr this_mmap, uint64_t source, uint64_t destination
 	principal_process->total_sample_count++;
 	principal_process->sample_count[source_index]++;
 	global_sample_count[source_index]++;
+	global_branch_sample_count++;
 
 	rva = source - this_mmap->addr + this_module->starting_ip;
 	target_rva = destination - target_mmap->addr + target_module->starting_ip;
@@ -1738,146 +1738,8 @@ increment_return(mmap_struc_ptr this_mmap, uint64_t source, uint64_t destination
 		print_rva++;
 		}
 */
-	val = (double) (rva & 0x7FFFFFFF);
-
-	if(this_module->this_table == NULL)
-		this_module->this_table = rva_hash_struc_create(default_hash_length);
-#ifdef DBUG
-	fprintf(stderr," made hash table, len = %d\n", default_hash_length);
-	fprintf(stderr," val = %f\n",val);
-//	fprintf(stderr," sqrt_five = %f\n",sqrt_five);
-#endif
-	if(this_module->this_table == NULL)
-		{
-		fprintf(stderr, " increment module failed to create initial hash table, module = %s\n",this_module->path);
-		err(1, "increment module failed to create initial hash table");
-		}
-
-	val = val*sqrt_five;
-	tmp = (uint64_t) val;
-	index = (int) (tmp & 0x7FFFFFFF);
-//	fprintf(stderr,"index = %x\n",index);
-	index = index%this_module->this_table->size;
-//	fprintf(stderr,"index = %x\n",index);
-	this_hash_array = this_module->this_table->this_array;
-	this_hash_entry = &this_hash_array[index];
-#ifdef DBUG
-	fprintf(stderr," got pointer to hash structure \n");
-	fprintf(stderr," got pointer to hash structure %p, hash rva = 0x%"PRIx64"\n",this_hash_entry, this_hash_entry->this_rva);
-#endif
-
-	if(this_hash_entry->this_rva != 0)
-		{
-//		fprintf(stderr," base entry exists\n");
-//	base entry exists
-//	find (or create) exact entry;
-//	increment sample struc
-		this_hash = this_hash_entry;
-		if(this_hash_entry->this_rva != rva)
-			{
-#ifdef DBUG
-			fprintf(stderr," hash rva != rva\n");
-#endif
-			this_hash = find_hash_entry(this_hash_entry, rva, this_module->this_table, this_module);
-#ifdef DBUG
-			fprintf(stderr," found hash entry != to hash table[index]\n");
-#endif	
-		}
-#ifdef DBUG
-		if(this_hash == NULL)fprintf(stderr," this_hash = NULL\n");
-#endif
-
-//		this_sample = this_hash_entry->this_sample;
-		this_sample = this_hash->this_sample;
-
-//this is where things chage with respect to increment_module..since we want to increment the linked list of return destinations
-		this_sample->sample_count[source_index]++;
-		if(this_sample->return_list == NULL)
-			{
-			this_sample->return_list = branch_struc_create();
-			if(this_sample->return_list == NULL)
-				err(1,"could not malloc buffer for top of rva struc return list");
-			this_sample->return_list->address = target_rva;
-			this_sample->return_list->this_module = target_module;
-			this_sample->total_sources++;
-			}
-		this_return = this_sample->return_list;
-		while(this_return->address != target_rva)
-			{
-			if(this_return->next == NULL)
-				{
-//			create new return struc and add it to the end of the stack
-				this_return->next = branch_struc_create();
-				if(this_return->next == NULL)
-					err(1,"could not malloc buffer for next return list");
-				this_return->next->previous = this_return;
-				this_return->next->address = target_rva;
-				this_return->next->this_module = target_module;
-				this_sample->total_sources++;
-				}
-			this_return = this_return->next;
-			}
-		this_return->count++;
-				
-
-		this_hash->this_sample->total_sample_count++;
-		global_branch_sample_count++;
-		}
-	else
-		{
-		
-//	fill the empty array element
-#ifdef DBUG
-		fprintf(stderr," need to make new hash structure for this index\n");
-#endif
-		this_hash_entry->this_rva = rva;
-		this_sample = sample_struc_create();
-		if(this_sample == NULL)
-			{
-			fprintf(stderr," failed to create sample entry for module %s, rva = 0x%"PRIx64"\n",this_module->path,rva);
-			err(1, "failed to create sample entry");
-			}
-#ifdef DBUG
-		fprintf(stderr," first sample at this index\n");
-#endif
-		this_hash_entry->this_sample = this_sample;
-//this is where things chage with respect to increment_module..since we want to increment the linked list of return destinations
-		this_sample->return_list = branch_struc_create();
-		if(this_sample->return_list == NULL)
-			err(1,"could not malloc buffer for top of rva struc return list");
-		this_sample->return_list->address = target_rva;
-		this_sample->return_list->this_module = target_module;
-		this_sample->return_list->count++;
-
-		this_sample->sample_count[source_index]++;
-		this_sample->total_sample_count++;
-		this_sample->total_sources++;
-		global_branch_sample_count++;
-		this_sample->next = this_module->first_sample;
-		this_sample->rva = rva;
-		if(this_module->first_sample != NULL)
-			this_module->first_sample->previous = this_sample;
-		this_module->first_sample = this_sample;
-		this_module->this_table->entries ++;
-#ifdef DBUG
-		fprintf(stderr," new sample, incremented table entries\n");
-#endif
-		if(this_module->this_table->entries > this_module->this_table->size*max_entry_fraction)
-//			create a new hash table and move all entries to the new table
-			{
-#ifdef DBUG
-			fprintf(stderr,"making a bigger table for module = %s\n",this_module->path);
-#endif
-			this_module->this_table = create_big_table(this_module);
-			if(this_module->this_table == NULL)
-				{
-				fprintf(stderr," failed to create larger hash table for module %s\n",this_module->path);
-				err(1, "failed to create larger hash");
-				}
-			}
-		}
+	count_rva(this_module, rva, source_index, RVA_RETURN, target_module, target_rva);
 	return 0;
-
 }
 
 int
@@ -1885,14 +1747,8 @@ increment_call_site(mmap_struc_ptr source_mmap, uint64_t source, uint64_t destin
 {
 	module_struc_ptr this_module, source_module;
 	process_struc_ptr this_process,principal_process;
-	sample_struc_ptr this_sample;
-	hash_struc_ptr this_hash_entry, this_hash; 
-	hash_data *this_hash_array;
-	branch_struc_ptr this_call;
 
 	uint64_t rva,source_rva,rva1,tmp, four_hundredK = 0x400000;
-	double val;
-	int index;
 	int offset, size;
 
 //	What is called a source or target depends on the usage.
@@ -1928,6 +1784,7 @@ increment_call_site(mmap_struc_ptr source_mmap, uint64_t source, uint64_t destin
 	principal_process->total_sample_count++;
 	principal_process->sample_count[target_index]++;
 	global_sample_count[target_index]++;
+	global_branch_sample_count++;
 
 	rva = destination - this_mmap->addr + this_module->starting_ip;
 	source_rva = source - source_mmap->addr + source_module->starting_ip;
@@ -1948,141 +1805,8 @@ increment_call_site(mmap_struc_ptr source_mmap, uint64_t source, uint64_t destin
 		print_rva++;
 		}
 */
-	val = (double) (rva & 0x7FFFFFFF);
-
-	if(this_module->this_table == NULL)
-		this_module->this_table = rva_hash_struc_create(default_hash_length);
-#ifdef DBUG
-	fprintf(stderr," made hash table, len = %d\n", default_hash_length);
-	fprintf(stderr," val = %f\n",val);
-//	fprintf(stderr," sqrt_five = %f\n",sqrt_five);
-#endif
-	if(this_module->this_table == NULL)
-		{
-		fprintf(stderr, " increment module failed to create initial hash table, module = %s\n",this_module->path);
-		err(1, "increment module failed to create initial hash table");
-		}
-
-	val = val*sqrt_five;
-	tmp = (uint64_t) val;
-	index = (int) (tmp & 0x7FFFFFFF);
-//	fprintf(stderr,"index = %x\n",index);
-	index = index%this_module->this_table->size;
-//	fprintf(stderr,"index = %x\n",index);
-	this_hash_array = this_module->this_table->this_array;
-	this_hash_entry = &this_hash_array[index];
-#ifdef DBUG
-	fprintf(stderr," got pointer to hash structure\n");
-#endif
-
-	if(this_hash_entry->this_rva != 0)
-		{
-//		fprintf(stderr," base entry exists\n");
-//	base entry exists
-//	find (or create) exact entry;
-//	increment sample struc
-		this_hash = this_hash_entry;
-		if(this_hash_entry->this_rva != rva)
-			{
-#ifdef DBUG
-			fprintf(stderr," hash rva != rva\n");
-#endif
-			this_hash = find_hash_entry(this_hash_entry, rva, this_module->this_table, this_module);
-#ifdef DBUG
-			fprintf(stderr," found hash entry != to hash table[index]\n");
-#endif	
-			}
-#ifdef DBUG
-		if(this_hash == NULL)fprintf(stderr," this_hash = NULL\n");
-#endif
-		this_sample = this_hash->this_sample;
-//this is where things change with respect to increment_module..since we want to increment the linked list of return destinations
-		this_sample->sample_count[target_index]++;
-		if(this_sample->call_list == NULL)
-			{
-			this_sample->call_list = branch_struc_create();
-			if(this_sample->call_list == NULL)
-				err(1,"could not malloc buffer for top of rva struc call list");
-			this_sample->call_list->address = source_rva;
-			this_sample->call_list->this_module = source_module;
-			this_sample->total_targets++;
-			}
-		this_call = this_sample->call_list;
-		while(this_call->address != source_rva)
-			{
-			if(this_call->next == NULL)
-				{
-//			create new return struc and add it to the end of the stack
-				this_call->next = branch_struc_create();
-				if(this_call->next == NULL)
-					err(1,"could not malloc buffer for next call list");
-				this_call->next->previous = this_call;
-				this_call->next->address = source_rva;
-				this_call->next->this_module = source_module;
-				this_sample->total_targets++;
-				}
-			this_call = this_call->next;
-			}
-		this_call->count++;
-				
-
-		this_hash->this_sample->total_sample_count++;
-		global_branch_sample_count++;
-		}
-	else
-		{
-		
-//	fill the empty array element
-#ifdef DBUG
-		fprintf(stderr," need to make new hash structure for this index\n");
-#endif
-		this_hash_entry->this_rva = rva;
-		this_sample = sample_struc_create();
-		if(this_sample == NULL)
-			{
-			fprintf(stderr," failed to create sample entry for module %s, rva = 0x%"PRIx64"\n",this_module->path,rva);
-			err(1, "failed to create sample entry");
-			}
-#ifdef DBUG
-		fprintf(stderr," first sample at this index\n");
-#endif
-		this_hash_entry->this_sample = this_sample;
-//this is where things change with respect to increment_module..since we want to increment the linked list of return destinations
-		this_sample->call_list = branch_struc_create();
-		if(this_sample->call_list == NULL)
-			err(1,"could not malloc buffer for top of rva struc call list");
-		this_sample->call_list->address = source_rva;
-		this_sample->call_list->this_module = source_module;
-		this_sample->call_list->count++;
-		this_sample->sample_count[target_index]++;
-		this_sample->total_sample_count++;
-		this_sample->total_targets++;
-		global_branch_sample_count++;
-		this_sample->next = this_module->first_sample;
-		this_sample->rva = rva;
-		if(this_module->first_sample != NULL)
-			this_module->first_sample->previous = this_sample;
-		this_module->first_sample = this_sample;
-		this_module->this_table->entries++;
-#ifdef DBUG
-		fprintf(stderr," new sample, incremented table entries\n");
-#endif
-		if(this_module->this_table->entries > this_module->this_table->size*max_entry_fraction)
-//			create a new hash table and move all entries to the new table
-			{
-#ifdef DBUG
-			fprintf(stderr,"making a bigger table for module = %s\n",this_module->path);
-#endif
-			this_module->this_table = create_big_table(this_module);
-			if(this_module->this_table == NULL)
-				{
-				fprintf(stderr," failed to create larger hash table for module %s\n",this_module->path);
-				err(1, "failed to create larger hash");
-				}
-			}
-		}
+	count_rva(this_module, rva, target_index, RVA_CALL, source_module, source_rva);
 	return 0;
-
 }
 
 int
@@ -2090,14 +1814,8 @@ increment_next_taken_site(mmap_struc_ptr this_mmap, uint64_t source, uint64_t ne
 {
 	module_struc_ptr this_module, next_taken_module;
 	process_struc_ptr this_process,principal_process;
-	sample_struc_ptr this_sample;
-	hash_struc_ptr this_hash_entry, this_hash; 
-	hash_data *this_hash_array;
-	branch_struc_ptr this_next_taken;
 
 	uint64_t rva,next_taken_rva,rva1,tmp, four_hundredK = 0x400000;
-	double val;
-	int index;
 	int offset, size;
 
 //	What is called a source or target depends on the usage.
@@ -2133,6 +1851,7 @@ increment_next_taken_site(mmap_struc_ptr this_mmap, uint64_t source, uint64_t ne
 	principal_process->total_sample_count++;
 	principal_process->sample_count[next_taken_index]++;
 	global_sample_count[next_taken_index]++;
+	global_branch_sample_count++;
 
 	if(this_mmap->addr != four_hundredK)
 		{
@@ -2151,141 +1870,8 @@ increment_next_taken_site(mmap_struc_ptr this_mmap, uint64_t source, uint64_t ne
 			next_branch,rva1,rva,this_mmap->addr, this_module->starting_ip);
 		print_rva++;
 		}
-	val = (double) (rva & 0x7FFFFFFF);
-
-	if(this_module->this_table == NULL)
-		this_module->this_table = rva_hash_struc_create(default_hash_length);
-#ifdef DBUG
-	fprintf(stderr," made hash table, len = %d\n", default_hash_length);
-	fprintf(stderr," val = %f\n",val);
-//	fprintf(stderr," sqrt_five = %f\n",sqrt_five);
-#endif
-	if(this_module->this_table == NULL)
-		{
-		fprintf(stderr, " increment module failed to create initial hash table, module = %s\n",this_module->path);
-		err(1, "increment module failed to create initial hash table");
-		}
-
-	val = val*sqrt_five;
-	tmp = (uint64_t) val;
-	index = (int) (tmp & 0x7FFFFFFF);
-//	fprintf(stderr,"index = %x\n",index);
-	index = index%this_module->this_table->size;
-//	fprintf(stderr,"index = %x\n",index);
-	this_hash_array = this_module->this_table->this_array;
-	this_hash_entry = &this_hash_array[index];
-#ifdef DBUG
-	fprintf(stderr," got pointer to hash structure\n");
-#endif
-
-	if(this_hash_entry->this_rva != 0)
-		{
-//		fprintf(stderr," base entry exists\n");
-//	base entry exists
-//	find (or create) exact entry;
-//	increment sample struc
-		this_hash = this_hash_entry;
-		if(this_hash_entry->this_rva != rva)
-			{
-#ifdef DBUG
-			fprintf(stderr," hash rva != rva\n");
-#endif
-			this_hash = find_hash_entry(this_hash_entry, rva, this_module->this_table, this_module);
-#ifdef DBUG
-			fprintf(stderr," found hash entry != to hash table[index]\n");
-#endif	
-			}
-#ifdef DBUG
-		if(this_hash == NULL)fprintf(stderr," this_hash = NULL\n");
-#endif
-		this_sample = this_hash->this_sample;
-//this is where things change with respect to increment_module..since we want to increment the linked list of return destinations
-		this_sample->sample_count[next_taken_index]++;
-		if(this_sample->next_taken_list == NULL)
-			{
-			this_sample->next_taken_list = branch_struc_create();
-			if(this_sample->next_taken_list == NULL)
-				err(1,"could not malloc buffer for top of rva struc next_taken list");
-			this_sample->next_taken_list->address = next_taken_rva;
-			this_sample->next_taken_list->this_module = next_taken_module;
-			this_sample->total_taken_branch++;
-			}
-		this_next_taken = this_sample->next_taken_list;
-		while(this_next_taken->address != next_taken_rva)
-			{
-			if(this_next_taken->next == NULL)
-				{
-//			create new return struc and add it to the end of the stack
-				this_next_taken->next = branch_struc_create();
-				if(this_next_taken->next == NULL)
-					err(1,"could not malloc buffer for next this_taken list");
-				this_next_taken->next->previous = this_next_taken;
-				this_next_taken->next->address = next_taken_rva;
-				this_next_taken->next->this_module = next_taken_module;
-				this_sample->total_taken_branch++;
-				}
-			this_next_taken = this_next_taken->next;
-			}
-		this_next_taken->count++;
-				
-
-		this_hash->this_sample->total_sample_count++;
-		global_branch_sample_count++;
-		}
-	else
-		{
-		
-//	fill the empty array element
-#ifdef DBUG
-		fprintf(stderr," need to make new hash structure for this index\n");
-#endif
-		this_hash_entry->this_rva = rva;
-		this_sample = sample_struc_create();
-		if(this_sample == NULL)
-			{
-			fprintf(stderr," failed to create sample entry for module %s, rva = 0x%"PRIx64"\n",this_module->path,rva);
-			err(1, "failed to create sample entry");
-			}
-#ifdef DBUG
-		fprintf(stderr," first sample at this index\n");
-#endif
-		this_hash_entry->this_sample = this_sample;
-//this is where things change with respect to increment_module..since we want to increment the linked list of next taken branch locations
-		this_sample->next_taken_list = branch_struc_create();
-		if(this_sample->next_taken_list == NULL)
-			err(1,"could not malloc buffer for top of rva struc next_taken list");
-		this_sample->next_taken_list->address = next_taken_rva;
-		this_sample->next_taken_list->this_module = next_taken_module;
-		this_sample->next_taken_list->count++;
-		this_sample->sample_count[next_taken_index]++;
-		this_sample->total_sample_count++;
-		this_sample->total_taken_branch++;
-		global_branch_sample_count++;
-		this_sample->next = this_module->first_sample;
-		this_sample->rva = rva;
-		if(this_module->first_sample != NULL)
-			this_module->first_sample->previous = this_sample;
-		this_module->first_sample = this_sample;
-		this_module->this_table->entries++;
-#ifdef DBUG
-		fprintf(stderr," new sample, incremented table entries\n");
-#endif
-		if(this_module->this_table->entries > this_module->this_table->size*max_entry_fraction)
-//			create a new hash table and move all entries to the new table
-			{
-#ifdef DBUG
-			fprintf(stderr,"making a bigger table for module = %s\n",this_module->path);
-#endif
-			this_module->this_table = create_big_table(this_module);
-			if(this_module->this_table == NULL)
-				{
-				fprintf(stderr," failed to create larger hash table for module %s\n",this_module->path);
-				err(1, "failed to create larger hash");
-				}
-			}
-		}
+	count_rva(this_module, rva, next_taken_index, RVA_NEXT_TAKEN, next_taken_module, next_taken_rva);
 	return 0;
-
 }
 
 
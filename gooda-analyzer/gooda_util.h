@@ -17,7 +17,7 @@ limitations under the License.
 extern int *id_array, num_cores, num_sockets, *socket, num_events;
 extern uint64_t min_event_id;
 extern int default_hash_length, max_default_entries;
-extern double sqrt_five, max_entry_fraction;
+extern char *local_bin_dir;
 extern int pop_threshold;
 extern int bad_rva, global_rva, bad_sample_count, total_function_sample_count;
 extern int arch_type_flag, objdump_len, bin_type;
@@ -71,7 +71,7 @@ typedef struct perf_file_section {
 	uint64_t size;
 }perf_file_section_data;
 
-enum {
+typedef enum {
         HEADER_RESERVED   = 0,
         HEADER_TRACE_INFO = 1,
         HEADER_BUILD_ID,
@@ -192,6 +192,12 @@ typedef struct {
 	size_t sz_sample_id_all;
 	int fd;
 	int needs_bswap; /* needs byte swapping for endianess */
+	char *map;          /* mmap'ed window of the file, NULL when using read() */
+	uint64_t map_pos;   /* file offset of the first byte of the window */
+	size_t map_len;     /* length of the current window */
+	size_t map_window;  /* window size, 0 = fall back to lseek()/read() */
+	uint64_t file_size;
+	int stream;         /* fd is a pipe: read() only, the data section ends at EOF */
 } bufdesc_t;
 
 typedef struct event_id * event_id_ptr;
@@ -236,7 +242,11 @@ struct perf_branch_entry {
        struct {
                uint64_t  mispredicted:1,       /* target mispredicted */
                             predicted:1,       /* target predicted */
-                            reserved:62;
+                            in_tx:1,           /* in transaction */
+                            abort:1,           /* transaction abort */
+                            cycles:16,         /* cycles since the previous branch, 0 if not timed */
+                            type:4,            /* branch type */
+                            reserved:40;
        };
 };
 
@@ -264,11 +274,55 @@ extern uint32_t pid_ker;
 extern int aggregate_func_list;
 extern char *subst_path_prefix[2];
 extern uint64_t * core_start_time, * core_last_time;
+extern int num_threads;
+
+//	kind of per RVA update, see increment_rva
+enum rva_update_type {
+	RVA_SAMPLE = 0,
+	RVA_RETURN,
+	RVA_CALL,
+	RVA_NEXT_TAKEN,
+	RVA_MEM,		/* index is the mem_src_type, target_rva the weight */
+	RVA_BRANCH,		/* taken LBR branch, index is 1 when it was mispredicted */
+	RVA_CYCLES,		/* timed LBR block, index is 1 for a loop iteration, target_rva the cycles */
+};
+
+//	what render_dot does with a graph, -r
+enum render_mode_type {
+	RENDER_ASYNC = 0,	/* dot -Tsvg on the render threads */
+	RENDER_DEFER,		/* append the command to spreadsheets/render.sh */
+	RENDER_NONE,		/* leave the .dot file */
+};
+extern int render_mode;
+extern long render_max_bytes;
+
+//	DWARF sections read by gooda_dwarf.c, see elf_debug_sections
+enum dwarf_section_type {
+	DWARF_INFO = 0,
+	DWARF_ABBREV,
+	DWARF_LINE,
+	DWARF_STR,
+	DWARF_LINE_STR,
+	DWARF_RANGES,
+	DWARF_RNGLISTS,
+	DWARF_ADDR,
+	DWARF_STR_OFFSETS,
+	NUM_DWARF_SECTION,
+};
+
+typedef struct elf_debug_struc{
+	unsigned char *	data[NUM_DWARF_SECTION];	/* NULL if the file has no such section */
+	uint64_t	size[NUM_DWARF_SECTION];
+	unsigned char *	inflated[NUM_DWARF_SECTION];	/* decompressed copies */
+	unsigned char *	base;
+	uint64_t	len;
+	}elf_debug_data;
 
 mmap_struc_ptr insert_mmap (mm_struc_ptr this_mm, char* filename, uint64_t this_time);
 void* insert_event_descriptions(int nr_attrs, int nr_ids, perf_file_attr_ptr attrs, event_id_ptr event_ids);
 mmap_struc_ptr find_mmap(mmap_struc_ptr pid_mmap_stack, mm_struc_ptr this_mm, char* filename, uint64_t new_time);
 mmap_struc_ptr bind_sample(uint32_t pid, uint64_t ip, uint64_t this_time);
+mmap_struc_ptr mmap_index_find(process_struc_ptr this_process, uint32_t pid, uint64_t ip, uint64_t new_time);
 thread_struc_ptr find_thread_struc(process_struc_ptr this_process, uint32_t tid);
 process_struc_ptr find_process_struc(uint32_t pid);
 process_struc_ptr find_principal_process(mmap_struc_ptr this_mmap);
@@ -277,7 +331,7 @@ module_struc_ptr bind_mmap(mmap_struc_ptr this_mmap);
 mmap_struc_ptr bind_sample(uint32_t pid, uint64_t ip, uint64_t this_time);
 process_struc_ptr insert_comm(comm_struc_ptr local_comm);
 process_struc_ptr insert_fork(fork_struc_ptr f);
-int     increment_module_struc(uint32_t pid, uint32_t tid, uint64_t ip, int this_event, int this_cpu, mmap_struc_ptr this_mmap, uint64_t time_enabled, uint64_t time_running);
+int     increment_module_struc(uint32_t pid, uint32_t tid, uint64_t ip, int this_event, int this_cpu, mmap_struc_ptr this_mmap, uint64_t time_enabled, uint64_t time_running, uint64_t weight, int mem_src);
 void  hotspot_function(pointer_data * global_func_list);
 void  src_trg_func_list(pointer_data * global_func_list);
 void  hotspot_call_graph(pointer_data * global_func_list);
@@ -286,9 +340,56 @@ void * hot_list(pointer_data * global_func_list);
 int func_asm(pointer_data * global_func_list, int index);
 void create_dir();
 void multiplex_correction();
-void quickSortIndex(index_data *arr, int elements);
+enum radix_key_type {
+	RADIX_KEY_U64 = 0,	/* uint64_t key */
+	RADIX_KEY_U32,		/* uint32_t key */
+	RADIX_KEY_INT,		/* int key, negative values first */
+};
+void radix_sort(void *base, int count, size_t size, size_t key_offset, int key_type);
+void radix_sort_threads(void *base, int count, size_t size, size_t key_offset, int key_type, int threads);
+void sort_u64(uint64_t *arr, int elements);
+void sort_pointer(pointer_data *arr, int elements);
+void sort_loc(function_loc_data *arr, int elements);
+void sort_index(index_data *arr, int elements);
 int increment_return(mmap_struc_ptr this_mmap, uint64_t source, uint64_t destination, mmap_struc_ptr target_mmap);
 int increment_call_site(mmap_struc_ptr this_mmap, uint64_t source, uint64_t destination, mmap_struc_ptr target_mmap);
 int increment_next_taken_site(mmap_struc_ptr this_mmap, uint64_t source, uint64_t next_branch, mmap_struc_ptr next_taken_mmap);
+int increment_branch_outcome(mmap_struc_ptr this_mmap, uint64_t source, int mispredict);
+int increment_block_cycles(mmap_struc_ptr this_mmap, uint64_t start, uint64_t cycles, int loop);
 uint64_t parse_elf_header(int fd);
+int elf_function_list(char *path, function_loc_data **list);
+char *elf_build_id(char *path);
+int elf_debug_sections(char *path, elf_debug_data *dbg);
+void elf_debug_release(elf_debug_data *dbg);
+extern char *symcache_dir;
+functionlist_struc_ptr symcache_load_functions(char *buildid);
+void symcache_store_functions(char *buildid, functionlist_struc_ptr this_functionlist);
+void symcache_check_build_id(char *path, char *buildid);
+void symcache_report(void);
+void *symcache_map(char *buildid, char *entry, size_t *len);
+FILE *symcache_create(char *buildid, char *entry, char **tmp_name);
+void symcache_commit(char *buildid, char *entry, char *tmp_name, FILE *out, int ok);
+void disasm_add_range(module_struc_ptr this_module, uint64_t base, uint64_t end);
+void disasm_run(void);
+FILE *disasm_open(module_struc_ptr this_module, uint64_t base, uint64_t end);
+void disasm_free(void);
+void render_dot(char *dot_file, char *svg_file);
+void render_finish(void);
+sample_struc_ptr find_rva_sample(module_struc_ptr this_module, uint64_t rva);
+function_loc_data *find_function_loc(module_struc_ptr this_module, uint64_t rva);
+void increment_rva(module_struc_ptr this_module, uint64_t rva, int index, int type, module_struc_ptr target_module, uint64_t target_rva);
+void branch_edge_lists(void);
+void shard_init(int n);
+void shard_push(module_struc_ptr this_module, uint64_t rva, int index, int type, module_struc_ptr target_module, uint64_t target_rva);
+void shard_sync(void);
+void shard_finish(void);
+void pool_run(int count, int n, void (*work)(int item, void *arg), void (*finish)(void *arg), void *arg);
+void cct_add(uint32_t pid, uint64_t this_time, uint64_t *chain, int len, int event, process_struc_ptr principal_process);
+void cct_report(void);
+extern int window_ms;
+void window_add(uint64_t sample_time, mmap_struc_ptr this_mmap, uint64_t ip, int event);
+void window_report(void);
+extern int lbr_any, lbr_ret, total_lbr_entries;
+void aggregate_write(char *path, uint64_t data_offset, uint64_t data_size);
+void aggregate_read(char *path, uint64_t data_offset, uint64_t data_size);
 
@@ -0,0 +1,484 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	time windowed profiles for Gooda
+//
+//	With --window ms every sample is also counted in the window its
+//	PERF_SAMPLE_TIME falls into, numbered from the first sample read and
+//	renumbered from the earliest one in the report. The counts are
+//	sparse: one row per (window, principal process, module, rva) that actually
+//	got a sample, holding one counter per event, in one open addressing table.
+//	Nothing is copied when a window closes, so samples that perf writes slightly
+//	out of time order still land in their own window.
+//	Function lists only exist once the analysis has run, so window_report
+//	folds the rva rows into per window process, module and function rows,
+//	the same way cct_report folds the calling context tree, and writes
+//	  spreadsheets/timeline_process.csv	window, start, process, counts
+//	  spreadsheets/timeline_module.csv	window, start, module, process, counts
+//	  spreadsheets/timeline_function.csv	window, start, function, module, process, counts
+//	with only the nonzero rows, in window order, plus spreadsheets/timeline.bin
+//	for the visualizer (all fields little endian, as written by the host):
+//	  char magic[8] "GOODATL1", uint32 version, uint32 num_events,
+//	  uint64 window_ns, uint64 first sample time, uint32 num_names, uint32 num_blocks
+//	  num_events event names, each uint16 length + bytes
+//	  num_names names, each uint8 level (0 process, 1 module, 2 function),
+//	    uint32 parent name (0xffffffff for processes), uint16 length + bytes
+//	  num_blocks index entries, one per nonempty window in increasing order,
+//	    uint32 window, uint32 rows, uint64 file offset of the rows
+//	  the rows, each uint32 name + num_events uint32 counts
+//	so a viewer can read the names and the index and then page in any window.
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+#include "gooda_log.h"
+
+#define WINDOW_LEVELS	3	/* process, module, function */
+
+typedef struct window_row_struc{
+	void *			owner;		/* module, principal process or function_loc_data */
+	void *			parent;
+	uint64_t		key;
+	int			window;
+	int			count[];	/* ncount counters */
+	}window_row_data;
+
+typedef struct window_table_struc{
+	char *			row;		/* rows, stride bytes apart, in insertion order */
+	int *			slot;		/* row index + 1, 0 marks an empty slot */
+	size_t			stride;
+	int			ncount;
+	int			size;
+	int			shift;
+	int			rows;
+	int			max_rows;
+	}window_table_data;
+
+int window_ms = 0;
+static uint64_t window_ns = 0, window_start = 0;
+static int window_first = 0, window_last = 0;
+static int window_samples = 0;
+static window_table_data rva_rows;
+
+static inline window_row_data *
+window_row(window_table_data *this_table, int index)
+{
+	return (window_row_data *)(this_table->row + (size_t)index*this_table->stride);
+}
+
+static void
+window_table_init(window_table_data *this_table, int ncount)
+{
+	memset(this_table, 0, sizeof(window_table_data));
+	this_table->ncount = ncount;
+	this_table->stride = (offsetof(window_row_data, count) + ncount*sizeof(int) + 7) & ~(size_t)7;
+}
+
+static void
+window_table_free(window_table_data *this_table)
+{
+	free(this_table->row);
+	free(this_table->slot);
+	window_table_init(this_table, this_table->ncount);
+}
+
+static inline int
+window_slot(window_table_data *this_table, int window, void *owner, void *parent, uint64_t key)
+{
+	uint64_t h;
+
+	h = (uint64_t)(uintptr_t)owner * 0x9E3779B97F4A7C15ULL;
+	h ^= (uint64_t)(uintptr_t)parent * 0xC2B2AE3D27D4EB4FULL;
+	h ^= key * 0x165667B19E3779F9ULL;
+	h ^= (uint64_t)(uint32_t)window * 0x27D4EB2F165667C5ULL;
+	h ^= h >> 29;
+	return (int)((h * 0x9E3779B97F4A7C15ULL) >> this_table->shift);
+}
+
+static void
+window_grow(window_table_data *this_table)
+{
+	window_row_data *this_row;
+	int i, index, mask;
+
+	if(this_table->size == 0)
+		{
+		this_table->size = 1024;
+		this_table->shift = 54;
+		}
+	else
+		{
+		this_table->size *= 2;
+		this_table->shift--;
+		}
+	free(this_table->slot);
+	this_table->slot = (int *)calloc(this_table->size, sizeof(int));
+	if(this_table->slot == NULL)
+		err(1,"failed to allocate time window table of %d slots",this_table->size);
+	mask = this_table->size - 1;
+	for(i = 0; i < this_table->rows; i++)
+		{
+		this_row = window_row(this_table, i);
+		index = window_slot(this_table, this_row->window, this_row->owner, this_row->parent, this_row->key);
+		while(this_table->slot[index] != 0)
+			index = (index + 1) & mask;
+		this_table->slot[index] = i + 1;
+		}
+}
+
+//	counters of the (window, owner, parent, key) row, created zeroed. The
+//	pointer is only good until the next call on this_table
+static int *
+window_count(window_table_data *this_table, int window, void *owner, void *parent, uint64_t key)
+{
+	window_row_data *this_row;
+	int index, mask, max_rows;
+
+	if(2*(this_table->rows + 1) > this_table->size)
+		window_grow(this_table);
+	mask = this_table->size - 1;
+	index = window_slot(this_table, window, owner, parent, key);
+	while(this_table->slot[index] != 0)
+		{
+		this_row = window_row(this_table, this_table->slot[index] - 1);
+		if((this_row->window == window) && (this_row->owner == owner) && (this_row->parent == parent) && (this_row->key == key))
+			return this_row->count;
+		index = (index + 1) & mask;
+		}
+	if(this_table->rows == this_table->max_rows)
+		{
+		max_rows = (this_table->max_rows == 0) ? 1024 : 2*this_table->max_rows;
+		this_table->row = (char *)realloc(this_table->row, (size_t)max_rows*this_table->stride);
+		if(this_table->row == NULL)
+			err(1,"failed to allocate %d time window rows",max_rows);
+		this_table->max_rows = max_rows;
+		}
+	this_row = window_row(this_table, this_table->rows);
+	memset(this_row, 0, this_table->stride);
+	this_row->window = window;
+	this_row->owner = owner;
+	this_row->parent = parent;
+	this_row->key = key;
+	this_table->slot[index] = ++this_table->rows;
+	return this_row->count;
+}
+
+//	count one sample, called from display_sample once the mmap is bound
+void
+window_add(uint64_t sample_time, mmap_struc_ptr this_mmap, uint64_t ip, int event)
+{
+	module_struc_ptr this_module = this_mmap->this_module;
+	int64_t window;
+	int *count;
+
+	if((window_ms == 0) || (event < 0) || (event >= num_events) || (this_module == NULL))
+		return;
+	if(window_ns == 0)
+		{
+		window_ns = (uint64_t)window_ms*1000000;
+		window_start = sample_time;
+		window_table_init(&rva_rows, num_events);
+		}
+//	perf only orders the samples within a round, earlier ones get negative windows
+	if(sample_time >= window_start)
+		window = (int64_t)((sample_time - window_start)/window_ns);
+	else
+		window = -(int64_t)((window_start - sample_time + window_ns - 1)/window_ns);
+	if(window > INT32_MAX)
+		window = INT32_MAX;
+	if(window < INT32_MIN)
+		window = INT32_MIN;
+	if(window < window_first)
+		window_first = (int)window;
+	if(window > window_last)
+		window_last = (int)window;
+	count = window_count(&rva_rows, (int)window, this_module, this_mmap->principal_process,
+		ip - this_mmap->addr + this_module->starting_ip);
+	count[event]++;
+	window_samples++;
+}
+
+static const char *
+window_name(int level, window_row_data *this_row)
+{
+	function_loc_data *this_func;
+
+	if(level == 0)
+		return ((process_struc_ptr)this_row->owner)->name;
+	if(level == 1)
+		return ((module_struc_ptr)this_row->owner)->path;
+	this_func = (function_loc_data *)this_row->owner;
+	if(this_func == NULL)
+		return "[unknown]";
+	if(this_func->this_function != NULL)
+		return this_func->this_function->function_name;
+	return this_func->name;
+}
+
+static FILE *
+window_csv(const char *file_name, const char *columns)
+{
+	FILE *list;
+	int k;
+
+	list = fopen(file_name, "w");
+	if(list == NULL)
+		{
+		fprintf(stderr,"window_report failed to open file %s\n",file_name);
+		return NULL;
+		}
+	fprintf(list,"[\n[, \"Window\", \"Start ms\", %s",columns);
+	for(k = 0; k < num_events; k++)fprintf(list," \"%s\",",event_list[k].name);
+	fprintf(list," ],\n");
+	return list;
+}
+
+static void
+window_csv_row(FILE *list, int level, window_row_data *this_row)
+{
+	module_struc_ptr this_module;
+	int k;
+
+	fprintf(list,"[, %d, %"PRIu64", \"%s\",",this_row->window,(uint64_t)this_row->window*window_ms,window_name(level, this_row));
+	if(level == 1)
+		fprintf(list," \"%s\",",((process_struc_ptr)this_row->parent)->name);
+	if(level == 2)
+		{
+		this_module = (module_struc_ptr)this_row->parent;
+		fprintf(list," \"%s\", \"%s\",",this_module->path,((process_struc_ptr)(uintptr_t)this_row->key)->name);
+		}
+	for(k = 0; k < num_events; k++)fprintf(list," %d,",this_row->count[k]);
+	fprintf(list," ],\n");
+}
+
+static void
+window_put(FILE *out, const void *data, size_t len)
+{
+	if(fwrite(data, 1, len, out) != len)
+		err(1,"failed to write time window timeline");
+}
+
+static void
+window_put_string(FILE *out, const char *str)
+{
+	size_t len = strlen(str);
+	uint16_t len16;
+
+	if(len > UINT16_MAX)
+		len = UINT16_MAX;
+	len16 = (uint16_t)len;
+	window_put(out, &len16, sizeof(len16));
+	window_put(out, str, len);
+}
+
+//	name ids for the timeline, the entity row's counter holds id + 1
+static uint32_t
+window_name_id(window_table_data *names, int level, window_row_data *this_row)
+{
+	int *id;
+
+	id = window_count(names, level, this_row->owner, this_row->parent, this_row->key);
+	if(*id == 0)
+		*id = names->rows;
+	return (uint32_t)(*id - 1);
+}
+
+static void
+window_timeline(const char *file_name, window_table_data *level_rows)
+{
+	window_table_data names;
+	window_row_data *this_row, *name_row, lookup;
+	uint32_t *row_name[WINDOW_LEVELS], parent, version = 1, value, num_names, num_blocks = 0, rows;
+	uint64_t offset, value64, first_time;
+	int level, window, i, pos[WINDOW_LEVELS];
+	uint8_t level8;
+	FILE *out;
+
+	out = fopen(file_name, "w");
+	if(out == NULL)
+		{
+		fprintf(stderr,"window_report failed to open file %s\n",file_name);
+		return;
+		}
+
+//	number the processes, modules and functions, parents first
+	window_table_init(&names, 1);
+	for(level = 0; level < WINDOW_LEVELS; level++)
+		{
+		row_name[level] = (uint32_t *)malloc((level_rows[level].rows + 1)*sizeof(uint32_t));
+		if(row_name[level] == NULL)
+			err(1,"failed to allocate time window name ids");
+		for(i = 0; i < level_rows[level].rows; i++)
+			{
+			this_row = window_row(&level_rows[level], i);
+			if(level > 0)
+				{
+				memset(&lookup, 0, sizeof(lookup));
+				lookup.owner = this_row->parent;
+				lookup.parent = (level == 1) ? NULL : (void *)(uintptr_t)this_row->key;
+				window_name_id(&names, level - 1, &lookup);
+				}
+			row_name[level][i] = window_name_id(&names, level, this_row);
+			}
+		}
+	for(i = 0; i < level_rows[0].rows; i++)
+		if((i == 0) || (window_row(&level_rows[0], i)->window != window_row(&level_rows[0], i-1)->window))
+			num_blocks++;
+	num_names = names.rows;
+
+	window_put(out, "GOODATL1", 8);
+	window_put(out, &version, sizeof(version));
+	value = num_events;
+	window_put(out, &value, sizeof(value));
+	window_put(out, &window_ns, sizeof(window_ns));
+	first_time = window_start - (uint64_t)(-(int64_t)window_first)*window_ns;
+	window_put(out, &first_time, sizeof(first_time));
+	window_put(out, &num_names, sizeof(num_names));
+	window_put(out, &num_blocks, sizeof(num_blocks));
+	for(i = 0; i < num_events; i++)
+		window_put_string(out, event_list[i].name);
+	for(i = 0; i < names.rows; i++)
+		{
+		name_row = window_row(&names, i);
+		level8 = (uint8_t)name_row->window;
+		parent = UINT32_MAX;
+		if(level8 > 0)
+			{
+			memset(&lookup, 0, sizeof(lookup));
+			lookup.owner = name_row->parent;
+			lookup.parent = (level8 == 1) ? NULL : (void *)(uintptr_t)name_row->key;
+			parent = window_name_id(&names, level8 - 1, &lookup);
+			}
+		window_put(out, &level8, sizeof(level8));
+		window_put(out, &parent, sizeof(parent));
+		window_put_string(out, window_name(level8, name_row));
+		}
+
+//	every window with a sample has a process row, so the process rows give the blocks
+	offset = (uint64_t)ftell(out) + (uint64_t)num_blocks*(2*sizeof(uint32_t) + sizeof(uint64_t));
+	for(level = 0; level < WINDOW_LEVELS; level++)
+		pos[level] = 0;
+	while(pos[0] < level_rows[0].rows)
+		{
+		window = window_row(&level_rows[0], pos[0])->window;
+		rows = 0;
+		for(level = 0; level < WINDOW_LEVELS; level++)
+			for(i = pos[level]; (i < level_rows[level].rows) && (window_row(&level_rows[level], i)->window == window); i++)
+				rows++;
+		value = (uint32_t)window;
+		window_put(out, &value, sizeof(value));
+		window_put(out, &rows, sizeof(rows));
+		window_put(out, &offset, sizeof(offset));
+		offset += (uint64_t)rows*(1 + num_events)*sizeof(uint32_t);
+		for(level = 0; level < WINDOW_LEVELS; level++)
+			while((pos[level] < level_rows[level].rows) && (window_row(&level_rows[level], pos[level])->window == window))
+				pos[level]++;
+		}
+//	then the rows, window by window
+	for(level = 0; level < WINDOW_LEVELS; level++)
+		pos[level] = 0;
+	while(pos[0] < level_rows[0].rows)
+		{
+		window = window_row(&level_rows[0], pos[0])->window;
+		for(level = 0; level < WINDOW_LEVELS; level++)
+			for(; (pos[level] < level_rows[level].rows) && (window_row(&level_rows[level], pos[level])->window == window); pos[level]++)
+				{
+				this_row = window_row(&level_rows[level], pos[level]);
+				window_put(out, &row_name[level][pos[level]], sizeof(uint32_t));
+				window_put(out, this_row->count, num_events*sizeof(uint32_t));
+				}
+		}
+	value64 = (uint64_t)ftell(out);
+	if(value64 != offset)
+		errx(1,"time window timeline is %"PRIu64" bytes, expected %"PRIu64,value64,offset);
+	fclose(out);
+
+	for(level = 0; level < WINDOW_LEVELS; level++)
+		free(row_name[level]);
+	window_table_free(&names);
+}
+
+//	fold the rva rows into process, module and function rows and write the
+//	time series tables, needs the function lists
+void
+window_report(void)
+{
+	window_table_data level_rows[WINDOW_LEVELS];
+	window_row_data *this_row;
+	module_struc_ptr this_module;
+	function_loc_data *this_func;
+	const char *file_name[WINDOW_LEVELS] = {
+		"./spreadsheets/timeline_process.csv",
+		"./spreadsheets/timeline_module.csv",
+		"./spreadsheets/timeline_function.csv"};
+	const char *columns[WINDOW_LEVELS] = {
+		"\"Process Path\",",
+		"\"Module Path\", \"Process Path\",",
+		"\"Function Name\", \"Module Path\", \"Process Path\","};
+	int *count[WINDOW_LEVELS];
+	int level, window, i, k;
+	FILE *list;
+
+	if(window_samples == 0)
+		return;
+	for(level = 0; level < WINDOW_LEVELS; level++)
+		window_table_init(&level_rows[level], num_events);
+	for(i = 0; i < rva_rows.rows; i++)
+		{
+		this_row = window_row(&rva_rows, i);
+		this_module = (module_struc_ptr)this_row->owner;
+		this_func = find_function_loc(this_module, this_row->key);
+		window = this_row->window - window_first;
+		count[0] = window_count(&level_rows[0], window, this_row->parent, NULL, 0);
+		count[1] = window_count(&level_rows[1], window, this_module, this_row->parent, 0);
+		count[2] = window_count(&level_rows[2], window, this_func, this_module, (uint64_t)(uintptr_t)this_row->parent);
+		for(level = 0; level < WINDOW_LEVELS; level++)
+			for(k = 0; k < num_events; k++)
+				count[level][k] += this_row->count[k];
+		}
+	gooda_log(GLOG_INFO,"time windows: %d samples in %d windows of %d ms, %d rva, %d process, %d module, %d function rows\n",
+		window_samples, window_last - window_first + 1, window_ms, rva_rows.rows, level_rows[0].rows, level_rows[1].rows, level_rows[2].rows);
+	if(window_last == window_first)
+		gooda_log(GLOG_WARN,"time windows: all samples are in the first window, is PERF_SAMPLE_TIME recorded?\n");
+	window_table_free(&rva_rows);
+
+//	stable, so the rows of a window stay in the order they were first seen
+	for(level = 0; level < WINDOW_LEVELS; level++)
+		{
+		radix_sort(level_rows[level].row, level_rows[level].rows, level_rows[level].stride,
+			offsetof(window_row_data, window), RADIX_KEY_INT);
+		list = window_csv(file_name[level], columns[level]);
+		if(list == NULL)
+			continue;
+		for(i = 0; i < level_rows[level].rows; i++)
+			window_csv_row(list, level, window_row(&level_rows[level], i));
+		fprintf(list,"]\n");
+		fclose(list);
+		}
+	window_timeline("./spreadsheets/timeline.bin", level_rows);
+	for(level = 0; level < WINDOW_LEVELS; level++)
+		window_table_free(&level_rows[level]);
+}
@@ -5,10 +5,17 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <byteswap.h>
+#include <endian.h>
+#include <string.h>
+#include <err.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
 #include "perf_event.h"
 #include "gooda.h"
 #include "perf_gooda.h"
 #include "gooda_util.h"
+#include "gooda_log.h"
 
 #define EI_NIDENT 16
 #define ELFMAG0		0x7f		/* Magic number byte 0 */
@@ -235,7 +242,7 @@ parse_elf_header(int fd)
 		warnx("not an ELF file");
 		return -1;
 	}
-#ifdef LITTLE_ENDIAN
+#if __BYTE_ORDER == __LITTLE_ENDIAN
 	if (ident[EI_DATA] == ELFDATA2MSB)
 		needs_swap = 1;	
 #else
@@ -269,3 +276,526 @@ parse_elf_header(int fd)
 	return addr;
 }
 
+
+//	function symbols straight from .symtab and .dynsym, replacing the
+//	readelf -s -W, readelf -e | grep and readelf -x .opd pipes in get_functionlist
+
+typedef struct {
+	uint32_t sh_name;
+	uint32_t sh_type;
+	uint32_t sh_flags;
+	uint32_t sh_addr;
+	uint32_t sh_offset;
+	uint32_t sh_size;
+	uint32_t sh_link;
+	uint32_t sh_info;
+	uint32_t sh_addralign;
+	uint32_t sh_entsize;
+} Elf32_Shdr;
+
+typedef struct {
+  uint32_t sh_name;		/* Section name (string tbl index) */
+  uint32_t sh_type;		/* Section type */
+  uint64_t sh_flags;		/* Section flags */
+  uint64_t sh_addr;		/* Section virtual addr at execution */
+  uint64_t sh_offset;		/* Section file offset */
+  uint64_t sh_size;		/* Section size in bytes */
+  uint32_t sh_link;		/* Link to another section */
+  uint32_t sh_info;		/* Additional section information */
+  uint64_t sh_addralign;	/* Section alignment */
+  uint64_t sh_entsize;		/* Entry size if section holds table */
+} Elf64_Shdr;
+
+typedef struct {
+	uint32_t st_name;
+	uint32_t st_value;
+	uint32_t st_size;
+	unsigned char st_info;
+	unsigned char st_other;
+	uint16_t st_shndx;
+} Elf32_Sym;
+
+typedef struct {
+  uint32_t st_name;		/* Symbol name (string tbl index) */
+  unsigned char st_info;	/* Symbol type and binding */
+  unsigned char st_other;	/* Symbol visibility */
+  uint16_t st_shndx;		/* Section index */
+  uint64_t st_value;		/* Symbol value */
+  uint64_t st_size;		/* Symbol size */
+} Elf64_Sym;
+
+#define EM_ARM		40
+#define EM_PPC64	21
+#define EM_X86_64	62
+
+#define SHT_SYMTAB	2
+#define SHT_NOTE	7
+#define SHT_NOBITS	8
+#define SHT_DYNSYM	11
+#define SHN_UNDEF	0
+#define SHN_LORESERVE	0xff00
+#define SHN_XINDEX	0xffff
+
+#define NT_GNU_BUILD_ID	3
+
+#define ET_REL		1
+#define SHF_COMPRESSED	0x800
+#define ELFCOMPRESS_ZLIB	1
+
+#define STT_FUNC	2
+#define STB_LOCAL	0
+#define STB_GLOBAL	1
+#define STB_WEAK	2
+#define STB_GNU_UNIQUE	10
+
+//	section header fields common to both classes
+typedef struct {
+	uint32_t	name;
+	uint32_t	type;
+	uint32_t	link;
+	uint64_t	flags;
+	uint64_t	addr;
+	uint64_t	offset;
+	uint64_t	size;
+	uint64_t	entsize;
+} elf_section_data;
+
+//	the mapped file and how to read it
+typedef struct {
+	unsigned char *	base;
+	uint64_t	len;
+	int		is64;
+	int		needs_swap;
+} elf_image_data;
+
+static uint16_t
+elf_16(elf_image_data *img, uint16_t val)
+{
+	return img->needs_swap ? bswap_16(val) : val;
+}
+
+static uint32_t
+elf_32(elf_image_data *img, uint32_t val)
+{
+	return img->needs_swap ? bswap_32(val) : val;
+}
+
+static uint64_t
+elf_64(elf_image_data *img, uint64_t val)
+{
+	return img->needs_swap ? bswap_64(val) : val;
+}
+
+static int
+elf_section(elf_image_data *img, uint64_t shoff, int index, elf_section_data *sec)
+{
+	Elf32_Shdr shdr32;
+	Elf64_Shdr shdr64;
+	uint64_t o;
+
+	o = shoff + (uint64_t)index*(img->is64 ? sizeof(shdr64) : sizeof(shdr32));
+	if(o + (img->is64 ? sizeof(shdr64) : sizeof(shdr32)) > img->len)
+		return -1;
+	if(img->is64)
+		{
+		memcpy(&shdr64, img->base + o, sizeof(shdr64));
+		sec->name = elf_32(img, shdr64.sh_name);
+		sec->type = elf_32(img, shdr64.sh_type);
+		sec->link = elf_32(img, shdr64.sh_link);
+		sec->flags = elf_64(img, shdr64.sh_flags);
+		sec->addr = elf_64(img, shdr64.sh_addr);
+		sec->offset = elf_64(img, shdr64.sh_offset);
+		sec->size = elf_64(img, shdr64.sh_size);
+		sec->entsize = elf_64(img, shdr64.sh_entsize);
+		}
+	else
+		{
+		memcpy(&shdr32, img->base + o, sizeof(shdr32));
+		sec->name = elf_32(img, shdr32.sh_name);
+		sec->type = elf_32(img, shdr32.sh_type);
+		sec->link = elf_32(img, shdr32.sh_link);
+		sec->flags = elf_32(img, shdr32.sh_flags);
+		sec->addr = elf_32(img, shdr32.sh_addr);
+		sec->offset = elf_32(img, shdr32.sh_offset);
+		sec->size = elf_32(img, shdr32.sh_size);
+		sec->entsize = elf_32(img, shdr32.sh_entsize);
+		}
+	if((sec->type != SHT_NOBITS) && (sec->offset + sec->size > img->len))
+		return -1;
+	return 0;
+}
+
+//	map path read only, 0 if it is an ELF file
+static int
+elf_map(char *path, elf_image_data *img)
+{
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if(fd == -1)
+		return -1;
+	if((fstat(fd, &st) == -1) || (st.st_size < (off_t)sizeof(Elf64_Ehdr)))
+		{
+		close(fd);
+		return -1;
+		}
+	img->len = (uint64_t)st.st_size;
+	img->base = mmap(NULL, img->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(img->base == MAP_FAILED)
+		{
+		warnx("cannot map %s", path);
+		return -1;
+		}
+	if(memcmp(img->base, ELFMAG, 4) != 0)
+		{
+		munmap(img->base, img->len);
+		return -1;
+		}
+	img->is64 = (img->base[EI_CLASS] == ELFCLASS64);
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+	img->needs_swap = (img->base[EI_DATA] == ELFDATA2MSB);
+#else
+	img->needs_swap = (img->base[EI_DATA] == ELFDATA2LSB);
+#endif
+	return 0;
+}
+
+static void
+elf_header(elf_image_data *img, uint16_t *machine, uint64_t *shoff, int *shnum, int *shstrndx)
+{
+	Elf32_Ehdr *hdr32 = (Elf32_Ehdr *)img->base;
+	Elf64_Ehdr *hdr64 = (Elf64_Ehdr *)img->base;
+
+	if(img->is64)
+		{
+		*machine = elf_16(img, hdr64->e_machine);
+		*shoff = elf_64(img, hdr64->e_shoff);
+		*shnum = elf_16(img, hdr64->e_shnum);
+		*shstrndx = elf_16(img, hdr64->e_shstrndx);
+		}
+	else
+		{
+		*machine = elf_16(img, hdr32->e_machine);
+		*shoff = elf_32(img, hdr32->e_shoff);
+		*shnum = elf_16(img, hdr32->e_shnum);
+		*shstrndx = elf_16(img, hdr32->e_shstrndx);
+		}
+}
+
+static const char *
+elf_bind_name(int bind)
+{
+	switch(bind) {
+	case STB_LOCAL:		return "LOCAL";
+	case STB_GLOBAL:	return "GLOBAL";
+	case STB_WEAK:		return "WEAK";
+	case STB_GNU_UNIQUE:	return "UNIQUE";
+	}
+	return "OTHER";
+}
+
+//	fill *list with the sized FUNC symbols of path, unsorted, names in one block
+//	returns the number of functions, 0 when the file is not an ELF for the
+//	sampled architecture or has no function symbols
+int
+elf_function_list(char *path, function_loc_data **list)
+{
+	elf_image_data img;
+	elf_section_data sec, strsec, shstr, *secs;
+	Elf32_Sym sym32;
+	Elf64_Sym sym64;
+	function_loc_data *funcs = NULL;
+	uint64_t shoff, value, size, entsize, nsym, o, opd_val;
+	uint32_t name;
+	uint16_t machine, shndx;
+	int shnum, shstrndx, expected, i, pass, num_func = 0, info;
+	size_t names_len = 0, len;
+	char *names = NULL, *sym_name;
+	const char *sec_name;
+
+	*list = NULL;
+	if(elf_map(path, &img) != 0)
+		return 0;
+	elf_header(&img, &machine, &shoff, &shnum, &shstrndx);
+
+//	same test as grepping readelf -e for the machine name of the perf.data arch
+	expected = EM_X86_64;
+	if(arch_type_flag == 1)expected = EM_ARM;
+	if(arch_type_flag == 2)expected = EM_PPC64;
+	if(machine != expected)
+		{
+		gooda_log(GLOG_VERBOSE," module %s is machine %d, expected %d\n", path, machine, expected);
+		goto out;
+		}
+	if(shoff == 0)
+		goto out;
+//	extended section numbering keeps the real counts in section 0
+	if((shnum == 0) || (shstrndx == SHN_XINDEX))
+		{
+		if(elf_section(&img, shoff, 0, &sec) != 0)
+			goto out;
+		if(shnum == 0)shnum = (int)sec.size;
+		if(shstrndx == SHN_XINDEX)shstrndx = sec.link;
+		}
+	secs = (elf_section_data *)malloc(shnum*sizeof(elf_section_data));
+	if(secs == NULL)
+		err(1,"failed to malloc %d section headers for %s",shnum,path);
+	for(i = 0; i < shnum; i++)
+		if(elf_section(&img, shoff, i, &secs[i]) != 0)
+			{
+			warnx("bad section header %d in %s", i, path);
+			free(secs);
+			goto out;
+			}
+	if(shstrndx < shnum)
+		shstr = secs[shstrndx];
+	else
+		memset(&shstr, 0, sizeof(shstr));
+
+//	pass 0 counts the functions and the name space, pass 1 fills the list
+	for(pass = 0; pass < 2; pass++)
+		{
+		if(pass == 1)
+			{
+			if(num_func == 0)
+				break;
+			funcs = (function_loc_data *)calloc(num_func, sizeof(function_loc_data));
+			names = (char *)malloc(names_len);
+			if((funcs == NULL) || (names == NULL))
+				err(1,"failed to malloc function list of %d entries for %s",num_func,path);
+			num_func = 0;
+			names_len = 0;
+			}
+		for(i = 0; i < shnum; i++)
+			{
+			if((secs[i].type != SHT_SYMTAB) && (secs[i].type != SHT_DYNSYM))
+				continue;
+			if(secs[i].link >= shnum)
+				continue;
+			strsec = secs[secs[i].link];
+			entsize = img.is64 ? sizeof(Elf64_Sym) : sizeof(Elf32_Sym);
+			nsym = secs[i].size/entsize;
+			for(o = secs[i].offset; nsym > 0; nsym--, o += entsize)
+				{
+				if(img.is64)
+					{
+					memcpy(&sym64, img.base + o, sizeof(sym64));
+					name = elf_32(&img, sym64.st_name);
+					info = sym64.st_info;
+					shndx = elf_16(&img, sym64.st_shndx);
+					value = elf_64(&img, sym64.st_value);
+					size = elf_64(&img, sym64.st_size);
+					}
+				else
+					{
+					memcpy(&sym32, img.base + o, sizeof(sym32));
+					name = elf_32(&img, sym32.st_name);
+					info = sym32.st_info;
+					shndx = elf_16(&img, sym32.st_shndx);
+					value = elf_32(&img, sym32.st_value);
+					size = elf_32(&img, sym32.st_size);
+					}
+				if(((info & 0xf) != STT_FUNC) || (shndx == SHN_UNDEF) || ((uint32_t)size == 0))
+					continue;
+				if(name >= strsec.size)
+					continue;
+				sym_name = (char *)img.base + strsec.offset + name;
+				len = strnlen(sym_name, strsec.size - name);
+				if(pass == 0)
+					{
+					num_func++;
+					names_len += len + 1;
+					continue;
+					}
+//				PPC64 ELFv1 function symbols point at their .opd descriptor,
+//				whose first word is the entry address
+				if((shndx < shnum) && (shndx < SHN_LORESERVE) && (shstr.size > secs[shndx].name))
+					{
+					sec_name = (char *)img.base + shstr.offset + secs[shndx].name;
+					if((strcmp(sec_name, ".opd") == 0) && (value >= secs[shndx].addr) &&
+						(value - secs[shndx].addr + 8 <= secs[shndx].size))
+						{
+						memcpy(&opd_val, img.base + secs[shndx].offset + (value - secs[shndx].addr), sizeof(opd_val));
+						value = elf_64(&img, opd_val);
+						}
+					}
+				memcpy(names + names_len, sym_name, len);
+				names[names_len + len] = '\0';
+				funcs[num_func].name = names + names_len;
+				funcs[num_func].bind = (char *)elf_bind_name(info >> 4);
+				funcs[num_func].base = value & addr_mask;
+				funcs[num_func].len = (uint32_t)size;
+				names_len += len + 1;
+				num_func++;
+				}
+			}
+		}
+	free(secs);
+	if(num_func > 0)
+		*list = funcs;
+out:
+	munmap(img.base, img.len);
+	return num_func;
+}
+
+//	NT_GNU_BUILD_ID of path as a malloc'ed hex string, NULL if it has none
+char *
+elf_build_id(char *path)
+{
+	elf_image_data img;
+	elf_section_data sec;
+	uint64_t shoff, o, end;
+	uint32_t namesz, descsz, type, word;
+	uint16_t machine;
+	int shnum, shstrndx, i, j;
+	char *id = NULL;
+
+	if(elf_map(path, &img) != 0)
+		return NULL;
+	elf_header(&img, &machine, &shoff, &shnum, &shstrndx);
+	if((shoff != 0) && (shnum == 0) && (elf_section(&img, shoff, 0, &sec) == 0))
+		shnum = (int)sec.size;
+	for(i = 0; (shoff != 0) && (i < shnum) && (id == NULL); i++)
+		{
+		if((elf_section(&img, shoff, i, &sec) != 0) || (sec.type != SHT_NOTE))
+			continue;
+		o = sec.offset;
+		end = sec.offset + sec.size;
+//		notes are namesz, descsz, type, then name and desc each padded to 4 bytes
+		while((id == NULL) && (o + 12 <= end))
+			{
+			memcpy(&word, img.base + o, 4);
+			namesz = elf_32(&img, word);
+			memcpy(&word, img.base + o + 4, 4);
+			descsz = elf_32(&img, word);
+			memcpy(&word, img.base + o + 8, 4);
+			type = elf_32(&img, word);
+			o += 12;
+			if((namesz > end - o) || (descsz > end - o - ((namesz + 3) & ~3)))
+				break;
+			if((type == NT_GNU_BUILD_ID) && (namesz == 4) && (memcmp(img.base + o, "GNU", 4) == 0) && (descsz > 0))
+				{
+				id = (char *)malloc(2*descsz + 1);
+				if(id == NULL)
+					err(1,"failed to malloc build id for %s",path);
+				for(j = 0; j < descsz; j++)
+					sprintf(id + 2*j, "%02x", img.base[o + ((namesz + 3) & ~3) + j]);
+				}
+			o += ((namesz + 3) & ~3) + ((descsz + 3) & ~3);
+			}
+		}
+	munmap(img.base, img.len);
+	return id;
+}
+
+static char *dwarf_section_name[NUM_DWARF_SECTION] = {
+	".debug_info", ".debug_abbrev", ".debug_line", ".debug_str", ".debug_line_str",
+	".debug_ranges", ".debug_rnglists", ".debug_addr", ".debug_str_offsets"};
+
+//	section contents, inflating SHF_COMPRESSED sections
+static int
+elf_debug_section(elf_image_data *img, elf_section_data *sec, elf_debug_data *dbg, int k)
+{
+	unsigned char *p = img->base + sec->offset;
+	uint32_t ch_type, word;
+	uint64_t ch_size, hdr_len;
+	uLongf out_len;
+
+	if(sec->type == SHT_NOBITS)
+		return -1;
+	if((sec->flags & SHF_COMPRESSED) == 0)
+		{
+		dbg->data[k] = p;
+		dbg->size[k] = sec->size;
+		return 0;
+		}
+	hdr_len = img->is64 ? 24 : 12;
+	if(sec->size < hdr_len)
+		return -1;
+	memcpy(&word, p, 4);
+	ch_type = elf_32(img, word);
+	if(img->is64)
+		{
+		memcpy(&ch_size, p + 8, 8);
+		ch_size = elf_64(img, ch_size);
+		}
+	else
+		{
+		memcpy(&word, p + 4, 4);
+		ch_size = elf_32(img, word);
+		}
+	if(ch_type != ELFCOMPRESS_ZLIB)
+		return -1;
+	dbg->inflated[k] = (unsigned char *)malloc(ch_size + 1);
+	if(dbg->inflated[k] == NULL)
+		err(1,"failed to malloc %"PRIu64" bytes for %s",ch_size,dwarf_section_name[k]);
+	out_len = ch_size;
+	if((uncompress(dbg->inflated[k], &out_len, p + hdr_len, sec->size - hdr_len) != Z_OK) || (out_len != ch_size))
+		return -1;
+	dbg->data[k] = dbg->inflated[k];
+	dbg->size[k] = ch_size;
+	return 0;
+}
+
+//	map the DWARF sections of path for gooda_dwarf.c, 0 on success
+//	only linked, host byte order files are handled, the caller falls back to
+//	libbfd for anything else
+int
+elf_debug_sections(char *path, elf_debug_data *dbg)
+{
+	elf_image_data img;
+	elf_section_data sec, shstr;
+	uint64_t shoff;
+	uint16_t machine, e_type;
+	int shnum, shstrndx, i, k;
+	const char *sec_name;
+
+	memset(dbg, 0, sizeof(elf_debug_data));
+	if(elf_map(path, &img) != 0)
+		return -1;
+	dbg->base = img.base;
+	dbg->len = img.len;
+	elf_header(&img, &machine, &shoff, &shnum, &shstrndx);
+	memcpy(&e_type, img.base + 16, 2);
+	if(img.needs_swap || (e_type == ET_REL) || (shoff == 0))
+		goto bad;
+	if((shnum == 0) || (shstrndx == SHN_XINDEX))
+		{
+		if(elf_section(&img, shoff, 0, &sec) != 0)
+			goto bad;
+		if(shnum == 0)shnum = (int)sec.size;
+		if(shstrndx == SHN_XINDEX)shstrndx = sec.link;
+		}
+	if((shstrndx >= shnum) || (elf_section(&img, shoff, shstrndx, &shstr) != 0))
+		goto bad;
+	for(i = 0; i < shnum; i++)
+		{
+		if((elf_section(&img, shoff, i, &sec) != 0) || (sec.name >= shstr.size))
+			goto bad;
+		sec_name = (char *)img.base + shstr.offset + sec.name;
+		for(k = 0; k < NUM_DWARF_SECTION; k++)
+			if((dbg->data[k] == NULL) && (strcmp(sec_name, dwarf_section_name[k]) == 0))
+				if(elf_debug_section(&img, &sec, dbg, k) != 0)
+					goto bad;
+		}
+	if((dbg->data[DWARF_INFO] == NULL) || (dbg->data[DWARF_ABBREV] == NULL) || (dbg->data[DWARF_LINE] == NULL))
+		goto bad;
+	return 0;
+bad:
+	elf_debug_release(dbg);
+	return -1;
+}
+
+void
+elf_debug_release(elf_debug_data *dbg)
+{
+	int k;
+
+	for(k = 0; k < NUM_DWARF_SECTION; k++)
+		free(dbg->inflated[k]);
+	if(dbg->base != NULL)
+		munmap(dbg->base, dbg->len);
+	memset(dbg, 0, sizeof(elf_debug_data));
+}
@@ -0,0 +1,199 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	stand alone check and benchmark for gooda_mmap.c. It builds process mmap
+//	stacks of shared libraries, with a heap sized mapping at the bottom of the
+//	address space, with overlapping remaps of different ages and with mmaps
+//	inherited from a parent pid, then looks up random ips at random times
+//	through the old linear walk of first_mmap from bind_sample and through
+//	mmap_index_find. Every lookup must return the same mmap, and the time of
+//	each is reported.
+//
+//	make mmap_index_bench
+//	./mmap_index_bench [mmaps [lookups]]
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+
+#define BENCH_PID	100
+#define PARENT_PID	99
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + 1.0e-6*(double)tv.tv_usec;
+}
+
+static uint64_t
+next_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+//	the walk of first_mmap bind_sample did before the index
+static mmap_struc_ptr
+linear_find(process_struc_ptr this_process, uint32_t pid, uint64_t ip, uint64_t new_time)
+{
+	mmap_struc_ptr this_mmap;
+
+	for(this_mmap = this_process->first_mmap; this_mmap != NULL; this_mmap = this_mmap->next)
+		if((this_mmap->pid == pid) && (this_mmap->addr < ip) && (this_mmap->len > ip - this_mmap->addr)
+			&& (this_mmap->time < new_time))
+			return this_mmap;
+	return NULL;
+}
+
+//	count mmaps pushed on the stack, the last one pushed on top with the largest stamp
+static void
+make_stack(process_struc_ptr this_process, int count, int layout, uint64_t *state)
+{
+	mmap_struc_ptr this_mmap;
+	uint64_t base = 0x7f0000000000ULL;
+	int i;
+
+	for(i = 0; i < count; i++)
+		{
+		this_mmap = calloc(1, sizeof(mmap_data));
+		if(this_mmap == NULL)
+			err(1,"failed to allocate mmap %d",i);
+		this_mmap->pid = BENCH_PID;
+		this_mmap->time = next_rand(state) % 1000;
+		if((i == 0) && (layout != 1))
+			{
+//			heap or large anonymous region below every library
+			this_mmap->addr = 0x1000;
+			this_mmap->len = base;
+			}
+		else if(layout == 1)
+			{
+//			dlopen and dlclose cycles, each address covered by a few remaps
+			this_mmap->addr = 0x400000 + 0x1000*(next_rand(state) % (uint64_t)(2*count + 1));
+			this_mmap->len = 0x1000*(1 + next_rand(state) % 16);
+			}
+		else
+			{
+			this_mmap->addr = base;
+			this_mmap->len = 0x1000*(1 + next_rand(state) % 512);
+			base += this_mmap->len + 0x1000*(next_rand(state) % 4);
+			}
+		if((layout == 2) && ((next_rand(state) % 8) == 0))
+			this_mmap->pid = PARENT_PID;
+		this_mmap->stamp = i + 1;
+		this_mmap->next = this_process->first_mmap;
+		if(this_process->first_mmap != NULL)
+			this_process->first_mmap->previous = this_mmap;
+		this_process->first_mmap = this_mmap;
+		}
+	this_process->mmap_generation++;
+}
+
+int
+main(int argc, char **argv)
+{
+	static const char *layout_name[] = {"libraries", "remapped", "inherited"};
+	process_data this_process_data;
+	process_struc_ptr this_process = &this_process_data;
+	mmap_struc_ptr this_mmap, next_mmap, expect;
+	uint64_t state = 0x2545F4914F6CDD1DULL, lo_ip, hi_ip, *ip, *when;
+	int count = 2000, lookups = 1000000, layout, i, found;
+	double t0, t_linear, t_index;
+
+	if(argc > 1)count = atoi(argv[1]);
+	if(argc > 2)lookups = atoi(argv[2]);
+	if((count < 1) || (lookups < 1))
+		errx(1,"usage: %s [mmaps [lookups]]",argv[0]);
+	ip = malloc(lookups*sizeof(uint64_t));
+	when = malloc(lookups*sizeof(uint64_t));
+	if((ip == NULL) || (when == NULL))
+		err(1,"failed to allocate %d lookups",lookups);
+
+	printf("%10s %10s %10s %12s %12s\n","layout","mmaps","bound","linear ms","index ms");
+	for(layout = 0; layout < 3; layout++)
+		{
+		memset(this_process, 0, sizeof(process_data));
+		this_process->pid = BENCH_PID;
+		make_stack(this_process, count, layout, &state);
+		lo_ip = ~0ULL;
+		hi_ip = 0;
+		for(this_mmap = this_process->first_mmap; this_mmap != NULL; this_mmap = this_mmap->next)
+			{
+			if(this_mmap->addr < lo_ip)lo_ip = this_mmap->addr;
+			if(this_mmap->addr + this_mmap->len > hi_ip)hi_ip = this_mmap->addr + this_mmap->len;
+			}
+		for(i = 0; i < lookups; i++)
+			{
+//			mostly library text, some heap and some unmapped addresses
+			if((layout != 1) && ((next_rand(&state) % 4) != 0))
+				ip[i] = 0x7f0000000000ULL + next_rand(&state) % (hi_ip - 0x7f0000000000ULL + 0x10000);
+			else
+				ip[i] = lo_ip + next_rand(&state) % (hi_ip - lo_ip + 0x10000);
+			when[i] = next_rand(&state) % 1100;
+			}
+
+		found = 0;
+		t0 = now();
+		for(i = 0; i < lookups; i++)
+			if(linear_find(this_process, BENCH_PID, ip[i], when[i]) != NULL)
+				found++;
+		t_linear = now() - t0;
+
+		t0 = now();
+		for(i = 0; i < lookups; i++)
+			mmap_index_find(this_process, BENCH_PID, ip[i], when[i]);
+		t_index = now() - t0;
+
+		for(i = 0; i < lookups; i++)
+			{
+			expect = linear_find(this_process, BENCH_PID, ip[i], when[i]);
+			if(mmap_index_find(this_process, BENCH_PID, ip[i], when[i]) != expect)
+				errx(1,"%s layout: ip 0x%"PRIx64" at time %"PRIu64" bound to a different mmap than the linear walk",
+					layout_name[layout],ip[i],when[i]);
+			}
+		printf("%10s %10d %9.1f%% %12.3f %12.3f\n",layout_name[layout],count,100.0*found/lookups,
+			1.0e3*t_linear,1.0e3*t_index);
+
+		for(this_mmap = this_process->first_mmap; this_mmap != NULL; this_mmap = next_mmap)
+			{
+			next_mmap = this_mmap->next;
+			free(this_mmap);
+			}
+		free(this_process->mmap_index);
+		free(this_process->mmap_index_end);
+		}
+	free(ip);
+	free(when);
+	return 0;
+}
@@ -14,376 +14,1721 @@ See the License for the specific language governing permissions and
 limitations under the License.
 
  */
+
+//	multi_perf, merge the profiles of many Gooda runs
+//
+//	The inputs are either all report directories, whose spreadsheets/process.csv
+//	and function_hotspots.csv are merged into output/spreadsheets, or all
+//	--aggregate files, merged into one aggregate file that gooda --from-aggregate
+//	turns into a full report with the perf.data of the first input.
+//
+//	The merge is a tree. The inputs are taken fan_in at a time (-f), each group
+//	is merged into a temporary result under ./multi_perf.XXXXXX and the groups
+//	of one level run on -j threads. The results are merged the same way until
+//	one group is left, so a thread never has more than fan_in inputs open.
+//	Within a group every input is sorted by key and the sorted inputs are
+//	combined by a k-way merge, rows with the same key add up.
+//
+//	Report tables: processes are aligned by name, modules by path within their
+//	process and functions by (module, offset, name, process), the reports carry
+//	no build-id so the name stands in for it. Event columns are matched by name
+//	and the counts of each input are scaled by its multiplex over the first
+//	input's, as gooda_sum.py did. Merged tables are in the same format and are
+//	ordered by their first column, the functions are renumbered in that order.
+//
+//	Aggregates: processes are aligned by name, modules by (path, build-id)
+//	within their process, rvas by address and LBR branches by (type, target
+//	module, address). Counters, totals, LBR outcomes, memory and block latency
+//	profiles add up, the multiplex correction of each counter is the count
+//	weighted mean of the inputs. All inputs must have the same events and
+//	topology and the merged file keeps the perf.data fingerprint of the first.
+//	gooda loads it with the binaries of the first run and refuses modules
+//	whose build-id differs from the one that run recorded.
+
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <stdarg.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <inttypes.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
+#include <ctype.h>
+#include <math.h>
 #include <getopt.h>
-#include <sys/stat.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <err.h>
 #include "perf_event.h"
 #include "gooda.h"
 #include "perf_gooda.h"
 #include "gooda_util.h"
+#include "gooda_aggregate.h"
 
-typedef struct properties * properties_ptr;
-
-typedef struct properties{
-	char*	arch;
-	char*	cpu_desc;
-	char*	path;
-	int	family;
-	int	model;
-	int	num_col;
-	int 	num_cores;
-	int	num_sockets;
-	int	num_fixed;
-	int	num_ordered;
-	int	num_branch;
-	int	num_sub_branch;
-	} properties_data;
-	
-typedef struct csv_field_pointer * csv_field_pointer_ptr;
-
-typedef struct csv_field_pointer{
-	csv_field_pointer_ptr	next;
-	csv_field_pointer_ptr	previous;
-	char *			csv_field;
-	}csv_field_pointer_data;
+#define MERGE_REPORT	1
+#define MERGE_AGGREGATE	2
 
+#define CSV_PROCESS	0
+#define CSV_FUNCTION	1
 
 char prop_str[] = "platform_properties.txt";
 char func_str[] = "function_hotspots.csv";
 char proc_str[] = "process.csv";
 char spreadsheets[] = "/spreadsheets/";
-int prop_len=23,func_len=21, proc_len=11, spread_len=14;
-
-int dbg_count = 0;
-
-properties_data * input_properties;
-event_order_struc_ptr *input_order, global_event_order;
-
-char*
-extract_input_string(char* instr, char key, int index, int* next)
-{
-	int i,j,k,len;
-	char* ret_string;
-
-	len = strlen(instr);
-	i = 0;
-	while((instr[i] != key) && (i <= len))i++;
-	if(i == len)
-		err(1,"unrecognized input string in read_platform_properties for index = %d, string = %s",index,instr);
-	j=i+1;
-	while((instr[j] != '\n') && (instr[j] != ',') && (j <= len))j++;
-	*next = j+1;
-	len = j - i - 1;
-	ret_string = malloc(len+1);
-	if(ret_string == NULL)
-		err(1,"extract_input_string failled to malloc return string of length %d for processing %s",len,instr);
-	strncpy(ret_string,&instr[i+1],len);
-	ret_string[len]='\0';
-//	fprintf(stderr," address of instr = %p, i = %d, j = %d, return_string = %s\n",instr,i,j,ret_string);
-	return ret_string;
-}
-char*
-extract_csv_field(char* instr, int index, int* next)
-{
-	int i,j,k,len;
-	char* ret_string;
-
-	len = strlen(instr);
-	i = 0;
-	while((instr[i] != ',') && (instr[i] != '\n') && (i <= len))
-		{
-		if(instr[i] == '"')
+char global_str[] = "\"Global sample breakdown\"";
+
+int num_threads = 1;			/* for sort_pointer, the groups already run in parallel */
+int merge_threads = 1, fan_in = 16, merge_kind = 0;
+
+typedef struct merge_level_struc{
+	char **			in;
+	char **			out;
+	int			num_in;
+	int			num_out;
+	int			next;
+	}merge_level_data;
+
+//	a report table row, the module rows of a process or the source and target
+//	rows of a function are its children
+typedef struct csv_row_struc * csv_row_ptr;
+typedef struct csv_row_struc{
+	char *			key;
+	char **			field;			/* the first_data text columns */
+	double *		val;			/* the event columns, NAN when empty */
+	csv_row_ptr		child;
+	int			num_child;
+	int			index;			/* funclist index, the rank once merged */
+	int			target;			/* funclist index of a branch target, -1 for none */
+	char *			target_key;
+	}csv_row_data;
+
+typedef struct csv_run_struc{
+	csv_row_ptr		row;
+	int			len;
+	int			pos;
+	}csv_run_data;
+
+typedef struct csv_table_struc{
+	char *			path;
+	int			type;
+	int			first_data;		/* 3 in process.csv, 8 in function_hotspots.csv */
+	int			num_data;
+	int			num_head;
+	char **			head_line;		/* the rows down to "Cycles", printed as read */
+	char **			name;			/* event column names */
+	double *		multiplex;
+	csv_row_ptr		row;
+	int			num_row;
+	int			max_row;
+	csv_row_data		global;
+	}csv_table_data;
+
+typedef struct agg_input_struc * agg_input_ptr;
+typedef struct agg_input_struc{
+	char *			path;
+	char *			map;
+	size_t			len;
+	agg_header_data *	hdr;
+	char *			strings;
+	int64_t *		global_count;
+	double *		global_multiplex;
+	agg_process_data *	process;
+	int64_t *		process_count;
+	agg_module_data *	module;
+	int64_t *		module_count;
+	uint64_t *		rva_addr;
+	agg_rva_data *		rva;
+	agg_pair_data *		pair;
+	uint64_t *		branch_addr;
+	agg_branch_data *	branch;
+	agg_mem_data *		mem;
+	agg_cycles_data *	cycles;
+	uint32_t *		modmap;			/* module index to merged module index */
+	}agg_input_data;
+
+typedef struct agg_key_struc{
+	char *			name;			/* process name or module path */
+	char *			buildid;
+	int			input;
+	uint32_t		index;
+	}agg_key_data;
+
+typedef struct agg_member_struc{
+	int			input;
+	uint32_t		module;
+	}agg_member_data;
+
+typedef struct agg_edge_struc{
+	uint64_t		address;
+	uint32_t		module;
+	int32_t			type;
+	int64_t			count;
+	}agg_edge_data;
+
+//	the rva being merged
+typedef struct agg_acc_struc{
+	int64_t *		count;
+	char *			seen;
+	int *			touched;
+	int			num_touched;
+	agg_edge_data *		edge;
+	int			num_edge;
+	int			max_edge;
+	agg_rva_data		rva;
+	agg_mem_data		mem;
+	agg_cycles_data		cycles;
+	}agg_acc_data;
+
+typedef struct agg_merge_struc{
+	int			count;
+	FILE *			column[NUM_AGG_COLUMNS];	/* streamed columns */
+	uint64_t		entries[NUM_AGG_COLUMNS];
+	agg_process_data *	process;
+	int64_t *		process_count;
+	agg_module_data *	module;
+	int64_t *		module_count;
+	int *			member_first;
+	int *			member_num;
+	agg_member_data *	member;
+	int			np, max_process, max_process_count;
+	int			nm, max_module, max_module_count, max_member_first, max_member_num;
+	int			num_member, max_member;
+	}agg_merge_data;
+
+static void *
+merge_calloc(size_t entries, size_t size)
+{
+	void *buf;
+
+	buf = calloc(entries ? entries : 1, size);
+	if(buf == NULL)
+		err(1,"failed to allocate %zu merge entries",entries);
+	return buf;
+}
+
+static void *
+merge_grow(void *buf, int *max, int need, size_t size)
+{
+	if(need <= *max)
+		return buf;
+	while(*max < need)
+		*max = (*max != 0) ? 2*(*max) : 16;
+	buf = realloc(buf, (size_t)(*max)*size);
+	if(buf == NULL)
+		err(1,"failed to grow a merge buffer to %d entries",*max);
+	return buf;
+}
+
+static char *
+merge_path(char *dir, char *name)
+{
+	char *path;
+	size_t len;
+
+	len = strlen(dir) + strlen(spreadsheets) + strlen(name) + 1;
+	path = merge_calloc(len, 1);
+	snprintf(path, len, "%s%s%s", dir, spreadsheets, name);
+	return path;
+}
+
+//	report directory or aggregate file
+static int
+merge_input_kind(char *path)
+{
+	struct stat st;
+	char magic[8], *name;
+	FILE *in;
+
+	if(stat(path, &st) != 0)
+		err(1,"cannot find input %s",path);
+	if(S_ISDIR(st.st_mode))
+		{
+		name = merge_path(path, func_str);
+		if(access(name, R_OK) != 0)
+			err(1,"%s is not a gooda report directory, cannot read %s",path,name);
+		free(name);
+		return MERGE_REPORT;
+		}
+	in = fopen(path, "r");
+	if(in == NULL)
+		err(1,"cannot open input %s",path);
+	if((fread(magic, 1, sizeof(magic), in) != sizeof(magic)) || (memcmp(magic, AGG_MAGIC, sizeof(magic)) != 0))
+		errx(1,"%s is neither a gooda report directory nor an aggregate file",path);
+	fclose(in);
+	return MERGE_AGGREGATE;
+}
+
+//	report tables
+
+static char *
+csv_trim(char *start, char *end)
+{
+	char *field;
+	size_t len;
+
+	while((start < end) && isspace((unsigned char)*start))
+		start++;
+	while((end > start) && isspace((unsigned char)end[-1]))
+		end--;
+	len = end - start;
+	field = merge_calloc(len + 1, 1);
+	memcpy(field, start, len);
+	return field;
+}
+
+//	the fields of a "[, a, "b", 1, ]," row, NULL for any other line
+static char **
+csv_split(char *line, int *num_field)
+{
+	char **field = NULL, *p, *start, *end;
+	int max_field = 0, n = 0, quote;
+
+	p = line;
+	while(isspace((unsigned char)*p))
+		p++;
+	if(*p != '[')
+		return NULL;
+	p++;
+	end = strrchr(p, ']');
+	if(end == NULL)
+		return NULL;
+	*end = '\0';
+	for(;;)
+		{
+		start = p;
+		quote = 0;
+		while((*p != '\0') && (quote || (*p != ',')))
 			{
-			i++;
-			while(instr[i] != '"')i++;
+			if(*p == '"')
+				quote = !quote;
+			p++;
 			}
-		i++;
-		}
-	if(i >= len)
-		err(1,"unrecognized input string in read_platform_properties for index = %d, string = %s",index,instr);
-	len = i;
-	*next = i+1;
-	if((i == 0) && (instr[i] == '\n'))len++;
-	if((i == 1) && (instr[i] == '\n'))len++;
-	ret_string = malloc(len+1);
-	if(ret_string == NULL)
-		err(1,"extract_input_string failled to malloc return string of length %d for processing %s",len,instr);
-	strncpy(ret_string,instr,len);
-	ret_string[len]='\0';
-	if(dbg_count < 100)
-		{
-		fprintf(stderr," address of instr = %p, i = %d, return_string = %s\n",instr,i,ret_string);
-		dbg_count++;
-		}
-	return ret_string;
-}
-
-char*
-read_file(char* local_path)
-{
-	FILE *fdesc;
-	int access_status;
-	char* input_str;
-	long file_size, test;
-
-	access_status = access(local_path, R_OK);
-	if(access_status != 0)
-		err(1,"cannot find the platform_properties.txt file from path %s",local_path);
-	fdesc = fopen(local_path, "r");
-	if(fdesc == NULL)
-		err(1, "failed to open file %s\n",local_path);
-	fseek(fdesc, 0, SEEK_END);
-	file_size = ftell(fdesc);
-	rewind(fdesc);
-
-	input_str = (char*)malloc(sizeof(char)*file_size);
-	if(input_str == NULL)
-		err(1," failed to malloc buffer for reading input file %s size = %ld",local_path,file_size);
-	test = fread(input_str,1,file_size,fdesc);
-	if(test != file_size)
-		err(1,"read size, %ld != file_size %ld for file %s",test,file_size,local_path);
-
-	return input_str;
+		field = merge_grow(field, &max_field, n + 1, sizeof(char *));
+		field[n++] = csv_trim(start, p);
+		if(*p == '\0')
+			break;
+		p++;
+		}
+	*num_field = n;
+	return field;
 }
-int
-read_platform_properties(int index)
-{
-
-	int i,j,k,len,ret=0, access_status, test;
-	char * local_prop, *input_str, *ret_str;
-	FILE * pr;
-	long file_size;
-	int begin_line=0, read_start = 0;;
-
-	len = strlen(input_properties[index].path);
-//	fprintf(stderr," index = %d, len = %d, path = %s\n",index,len,input_properties[index].path);
-	local_prop = malloc(len + spread_len + prop_len + 1);
-	if(local_prop == NULL)
-		err(1,"malloc failed for input properties index = %d",index);
-	strncpy(local_prop, input_properties[index].path, len);
-	local_prop[len] = '\0';
-//	fprintf(stderr,"local_prop = %s\n",local_prop);
-	strncpy(&local_prop[len], spreadsheets, spread_len);
-	local_prop[len+spread_len] = '\0';
-//	fprintf(stderr,"local_prop = %s\n",local_prop);
-	strncpy(&local_prop[len+spread_len], prop_str, prop_len);
-
-//	for(i=0; i < len; i++)local_prop[i] = input_properties[index].path[i];
-//	for(i=len; i < len + spread_len; i++)local_prop[i] = spreadsheets[i-len];
-//	for(i=len + spread_len; i < len + spread_len + prop_len; i++)local_prop[i] = prop_str[i-len-spread_len];
-
-	local_prop[len + spread_len + prop_len] = '\0';
-	fprintf(stderr,"local_prop = %s\n",local_prop);
-
-	input_str = read_file(local_prop);
-	if(input_str == NULL)
-		err(1,"read_file returned a NULL pointer for index %d path = %s",index,local_prop);
-
-	len = strlen(input_str);
-	fprintf(stderr," length of input_str = %d\n",len);
-//	fprintf(stderr,"input_str = \n");
-//	fprintf(stderr,"%s\n",input_str);
-	input_properties[index].arch = extract_input_string(input_str, ':', index, &begin_line);
-	read_start+=begin_line;
-	input_properties[index].family = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	read_start+=begin_line;
-	input_properties[index].model = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	read_start+=begin_line;
-	input_properties[index].num_sockets = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	read_start+=begin_line;
-	input_properties[index].num_cores = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	read_start+=begin_line;
-	input_properties[index].num_col = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	read_start+=begin_line;
-	input_properties[index].cpu_desc = extract_input_string(&input_str[read_start], ':', index, &begin_line);
-	read_start+=begin_line;
-	input_properties[index].num_fixed = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	read_start+=begin_line;
-	input_properties[index].num_ordered = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	read_start+=begin_line;
-	input_properties[index].num_branch = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	read_start+=begin_line;
-	input_properties[index].num_sub_branch = atoi(extract_input_string(&input_str[read_start], ':', index, &begin_line));
-	fprintf(stderr,"arch = %s\n",input_properties[index].arch);
-	fprintf(stderr,"cpu_desc = %s\n",input_properties[index].cpu_desc);
-	fprintf(stderr,"family = %d, model = %d\n",input_properties[index].family,input_properties[index].model);
-	fprintf(stderr,"num_sockets = %d, num_cores = %d\n",input_properties[index].num_sockets,input_properties[index].num_cores);
-	fprintf(stderr,"num_col = %d\n",input_properties[index].num_col);
-	fprintf(stderr,"num_fixed = %d, num_ordered = %d\n",input_properties[index].num_fixed,input_properties[index].num_ordered);
-	fprintf(stderr,"num_branch = %d, num_sub_branch = %d\n",input_properties[index].num_branch,input_properties[index].num_sub_branch);
-	return 0;
+
+static void
+csv_free_fields(char **field, int first, int num_field)
+{
+	int i;
+
+	for(i = first; i < num_field; i++)
+		free(field[i]);
 }
 
-int
-read_func_table(int index)
-{
-	int i,j,k,len,ret=0, field_len, fields_per_line=0, lines=0;;
-	char * local_func, *input_str, *ret_str;
-	FILE *func_tab;
-	long file_size;
-	int begin_line=0, read_start=0;
-
-	len = strlen(input_properties[index].path);
-//	fprintf(stderr," index = %d, len = %d, path = %s\n",index,len,input_properties[index].path);
-	local_func = malloc(len + spread_len + func_len + 1);
-	if(local_func == NULL)
-		err(1,"malloc failed for input properties index = %d",index);
-	strncpy(local_func, input_properties[index].path, len);
-	local_func[len] = '\0';
-//	fprintf(stderr,"local_func = %s\n",local_func);
-	strncpy(&local_func[len], spreadsheets, spread_len);
-	local_func[len+spread_len] = '\0';
-//	fprintf(stderr,"local_func = %s\n",local_func);
-	strncpy(&local_func[len+spread_len], func_str, func_len);
-
-	local_func[len + spread_len + func_len] = '\0';
-	fprintf(stderr,"local_func = %s\n",local_func);
-
-	input_str = read_file(local_func);
-	if(input_str == NULL)
-		err(1,"read_file returned a NULL pointer for index %d path = %s",index,local_func);
-
-	len = strlen(input_str);
-	fprintf(stderr," length of input_str = %d\n",len);
-
-	while(read_start < len)
-		{
-		ret_str = extract_csv_field(&input_str[read_start],index,&begin_line);
-		fields_per_line++;
-//		field_len = strlen(ret_str);
-		field_len = begin_line-1;
-		if(ret_str[field_len] == '\n')
+static void
+csv_read(csv_table_data *table, char *path)
+{
+	FILE *in;
+	char *line = NULL, *p, **field;
+	size_t line_max = 0;
+	int num_field, in_head = 1, key_col = 0, c, max_head = 0;
+	csv_row_ptr this_row, parent = NULL;
+
+	memset(table, 0, sizeof(csv_table_data));
+	table->path = path;
+	table->type = -1;
+	in = fopen(path, "r");
+	if(in == NULL)
+		err(1,"cannot open %s",path);
+	while(getline(&line, &line_max, in) > 0)
+		{
+		for(p = line; isspace((unsigned char)*p); p++);
+		if((*p == '\0') || (((*p == '[') || (*p == ']')) && (p[1 + strspn(p + 1, " \t\r\n")] == '\0')))
+			continue;
+		p[strcspn(p, "\r\n")] = '\0';
+		if(in_head)
+			{
+			table->head_line = merge_grow(table->head_line, &max_head, table->num_head + 1, sizeof(char *));
+			table->head_line[table->num_head++] = strdup(p);
+			}
+		field = csv_split(line, &num_field);
+		if(field == NULL)
+			errx(1,"%s: unexpected line %s",path,p);
+		if(table->type < 0)
+			{
+			if((num_field > 4) && (strcmp(field[3], "\"Function Name\"") == 0))
+				{
+				table->type = CSV_FUNCTION;
+				table->first_data = 8;
+				key_col = 3;
+				}
+			else if((num_field > 2) && (strcmp(field[1], "\"Process Path\"") == 0))
+				{
+				table->type = CSV_PROCESS;
+				table->first_data = 3;
+				key_col = 2;
+				}
+			else
+				errx(1,"%s is not a gooda process or function table",path);
+			table->num_data = num_field - table->first_data - 1;
+			if(table->num_data < 1)
+				errx(1,"%s has no event columns",path);
+			table->name = field;
+			continue;
+			}
+		if(num_field != table->first_data + table->num_data + 1)
+			errx(1,"%s: row with %d columns in a table of %d: %s",path,num_field,
+				table->first_data + table->num_data + 1,p);
+		if(in_head)
+			{
+			if(strcmp(field[key_col], "\"Multiplex\"") == 0)
+				{
+				table->multiplex = merge_calloc(table->num_data, sizeof(double));
+				for(c = 0; c < table->num_data; c++)
+					table->multiplex[c] = atof(field[table->first_data + c]);
+				}
+			if(strcmp(field[key_col], "\"Cycles\"") == 0)
+				in_head = 0;
+			csv_free_fields(field, 0, num_field);
+			free(field);
+			continue;
+			}
+
+		if(strcmp(field[1], global_str) == 0)
+			{
+			this_row = &table->global;
+			parent = NULL;
+			}
+		else if(((table->type == CSV_FUNCTION) && (field[7][0] != '\0'))
+			|| ((table->type == CSV_PROCESS) && (field[1][0] != '\0')))
+			{
+			table->row = merge_grow(table->row, &table->max_row, table->num_row + 1, sizeof(csv_row_data));
+			this_row = &table->row[table->num_row++];
+			memset(this_row, 0, sizeof(csv_row_data));
+			parent = this_row;
+			}
+		else
 			{
-			lines++;
-			fprintf(stderr,"line number %d, fields_per_line = %d\n",lines,fields_per_line);
-			fields_per_line = 0;
+			if(parent == NULL)
+				errx(1,"%s: row before its process or function: %s",path,p);
+//			the child arrays grow by doubling, their size is a power of 2
+			if((parent->num_child & (parent->num_child - 1)) == 0)
+				{
+				parent->child = realloc(parent->child, (parent->num_child ? 2*parent->num_child : 1)*sizeof(csv_row_data));
+				if(parent->child == NULL)
+					err(1,"failed to grow the rows of %s",path);
+				}
+			this_row = &parent->child[parent->num_child++];
+			memset(this_row, 0, sizeof(csv_row_data));
 			}
-		read_start+=begin_line;
+		this_row->field = field;
+		this_row->val = merge_calloc(table->num_data, sizeof(double));
+		for(c = 0; c < table->num_data; c++)
+			this_row->val[c] = (field[table->first_data + c][0] == '\0') ? NAN : atof(field[table->first_data + c]);
+		csv_free_fields(field, table->first_data, num_field);
+		this_row->index = atoi(field[1]);
+		this_row->target = atoi(field[2]);
 		}
-	return 0;
+	free(line);
+	fclose(in);
+	if(table->type < 0)
+		errx(1,"%s is empty",path);
+	if(table->global.val == NULL)
+		errx(1,"%s has no Global sample breakdown row",path);
+	if(table->multiplex == NULL)
+		errx(1,"%s has no Multiplex row",path);
 }
 
-int read_proc_table(int index)
+static void
+csv_free_row(csv_row_ptr this_row, int first_data)
 {
-	int i,j,k,len,ret=0;
-	char * local_func, *local_proc;
+	int i;
 
-	return 0;
+	for(i = 0; i < this_row->num_child; i++)
+		csv_free_row(&this_row->child[i], first_data);
+	free(this_row->child);
+	if(this_row->field != NULL)
+		csv_free_fields(this_row->field, 0, first_data);
+	free(this_row->field);
+	free(this_row->val);
+	free(this_row->key);
 }
-void
-usage()
+
+static void
+csv_free(csv_table_data *table)
 {
-	fprintf(stderr,"multi_perf creates a new ./spreadsheets tree by summing the table contents\n");
-	fprintf(stderr,"from the spreadsheet directories in a list of input report directory paths or\n");
-	fprintf(stderr,"by taking the difference of the tables in the spreadsheet directories of 2 report paths\n");
-	fprintf(stderr,"The first argument must be -n followed by the number of report directories to come (with or without a space)\n");
-	fprintf(stderr," each report directory path (absolute or relative) is input with the -d flag, one directory for each -d\n");
-	fprintf(stderr," -a (with no argument value) indicates the tables should be summed\n");
-	fprintf(stderr," -s (with no argument value) indicates a subtraction of the table data and the value for -n MUST be 2\n");
-	fprintf(stderr," -h produces this output\n");
+	int i;
+
+	for(i = 0; i < table->num_row; i++)
+		csv_free_row(&table->row[i], table->first_data);
+	free(table->row);
+	csv_free_row(&table->global, table->first_data);
+	for(i = 0; i < table->num_head; i++)
+		free(table->head_line[i]);
+	free(table->head_line);
+	csv_free_fields(table->name, 0, table->first_data + table->num_data + 1);
+	free(table->name);
+	free(table->multiplex);
 }
 
-int
-main( int argc, char** argv)
+//	move the event columns of a row to the order of the reference, scaled
+static void
+csv_map_row(csv_row_ptr this_row, int *map, double *scale, int num_data, double *tmp)
+{
+	int c;
+
+	for(c = 0; c < num_data; c++)
+		tmp[map[c]] = isnan(this_row->val[c]) ? NAN : this_row->val[c]*scale[c];
+	memcpy(this_row->val, tmp, num_data*sizeof(double));
+	for(c = 0; c < this_row->num_child; c++)
+		csv_map_row(&this_row->child[c], map, scale, num_data, tmp);
+}
+
+static void
+csv_map_columns(csv_table_data *table, csv_table_data *ref)
 {
+	int *map, c, j, i;
+	char *used;
+	double *scale, *tmp;
 
-	int i,j,k,dir=0,len,len1,ret;
-	int num_dir=0, add = 0, sub = 0;
+	if((table->type != ref->type) || (table->num_data != ref->num_data))
+		errx(1,"%s and %s have different event columns",table->path,ref->path);
+	map = merge_calloc(table->num_data, sizeof(int));
+	used = merge_calloc(table->num_data, 1);
+	scale = merge_calloc(table->num_data, sizeof(double));
+	tmp = merge_calloc(table->num_data, sizeof(double));
+	for(c = 0; c < table->num_data; c++)
+		{
+		for(j = 0; j < ref->num_data; j++)
+			if(!used[j] && (strcmp(table->name[table->first_data + c], ref->name[ref->first_data + j]) == 0))
+				break;
+		if(j == ref->num_data)
+			errx(1,"%s has event %s which %s does not",table->path,table->name[table->first_data + c],ref->path);
+		used[j] = 1;
+		map[c] = j;
+		scale[c] = ((ref->multiplex[j] != 0.0) && (table->multiplex[c] != 0.0)) ? table->multiplex[c]/ref->multiplex[j] : 1.0;
+		}
+	for(i = 0; i < table->num_row; i++)
+		csv_map_row(&table->row[i], map, scale, table->num_data, tmp);
+	csv_map_row(&table->global, map, scale, table->num_data, tmp);
+	free(map);
+	free(used);
+	free(scale);
+	free(tmp);
+}
+
+static char *
+csv_key(char **part, int num_part)
+{
+	char *key;
+	size_t len = 0;
+	int i;
+
+	for(i = 0; i < num_part; i++)
+		len += strlen(part[i]) + 1;
+	key = merge_calloc(len, 1);
+	for(i = 0; i < num_part; i++)
+		{
+		strcat(key, part[i]);
+		if(i < num_part - 1)
+			strcat(key, "\001");
+		}
+	return key;
+}
+
+static int
+csv_key_cmp(const void *a, const void *b)
+{
+	return strcmp(((csv_row_ptr)a)->key, ((csv_row_ptr)b)->key);
+}
+
+static int
+csv_index_cmp(const void *a, const void *b)
+{
+	csv_row_ptr ra = *(csv_row_ptr *)a, rb = *(csv_row_ptr *)b;
+
+	return (ra->index > rb->index) - (ra->index < rb->index);
+}
+
+static int
+csv_order_cmp(const void *a, const void *b)
+{
+	csv_row_ptr ra = *(csv_row_ptr *)a, rb = *(csv_row_ptr *)b;
+	int ret;
+
+	ret = strcmp(ra->key, rb->key);
+	if(ret != 0)
+		return ret;
+	return (ra > rb) - (ra < rb);
+}
+
+//	rows of one table that share a key, such as two mappings of one library
+//	in a process or two processes of one name, are different rows: the
+//	second and later get their rank among them appended, so the n-th of an
+//	input adds up with the n-th of the others
+static void
+csv_unique_keys(csv_row_ptr row, int num_row)
+{
+	csv_row_ptr *order;
+	char rank[16], *part[2];
+	int i, j;
+
+	if(num_row < 2)
+		return;
+	order = merge_calloc(num_row, sizeof(csv_row_ptr));
+	for(i = 0; i < num_row; i++)
+		order[i] = &row[i];
+	qsort(order, num_row, sizeof(csv_row_ptr), csv_order_cmp);
+	for(i = 0; i < num_row; i = j)
+		for(j = i + 1; (j < num_row) && (strcmp(order[i]->key, order[j]->key) == 0); j++)
+			{
+			snprintf(rank, sizeof(rank), "#%d", j - i + 1);
+			part[0] = order[j]->key;
+			part[1] = rank;
+			order[j]->key = csv_key(part, 2);
+			free(part[0]);
+			}
+	free(order);
+}
+
+//	build the keys once the columns are in the reference order, the function
+//	branch rows are told apart by the column holding their count
+static void
+csv_keys(csv_table_data *table)
+{
+	csv_row_ptr this_row, child, *by_index, *found, probe;
+	csv_row_data probe_row;
+	char *part[4], side[16];
+	int i, j, c;
+
+	for(i = 0; i < table->num_row; i++)
+		{
+		this_row = &table->row[i];
+		if(table->type == CSV_FUNCTION)
+			{
+			part[0] = this_row->field[6];
+			part[1] = this_row->field[4];
+			part[2] = this_row->field[3];
+			part[3] = this_row->field[7];
+			this_row->key = csv_key(part, 4);
+			}
+		else
+			this_row->key = csv_key(&this_row->field[1], 1);
+		for(j = 0; j < this_row->num_child; j++)
+			{
+			child = &this_row->child[j];
+			if(table->type == CSV_FUNCTION)
+				{
+				for(c = 0; (c < table->num_data) && isnan(child->val[c]); c++);
+				snprintf(side, sizeof(side), "%d", c);
+				part[0] = child->field[3];
+				part[1] = child->field[4];
+				part[2] = child->field[6];
+				part[3] = side;
+				child->key = csv_key(part, 4);
+				}
+			else
+				child->key = csv_key(&child->field[2], 1);
+			}
+		csv_unique_keys(this_row->child, this_row->num_child);
+		}
+	csv_unique_keys(table->row, table->num_row);
+	if(table->type != CSV_FUNCTION)
+		return;
+
+//	branch targets by funclist index, in this input
+	by_index = merge_calloc(table->num_row, sizeof(csv_row_ptr));
+	for(i = 0; i < table->num_row; i++)
+		by_index[i] = &table->row[i];
+	qsort(by_index, table->num_row, sizeof(csv_row_ptr), csv_index_cmp);
+	probe = &probe_row;
+	for(i = 0; i < table->num_row; i++)
+		for(j = 0; j < table->row[i].num_child; j++)
+			{
+			child = &table->row[i].child[j];
+			if(child->target < 0)
+				continue;
+			probe_row.index = child->target;
+			found = bsearch(&probe, by_index, table->num_row, sizeof(csv_row_ptr), csv_index_cmp);
+			if(found != NULL)
+				child->target_key = (*found)->key;
+			}
+	free(by_index);
+}
+
+static void
+csv_sort(csv_table_data *table)
+{
+	int i;
+
+	if(table->num_row > 0)
+		qsort(table->row, table->num_row, sizeof(csv_row_data), csv_key_cmp);
+	for(i = 0; i < table->num_row; i++)
+		if(table->row[i].num_child > 0)
+			qsort(table->row[i].child, table->row[i].num_child, sizeof(csv_row_data), csv_key_cmp);
+}
+
+static void
+csv_add(double *to, double *from, int num_data)
+{
 	int c;
-	char* path_buf;
-
-	fprintf(stderr,"argc = %d\n",argc);
-	for(i=0;i<argc; i++)fprintf(stderr,"argv[%d] = %s\n",i,argv[i]);
-
-	while ((c= getopt(argc, argv, "h:n:d:a:s")) != -1) {
-                switch(c) {
-                case 'h':
-                        usage();
-                        exit(0);
-		case 'n':
-			num_dir = atoi(optarg);
-			fprintf(stderr," num_dir = %d, sizeof(properties_data) = %ld\n",num_dir, sizeof(properties_data));
-//			malloc array of structures for the platform properites data
-			input_properties = (properties_data*)calloc(1,(num_dir+1)*sizeof(properties_data));
-			fprintf(stderr,"finished calloc for properties_data at %p\n",input_properties);
-			if(input_properties == NULL)
-				err(1," failed to malloc buffer for input_properties array");
+
+	for(c = 0; c < num_data; c++)
+		if(!isnan(from[c]))
+			to[c] = isnan(to[c]) ? from[c] : to[c] + from[c];
+}
+
+//	k-way merge of n key sorted runs, the merged rows point at the fields and
+//	keys of the first input row with their key
+static csv_row_ptr
+csv_merge_rows(csv_run_data *run, int n, int num_data, int *num_out)
+{
+	csv_row_ptr out = NULL, this_row, from;
+	csv_run_data *child = NULL;
+	int max_out = 0, max_child = 0, nout = 0, nchild, i, c, min;
+	char *key;
+
+	for(;;)
+		{
+		min = -1;
+		for(i = 0; i < n; i++)
+			if((run[i].pos < run[i].len)
+				&& ((min < 0) || (strcmp(run[i].row[run[i].pos].key, run[min].row[run[min].pos].key) < 0)))
+				min = i;
+		if(min < 0)
 			break;
-                case 'd':
-			fprintf(stderr,"argument = -d\n");
-			if(num_dir == 0){
-				usage();
-				err(1,"the number of directories argument -n must appear before any of the directory arguments, -d");
+		out = merge_grow(out, &max_out, nout + 1, sizeof(csv_row_data));
+		this_row = &out[nout++];
+		*this_row = run[min].row[run[min].pos];
+		this_row->val = merge_calloc(num_data, sizeof(double));
+		for(c = 0; c < num_data; c++)
+			this_row->val[c] = NAN;
+		this_row->child = NULL;
+		this_row->num_child = 0;
+		key = this_row->key;
+		nchild = 0;
+		for(i = min; i < n; i++)
+			while((run[i].pos < run[i].len) && (strcmp(run[i].row[run[i].pos].key, key) == 0))
+				{
+				from = &run[i].row[run[i].pos++];
+				csv_add(this_row->val, from->val, num_data);
+				if(this_row->target_key == NULL)
+					this_row->target_key = from->target_key;
+				if(from->num_child == 0)
+					continue;
+				child = merge_grow(child, &max_child, nchild + 1, sizeof(csv_run_data));
+				child[nchild].row = from->child;
+				child[nchild].len = from->num_child;
+				child[nchild].pos = 0;
+				nchild++;
 				}
-			fprintf(stderr,"address of optarg = %p\n",optarg);
-			fprintf(stderr," -d arg = %s\n",optarg);
-			len = strlen(optarg);
-			if(dir < num_dir){
-				dir++;
-//				fprintf(stderr,"address of *path = %p\n",&input_properties[dir].path);
-//				for(i=0;i<=num_dir;i++)fprintf(stderr," loop index %d, address of *path = %p\n",i,&input_properties[i].path);
-//				path_buf = (char*)malloc(len+1);
-//				if(path_buf == NULL)
-//					err(1,"cannot malloc buffer for path %d, len = %d",dir,len);
-//				for(i=0; i<len; i++)path_buf[i] = optarg[i];
-//				path_buf[len] = '\0';
-//				fprintf(stderr,"address of path_buf = %p, path_buf = %s\n",path_buf,path_buf);
-				input_properties[dir].path = (char*)malloc(len+1);
-				if(input_properties[dir].path == NULL)
-					err(1,"cannot malloc buffer for path %d, len = %d",dir,len);
-				for(i=0; i<len; i++)input_properties[dir].path[i] = optarg[i];
-				input_properties[dir].path[len] = '\0';
-
-//				input_properties[dir].path = path_buf;
-				len1 = strlen(input_properties[dir].path);
-//				fprintf(stderr," dir = %d, len = %d, len1 = %d, path = %s\n",dir,len,len1,input_properties[dir].path);
-//				fprintf(stderr,"address of path = %p, = %p\n",&input_properties[dir].path,&input_properties[dir].path[0]);
-//				for(i=1;i<=dir;i++){
-//				len1 = strlen(input_properties[i].path);
-//				fprintf(stderr," dir = %d, len1 = %d, path = %s,  address = %p\n",i,len1,input_properties[i].path,input_properties[i].path);
-//				}
-				break;
+		if(nchild > 0)
+			this_row->child = csv_merge_rows(child, nchild, num_data, &this_row->num_child);
+		}
+	free(child);
+	*num_out = nout;
+	return out;
+}
+
+static void
+csv_free_merged(csv_row_ptr row, int num_row)
+{
+	int i;
+
+	for(i = 0; i < num_row; i++)
+		{
+		csv_free_merged(row[i].child, row[i].num_child);
+		free(row[i].val);
+		}
+	free(row);
+}
+
+//	hottest first, by the first event column as gooda_sum.py did
+static int
+csv_value_cmp(const void *a, const void *b)
+{
+	csv_row_ptr ra = *(csv_row_ptr *)a, rb = *(csv_row_ptr *)b;
+	double va, vb;
+
+	va = isnan(ra->val[0]) ? 0.0 : fabs(ra->val[0]);
+	vb = isnan(rb->val[0]) ? 0.0 : fabs(rb->val[0]);
+	if(va != vb)
+		return (va < vb) ? 1 : -1;
+	return strcmp(ra->key, rb->key);
+}
+
+static csv_row_ptr *
+csv_order(csv_row_ptr row, int num_row)
+{
+	csv_row_ptr *order;
+	int i;
+
+	order = merge_calloc(num_row, sizeof(csv_row_ptr));
+	for(i = 0; i < num_row; i++)
+		order[i] = &row[i];
+	qsort(order, num_row, sizeof(csv_row_ptr), csv_value_cmp);
+	return order;
+}
+
+static void
+csv_print_row(FILE *out, csv_table_data *table, csv_row_ptr this_row, int renumber, int index, int target, int last)
+{
+	int c;
+
+	fprintf(out,"[");
+	for(c = 0; c < table->first_data; c++)
+		{
+		if(c != 0)
+			fprintf(out,", ");
+		if(renumber && (c == 1))
+			fprintf(out,"%d",index);
+		else if(renumber && (c == 2))
+			fprintf(out,"%d",target);
+		else
+			fprintf(out,"%s",this_row->field[c]);
+		}
+	for(c = 0; c < table->num_data; c++)
+		{
+		if(isnan(this_row->val[c]))
+			fprintf(out,", ");
+		else
+			fprintf(out,", %.0f",this_row->val[c]);
+		}
+	fprintf(out,", ]%s\n",last ? "" : ",");
+}
+
+static void
+csv_merge_table(csv_table_data *table, int n, char *path)
+{
+	csv_run_data *run;
+	csv_row_ptr merged, *order, *child_order, found;
+	csv_row_data global, probe;
+	FILE *out;
+	int num_merged, i, j, target, renumber;
+
+	for(i = 0; i < n; i++)
+		{
+		if(i > 0)
+			csv_map_columns(&table[i], &table[0]);
+		csv_keys(&table[i]);
+		csv_sort(&table[i]);
+		}
+	run = merge_calloc(n, sizeof(csv_run_data));
+	for(i = 0; i < n; i++)
+		{
+		run[i].row = table[i].row;
+		run[i].len = table[i].num_row;
+		}
+	merged = csv_merge_rows(run, n, table[0].num_data, &num_merged);
+	global = table[0].global;
+	global.val = merge_calloc(table[0].num_data, sizeof(double));
+	for(j = 0; j < table[0].num_data; j++)
+		global.val[j] = NAN;
+	for(i = 0; i < n; i++)
+		csv_add(global.val, table[i].global.val, table[0].num_data);
+
+	order = csv_order(merged, num_merged);
+	for(i = 0; i < num_merged; i++)
+		order[i]->index = i;
+
+	out = fopen(path, "w");
+	if(out == NULL)
+		err(1,"cannot create %s",path);
+	renumber = (table[0].type == CSV_FUNCTION);
+	fprintf(out,"[\n");
+	for(i = 0; i < table[0].num_head; i++)
+		fprintf(out,"%s\n",table[0].head_line[i]);
+	for(i = 0; i < num_merged; i++)
+		{
+		csv_print_row(out, &table[0], order[i], renumber, order[i]->index, order[i]->index, 0);
+		child_order = csv_order(order[i]->child, order[i]->num_child);
+		for(j = 0; j < order[i]->num_child; j++)
+			{
+			target = -1;
+			if((child_order[j]->target_key != NULL) && (num_merged > 0))
+				{
+				probe.key = child_order[j]->target_key;
+				found = bsearch(&probe, merged, num_merged, sizeof(csv_row_data), csv_key_cmp);
+				if(found != NULL)
+					target = found->index;
 				}
-			else{
-				err(1," more directories listed with -d flag than were declared with -n");
+			csv_print_row(out, &table[0], child_order[j], renumber, order[i]->index, target, 0);
+			}
+		free(child_order);
+		}
+	csv_print_row(out, &table[0], &global, 0, 0, 0, 1);
+	fprintf(out,"]\n");
+	if(ferror(out) || (fclose(out) != 0))
+		err(1,"failed to write %s",path);
+
+	free(order);
+	free(global.val);
+	csv_free_merged(merged, num_merged);
+	free(run);
+}
+
+static void
+report_copy(char *from, char *to)
+{
+	FILE *in, *out;
+	char buf[8192];
+	size_t len;
+
+	in = fopen(from, "r");
+	if(in == NULL)
+		return;
+	out = fopen(to, "w");
+	if(out == NULL)
+		err(1,"cannot create %s",to);
+	while((len = fread(buf, 1, sizeof(buf), in)) > 0)
+		fwrite(buf, 1, len, out);
+	fclose(in);
+	if(ferror(out) || (fclose(out) != 0))
+		err(1,"failed to write %s",to);
+}
+
+static void
+report_merge(char **in, int n, char *out_dir)
+{
+	static char *table_name[2] = {proc_str, func_str};
+	csv_table_data *table;
+	char *name, *from;
+	int t, i;
+
+	name = merge_path(out_dir, "");
+	if((mkdir(out_dir, 0755) != 0) && (errno != EEXIST))
+		err(1,"cannot create %s",out_dir);
+	if((mkdir(name, 0755) != 0) && (errno != EEXIST))
+		err(1,"cannot create %s",name);
+	free(name);
+	for(t = 0; t < 2; t++)
+		{
+		table = merge_calloc(n, sizeof(csv_table_data));
+		for(i = 0; i < n; i++)
+			csv_read(&table[i], merge_path(in[i], table_name[t]));
+		name = merge_path(out_dir, table_name[t]);
+		csv_merge_table(table, n, name);
+		free(name);
+		for(i = 0; i < n; i++)
+			{
+			free(table[i].path);
+			csv_free(&table[i]);
+			}
+		free(table);
+		}
+	from = merge_path(in[0], prop_str);
+	name = merge_path(out_dir, prop_str);
+	report_copy(from, name);
+	free(from);
+	free(name);
+}
+
+//	aggregate files
+
+static void *
+agg_input_column(agg_input_ptr in, int column)
+{
+	uint64_t offset = in->hdr->column[column].offset, entries = in->hdr->column[column].entries;
+
+	if((offset & 7) || (offset < sizeof(agg_header_data)) || (offset > in->len)
+		|| (entries > (in->len - offset)/agg_column_size[column]))
+		errx(1,"aggregate file %s is truncated or corrupt, column %d",in->path,column);
+	return in->map + offset;
+}
+
+static char *
+agg_input_string(agg_input_ptr in, uint32_t offset)
+{
+	uint64_t num_strings = in->hdr->column[AGG_STRINGS].entries;
+
+	if((offset >= num_strings) || (memchr(&in->strings[offset], '\0', num_strings - offset) == NULL))
+		errx(1,"aggregate file %s has a bad string offset %u",in->path,offset);
+	return &in->strings[offset];
+}
+
+static void
+agg_input_range(agg_input_ptr in, uint64_t first, uint64_t num, int column, char *what)
+{
+	if(first + num > in->hdr->column[column].entries)
+		errx(1,"aggregate file %s has a bad %s range",in->path,what);
+}
+
+static void
+agg_input_open(agg_input_ptr in, char *path, agg_input_ptr ref)
+{
+	agg_header_data *hdr;
+	struct stat st;
+	uint64_t i;
+	int fd;
+
+	memset(in, 0, sizeof(agg_input_data));
+	in->path = path;
+	fd = open(path, O_RDONLY);
+	if(fd == -1)
+		err(1,"cannot open aggregate file %s",path);
+	if(fstat(fd, &st) != 0)
+		err(1,"cannot stat aggregate file %s",path);
+	if((size_t)st.st_size < sizeof(agg_header_data))
+		errx(1,"aggregate file %s is too short",path);
+	in->len = st.st_size;
+	in->map = mmap(NULL, in->len, PROT_READ, MAP_PRIVATE, fd, 0);
+	if(in->map == MAP_FAILED)
+		err(1,"cannot mmap aggregate file %s",path);
+	close(fd);
+
+	hdr = in->hdr = (agg_header_data *)in->map;
+	if(memcmp(hdr->magic, AGG_MAGIC, sizeof(hdr->magic)) != 0)
+		errx(1,"%s is not a gooda aggregate file",path);
+	if((hdr->version != AGG_VERSION) || (hdr->num_columns != NUM_AGG_COLUMNS))
+		errx(1,"aggregate file %s has version %u, multi_perf reads version %d",path,hdr->version,AGG_VERSION);
+	if((ref != NULL) && ((hdr->num_events != ref->hdr->num_events) || (hdr->num_cores != ref->hdr->num_cores)
+		|| (hdr->num_sockets != ref->hdr->num_sockets) || (hdr->count != ref->hdr->count)
+		|| (hdr->event_hash != ref->hdr->event_hash)))
+		errx(1,"%s was recorded with other events or on another topology than %s",path,ref->path);
+	if(hdr->count < 1)
+		errx(1,"aggregate file %s has no counters",path);
+
+	in->strings = agg_input_column(in, AGG_STRINGS);
+	in->global_count = agg_input_column(in, AGG_GLOBAL_COUNT);
+	in->global_multiplex = agg_input_column(in, AGG_GLOBAL_MULTIPLEX);
+	in->process = agg_input_column(in, AGG_PROCESS);
+	in->process_count = agg_input_column(in, AGG_PROCESS_COUNT);
+	in->module = agg_input_column(in, AGG_MODULE);
+	in->module_count = agg_input_column(in, AGG_MODULE_COUNT);
+	in->rva_addr = agg_input_column(in, AGG_RVA_ADDR);
+	in->rva = agg_input_column(in, AGG_RVA);
+	in->pair = agg_input_column(in, AGG_PAIR);
+	in->branch_addr = agg_input_column(in, AGG_BRANCH_ADDR);
+	in->branch = agg_input_column(in, AGG_BRANCH);
+	in->mem = agg_input_column(in, AGG_MEM);
+	in->cycles = agg_input_column(in, AGG_CYCLES);
+	if((hdr->column[AGG_GLOBAL_COUNT].entries != (uint64_t)hdr->count)
+		|| (hdr->column[AGG_GLOBAL_MULTIPLEX].entries != (uint64_t)hdr->count)
+		|| (hdr->column[AGG_PROCESS_COUNT].entries != hdr->column[AGG_PROCESS].entries*hdr->count)
+		|| (hdr->column[AGG_MODULE_COUNT].entries != hdr->column[AGG_MODULE].entries*hdr->count)
+		|| (hdr->column[AGG_RVA_ADDR].entries != hdr->column[AGG_RVA].entries)
+		|| (hdr->column[AGG_BRANCH_ADDR].entries != hdr->column[AGG_BRANCH].entries))
+		errx(1,"aggregate file %s has inconsistent column sizes",path);
+	for(i = 0; i < hdr->column[AGG_PROCESS].entries; i++)
+		agg_input_range(in, in->process[i].first_module, in->process[i].num_modules, AGG_MODULE, "module");
+	for(i = 0; i < hdr->column[AGG_MODULE].entries; i++)
+		agg_input_range(in, in->module[i].first_rva, in->module[i].num_rvas, AGG_RVA, "rva");
+	in->modmap = merge_calloc(hdr->column[AGG_MODULE].entries, sizeof(uint32_t));
+}
+
+static void
+agg_input_close(agg_input_ptr in)
+{
+	munmap(in->map, in->len);
+	free(in->modmap);
+}
+
+static int
+agg_key_cmp(const void *a, const void *b)
+{
+	const agg_key_data *ka = a, *kb = b;
+	int ret;
+
+	ret = strcmp(ka->name, kb->name);
+	if(ret == 0)
+		ret = strcmp(ka->buildid, kb->buildid);
+	if(ret == 0)
+		ret = (ka->input > kb->input) - (ka->input < kb->input);
+	if(ret == 0)
+		ret = (ka->index > kb->index) - (ka->index < kb->index);
+	return ret;
+}
+
+static uint64_t
+agg_stream(agg_merge_data *m, int column, void *data, uint64_t entries)
+{
+	uint64_t first = m->entries[column];
+
+	if(first + entries > UINT32_MAX)
+		errx(1,"merged aggregate column %d has more than 2^32 entries",column);
+	if(fwrite(data, agg_column_size[column], entries, m->column[column]) != entries)
+		err(1,"failed to write a temporary aggregate column");
+	m->entries[column] += entries;
+	return first;
+}
+
+static uint32_t
+agg_stream_string(agg_merge_data *m, char *str)
+{
+	return agg_stream(m, AGG_STRINGS, str, strlen(str) + 1);
+}
+
+static void
+agg_add_counts(int64_t *to, int64_t *from, int count)
+{
+	int i;
+
+	for(i = 0; i < count; i++)
+		to[i] += from[i];
+}
+
+//	first pass, the merged processes and modules and the module index maps
+static void
+agg_merge_modules(agg_merge_data *m, agg_input_ptr in, int n)
+{
+	agg_key_data **proc, *mod = NULL, *key;
+	agg_process_data *to_process;
+	agg_module_data *to_module, *from_module;
+	agg_input_ptr from;
+	uint64_t *np, *pos, k;
+	int max_mod = 0, nmod, i, min, l, r, j;
+	char *name;
+
+	proc = merge_calloc(n, sizeof(agg_key_data *));
+	np = merge_calloc(n, sizeof(uint64_t));
+	pos = merge_calloc(n, sizeof(uint64_t));
+	for(i = 0; i < n; i++)
+		{
+		np[i] = in[i].hdr->column[AGG_PROCESS].entries;
+		proc[i] = merge_calloc(np[i], sizeof(agg_key_data));
+		for(k = 0; k < np[i]; k++)
+			{
+			proc[i][k].name = agg_input_string(&in[i], in[i].process[k].name);
+			proc[i][k].buildid = "";
+			proc[i][k].input = i;
+			proc[i][k].index = k;
+			}
+		qsort(proc[i], np[i], sizeof(agg_key_data), agg_key_cmp);
+		}
+
+	for(;;)
+		{
+		min = -1;
+		for(i = 0; i < n; i++)
+			if((pos[i] < np[i]) && ((min < 0) || (strcmp(proc[i][pos[i]].name, proc[min][pos[min]].name) < 0)))
+				min = i;
+		if(min < 0)
+			break;
+		name = proc[min][pos[min]].name;
+		m->process = merge_grow(m->process, &m->max_process, m->np + 1, sizeof(agg_process_data));
+		m->process_count = merge_grow(m->process_count, &m->max_process_count, (m->np + 1)*m->count, sizeof(int64_t));
+		to_process = &m->process[m->np];
+		memset(to_process, 0, sizeof(agg_process_data));
+		memset(&m->process_count[m->np*m->count], 0, m->count*sizeof(int64_t));
+		to_process->name = agg_stream_string(m, name);
+		to_process->pid = in[min].process[proc[min][pos[min]].index].pid;
+		to_process->tid_main = in[min].process[proc[min][pos[min]].index].tid_main;
+		to_process->first_module = m->nm;
+
+//		the modules of every process with this name, in every input
+		nmod = 0;
+		for(i = min; i < n; i++)
+			while((pos[i] < np[i]) && (strcmp(proc[i][pos[i]].name, name) == 0))
+				{
+				from = &in[i];
+				key = &proc[i][pos[i]++];
+				to_process->total_sample_count += from->process[key->index].total_sample_count;
+				agg_add_counts(&m->process_count[m->np*m->count], &from->process_count[(uint64_t)key->index*m->count], m->count);
+				for(k = from->process[key->index].first_module;
+					k < (uint64_t)from->process[key->index].first_module + from->process[key->index].num_modules; k++)
+					{
+					mod = merge_grow(mod, &max_mod, nmod + 1, sizeof(agg_key_data));
+					mod[nmod].name = agg_input_string(from, from->module[k].path);
+					mod[nmod].buildid = agg_input_string(from, from->module[k].buildid);
+					mod[nmod].input = i;
+					mod[nmod].index = k;
+					nmod++;
+					}
+				}
+		if(nmod > 0)
+			qsort(mod, nmod, sizeof(agg_key_data), agg_key_cmp);
+		for(l = 0; l < nmod; l = r)
+			{
+			for(r = l + 1; (r < nmod) && (strcmp(mod[r].name, mod[l].name) == 0)
+				&& (strcmp(mod[r].buildid, mod[l].buildid) == 0); r++);
+			m->module = merge_grow(m->module, &m->max_module, m->nm + 1, sizeof(agg_module_data));
+			m->module_count = merge_grow(m->module_count, &m->max_module_count, (m->nm + 1)*m->count, sizeof(int64_t));
+			m->member_first = merge_grow(m->member_first, &m->max_member_first, m->nm + 1, sizeof(int));
+			m->member_num = merge_grow(m->member_num, &m->max_member_num, m->nm + 1, sizeof(int));
+			to_module = &m->module[m->nm];
+			memset(to_module, 0, sizeof(agg_module_data));
+			memset(&m->module_count[m->nm*m->count], 0, m->count*sizeof(int64_t));
+			from_module = &in[mod[l].input].module[mod[l].index];
+			to_module->starting_ip = from_module->starting_ip;
+			to_module->length = from_module->length;
+			to_module->is_kernel = from_module->is_kernel;
+			to_module->path = agg_stream_string(m, mod[l].name);
+			to_module->buildid = agg_stream_string(m, mod[l].buildid);
+			m->member_first[m->nm] = m->num_member;
+			m->member_num[m->nm] = r - l;
+			for(j = l; j < r; j++)
+				{
+				from = &in[mod[j].input];
+				from_module = &from->module[mod[j].index];
+				to_module->total_sample_count += from_module->total_sample_count;
+				to_module->total_branches += from_module->total_branches;
+				to_module->total_sources += from_module->total_sources;
+				to_module->total_targets += from_module->total_targets;
+				agg_add_counts(&m->module_count[m->nm*m->count], &from->module_count[(uint64_t)mod[j].index*m->count], m->count);
+				m->member = merge_grow(m->member, &m->max_member, m->num_member + 1, sizeof(agg_member_data));
+				m->member[m->num_member].input = mod[j].input;
+				m->member[m->num_member].module = mod[j].index;
+				m->num_member++;
+				from->modmap[mod[j].index] = m->nm;
 				}
-		case 'a':
-			fprintf(stderr," -a arg, num_dir = %d, sub = %d\n",num_dir,sub);
-			if((sub != 0) || (num_dir < 2))
-				err(1," cannot set both -a and -s or value of -n argument less than 2");
-			add = 1;
+			m->nm++;
+			}
+		m->process[m->np].num_modules = m->nm - to_process->first_module;
+		m->np++;
+		}
+
+	for(i = 0; i < n; i++)
+		free(proc[i]);
+	free(proc);
+	free(np);
+	free(pos);
+	free(mod);
+}
+
+static void
+agg_acc_rva(agg_merge_data *m, agg_acc_data *acc, agg_input_ptr in, uint32_t k)
+{
+	agg_rva_data *from = &in->rva[k];
+	uint32_t l, module;
+	int index, j;
+
+	agg_input_range(in, from->first_pair, from->num_pairs, AGG_PAIR, "counter");
+	for(l = from->first_pair; l < from->first_pair + from->num_pairs; l++)
+		{
+		index = in->pair[l].index;
+		if((index < 0) || (index >= m->count))
+			errx(1,"aggregate file %s has a bad counter index %d",in->path,index);
+		if(!acc->seen[index])
+			{
+			acc->seen[index] = 1;
+			acc->touched[acc->num_touched++] = index;
+			}
+		acc->count[index] += in->pair[l].count;
+		}
+
+	agg_input_range(in, from->first_branch, from->num_branches, AGG_BRANCH, "branch");
+	for(l = from->first_branch; l < from->first_branch + from->num_branches; l++)
+		{
+		module = in->branch[l].module;
+		if((in->branch[l].type < RVA_RETURN) || (in->branch[l].type > RVA_NEXT_TAKEN)
+			|| ((module != AGG_NONE) && (module >= in->hdr->column[AGG_MODULE].entries)))
+			errx(1,"aggregate file %s has a bad branch",in->path);
+		acc->edge = merge_grow(acc->edge, &acc->max_edge, acc->num_edge + 1, sizeof(agg_edge_data));
+		acc->edge[acc->num_edge].address = in->branch_addr[l];
+		acc->edge[acc->num_edge].module = (module == AGG_NONE) ? AGG_NONE : in->modmap[module];
+		acc->edge[acc->num_edge].type = in->branch[l].type;
+		acc->edge[acc->num_edge].count = in->branch[l].count;
+		acc->num_edge++;
+		}
+
+	if(from->mem != 0)
+		{
+		agg_input_range(in, from->mem - 1, 1, AGG_MEM, "memory profile");
+		acc->rva.mem = 1;
+		acc->mem.lat_sum += in->mem[from->mem - 1].lat_sum;
+		acc->mem.count += in->mem[from->mem - 1].count;
+		for(j = 0; j < MEM_LAT_BUCKETS; j++)
+			acc->mem.lat_hist[j] += in->mem[from->mem - 1].lat_hist[j];
+		for(j = 0; j < NUM_MEM_SRC; j++)
+			acc->mem.src_count[j] += in->mem[from->mem - 1].src_count[j];
+		}
+	if(from->cycles != 0)
+		{
+		agg_input_range(in, from->cycles - 1, 1, AGG_CYCLES, "block cycles");
+		acc->rva.cycles = 1;
+		acc->cycles.cyc_sum += in->cycles[from->cycles - 1].cyc_sum;
+		acc->cycles.loop_cyc_sum += in->cycles[from->cycles - 1].loop_cyc_sum;
+		acc->cycles.count += in->cycles[from->cycles - 1].count;
+		acc->cycles.loop_count += in->cycles[from->cycles - 1].loop_count;
+		for(j = 0; j < MEM_LAT_BUCKETS; j++)
+			acc->cycles.cyc_hist[j] += in->cycles[from->cycles - 1].cyc_hist[j];
+		}
+	acc->rva.total_sample_count += from->total_sample_count;
+	acc->rva.lbr_taken += from->lbr_taken;
+	acc->rva.lbr_mispredict += from->lbr_mispredict;
+}
+
+static int
+agg_int_cmp(const void *a, const void *b)
+{
+	int ia = *(int *)a, ib = *(int *)b;
+
+	return (ia > ib) - (ia < ib);
+}
+
+static int
+agg_edge_cmp(const void *a, const void *b)
+{
+	const agg_edge_data *ea = a, *eb = b;
+
+	if(ea->type != eb->type)
+		return (ea->type > eb->type) - (ea->type < eb->type);
+	if(ea->module != eb->module)
+		return (ea->module > eb->module) - (ea->module < eb->module);
+	return (ea->address > eb->address) - (ea->address < eb->address);
+}
+
+static void
+agg_emit_rva(agg_merge_data *m, agg_acc_data *acc, uint64_t address)
+{
+	agg_rva_data *to = &acc->rva;
+	agg_pair_data this_pair;
+	agg_branch_data this_branch;
+	int i, j;
+
+	qsort(acc->touched, acc->num_touched, sizeof(int), agg_int_cmp);
+	to->first_pair = m->entries[AGG_PAIR];
+	for(i = 0; i < acc->num_touched; i++)
+		{
+		this_pair.index = acc->touched[i];
+		this_pair.pad = 0;
+		this_pair.count = acc->count[this_pair.index];
+		agg_stream(m, AGG_PAIR, &this_pair, 1);
+		acc->count[this_pair.index] = 0;
+		acc->seen[this_pair.index] = 0;
+		}
+	to->num_pairs = acc->num_touched;
+
+	if(acc->num_edge > 0)
+		qsort(acc->edge, acc->num_edge, sizeof(agg_edge_data), agg_edge_cmp);
+	to->first_branch = m->entries[AGG_BRANCH];
+	for(i = 0; i < acc->num_edge; i = j)
+		{
+		for(j = i + 1; (j < acc->num_edge) && (agg_edge_cmp(&acc->edge[i], &acc->edge[j]) == 0); j++)
+			acc->edge[i].count += acc->edge[j].count;
+		this_branch.module = acc->edge[i].module;
+		this_branch.type = acc->edge[i].type;
+		this_branch.count = acc->edge[i].count;
+//		the branch totals count distinct edges, as in increment_branch_edge
+		if(this_branch.type == RVA_RETURN)
+			to->total_sources++;
+		else if(this_branch.type == RVA_CALL)
+			to->total_targets++;
+		else
+			to->total_taken_branch++;
+		agg_stream(m, AGG_BRANCH_ADDR, &acc->edge[i].address, 1);
+		agg_stream(m, AGG_BRANCH, &this_branch, 1);
+		}
+	to->num_branches = m->entries[AGG_BRANCH] - to->first_branch;
+
+	if(to->mem != 0)
+		to->mem = agg_stream(m, AGG_MEM, &acc->mem, 1) + 1;
+	if(to->cycles != 0)
+		to->cycles = agg_stream(m, AGG_CYCLES, &acc->cycles, 1) + 1;
+	agg_stream(m, AGG_RVA_ADDR, &address, 1);
+	agg_stream(m, AGG_RVA, to, 1);
+
+	acc->num_touched = 0;
+	acc->num_edge = 0;
+	memset(&acc->rva, 0, sizeof(agg_rva_data));
+	memset(&acc->mem, 0, sizeof(agg_mem_data));
+	memset(&acc->cycles, 0, sizeof(agg_cycles_data));
+}
+
+//	second pass, a k-way merge of the address sorted rvas of the members of
+//	each merged module, one module in memory at a time
+static void
+agg_merge_rvas(agg_merge_data *m, agg_input_ptr in)
+{
+	agg_acc_data acc;
+	agg_member_data *member;
+	agg_module_data *from_module;
+	pointer_data **rva;
+	uint32_t *num, *pos, k;
+	uint64_t address;
+	int j, r, num_member, min;
+
+	memset(&acc, 0, sizeof(acc));
+	acc.count = merge_calloc(m->count, sizeof(int64_t));
+	acc.seen = merge_calloc(m->count, 1);
+	acc.touched = merge_calloc(m->count, sizeof(int));
+	for(j = 0; j < m->nm; j++)
+		{
+		member = &m->member[m->member_first[j]];
+		num_member = m->member_num[j];
+		rva = merge_calloc(num_member, sizeof(pointer_data *));
+		num = merge_calloc(num_member, sizeof(uint32_t));
+		pos = merge_calloc(num_member, sizeof(uint32_t));
+		for(r = 0; r < num_member; r++)
+			{
+			from_module = &in[member[r].input].module[member[r].module];
+			num[r] = from_module->num_rvas;
+			rva[r] = merge_calloc(num[r], sizeof(pointer_data));
+			for(k = 0; k < num[r]; k++)
+				{
+				rva[r][k].val = in[member[r].input].rva_addr[from_module->first_rva + k];
+				rva[r][k].ptr = (sample_struc_ptr)(uintptr_t)(from_module->first_rva + k);
+				}
+			sort_pointer(rva[r], num[r]);
+			}
+		m->module[j].first_rva = m->entries[AGG_RVA];
+		for(;;)
+			{
+			min = -1;
+			for(r = 0; r < num_member; r++)
+				if((pos[r] < num[r]) && ((min < 0) || (rva[r][pos[r]].val < rva[min][pos[min]].val)))
+					min = r;
+			if(min < 0)
+				break;
+			address = rva[min][pos[min]].val;
+			for(r = min; r < num_member; r++)
+				while((pos[r] < num[r]) && (rva[r][pos[r]].val == address))
+					{
+					agg_acc_rva(m, &acc, &in[member[r].input], (uint32_t)(uintptr_t)rva[r][pos[r]].ptr);
+					pos[r]++;
+					}
+			agg_emit_rva(m, &acc, address);
+			}
+		m->module[j].num_rvas = m->entries[AGG_RVA] - m->module[j].first_rva;
+		for(r = 0; r < num_member; r++)
+			free(rva[r]);
+		free(rva);
+		free(num);
+		free(pos);
+		}
+	free(acc.count);
+	free(acc.seen);
+	free(acc.touched);
+	free(acc.edge);
+}
+
+static void
+agg_column_start(FILE *out, agg_header_data *hdr, int column, uint64_t entries)
+{
+	static const char pad[8];
+	long pos;
+
+	pos = ftell(out);
+	if(pos & 7)
+		{
+		fwrite(pad, 1, 8 - (pos & 7), out);
+		pos += 8 - (pos & 7);
+		}
+	hdr->column[column].offset = pos;
+	hdr->column[column].entries = entries;
+}
+
+static void
+agg_column_copy(FILE *out, agg_header_data *hdr, int column, FILE *tmp, uint64_t entries)
+{
+	char buf[65536];
+	size_t len;
+
+	agg_column_start(out, hdr, column, entries);
+	rewind(tmp);
+	while((len = fread(buf, 1, sizeof(buf), tmp)) > 0)
+		if(fwrite(buf, 1, len, out) != len)
 			break;
-		case 's':
-			if((add != 0) || (num_dir < 2))
-				err(1," cannot set both -a and -s or value of -n argument less than 2");
-			sub = 1;
+	if(ferror(tmp))
+		err(1,"failed to read a temporary aggregate column");
+	fclose(tmp);
+}
+
+static void
+agg_merge(char **path, int n, char *out_path)
+{
+	agg_merge_data m;
+	agg_header_data hdr;
+	agg_input_ptr in;
+	int64_t *global_count;
+	double *global_multiplex, sum, weight;
+	FILE *out;
+	int i, c;
+
+	in = merge_calloc(n, sizeof(agg_input_data));
+	for(i = 0; i < n; i++)
+		agg_input_open(&in[i], path[i], (i > 0) ? &in[0] : NULL);
+	memset(&m, 0, sizeof(m));
+	m.count = in[0].hdr->count;
+	for(c = 0; c < NUM_AGG_COLUMNS; c++)
+		{
+		m.column[c] = tmpfile();
+		if(m.column[c] == NULL)
+			err(1,"cannot create a temporary aggregate column");
+		}
+
+	agg_merge_modules(&m, in, n);
+	agg_merge_rvas(&m, in);
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, AGG_MAGIC, sizeof(hdr.magic));
+	hdr.version = AGG_VERSION;
+	hdr.num_columns = NUM_AGG_COLUMNS;
+	hdr.num_events = in[0].hdr->num_events;
+	hdr.num_cores = in[0].hdr->num_cores;
+	hdr.num_sockets = in[0].hdr->num_sockets;
+	hdr.count = m.count;
+	hdr.data_offset = in[0].hdr->data_offset;
+	hdr.data_size = in[0].hdr->data_size;
+	hdr.event_hash = in[0].hdr->event_hash;
+	for(i = 0; i < n; i++)
+		for(c = 0; c < AGG_NUM_SCALARS; c++)
+			{
+			if((c == AGG_LBR_RET) || (c == AGG_LBR_ANY))
+				hdr.scalar[c] |= in[i].hdr->scalar[c];
+			else
+				hdr.scalar[c] += in[i].hdr->scalar[c];
+			}
+	global_count = merge_calloc(m.count, sizeof(int64_t));
+	global_multiplex = merge_calloc(m.count, sizeof(double));
+	for(c = 0; c < m.count; c++)
+		{
+		sum = weight = 0.0;
+		for(i = 0; i < n; i++)
+			{
+			global_count[c] += in[i].global_count[c];
+			sum += (double)in[i].global_count[c]*in[i].global_multiplex[c];
+			weight += (double)in[i].global_count[c];
+			}
+		global_multiplex[c] = (weight != 0.0) ? sum/weight : in[0].global_multiplex[c];
+		}
+
+	out = fopen(out_path, "w");
+	if(out == NULL)
+		err(1,"cannot create aggregate file %s",out_path);
+	fwrite(&hdr, sizeof(hdr), 1, out);
+	for(c = 0; c < NUM_AGG_COLUMNS; c++)
+		{
+		switch(c) {
+		case AGG_GLOBAL_COUNT:
+			agg_column_start(out, &hdr, c, m.count);
+			fwrite(global_count, sizeof(int64_t), m.count, out);
+			break;
+		case AGG_GLOBAL_MULTIPLEX:
+			agg_column_start(out, &hdr, c, m.count);
+			fwrite(global_multiplex, sizeof(double), m.count, out);
+			break;
+		case AGG_PROCESS:
+			agg_column_start(out, &hdr, c, m.np);
+			fwrite(m.process, sizeof(agg_process_data), m.np, out);
+			break;
+		case AGG_PROCESS_COUNT:
+			agg_column_start(out, &hdr, c, (uint64_t)m.np*m.count);
+			fwrite(m.process_count, sizeof(int64_t), (size_t)m.np*m.count, out);
+			break;
+		case AGG_MODULE:
+			agg_column_start(out, &hdr, c, m.nm);
+			fwrite(m.module, sizeof(agg_module_data), m.nm, out);
+			break;
+		case AGG_MODULE_COUNT:
+			agg_column_start(out, &hdr, c, (uint64_t)m.nm*m.count);
+			fwrite(m.module_count, sizeof(int64_t), (size_t)m.nm*m.count, out);
 			break;
 		default:
-			errx(1, "invalid argument key");
+			agg_column_copy(out, &hdr, c, m.column[c], m.entries[c]);
+			m.column[c] = NULL;
+			break;
+			}
 		}
-	}
-	fprintf(stderr,"exited input arg case statement\n");
-//	create_dir();
+	rewind(out);
+	fwrite(&hdr, sizeof(hdr), 1, out);
+	if(ferror(out) || (fclose(out) != 0))
+		err(1,"failed to write aggregate file %s",out_path);
+
+	for(c = 0; c < NUM_AGG_COLUMNS; c++)
+		if(m.column[c] != NULL)
+			fclose(m.column[c]);
+	for(i = 0; i < n; i++)
+		agg_input_close(&in[i]);
+	free(in);
+	free(global_count);
+	free(global_multiplex);
+	free(m.process);
+	free(m.process_count);
+	free(m.module);
+	free(m.module_count);
+	free(m.member_first);
+	free(m.member_num);
+	free(m.member);
+}
+
+//	the merge tree
+
+static void
+merge_group(merge_level_data *level, int group)
+{
+	int first = group*fan_in, n;
+
+	n = level->num_in - first;
+	if(n > fan_in)
+		n = fan_in;
+	if(merge_kind == MERGE_AGGREGATE)
+		agg_merge(&level->in[first], n, level->out[group]);
+	else
+		report_merge(&level->in[first], n, level->out[group]);
+}
+
+static void *
+merge_worker(void *arg)
+{
+	merge_level_data *level = (merge_level_data *)arg;
+	int group;
 
-	for(i=1; i<=num_dir; i++)
+	while((group = __sync_fetch_and_add(&level->next, 1)) < level->num_out)
+		merge_group(level, group);
+	return NULL;
+}
+
+static void
+merge_run(merge_level_data *level)
+{
+	pthread_t *threads;
+	int i, n, ret;
+
+	level->next = 0;
+	n = (merge_threads < level->num_out) ? merge_threads : level->num_out;
+	if(n <= 1)
 		{
-		len1 = strlen(input_properties[i].path);
-		fprintf(stderr," i = %d, len1 = %d, path = %s\n",i,len1,input_properties[i].path);
-		ret = read_platform_properties(i);
-		if(ret != 0)
-			err(1,"could not read platform properties for path %d = %s",i,input_properties[i].path);
-		ret = read_func_table(i);
+		merge_worker(level);
+		return;
+		}
+	threads = merge_calloc(n, sizeof(pthread_t));
+	for(i = 0; i < n; i++)
+		{
+		ret = pthread_create(&threads[i], NULL, merge_worker, level);
 		if(ret != 0)
-			err(1,"could not read function table for path %d = %s",i,input_properties[i].path);
+			errx(1,"failed to create merge thread %d, error %d",i,ret);
+		}
+	for(i = 0; i < n; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+
+//	remove an intermediate result
+static void
+merge_remove(char *path)
+{
+	char *name;
+
+	if(merge_kind == MERGE_AGGREGATE)
+		{
+		unlink(path);
+		return;
+		}
+	name = merge_path(path, proc_str);
+	unlink(name);
+	free(name);
+	name = merge_path(path, func_str);
+	unlink(name);
+	free(name);
+	name = merge_path(path, prop_str);
+	unlink(name);
+	free(name);
+	name = merge_path(path, "");
+	rmdir(name);
+	free(name);
+	rmdir(path);
+}
+
+static void
+merge_tree(char **in, int num_in, char *output)
+{
+	merge_level_data level;
+	char tmp_dir[] = "multi_perf.XXXXXX";
+	size_t len;
+	int depth = 0, g;
+
+	level.in = in;
+	level.num_in = num_in;
+	while(level.num_in > fan_in)
+		{
+		if((depth == 0) && (mkdtemp(tmp_dir) == NULL))
+			err(1,"cannot create a temporary directory");
+		level.num_out = (level.num_in + fan_in - 1)/fan_in;
+		level.out = merge_calloc(level.num_out, sizeof(char *));
+		for(g = 0; g < level.num_out; g++)
+			{
+			len = strlen(tmp_dir) + 32;
+			level.out[g] = merge_calloc(len, 1);
+			snprintf(level.out[g], len, "%s/%d_%d%s", tmp_dir, depth, g, (merge_kind == MERGE_AGGREGATE) ? ".agg" : "");
+			}
+		merge_run(&level);
+		fprintf(stderr,"multi_perf: level %d merged %d inputs into %d\n",depth,level.num_in,level.num_out);
+		if(depth > 0)
+			{
+			for(g = 0; g < level.num_in; g++)
+				{
+				merge_remove(level.in[g]);
+				free(level.in[g]);
+				}
+			free(level.in);
+			}
+		level.in = level.out;
+		level.num_in = level.num_out;
+		depth++;
+		}
+	level.out = &output;
+	level.num_out = 1;
+	merge_run(&level);
+	if(depth > 0)
+		{
+		for(g = 0; g < level.num_in; g++)
+			{
+			merge_remove(level.in[g]);
+			free(level.in[g]);
+			}
+		free(level.in);
+		rmdir(tmp_dir);
 		}
+	fprintf(stderr,"multi_perf: merged %d inputs into %s\n",num_in,output);
+}
 
+void
+usage()
+{
+	fprintf(stderr,"Usage: multi_perf [-h] [-j threads] [-f fan_in] [-o output] input ...\n");
+	fprintf(stderr," multi_perf sums the profiles of many gooda runs. The inputs are either all report directories,\n");
+	fprintf(stderr,"   whose spreadsheets/process.csv and function_hotspots.csv are merged into output/spreadsheets\n");
+	fprintf(stderr,"   (default ./spreadsheets), or all gooda --aggregate files, merged into the aggregate file output\n");
+	fprintf(stderr,"   (default merged.agg) for gooda -i first_perf.data --from-aggregate output.\n");
+	fprintf(stderr," gooda refuses modules whose build-id differs from the one first_perf.data recorded.\n");
+	fprintf(stderr," Aggregates must come from runs with the same events and topology.\n");
+	fprintf(stderr," The inputs are merged fan_in at a time (-f, default 16) in ./multi_perf.XXXXXX, on -j threads\n");
+	fprintf(stderr,"   (default 1), then the results are merged the same way until one is left.\n");
+	fprintf(stderr," The difference of two reports is computed by gooda_diff.py.\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	char *output = NULL;
+	int c, i;
+
+	while ((c= getopt(argc, argv, "hj:f:o:")) != -1) {
+		switch(c) {
+		case 'h':
+			usage();
+			exit(0);
+		case 'j':
+			merge_threads = atoi(optarg);
+			if(merge_threads < 1)
+				errx(1, "-j requires a thread count >= 1");
+			break;
+		case 'f':
+			fan_in = atoi(optarg);
+			if(fan_in < 2)
+				errx(1, "-f requires a fan in >= 2");
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	if(optind >= argc)
+		{
+		usage();
+		exit(1);
+		}
+	merge_kind = merge_input_kind(argv[optind]);
+	for(i = optind + 1; i < argc; i++)
+		if(merge_input_kind(argv[i]) != merge_kind)
+			errx(1,"%s and %s are not the same kind of input, merge report directories or aggregate files",
+				argv[optind],argv[i]);
+	if(output == NULL)
+		output = (merge_kind == MERGE_AGGREGATE) ? "merged.agg" : ".";
+	merge_tree(&argv[optind], argc - optind, output);
+	return 0;
 }
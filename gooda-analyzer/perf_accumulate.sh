@@ -19,23 +19,13 @@ fi
 new_dir=$2+$1
 echo "new temp directory (new + old) is" $new_dir
 echo $new_dir >> index
-mkdir $new_dir
-mkdir $new_dir/spreadsheets
-gooda_sum.py ./$1/spreadsheets/process.csv ./$2/spreadsheets/process.csv > ./$new_dir/spreadsheets/process.csv
+multi_perf -o $new_dir $1 $2
 ret=$?
 zero=0
-echo ret = $reta
-if [ $ret -ne $zero ]
-	then
-		echo "gooda_accumulate.py failed on process.csv"
-		exit
-fi
-gooda_sum.py ./$1/spreadsheets/function_hotspots.csv ./$2/spreadsheets/function_hotspots.csv > ./$new_dir/spreadsheets/function_hotspots.csv
-ret=$?
 echo ret = $ret
 if [ $ret -ne $zero ]
 	then
-		echo "gooda_accumulate.py failed on function_hotspot.csv"
+		echo "multi_perf failed"
 		exit
 fi
 
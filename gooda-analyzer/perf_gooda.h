@@ -64,6 +64,7 @@ typedef struct mmap_struc{
 	uint64_t	tsc_start;
 	uint64_t	tsc_end;
 	uint64_t	last_pgoff;
+	uint64_t	stamp;		/* larger = nearer the top of the process mmap stack */
 	int		is_kernel;
 	}mmap_data;
 
@@ -127,6 +128,12 @@ typedef struct read_struc{
 	uint32_t	size;
 	}read_data;
 
+typedef struct buildid_struc{
+	buildid_struc_ptr	next;
+	char*		filename;
+	char*		buildid;	/* hex, as recorded in the perf.data header */
+	}buildid_data;
+
 typedef struct raw_sample_struc{
 	raw_sample_struc_ptr	next;
 	raw_sample_struc_ptr	previous;
@@ -193,11 +200,12 @@ typedef struct derived_event_struc{
 extern mmap_struc_ptr  mmap_stack, mmap_current, kernel_mmap, previous_mmap;
 extern comm_struc_ptr	comm_stack, comm_current;
 extern int global_flag1,global_flag2;
-extern double sqrt_five, max_entry_fraction, sum_cutoff;
+extern double sum_cutoff;
 extern event_name_struc_ptr event_list;
 extern event_order_struc_ptr global_event_order;
 extern derived_sample_data* derived_events;
 extern int debug_flag;
+extern buildid_struc_ptr build_ll;
 
 mmap_struc_ptr mmap_struc_create();
 lost_struc_ptr lost_struc_create();
@@ -53,7 +53,7 @@ mmap_struc_create(void)
         this_struc->tsc_end = 0;
         this_struc->last_pgoff = 0;
 */
-	this_struc = calloc(1,sizeof(mmap_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(mmap_data));
         return this_struc;
 }
 
@@ -70,7 +70,7 @@ lost_struc_create(void)
         this_struc->id = 0;
         this_struc->lost = 0;
 */
-	this_struc = calloc(1,sizeof(lost_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(lost_data));
         return this_struc;
 }
 
@@ -89,7 +89,7 @@ comm_struc_create(void)
         this_struc->pid = 0;
         this_struc->tid = 0;
 */
-	this_struc = calloc(1,sizeof(comm_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(comm_data));
         return this_struc;
 }
 
@@ -108,7 +108,7 @@ exit_struc_create(void)
         this_struc->tid = 0;
         this_struc->ptid = 0;
 */
-	this_struc = calloc(1,sizeof(exit_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(exit_data));
         return this_struc;
 }
 
@@ -125,7 +125,7 @@ throttle_struc_create(void)
         this_struc->id = 0;
         this_struc->stream_id = 0;
 */
-	this_struc = calloc(1,sizeof(throttle_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(throttle_data));
         return this_struc;
 }
 
@@ -142,7 +142,7 @@ unthrottle_struc_create(void)
         this_struc->id = 0;
         this_struc->stream_id = 0;
 */
-	this_struc = calloc(1,sizeof(unthrottle_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(unthrottle_data));
         return this_struc;
 }
 
@@ -159,7 +159,7 @@ fork_struc_create(void)
         this_struc->ptid = 0;
         this_struc->time = 0;
 */
-	this_struc = calloc(1,sizeof(fork_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(fork_data));
         return this_struc;
 }
 
@@ -176,7 +176,7 @@ read_struc_create(void)
         this_struc->time = 0;
         this_struc->size = 0;
 */
-	this_struc = calloc(1,sizeof(read_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(read_data));
         return this_struc;
 }
 
@@ -198,7 +198,7 @@ raw_sample_struc_create(void)
 	this_struc->tid = 0;
 	this_struc->cpu = 0;
 */
-	this_struc = calloc(1,sizeof(raw_sample_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(raw_sample_data));
         return this_struc;
 }
 
@@ -212,6 +212,6 @@ pmu_programming_struc_create(void)
         this_struc->next = NULL;
         this_struc->previous = NULL;
 */
-	this_struc = calloc(1,sizeof(pmu_programming_data));
+	this_struc = arena_alloc(ARENA_RECORD, sizeof(pmu_programming_data));
         return this_struc;
 }
@@ -24,7 +24,11 @@ limitations under the License.
 #include <string.h>
 #include <getopt.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <time.h>
 #include <err.h>
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -34,6 +38,7 @@ limitations under the License.
 #include "gooda.h"
 #include "perf_gooda.h"
 #include "gooda_util.h"
+#include "gooda_log.h"
 
 int max_record=0, record_count=0;
 
@@ -58,6 +63,7 @@ int bad_rva =0, global_rva = 0,bad_sample_count=0,total_function_sample_count =
 int asm_cutoff = 0, func_cutoff = 50, source_cutoff = 50, max_bb = 250, max_branch = 10;
 int asm_cutoff_def = 20, asm_cutoff_big = 200, big_func_count = 500;
 int num_branch, num_sub_branch, num_derived;
+int num_threads = 1;
 int source_index=0, target_index=0, bb_exec_index = 0, sw_inst_retired_index = 0, next_taken_index = 0;
 int source_column = 0, target_column = 0, bb_exec_column = 0, sw_inst_retired_column = 0, next_taken_column = 0;
 int rs_empty_duration_index, call_index, mispredict_index, indirect_index;
@@ -65,7 +71,8 @@ int rs_empty_duration_index, call_column, mispredict_column, indirect_column;
 int *id_array, num_cores=0, num_sockets=2, *socket, num_events=0;
 uint64_t min_event_id=0xFFFFFFFFFFFFFFFFUL;
 int default_hash_length=10000, max_default_entries=2000;
-double sqrt_five, max_entry_fraction = 0.2, sum_cutoff = 0.95;
+char *local_bin_dir = "./binaries";
+double sum_cutoff = 0.95;
 int pop_threshold=0xFF;
 int *global_sample_count, total_sample_count=0;
 double *global_multiplex_correction, uop_issue_rate = 3.0;
@@ -110,8 +117,8 @@ branch_func *branch_func_array;
 
 int min_id_event=-1, max_id_event=-1;
 char *gooda_dir = GOODA_DIR;
-int sample_struc_count=0, asm_struc_count=0, basic_block_struc_count=0;
-uint64_t total_struc_size;
+uint64_t sample_count_bytes=0;
+int mem_sample_count=0, cct_sample_count=0, lbr_outcome_count=0, lbr_cycles_count=0;
 uint64_t * core_start_time, * core_last_time;
 
 char *subst_path_prefix[2]; /* 0 = old path, 1 = new path */
@@ -122,6 +129,11 @@ typedef struct lbr_record_struc{
 	uint64_t	source;
 	uint64_t	destination;
 	int		mispredict;
+	int		predicted;		/* either bit set means the prediction is known */
+	int		in_tx;
+	int		abort;
+	int		cycles;			/* since the previous (older) branch, 0 if not timed */
+	int		type;
 	}lbr_record_data;
 lbr_record_data* lbr_data;
 
@@ -163,6 +175,7 @@ static const char *__perf_magic = "PERFFILE";
 static const uint64_t __perf_magic2    = 0x32454c4946524550ULL;
 static const uint64_t __perf_magic2_sw = 0x50455246494c4532ULL;
 
+static int skip_callchains = 0;		/* set by stream_init, see streaming snapshots */
 static event_id_t *event_ids;		/* table of all the event ids */
 static struct perf_file_attr *attrs;	/* table of all attrs */
 static int nr_attrs;			/* number of elements in attrs */
@@ -179,8 +192,139 @@ get_count(void)
 }
 
 /*
- * read a chunk of buffer. Use actual file read for now.
- * Could use mmap() in the future
+ * regular files are mmap'ed rather than read one field at a time.
+ * Files up to map_window_max are mapped in one piece, bigger files
+ * are walked through with a sliding window of that size so we do not
+ * exhaust the address space on 32 bit hosts or multi-GB captures.
+ */
+#if __SIZEOF_POINTER__ >= 8
+static size_t map_window_max = (size_t)4096*1024*1024;
+#else
+static size_t map_window_max = (size_t)256*1024*1024;
+#endif
+
+/*
+ * make sure [pos, pos+sz) lies inside the current mmap window,
+ * moving the window if needed. Returns a pointer to pos.
+ */
+static inline char *
+map_buffer(bufdesc_t *desc, uint64_t pos, size_t sz)
+{
+	uint64_t start;
+	size_t len;
+	long page_size;
+
+	if ((pos >= desc->map_pos) && ((pos + sz) <= (desc->map_pos + desc->map_len)))
+		return desc->map + (pos - desc->map_pos);
+
+	if ((pos + sz) > desc->file_size)
+		err(1, "trying to map beyond the end of the file, pos = %"PRIu64", size = %zu", pos, sz);
+
+	if (desc->map != NULL)
+		munmap(desc->map, desc->map_len);
+
+	page_size = sysconf(_SC_PAGESIZE);
+	start = pos & ~((uint64_t)page_size - 1);
+	len = desc->map_window;
+	if (len < (pos - start) + sz)
+		len = (pos - start) + sz;
+	if (start + len > desc->file_size)
+		len = desc->file_size - start;
+
+	desc->map = mmap(NULL, len, PROT_READ|PROT_WRITE, MAP_PRIVATE, desc->fd, start);
+	if (desc->map == MAP_FAILED)
+		err(1, "cannot mmap %zu bytes at offset %"PRIu64, len, start);
+#ifdef DBUG
+	fprintf(stderr,"map_buffer: new window at offset %"PRIu64", len = %zu\n", start, len);
+#endif
+	madvise(desc->map, len, MADV_SEQUENTIAL);
+	desc->map_pos = start;
+	desc->map_len = len;
+
+	return desc->map + (pos - start);
+}
+
+/*
+ * switch desc to mmap mode if fd is a regular file.
+ * Pipes, fifos and sockets (perf record -o - | gooda -i -) are read in
+ * stream mode: strictly sequential read(), no seeking, and the data
+ * section runs until EOF. Anything else (failed mmap) keeps using lseek()/read()
+ */
+static void
+init_buffer_map(bufdesc_t *desc)
+{
+	struct stat stat;
+
+	desc->map = NULL;
+	desc->map_pos = 0;
+	desc->map_len = 0;
+	desc->map_window = 0;
+	desc->stream = 0;
+
+	if (fstat(desc->fd, &stat))
+		return;
+	if (!S_ISREG(stat.st_mode)) {
+		desc->stream = 1;
+		desc->cur.end = UINT64_MAX;
+		return;
+	}
+	if (stat.st_size == 0)
+		return;
+
+	desc->file_size = stat.st_size;
+	desc->map_window = map_window_max;
+	if ((uint64_t)desc->map_window > desc->file_size)
+		desc->map_window = desc->file_size;
+
+	desc->map = mmap(NULL, desc->map_window, PROT_READ|PROT_WRITE, MAP_PRIVATE, desc->fd, 0);
+	if (desc->map == MAP_FAILED) {
+		fprintf(stderr,"cannot mmap input file, falling back to read()\n");
+		desc->map = NULL;
+		desc->map_window = 0;
+		return;
+	}
+	madvise(desc->map, desc->map_window, MADV_SEQUENTIAL);
+	desc->map_len = desc->map_window;
+}
+
+static void
+close_buffer_map(bufdesc_t *desc)
+{
+	if (desc->map != NULL)
+		munmap(desc->map, desc->map_len);
+	desc->map = NULL;
+	desc->map_len = 0;
+	desc->map_window = 0;
+}
+
+/*
+ * read up to sz bytes from a stream, retrying partial reads.
+ * Returns the number of bytes read, less than sz only at EOF
+ */
+static size_t
+stream_read(bufdesc_t *desc, void *addr, size_t sz)
+{
+	size_t done = 0;
+	ssize_t ret;
+
+	while (done < sz) {
+		ret = read(desc->fd, (char *)addr + done, sz - done);
+		if (ret == 0)
+			break;
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			err(1, "cannot read %zu bytes from input stream", sz);
+		}
+		done += ret;
+	}
+	desc->cur.pos += done;
+	return done;
+}
+
+/*
+ * read a chunk of buffer. Copied straight out of the mmap window
+ * for regular files, actual file read for pipes
  */
 static void
 raw_read_buffer(bufdesc_t *desc, void *addr, size_t sz)
@@ -191,6 +335,18 @@ raw_read_buffer(bufdesc_t *desc, void *addr, size_t sz)
         if ((desc->cur.pos + sz) > desc->cur.end)
                 err(1, "trying to read beyond the end of the section");
 
+	if (desc->map_window) {
+		memcpy(addr, map_buffer(desc, desc->cur.pos, sz), sz);
+		desc->cur.pos += sz;
+		return;
+	}
+
+	if (desc->stream) {
+		if (stream_read(desc, addr, sz) < sz)
+			errx(1, "input stream ended inside a record");
+		return;
+	}
+
         off = lseek(desc->fd, desc->cur.pos, SEEK_SET);
         if (off == (off_t)-1)
                 err(1, "cannot seek to position %"PRIu64, desc->cur.pos);
@@ -208,10 +364,24 @@ raw_read_buffer(bufdesc_t *desc, void *addr, size_t sz)
 static int
 raw_skip_buffer(bufdesc_t *desc, size_t sz)
 {
+	char scratch[4096];
+	size_t len;
+
 	if ((desc->cur.pos + sz) > desc->cur.end)
 		return -1;
 
-	lseek(desc->fd, sz, SEEK_CUR);
+	if (desc->stream) {
+		while (sz) {
+			len = sz < sizeof(scratch) ? sz : sizeof(scratch);
+			if (stream_read(desc, scratch, len) < len)
+				return -1;
+			sz -= len;
+		}
+		return 0;
+	}
+
+	if (!desc->map_window)
+		lseek(desc->fd, sz, SEEK_CUR);
 	desc->cur.pos += sz;
 	return 0;
 }
@@ -287,13 +457,44 @@ bswap_event_attr(struct perf_event_attr *attr)
 static int
 read_buffer(bufdesc_t *desc, void *addr, size_t sz)
 {
+	size_t ret;
+
 	if (desc->cur.pos + sz > desc->data.end)
 		return -1;
 
+	/* a stream ends at EOF, but only between records */
+	if (desc->stream) {
+		ret = stream_read(desc, addr, sz);
+		if (ret == 0)
+			return -1;
+		if (ret < sz)
+			errx(1, "input stream ended inside a record");
+		return 0;
+	}
+
 	raw_read_buffer(desc, addr, sz);
 	return 0;
 }
 
+/*
+ * return a pointer to the next sz bytes of the data section and
+ * consume them, without copying. Only valid in mmap mode, returns
+ * NULL otherwise or when past the end of the data section.
+ * The pointer is only good until the next read from desc.
+ */
+static void *
+peek_buffer(bufdesc_t *desc, size_t sz)
+{
+	void *p;
+
+	if (!desc->map_window || (desc->cur.pos + sz > desc->data.end))
+		return NULL;
+
+	p = map_buffer(desc, desc->cur.pos, sz);
+	desc->cur.pos += sz;
+	return p;
+}
+
 /*
  * skip sz-sized chunk, but no beyond the end of
  * the data section
@@ -720,7 +921,7 @@ perf_display_raw(bufdesc_t *desc)
 static void
 perf_display_branch_stack(bufdesc_t *desc)
 {
-       struct perf_branch_entry b;
+       struct perf_branch_entry b, *bp;
        uint64_t nr;
        int ret, i;
 
@@ -743,33 +944,129 @@ perf_display_branch_stack(bufdesc_t *desc)
 #endif
 
        while (nr--) {
-               ret = read_buffer(desc, &b, sizeof(b));
-               if (ret)
-                       errx(1, "cannot read branch stack entry");
+//		decode in place from the mmap window when there is one
+		bp = peek_buffer(desc, sizeof(b));
+		if (bp == NULL) {
+			ret = read_buffer(desc, &b, sizeof(b));
+			if (ret)
+				errx(1, "cannot read branch stack entry");
+			bp = &b;
+		}
 
 		if (desc->needs_bswap) {
-			b.from = bswap_64(b.from);
-			b.to   = bswap_64(b.to);
-			mem_bswap_64((unsigned char *)(&b.to +1), sizeof(uint64_t));
+			bp->from = bswap_64(bp->from);
+			bp->to   = bswap_64(bp->to);
+			mem_bswap_64((unsigned char *)(&bp->to +1), sizeof(uint64_t));
 		}
 
 #ifdef ANALYZE
-		lbr_data[i].source = b.from;
-		lbr_data[i].destination = b.to;
-		lbr_data[i].mispredict = b.mispredicted;
+		lbr_data[i].source = bp->from;
+		lbr_data[i].destination = bp->to;
+		lbr_data[i].mispredict = bp->mispredicted;
+		lbr_data[i].predicted = bp->predicted;
+		lbr_data[i].in_tx = bp->in_tx;
+		lbr_data[i].abort = bp->abort;
+		lbr_data[i].cycles = bp->cycles;
+		lbr_data[i].type = bp->type;
 		i++;
 #endif
 #ifdef DBUG
-               fprintf(stderr,"\tFROM:0x%016"PRIx64" TO:0x%016"PRIx64" MISPRED:%c\n",
-                       b.from,
-                       b.to,
-                       !(b.mispredicted || b.predicted) ? '-':
-                       (b.mispredicted ? 'Y' :'N'));
+               fprintf(stderr,"\tFROM:0x%016"PRIx64" TO:0x%016"PRIx64" MISPRED:%c TX:%c ABORT:%c CYCLES:%d TYPE:%d\n",
+                       bp->from,
+                       bp->to,
+                       !(bp->mispredicted || bp->predicted) ? '-':
+                       (bp->mispredicted ? 'Y' :'N'),
+                       bp->in_tx ? 'Y' : 'N',
+                       bp->abort ? 'Y' : 'N',
+                       (int)bp->cycles, (int)bp->type);
 #endif
        }
 }
 
-static void perf_display_data_src(bufdesc_t *desc)
+//	PERF_SAMPLE_WEIGHT values are accumulated here instead of being printed
+//	for every sample, weight_report prints the summary once parsing is done.
+//	Bucket 0 counts zero weights, bucket i counts weights in [2^(i-1), 2^i),
+//	the last bucket takes everything above.
+#define WEIGHT_HIST_LEN	24
+
+typedef struct weight_stats_struc{
+	uint64_t	samples;
+	uint64_t	sum;
+	uint64_t	min;
+	uint64_t	max;
+	uint64_t	hist[WEIGHT_HIST_LEN];
+	}weight_stats_data;
+
+static weight_stats_data weight_stats = {0, 0, ~0ULL, 0, {0}};
+
+static void
+weight_add(uint64_t val)
+{
+	int bucket;
+
+	weight_stats.samples++;
+	weight_stats.sum += val;
+	if(val < weight_stats.min)weight_stats.min = val;
+	if(val > weight_stats.max)weight_stats.max = val;
+	bucket = (val == 0) ? 0 : 64 - __builtin_clzll(val);
+	if(bucket >= WEIGHT_HIST_LEN)bucket = WEIGHT_HIST_LEN - 1;
+	weight_stats.hist[bucket]++;
+}
+
+static void
+weight_report(void)
+{
+	int i;
+
+	if(weight_stats.samples == 0)
+		return;
+	gooda_log(GLOG_INFO,"sample weights: %"PRIu64" samples, mean = %.1f, min = %"PRIu64", max = %"PRIu64"\n",
+		weight_stats.samples, (double)weight_stats.sum/(double)weight_stats.samples,
+		weight_stats.min, weight_stats.max);
+	if(!log_enabled(GLOG_VERBOSE))
+		return;
+	for(i=0; i < WEIGHT_HIST_LEN; i++)
+		{
+		if(weight_stats.hist[i] == 0)
+			continue;
+		if(i == 0)
+			fprintf(stderr,"  weight 0            %"PRIu64"\n",weight_stats.hist[i]);
+		else if(i == WEIGHT_HIST_LEN - 1)
+			fprintf(stderr,"  weight >= %-9"PRIu64" %"PRIu64"\n",1ULL << (i - 1),weight_stats.hist[i]);
+		else
+			fprintf(stderr,"  weight < %-10"PRIu64" %"PRIu64"\n",1ULL << i,weight_stats.hist[i]);
+		}
+}
+
+//	data source class of a load or store for the per rva mem profile,
+//	-1 for samples that are neither
+static int
+mem_src_class(union perf_mem_data_src dsrc)
+{
+	uint64_t lvl = dsrc.mem_lvl;
+
+	if((dsrc.mem_op & (PERF_MEM_OP_LOAD | PERF_MEM_OP_STORE)) == 0)
+		return -1;
+	if(dsrc.mem_snoop & PERF_MEM_SNOOP_HITM)
+		return MEM_SRC_HITM;
+	if(lvl & (PERF_MEM_LVL_MISS | PERF_MEM_LVL_NA))
+		return MEM_SRC_OTHER;
+	if(lvl & PERF_MEM_LVL_L1)
+		return MEM_SRC_L1;
+	if(lvl & PERF_MEM_LVL_LFB)
+		return MEM_SRC_LFB;
+	if(lvl & PERF_MEM_LVL_L2)
+		return MEM_SRC_L2;
+	if(lvl & PERF_MEM_LVL_L3)
+		return MEM_SRC_L3;
+	if(lvl & PERF_MEM_LVL_LOC_RAM)
+		return MEM_SRC_LOCAL_RAM;
+	if(lvl & (PERF_MEM_LVL_REM_RAM1 | PERF_MEM_LVL_REM_RAM2 | PERF_MEM_LVL_REM_CCE1 | PERF_MEM_LVL_REM_CCE2))
+		return MEM_SRC_REMOTE;
+	return MEM_SRC_OTHER;
+}
+
+static int perf_display_data_src(bufdesc_t *desc)
 {
 	uint64_t val, lvl;
 	union perf_mem_data_src dsrc;
@@ -967,7 +1264,7 @@ static void perf_display_data_src(bufdesc_t *desc)
 #ifdef DBUG
 		fprintf(stderr, "] ");
 #endif
-
+	return mem_src_class(dsrc);
 }
 
 static void
@@ -976,9 +1273,10 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 	struct { uint32_t pid, tid; } pid;
 	uint64_t type = desc->sample_type;
 	uint64_t val64, ip, event_id = -1, id = -1, orig_event_id;
-	uint64_t time_enabled, time_running;
+	uint64_t time_enabled, time_running, weight = 0;
+	uint64_t chain[CCT_MAX_DEPTH];
 	struct { uint32_t cpu, reserved; } cpu;
-	int ret, i,j,k;
+	int ret, i,j,k, mem_src = -1, chain_len = 0;
         mmap_struc_ptr local_mmap, target_mmap;
 	process_struc_ptr principal_process;
 	module_struc_ptr this_module;
@@ -1277,6 +1575,11 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 			ret = read_buffer(desc, &ip, sizeof(ip));
 			if (ret)
 				errx(1, "cannot read ip");
+			if (desc->needs_bswap)
+				ip = bswap_64(ip);
+//			keep the innermost frames, skip the kernel/user context markers
+			if ((ip < PERF_CONTEXT_MAX) && (chain_len < CCT_MAX_DEPTH))
+				chain[chain_len++] = ip;
 
 #ifdef DBUG
 			fprintf(stderr,"\t0x%"PRIx64"\n", ip);
@@ -1303,14 +1606,17 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 
 		if (desc->needs_bswap)
 			val = bswap_64(val);
-//#ifdef DBUG
-#if 1
+		weight_add(val);
+		weight = val;
+#ifdef DBUG
 		fprintf(stderr,"WEIGHT:%"PRIu64" ", val);
 #endif
 	}
 
 	if (type & PERF_SAMPLE_DATA_SRC)
-		perf_display_data_src(desc);
+		mem_src = perf_display_data_src(desc);
+	else if (weight != 0)
+		mem_src = MEM_SRC_OTHER;
 #ifdef DBUG
 	fputc('\n',stderr);
 #endif
@@ -1382,7 +1688,8 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 //		fprintf(stderr,"found module in mmap, this_module path = %s, address %p\n",this_module->path,this_module);
 //		}
 	orig_event_id = event_id;
-	if(event_id < min_event_id)fprintf(stderr,"BAD EVENT ID = %ld, min_event_id = %ld\n",event_id,min_event_id);
+	if(event_id < min_event_id)
+		gooda_log_limit(GLOG_WARN, 10, "BAD EVENT ID = %ld, min_event_id = %ld\n",event_id,min_event_id);
         if(event_id == -1)
                 {
                 event_id = 0;
@@ -1391,7 +1698,8 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
                 {
                 event_id =  id_array[(int) (event_id - min_event_id)];
                 }
-	if(event_id > num_events)fprintf(stderr,"BAD EVENT ID orig = %ld, event_id = %ld\n",orig_event_id,event_id);
+	if(event_id > num_events)
+		gooda_log_limit(GLOG_WARN, 10, "BAD EVENT ID orig = %ld, event_id = %ld\n",orig_event_id,event_id);
 #ifdef DBUGA
         fprintf(stderr," found mmap for sample with pid = %d, ip = 0x%"PRIx64", at time = 0x%"PRIx64"\n",pid.pid,ip,this_time);
         fprintf(stderr," entering increment module structure, pid = %u, tid = %u, ip = 0x%"PRIx64",cpu = %d, mmap base = 0x%"PRIx64",time_enabled = %ld, time_running = %ld, id = %lu, event_id = %lu, orig_event_id = %lu\n",
@@ -1402,7 +1710,7 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 	if(core_start_time[cpu.cpu] == 0)core_start_time[cpu.cpu] = this_time;
 	core_last_time[cpu.cpu] = this_time;
 
-        ret = increment_module_struc(pid.pid,pid.tid,ip,event_id,cpu.cpu,local_mmap,time_enabled, time_running);
+        ret = increment_module_struc(pid.pid,pid.tid,ip,event_id,cpu.cpu,local_mmap,time_enabled, time_running, weight, mem_src);
 
 //		if(debug_flag == 1)
 #ifdef DBUGA
@@ -1413,6 +1721,12 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
                 fprintf(stderr,"failed to increment module struc for pid = %d, tid = %d, ip = 0x%"PRIx64"\n",pid.pid,pid.tid,ip);
                 err(1,"failed to increment module for sample");
                 }
+	if(window_ms != 0)
+		window_add(this_time, local_mmap, ip, event_id);
+	if((chain_len > 0) && !skip_callchains)
+		cct_add(pid.pid, this_time, chain, chain_len, event_id, principal_process);
+	else if(chain_len > 0)
+		gooda_log_limit(GLOG_WARN, 1," callchains are not collected with -s or -S, no calling context tree\n");
 //	check if address is greater than base address of kernel
 //	if so also add sample to psuedo pid = -1 to aggregate all kernel space activity
 	if(ip >= base_kern_address)
@@ -1423,8 +1737,8 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 		local_mmap = bind_sample(pid_ker,ip,this_time);
 		if(local_mmap == NULL)
 			{
+			gooda_log_limit(GLOG_WARN, 10, " could not find kernel mmap for sample with pid = %u, ip = 0x%"PRIx64", at time = 0x%"PRIx64"\n",pid.pid,ip,this_time);
 //#ifdef DBUGA
-			fprintf(stderr," could not find mmap for sample with pid = %u, ip = 0x%"PRIx64", at time = 0x%"PRIx64"\n",pid.pid,ip,this_time);
         //      	err(1,"failed to find mmap for sample");
 //#endif
 			return;
@@ -1438,7 +1752,7 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 
 //		fprintf(stderr,"kern addr: princ_proc = %p, this_mod = %p, local_mmap = %p, ip = 0x%"PRIx64"\n",
 //			principal_process,this_module,local_mmap,ip);
-		ret = increment_module_struc(pid_ker,tid_ker,ip,event_id,cpu.cpu,local_mmap,time_enabled, time_running);
+		ret = increment_module_struc(pid_ker,tid_ker,ip,event_id,cpu.cpu,local_mmap,time_enabled, time_running, weight, mem_src);
 		}
 
 //	find mmap's for source & destination
@@ -1468,6 +1782,8 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 				}
 			if(local_mmap->principal_process == NULL)principal_process = find_principal_process(local_mmap);
 			if(local_mmap->this_module == NULL)this_module = bind_mmap(local_mmap);
+			if(lbr_data[i].mispredict || lbr_data[i].predicted)
+				ret = increment_branch_outcome(local_mmap, lbr_data[i].source, lbr_data[i].mispredict);
 //	process the destination (call site + 1 instructions)
 			target_mmap = bind_sample(pid.pid,lbr_data[i].destination,this_time);
 		
@@ -1494,6 +1810,20 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 
 		for(i=num_lbr-1; i > 0; i--)
 			{
+//	process the next taken branch (lbr_data[i-1].source), it ends the block starting at lbr_data[i].destination
+			target_mmap = bind_sample(pid.pid,lbr_data[i-1].source,this_time);
+			if(target_mmap == NULL)
+				{
+#ifdef DBUGA
+				fprintf(stderr," bind sample failed for source %d at 0x%"PRIx64"\n",i-1,lbr_data[i-1].source);
+#endif
+				continue;
+				}
+			if(target_mmap->principal_process == NULL)principal_process = find_principal_process(target_mmap);
+			if(target_mmap->this_module == NULL)this_module = bind_mmap(target_mmap);
+//	the branch outcome only needs its own address, count it even when the block start does not bind
+			if(lbr_data[i-1].mispredict || lbr_data[i-1].predicted)
+				ret = increment_branch_outcome(target_mmap, lbr_data[i-1].source, lbr_data[i-1].mispredict);
 //	process the target = ip(target)
 			local_mmap = bind_sample(pid.pid,lbr_data[i].destination,this_time);
 			if(local_mmap == NULL)
@@ -1505,18 +1835,11 @@ display_sample(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_even
 				}
 			if(local_mmap->principal_process == NULL)principal_process = find_principal_process(local_mmap);
 			if(local_mmap->this_module == NULL)this_module = bind_mmap(local_mmap);
-//	process the next taken branch (lbr_data[i+1].source)
-			target_mmap = bind_sample(pid.pid,lbr_data[i-1].source,this_time);
-		
-			if(target_mmap == NULL)
-				{
-#ifdef DBUGA
-				fprintf(stderr," bind sample failed for destination %d at 0x%"PRIx64"\n",i-1,lbr_data[i-1].source);
-#endif
-				continue;
-				}
-			if(target_mmap->principal_process == NULL)principal_process = find_principal_process(target_mmap);
-			if(target_mmap->this_module == NULL)this_module = bind_mmap(target_mmap);
+//	timed LBRs, the cycles of entry i-1 cover the block from lbr_data[i].destination to its branch,
+//	blocks ending in a transaction abort did not run to the branch
+			if((lbr_data[i-1].cycles != 0) && !lbr_data[i-1].abort)
+				ret = increment_block_cycles(local_mmap, lbr_data[i].destination, lbr_data[i-1].cycles,
+					lbr_data[i-1].destination == lbr_data[i].destination);
 			ret = increment_next_taken_site(local_mmap, lbr_data[i].destination, lbr_data[i-1].source, target_mmap);
 			}
 		}
@@ -2016,6 +2339,7 @@ static void
 read_one_buildid(bufdesc_t *desc, struct perf_event_header *ehdr)
 {
         struct build_id_event_type b;
+        buildid_struc_ptr this_buildid;
         int i, len;
         char *str;
 
@@ -2041,7 +2365,19 @@ read_one_buildid(bufdesc_t *desc, struct perf_event_header *ehdr)
         }
         fprintf(stderr," %s\n", str);
 #endif
-        free(str);
+//	keep the ids so get_functionlist can spot stale binaries
+	this_buildid = (buildid_struc_ptr) malloc(sizeof(buildid_data));
+	if(this_buildid == NULL)
+		err(1, "cannot allocate memory for build id of %s", str);
+	this_buildid->buildid = (char *) malloc(2*BUILD_ID_SIZE + 1);
+	if(this_buildid->buildid == NULL)
+		err(1, "cannot allocate memory for build id of %s", str);
+	for (i = 0; i < BUILD_ID_SIZE; i++)
+		sprintf(this_buildid->buildid + 2*i, "%02x", b.build_id[i]);
+	str[len-1] = '\0';
+	this_buildid->filename = str;
+	this_buildid->next = build_ll;
+	build_ll = this_buildid;
 }
 
 static void
@@ -2071,7 +2407,7 @@ display_feature(bufdesc_t *desc, struct perf_event_header *ehdr, struct perf_eve
 
         feat = rec2feat[ehdr->type];
         if (feat == 0) {
-                fprintf(stderr,"unhandled feature record type %d\n", ehdr->type);
+                gooda_log_limit(GLOG_WARN, 10, "unhandled feature record type %d\n", ehdr->type);
                 skip_buffer(desc, ehdr->size - sizeof(*ehdr));
                 return;
         }
@@ -2112,6 +2448,183 @@ static record_ops_t record_ops[]={
 };
 #define NUM_RECORD_OPS	(sizeof(record_ops))/sizeof(record_ops_t));
 
+/*
+ * streaming snapshots
+ *
+ * With -s seconds and/or -S samples, parse() periodically writes a fresh
+ * function_hotspots.csv and process.csv to ./stream while it keeps reading,
+ * so a live perf record -o - pipe can be watched without restarting gooda.
+ * The aggregates are already bounded: they are keyed by process, module,
+ * function and rva, never by sample, so a long stream only grows them with
+ * the number of distinct addresses.
+ *
+ * The analysis rewrites and sorts the tables it reads, so it cannot run
+ * in place while samples keep coming in. Instead the ingest shards are
+ * drained and the reader forks: the child runs the spreadsheet part of the
+ * analysis on its copy-on-write snapshot in a private ./stream.tmp.<pid>,
+ * renames the two files into ./stream (readers never see a partial file)
+ * and exits, while the parent goes straight back to the pipe. A snapshot
+ * that comes due while the previous child still runs is skipped.
+ * The calling context tree and the --window rows grow with the length of
+ * the stream rather than with the code, so callchains are not collected
+ * and --window is rejected in this mode.
+ */
+static int snapshot_seconds = 0;	/* -s, 0 = off */
+static int snapshot_samples = 0;	/* -S, 0 = off */
+static time_t snapshot_time;
+static int snapshot_count;
+static pid_t snapshot_pid = 0;
+static int snapshot_done = 0;
+static int snapshot_records = 0;	/* the clock is read every STREAM_CLOCK_RECORDS records */
+#define STREAM_CLOCK_RECORDS	1024
+static char snapshot_dir[] = "stream";
+
+static void
+stream_init(void)
+{
+	char cwd[PATH_MAX];
+	char *path;
+	size_t len;
+
+	if (!snapshot_seconds && !snapshot_samples)
+		return;
+	if (mkdir(snapshot_dir, 0755) && (errno != EEXIST))
+		err(1, "cannot create snapshot directory ./%s", snapshot_dir);
+	/* the snapshot child runs in its own directory, it needs absolute paths to these */
+	if (getcwd(cwd, sizeof(cwd)) == NULL)
+		err(1, "cannot get current directory");
+	if (symcache_dir && (symcache_dir[0] != '/') && strcmp(symcache_dir, "none")) {
+		len = strlen(cwd) + strlen(symcache_dir) + 2;
+		path = malloc(len);
+		if (path == NULL)
+			err(1, "failed to malloc symbol cache path");
+		snprintf(path, len, "%s/%s", cwd, symcache_dir);
+		symcache_dir = path;
+	}
+	if (local_bin_dir[0] != '/') {
+		if (strncmp(local_bin_dir, "./", 2) == 0)
+			local_bin_dir += 2;
+		len = strlen(cwd) + strlen(local_bin_dir) + 2;
+		path = malloc(len);
+		if (path == NULL)
+			err(1, "failed to malloc binaries path");
+		snprintf(path, len, "%s/%s", cwd, local_bin_dir);
+		local_bin_dir = path;
+	}
+	skip_callchains = 1;
+	time(&snapshot_time);
+	snapshot_count = 0;
+	gooda_log(GLOG_INFO,"writing snapshots to ./%s every %d seconds, %d samples\n",
+		snapshot_dir, snapshot_seconds, snapshot_samples);
+}
+
+static void
+stream_move(const char *name)
+{
+	char from[PATH_MAX], to[PATH_MAX];
+
+	snprintf(from, sizeof(from), "spreadsheets/%s", name);
+	snprintf(to, sizeof(to), "../%s/%s", snapshot_dir, name);
+	if (rename(from, to))
+		gooda_log(GLOG_WARN,"snapshot: cannot move %s to %s\n", from, to);
+}
+
+//	runs in the forked child, never returns
+static void
+stream_child(void)
+{
+	char tmp_dir[64], command[128];
+	pointer_data *global_func_list = NULL;
+	int status = 0;
+
+	if (log_level > GLOG_WARN)
+		log_level--;
+	snprintf(tmp_dir, sizeof(tmp_dir), "%s.tmp.%d", snapshot_dir, (int)getpid());
+	if (mkdir(tmp_dir, 0755) || chdir(tmp_dir)) {
+		fprintf(stderr, "snapshot: cannot create %s\n", tmp_dir);
+		_exit(1);
+	}
+#ifdef ANALYZE
+	branch_edge_lists();
+	create_dir();
+	multiplex_correction();
+	reorder_process();
+	global_event_order = set_order(global_sample_count);
+	if (global_func_count >= 1) {
+		global_func_list = sort_global_func_list();
+		hotspot_function(global_func_list);
+		stream_move("function_hotspots.csv");
+	}
+	process_table();
+	stream_move("process.csv");
+#endif
+
+	snprintf(command, sizeof(command), "rm -rf %s", tmp_dir);
+	if (chdir("..") || system(command))
+		status = 1;
+	fflush(stderr);
+	_exit(status);
+}
+
+static void
+stream_reap(int hang)
+{
+	int status;
+
+	if (!snapshot_pid || (waitpid(snapshot_pid, &status, hang ? 0 : WNOHANG) == 0))
+		return;
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		gooda_log(GLOG_WARN,"snapshot %d did not complete\n", snapshot_done);
+	snapshot_pid = 0;
+}
+
+//	called by parse() after every record
+static void
+stream_tick(void)
+{
+	time_t now = 0;
+	int due = 0;
+
+	if (snapshot_samples && (total_sample_count - snapshot_count >= snapshot_samples))
+		due = 1;
+	if (snapshot_seconds && (++snapshot_records >= STREAM_CLOCK_RECORDS)) {
+		snapshot_records = 0;
+		now = time(NULL);
+		if (now - snapshot_time >= snapshot_seconds)
+			due = 1;
+	}
+	if (!due)
+		return;
+	if (now == 0)
+		now = time(NULL);
+	snapshot_records = 0;
+	snapshot_time = now;
+	snapshot_count = total_sample_count;
+
+	stream_reap(0);
+	if (snapshot_pid || (total_sample_count == 0))
+		return;
+
+	shard_sync();
+	fflush(NULL);
+	snapshot_pid = fork();
+	if (snapshot_pid == -1)
+		err(1, "cannot fork snapshot");
+	if (snapshot_pid == 0)
+		stream_child();
+	snapshot_done++;
+	gooda_log(GLOG_VERBOSE,"snapshot %d started at %d samples\n", snapshot_done, total_sample_count);
+}
+
+//	wait for the last snapshot before the final analysis
+static void
+stream_finish(void)
+{
+	stream_reap(1);
+	if (snapshot_done)
+		gooda_log(GLOG_INFO,"wrote %d snapshots to ./%s\n", snapshot_done, snapshot_dir);
+}
+
 static void
 parse(bufdesc_t *desc)
 {
@@ -2133,6 +2646,11 @@ parse(bufdesc_t *desc)
 		if (desc->needs_bswap)
 			bswap_ehdr(&ehdr);
 
+//		pull the whole record into the mmap window so the fields
+//		below are decoded from memory and the window only moves between records
+		if (desc->map_window && (opos + ehdr.size <= desc->data.end))
+			map_buffer(desc, opos, ehdr.size);
+
 		//fprintf(stderr,"SAMPLE.TYPE:%d SAMPLE.SZ:%d\n", ehdr.type, ehdr.size);
 
                 if (ehdr.type < PERF_RECORD_MMAP || ehdr.type >= PERF_RECORD_HEADER_MAX) {
@@ -2164,6 +2682,8 @@ skip:
 #endif
 			skip_buffer(desc, opos + ehdr.size - desc->cur.pos);
 		}
+		if (snapshot_seconds || snapshot_samples)
+			stream_tick();
 	}
 }
 
@@ -2335,13 +2855,13 @@ read_arch(bufdesc_t *desc, struct perf_file_header *hdr)
 		objdump_bin = local_objdump;
 		}
 	objdump_len = strlen(objdump_bin) + 1;
-	fprintf(stderr," objdump was %s\n",objdump_bin);
+	gooda_log(GLOG_VERBOSE," objdump was %s\n",objdump_bin);
 
 	sprintf(which_cmd,"which %s\0",objdump_bin);
 	which_out = popen(which_cmd, "r");
 	if(fgets(which_buf,pipe_buf_len,which_out) != NULL)
 		{
-		fprintf(stderr," objdump found at %s\n",which_buf);
+		gooda_log(GLOG_VERBOSE," objdump found at %s\n",which_buf);
 		found_objdump = 1;
 		}
 	else
@@ -2415,7 +2935,7 @@ read_cpuid(bufdesc_t *desc, struct perf_file_header *hdr)
 	if(j != 0)family = atoi(fam_str);
 	if(k != 0)model = atoi(model_str);
 //#ifdef DBUG
-	fprintf(stderr," family = %d, model = %d\n",family,model);
+	gooda_log(GLOG_VERBOSE," family = %d, model = %d\n",family,model);
 //#endif
         free(str);
 }
@@ -2469,7 +2989,7 @@ read_event_desc(bufdesc_t *desc, struct perf_file_header *hdr)
 	int previous_nri = -1;
 	void* ret_set;
 
-	fprintf(stderr," max_id = %ld, min_event_id = %ld\n",max_id, min_event_id);
+	gooda_log(GLOG_VERBOSE," max_id = %ld, min_event_id = %ld\n",max_id, min_event_id);
 	/* number of events */
 	raw_read_buffer(desc, &nre, sizeof(nre));
 
@@ -2550,7 +3070,7 @@ read_event_desc(bufdesc_t *desc, struct perf_file_header *hdr)
 		str = raw_read_string(desc);
 
 //#ifdef DBUG
-		fprintf(stderr,"# EVENT :name = %s, nri = %d ", str, nri);
+		gooda_log(GLOG_VERBOSE,"# EVENT :name = %s, nri = %d ", str, nri);
 //#endif
 
 //		free(str);
@@ -2569,7 +3089,7 @@ read_event_desc(bufdesc_t *desc, struct perf_file_header *hdr)
 #endif
 //#ifdef DBUG
 		if (nri)
-			fprintf(stderr,",  id = {");
+			gooda_log(GLOG_VERBOSE,",  id = {");
 //#endif
 
 		for (j = 0 ; j < nri; j++) {
@@ -2589,13 +3109,13 @@ read_event_desc(bufdesc_t *desc, struct perf_file_header *hdr)
 				}
 //#ifdef DBUG
 			if (j)
-				fputc(',',stderr);
-			fprintf(stderr," %"PRIu64, id);
+				gooda_log(GLOG_VERBOSE,",");
+			gooda_log(GLOG_VERBOSE," %"PRIu64, id);
 //#endif
 			}
 //#ifdef DBUG
 		if (nri && j == nri)
-			fprintf(stderr," }\n");
+			gooda_log(GLOG_VERBOSE," }\n");
 //#endif
 
 //	process event_desc, create map of event IDs to event numbers and call init_order
@@ -2659,11 +3179,11 @@ read_event_desc(bufdesc_t *desc, struct perf_file_header *hdr)
 		fprintf(stderr,"failed to malloc id_array, max_id = %ld, min_event_id = %ld\n",max_id,min_event_id);
 		err(1,"id_array malloc failed in read_event_desc");
 		}
-	fprintf(stderr," max_id = %ld, min_event_id = %ld\n",max_id, min_event_id);
-	fprintf(stderr,"num_events = %d, nri = %d, min_id_event = %d, max_id_event = %d\n",nre,nri,min_id_event,max_id_event); 
+	gooda_log(GLOG_VERBOSE," max_id = %ld, min_event_id = %ld\n",max_id, min_event_id);
+	gooda_log(GLOG_VERBOSE,"num_events = %d, nri = %d, min_id_event = %d, max_id_event = %d\n",nre,nri,min_id_event,max_id_event); 
 	for(i=0; i< nre; i++)
 		{
-		fprintf(stderr,"event_name = %s, first ids = %ld, last ids = %ld\n",event_list[i].name,global_attrs[i].ids[0],global_attrs[i].ids[nri-1]);
+		gooda_log(GLOG_VERBOSE,"event_name = %s, first ids = %ld, last ids = %ld\n",event_list[i].name,global_attrs[i].ids[0],global_attrs[i].ids[nri-1]);
 		for(j=0; j<global_attrs[i].nr_ids; j++)
 			id_array[(int)(global_attrs[i].ids[j] - min_event_id)] = i;
 		}
@@ -2731,9 +3251,9 @@ gooda_init()
 		(num_events*(num_cores+num_sockets+1) + num_branch + num_sub_branch + num_derived + 1)*sizeof(int) );
 
 	num_col = num_events+global_event_order->num_branch + global_event_order->num_sub_branch +global_event_order->num_derived + 1;
-	fprintf(stderr,"initialization: global_sample_count totals  ");
-	for(i=0; i< num_col; i++)fprintf(stderr," %d,",global_sample_count[num_events*(num_cores+num_sockets) + i]);
-	fprintf(stderr,"\n");
+	gooda_log(GLOG_VERBOSE,"initialization: global_sample_count totals  ");
+	for(i=0; i< num_col; i++)gooda_log(GLOG_VERBOSE," %d,",global_sample_count[num_events*(num_cores+num_sockets) + i]);
+	gooda_log(GLOG_VERBOSE,"\n");
 
 //      create global_multiplex_correction array
 
@@ -2764,7 +3284,7 @@ read_cpu_topology(bufdesc_t *desc, struct perf_file_header *hdr)
 		nr = bswap_32(nr);
 
 	socket_count = nr;
-	fprintf(stderr,"first value of nr = %d\n",nr);
+	gooda_log(GLOG_VERBOSE,"first value of nr = %d\n",nr);
         for (i = 0 ; i < nr; i++) {
                 str = raw_read_string(desc);
 #ifdef DBUG
@@ -2777,7 +3297,7 @@ read_cpu_topology(bufdesc_t *desc, struct perf_file_header *hdr)
 		nr = bswap_32(nr);
 	base_core_count = nr;
 	core_count = 0;
-	fprintf(stderr,"second value of nr = %d\n",nr);
+	gooda_log(GLOG_VERBOSE,"second value of nr = %d\n",nr);
         for (i = 0 ; i < nr; i++) {
                 str = raw_read_string(desc);
 		len = strlen(str);
@@ -2805,7 +3325,7 @@ read_cpu_topology(bufdesc_t *desc, struct perf_file_header *hdr)
 				}
 			}
 //		core_count += base_core_count;
-		fprintf(stderr," core_count = %d\n",core_count);
+		gooda_log(GLOG_VERBOSE," core_count = %d\n",core_count);
                 free(str);
         }
 #ifdef ANALYZE
@@ -2880,7 +3400,7 @@ read_numa_topology(bufdesc_t *desc, struct perf_file_header *hdr)
 				}
 			}
 //		core_count += base_core_count;
-		fprintf(stderr," core_count = %d\n",core_count);
+		gooda_log(GLOG_VERBOSE," core_count = %d\n",core_count);
                 free(str);
 
         }
@@ -3076,7 +3596,7 @@ read_feature_bits(bufdesc_t *desc, struct perf_file_header *hdr)
 	for (i=0; i < sizeof(hdr->adds_features)>>2; i++) {
 		if (desc->needs_bswap)
 			hdr->adds_features[i] = bswap_32(hdr->adds_features[i]);
-                fprintf(stderr, "f[%d]=0x%lx\n", i, hdr->adds_features[i]);
+                gooda_log(GLOG_VERBOSE,"f[%d]=0x%lx\n", i, hdr->adds_features[i]);
 	}
 
 	/* feature bits are after data section */
@@ -3215,6 +3735,13 @@ read_pipe_header(bufdesc_t *desc)
 #ifdef DBUG
         fprintf(stderr,"PIPED FILE DETECTED\n");
 #endif
+	/* detect_piped_file already consumed the header from the stream */
+	if (desc->stream) {
+		desc->data.pos = sizeof(hdr);
+		desc->data.end = UINT64_MAX;
+		return;
+	}
+
         ret = fstat(desc->fd, &stat);
         if (ret)
                 err(1, "cannot stat data file");
@@ -3245,6 +3772,18 @@ detect_piped_file(bufdesc_t *desc)
         bufdesc_t d = *desc;
         int ret;
 
+	/* a stream cannot be rewound, read the header for good */
+	if (desc->stream) {
+		raw_read_buffer(desc, &hdr, sizeof(hdr));
+		if (!validate_magic(desc, &hdr.magic))
+			errx(1, "not a perf.data stream");
+		if (desc->needs_bswap)
+			hdr.size = bswap_64(hdr.size);
+		if (hdr.size != sizeof(hdr))
+			errx(1, "input is a pipe but not in perf pipe format, record it with perf record -o -");
+		return 1;
+	}
+
         ret = fstat(desc->fd, &stat);
         if (ret)
                 err(1, "cannot stat data file");
@@ -3254,6 +3793,9 @@ detect_piped_file(bufdesc_t *desc)
         d.fd = dup(desc->fd);
         if (!d.fd)
                 err(1, "cannot duplicate file descriptor");
+	d.map = NULL;
+	d.map_len = 0;
+	d.map_window = 0;
 
         raw_read_buffer(&d, &hdr, sizeof(hdr));
 
@@ -3348,11 +3890,26 @@ check4gooda(bufdesc_t *desc)
 #endif
 }
 
+static struct option long_options[] = {
+	{"window", required_argument, NULL, 'w'},
+	{"aggregate", required_argument, NULL, 'a'},
+	{"from-aggregate", required_argument, NULL, 'A'},
+	{NULL, 0, NULL, 0},
+};
+
 static void usage(void)
 {
-	fprintf(stderr,"Usage: gooda [-v] [-h] [-i perf_data_file] [-n val] [-p old_prefix,new_prefix] [-p old_bin_prefix,new_bin_prefix] \n");
+	fprintf(stderr,"Usage: gooda [-v] [-h] [-q] [-d] [-i perf_data_file] [-n val] [-j threads] [-c cache_dir] [-r async|defer|none] [-s seconds] [-S samples] [-w|--window ms] [-a|--aggregate file] [--from-aggregate file] [-p old_prefix,new_prefix] [-p old_bin_prefix,new_bin_prefix] \n");
 	fprintf(stderr," by default gooda will try to read perf data from ./perf.data\n");
-	fprintf(stderr,"   use the -i option and the preferred file name to change this\n");
+	fprintf(stderr,"   use the -i option and the preferred file name to change this, -i - reads a perf record -o - pipe on stdin\n");
+	fprintf(stderr," While reading, -s seconds and/or -S samples periodically write function_hotspots.csv and process.csv\n");
+	fprintf(stderr,"   for the data read so far to ./stream, the full analysis still runs at the end of the input.\n");
+	fprintf(stderr,"   Callchains are not collected and --window is not allowed in this mode.\n");
+	fprintf(stderr," --window ms also counts the samples per ms long time window and writes the timeline_process, timeline_module\n");
+	fprintf(stderr,"   and timeline_function tables and spreadsheets/timeline.bin. Needs PERF_SAMPLE_TIME.\n");
+	fprintf(stderr," --aggregate file saves the profile once the samples are read, --from-aggregate file loads it instead of\n");
+	fprintf(stderr,"   reading the samples again, to redo the analysis with other -n, -p, -b, -r or -j options. -i must name the\n");
+	fprintf(stderr,"   same perf.data file in both runs, pipes are not supported. Call stacks and time windows are not saved.\n");
 	fprintf(stderr," by default gooda will attempt to create annoted disassembly and source listings, and CFG displays\n");
 	fprintf(stderr,"   for the hottest 20 functions. If there are more than 500 functions this limit is kicked up to 200\n");
 	fprintf(stderr,"   This limit can be changed by using the -n option followed by the number\n");
@@ -3360,6 +3917,13 @@ static void usage(void)
 	fprintf(stderr,"   Increasing the number will slightly increase the runtime\n");
 	fprintf(stderr," Source Path prefix can be substituted for another using the -p old_prefix,new_prefix option.\n");
 	fprintf(stderr," Bin Path prefix can be substituted for another using the -b old_bin_prefix,new_bin_prefix option.\n");
+	fprintf(stderr," The -j option sets the number of worker threads used to accumulate the samples and write the hot function reports, default 1.\n");
+	fprintf(stderr," Function lists are cached by build-id in -c cache_dir, default $XDG_CACHE_HOME/gooda or ~/.cache/gooda,\n");
+	fprintf(stderr,"   -c none turns the cache off.\n");
+	fprintf(stderr," The -r option selects how the call graph and cfg .dot files are rendered to svg: async runs dot on -j\n");
+	fprintf(stderr,"   background threads (default), defer writes the commands to spreadsheets/render.sh, none skips rendering.\n");
+	fprintf(stderr," -q prints less progress and diagnostic output, -qq only errors.\n");
+	fprintf(stderr," -d prints more diagnostic output and can be repeated, -v prints the version.\n");
 }
 
 /*
@@ -3373,17 +3937,24 @@ main(int argc, char **argv)
         pointer_data * global_func_list;
 	column_flag = 0;
 	char def_file[] = "perf.data";
-	char * file_name, *p, *b;
+	char * file_name, *p, *b, *aggregate_out = NULL, *aggregate_in = NULL;
 	struct rusage r_usage;
 
 	file_name = def_file;
 	asm_cutoff = asm_cutoff_def;	
 
-	while ((c= getopt(argc, argv, "i:n:v:hp:b:")) != -1) {
+	while ((c= getopt_long(argc, argv, "i:n:v::qdVhp:b:j:c:r:s:S:w:a:", long_options, NULL)) != -1) {
 		switch(c) {
 		case 'v':
+		case 'V':
 			fprintf(stderr,"perf_reader v%s\n", PERF_READER_VERSION);
 			exit(0);
+		case 'd':
+			if(log_level < GLOG_DEBUG)log_level++;
+			break;
+		case 'q':
+			if(log_level > GLOG_ERROR)log_level--;
+			break;
 		case 'h':
 			usage();
 			exit(0);
@@ -3418,29 +3989,94 @@ main(int argc, char **argv)
 		case 'n':
 			asm_cutoff = atoi(optarg);
 			break;
+		case 'j':
+			num_threads = atoi(optarg);
+			if (num_threads < 1)
+				errx(1, "-j requires a thread count >= 1");
+			break;
+		case 'c':
+			symcache_dir = optarg;
+			break;
+		case 'r':
+			if(strcmp(optarg, "async") == 0)
+				render_mode = RENDER_ASYNC;
+			else if(strcmp(optarg, "defer") == 0)
+				render_mode = RENDER_DEFER;
+			else if(strcmp(optarg, "none") == 0)
+				render_mode = RENDER_NONE;
+			else
+				errx(1, "-r requires async, defer or none");
+			break;
+		case 's':
+			snapshot_seconds = atoi(optarg);
+			if (snapshot_seconds < 1)
+				errx(1, "-s requires a snapshot interval >= 1 second");
+			break;
+		case 'S':
+			snapshot_samples = atoi(optarg);
+			if (snapshot_samples < 1)
+				errx(1, "-S requires a snapshot interval >= 1 sample");
+			break;
+		case 'w':
+			window_ms = atoi(optarg);
+			if (window_ms < 1)
+				errx(1, "--window requires a window length >= 1 ms");
+			break;
+		case 'a':
+			aggregate_out = optarg;
+			break;
+		case 'A':
+			aggregate_in = optarg;
+			break;
 		default:
 			errx(1, "invalid argument key");
 		}
 	}
+	if((window_ms != 0) && ((snapshot_seconds != 0) || (snapshot_samples != 0)))
+		errx(1, "--window cannot be combined with -s or -S, its rows grow with the length of the stream");
+	if((aggregate_in != NULL) && ((snapshot_seconds != 0) || (snapshot_samples != 0) || (window_ms != 0)))
+		errx(1, "--from-aggregate cannot be combined with -s, -S or --window, the samples are not read");
 	memset(&desc, 0, sizeof(desc));
 
 //	if (argc < 2)
 //		errx(1, "need to pass a perf.data file");
 
-	desc.fd = open(file_name, O_RDONLY);
+	if (strcmp(file_name, "-") == 0)
+		desc.fd = STDIN_FILENO;
+	else
+		desc.fd = open(file_name, O_RDONLY);
 	if (desc.fd == -1)
 		err(1, "argv[1] = %s, cannot open %s", argv[1],file_name);
+	init_buffer_map(&desc);
 
         if (detect_piped_file(&desc))
+		{
+		if((aggregate_out != NULL) || (aggregate_in != NULL))
+			errx(1, "--aggregate and --from-aggregate need a perf.data file, not a pipe");
                 read_pipe_header(&desc);
+		}
         else
 		{
                 read_file_header(&desc);
 		check4gooda(&desc);
 		}
-	parse(&desc);
+	if(aggregate_in != NULL)
+		aggregate_read(aggregate_in, desc.data.pos, desc.data.end - desc.data.pos);
+	else
+		{
+		if(num_threads > 1)
+			shard_init(num_threads);
+		stream_init();
+		parse(&desc);
+		stream_finish();
+		shard_finish();
+		branch_edge_lists();
+		weight_report();
+		if(aggregate_out != NULL)
+			aggregate_write(aggregate_out, desc.data.pos, desc.data.end - desc.data.pos);
+		}
 
-	fprintf(stderr,"finished reading input data file, commencing analysis\n");
+	gooda_log(GLOG_INFO,"finished reading input data file, commencing analysis\n");
 
 #ifdef ANALYZE
 #ifdef DBUGA
@@ -3453,6 +4089,7 @@ main(int argc, char **argv)
 	column_flag = 1;
 #endif
         reorder_process();
+	cct_report();
 
 	global_event_order = set_order(global_sample_count);
 
@@ -3470,7 +4107,7 @@ main(int argc, char **argv)
 //		loop through the hottest "asm_cuttoff" functions and create asm, source and cfg files
 		if(found_objdump == 1)
 		        hot_list(global_func_list);
-		fprintf(stderr,"normal termination\n");
+		gooda_log(GLOG_INFO,"normal termination\n");
 		}
 	else
 		{
@@ -3480,11 +4117,14 @@ main(int argc, char **argv)
        	hotspot_function( global_func_list);
 //		print out the process/module spreadsheet
 	process_table();
+//		print out the per time window tables
+	window_report();
+	render_finish();
 
 	num_col = num_events + global_event_order->num_branch + global_event_order->num_sub_branch +global_event_order->num_derived + 1;
-       	fprintf(stderr," bad rva count = %d, with %d samples, out of global_rva = %d, with %d total samples in modules with functions and %d total samples\n",
+       	gooda_log(GLOG_INFO," bad rva count = %d, with %d samples, out of global_rva = %d, with %d total samples in modules with functions and %d total samples\n",
 		bad_rva, bad_sample_count, global_rva, total_function_sample_count, total_sample_count);
-	fprintf(stderr," num_col = %d, num_events = %d, num_branch = %d, num_sub_branch = %d, num_derived = %d\n",
+	gooda_log(GLOG_VERBOSE," num_col = %d, num_events = %d, num_branch = %d, num_sub_branch = %d, num_derived = %d\n",
 		num_col, num_events, global_event_order->num_branch, global_event_order->num_sub_branch, global_event_order->num_derived);
 /*
 		fprintf(stderr,"main: global_sample_count totals  ");
@@ -3498,13 +4138,10 @@ main(int argc, char **argv)
 			fprintf(stderr,"\n");
 			}
 */
-	fprintf(stderr," total_lbr_entries = %d\n",total_lbr_entries);
-	total_struc_size = (uint64_t)sample_struc_count*(sizeof(sample_data) + sizeof(int)*get_count());
-	fprintf(stderr," total sample_struc's created = %d, for a total size of %ld\n",sample_struc_count, total_struc_size);
-	total_struc_size = (uint64_t)asm_struc_count*(sizeof(asm_data) + sizeof(int)*get_count());
-	fprintf(stderr," total asm_struc's created = %d, for a total size of %ld\n",asm_struc_count, total_struc_size);
-	total_struc_size = (uint64_t)basic_block_struc_count*(sizeof(basic_block_data) + sizeof(int)*get_count());
-	fprintf(stderr," total basic_block_struc's created = %d for a total size of %ld\n",basic_block_struc_count, total_struc_size);
+	gooda_log(GLOG_VERBOSE," total_lbr_entries = %d\n",total_lbr_entries);
+	if(log_enabled(GLOG_INFO))
+		arena_report();
+	symcache_report();
 	retval = getrusage(RUSAGE_SELF,&r_usage);
 	if(retval != 0)
 		{
@@ -3512,10 +4149,12 @@ main(int argc, char **argv)
 		}
 	else
 		{
-	retval = fprintf(stderr," total memory usage from getrusage = %ld\n",r_usage.ru_maxrss);
+	gooda_log(GLOG_INFO," total memory usage from getrusage = %ld\n",r_usage.ru_maxrss);
 		}
 #endif
+	log_report();
 
+	close_buffer_map(&desc);
 	close(desc.fd);
 	free(event_ids);
 	return 0;
@@ -18,23 +18,13 @@ fi
 
 new_dir=$2+$1
 echo "new directory (new + old) is" $new_dir
-mkdir $new_dir
-mkdir $new_dir/spreadsheets
-gooda_sum.py ./$1/spreadsheets/process.csv ./$2/spreadsheets/process.csv > ./$new_dir/spreadsheets/process.csv
+multi_perf -o $new_dir $1 $2
 ret=$?
 zero=0
 echo "ret = " $ret
 if [ $ret -ne $zero ]
     then
-	echo "gooda_sum.py failed on process.csv"
-        exit
-fi
-gooda_sum.py ./$1/spreadsheets/function_hotspots.csv ./$2/spreadsheets/function_hotspots.csv > ./$new_dir/spreadsheets/function_hotspots.csv
-ret=$?
-echo "ret = " $ret
-if [ $ret -ne $zero ]
-    then
-	echo "gooda_sum.py failed on function_hotspots.csv"
+	echo "multi_perf failed"
         exit
 fi
 echo $new_dir >> index
@@ -0,0 +1,287 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	stand alone micro benchmark for the per module rva -> sample_struc table
+//	of gooda_rva.c. It replays a sample stream for one hot module through the
+//	old chained table (sqrt(5) floating point hash, buckets chained one node
+//	at a time, table grown 10x at 20% fill) and through find_rva_sample, both
+//	creating and counting samples with gooda_create.c, and reports the
+//	throughput of each.
+//
+//	make rva_hash_bench
+//	./rva_hash_bench [distinct_ips [samples]]
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <math.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+
+#define NUM_COUNTS	8	/* counter columns the stream is spread over */
+
+//	globals of perf_gooda_read.c that gooda_create.c and gooda_rva.c read
+int num_events = NUM_COUNTS, num_cores = 0, num_sockets = 0;
+int num_branch = 0, num_sub_branch = 0, num_derived = 0;
+int default_hash_length = 10000;
+uint64_t sample_count_bytes = 0;
+
+//	old table, as it was in increment_module_struc / find_hash_entry / create_big_table
+
+typedef struct old_hash_struc * old_hash_struc_ptr;
+typedef struct old_hash_struc{
+	sample_struc_ptr	this_sample;
+	uint64_t		this_rva;
+	old_hash_struc_ptr	next;
+	}old_hash_data;
+
+typedef struct chain_table_struc{
+	int			size;
+	int			entries;
+	old_hash_data	*	this_array;
+	}chain_table_data;
+
+static double sqrt_five;
+
+static int
+chain_index(uint64_t rva, int size)
+{
+	double val;
+	uint64_t tmp;
+	int index;
+
+	val = (double) (rva & 0x7FFFFFFF);
+	val = val*sqrt_five;
+	tmp = (uint64_t) val;
+	index = (int) (tmp & 0x7FFFFFFF);
+	return index%size;
+}
+
+static chain_table_data *
+chain_create(int size)
+{
+	chain_table_data *this_table;
+
+	this_table = calloc(1, sizeof(chain_table_data));
+	if(this_table == NULL)
+		err(1,"failed to create chained table");
+	this_table->size = size;
+	this_table->this_array = calloc(size, sizeof(old_hash_data));
+	if(this_table->this_array == NULL)
+		err(1,"failed to create chained table array");
+	return this_table;
+}
+
+static chain_table_data *
+chain_grow(chain_table_data *old_table)
+{
+	chain_table_data *new_table;
+	old_hash_struc_ptr old_entry, this_entry, tmp_entry;
+	int i, index;
+
+	new_table = chain_create(10*old_table->size);
+	for(i = 0; i < old_table->size; i++)
+		{
+		if(old_table->this_array[i].this_rva == 0)
+			continue;
+		old_entry = &old_table->this_array[i];
+		while(old_entry != NULL)
+			{
+			index = chain_index(old_entry->this_rva, new_table->size);
+			this_entry = &new_table->this_array[index];
+			if(this_entry->this_rva != 0)
+				{
+				tmp_entry = this_entry;
+				while(tmp_entry->next != NULL)
+					tmp_entry = tmp_entry->next;
+				this_entry = calloc(1, sizeof(old_hash_data));
+				if(this_entry == NULL)
+					err(1,"failed to create hash entry");
+				tmp_entry->next = this_entry;
+				}
+			this_entry->this_rva = old_entry->this_rva;
+			this_entry->this_sample = old_entry->this_sample;
+			new_table->entries++;
+			old_entry = old_entry->next;
+			}
+		}
+//	the old code leaked the previous table, so does this
+	return new_table;
+}
+
+static sample_struc_ptr
+chain_find(chain_table_data **table_ptr, uint64_t rva)
+{
+	chain_table_data *this_table = *table_ptr;
+	old_hash_struc_ptr this_entry, tmp_entry;
+	sample_struc_ptr this_sample;
+	int index;
+
+	index = chain_index(rva, this_table->size);
+	this_entry = &this_table->this_array[index];
+	if(this_entry->this_rva != 0)
+		{
+		while(this_entry != NULL)
+			{
+			if(this_entry->this_rva == rva)
+				return this_entry->this_sample;
+			tmp_entry = this_entry;
+			this_entry = this_entry->next;
+			}
+		this_entry = calloc(1, sizeof(old_hash_data));
+		if(this_entry == NULL)
+			err(1,"failed to create hash entry");
+		tmp_entry->next = this_entry;
+		}
+	this_sample = sample_struc_create();
+	if(this_sample == NULL)
+		err(1,"failed to create sample struc");
+	this_sample->rva = rva;
+	this_entry->this_rva = rva;
+	this_entry->this_sample = this_sample;
+	this_table->entries++;
+	if(this_table->entries > this_table->size*0.2)
+		*table_ptr = chain_grow(this_table);
+	return this_sample;
+}
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + 1.0e-6*(double)tv.tv_usec;
+}
+
+//	small xorshift generator so both runs see the same stream
+static uint64_t
+next_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+int
+main(int argc, char **argv)
+{
+	uint64_t *ips, *stream, state;
+	long num_ips = 1000000, num_samples = 20000000, i;
+	chain_table_data *chain_table;
+	module_data this_module_data;
+	module_struc_ptr this_module = &this_module_data;
+	sample_struc_ptr this_sample;
+	uint64_t total, chain_check = 0, open_check = 0;
+	int found, j;
+	double t0, chain_time, open_time;
+
+	if(argc > 1)num_ips = atol(argv[1]);
+	if(argc > 2)num_samples = atol(argv[2]);
+	if((num_ips < 1) || (num_samples < 1))
+		errx(1,"usage: %s [distinct_ips [samples]]",argv[0]);
+	sqrt_five = sqrt(5.0);
+
+//	distinct instruction addresses spread over a 64MB text segment,
+//	half the samples go to the hottest 1% of them
+	ips = malloc(num_ips*sizeof(uint64_t));
+	stream = malloc(num_samples*sizeof(uint64_t));
+	if((ips == NULL) || (stream == NULL))
+		err(1,"failed to allocate the sample stream");
+	for(i = 0; i < num_ips; i++)
+		ips[i] = 0x400000 + 64*(uint64_t)i + (i % 13);
+	state = 0x2545F4914F6CDD1DULL;
+	for(i = num_ips - 1; i > 0; i--)
+		{
+		long j = (long)(next_rand(&state) % (uint64_t)(i + 1));
+		uint64_t tmp = ips[i];
+		ips[i] = ips[j];
+		ips[j] = tmp;
+		}
+	for(i = 0; i < num_samples; i++)
+		{
+		if(i < num_ips)
+			stream[i] = ips[i];
+		else if(next_rand(&state) & 1)
+			stream[i] = ips[next_rand(&state) % (uint64_t)(num_ips/100 + 1)];
+		else
+			stream[i] = ips[next_rand(&state) % (uint64_t)num_ips];
+		}
+	for(i = num_samples - 1; i > 0; i--)
+		{
+		long j = (long)(next_rand(&state) % (uint64_t)(i + 1));
+		uint64_t tmp = stream[i];
+		stream[i] = stream[j];
+		stream[j] = tmp;
+		}
+
+	chain_table = chain_create(10000);
+	t0 = now();
+	for(i = 0; i < num_samples; i++)
+		chain_check += (uintptr_t)chain_find(&chain_table, stream[i]);
+	chain_time = now() - t0;
+	arena_reset(ARENA_SAMPLE);
+
+	memset(this_module, 0, sizeof(module_data));
+	this_module->path = "bench";
+	t0 = now();
+	for(i = 0; i < num_samples; i++)
+		open_check += (uintptr_t)find_rva_sample(this_module, stream[i]);
+	open_time = now() - t0;
+
+//	count outside the timed loops, every sample must land on its own rva
+	for(i = 0; i < num_samples; i++)
+		{
+		this_sample = find_rva_sample(this_module, stream[i]);
+		if(this_sample->rva != stream[i])
+			errx(1,"rva 0x%"PRIx64" found the sample of rva 0x%"PRIx64,stream[i],this_sample->rva);
+		sample_count_add(this_sample, i & (NUM_COUNTS - 1), 1);
+		}
+
+	found = 0;
+	total = 0;
+	for(this_sample = this_module->first_sample; this_sample != NULL; this_sample = this_sample->next)
+		{
+		found++;
+		for(j = 0; j < NUM_COUNTS; j++)
+			total += sample_count_get(this_sample, j);
+		}
+	if((found != chain_table->entries) || (this_module->this_table->entries != chain_table->entries))
+		errx(1,"tables disagree, chained %d entries, find_rva_sample %d entries, %d samples",
+			chain_table->entries,this_module->this_table->entries,found);
+	if(total != (uint64_t)num_samples)
+		errx(1,"find_rva_sample counted %"PRIu64" of %ld samples",total,num_samples);
+	printf("%ld samples over %d distinct ips\n",num_samples,chain_table->entries);
+	printf("chained sqrt(5) table   %8.3f s  %8.2f Msamples/s\n",chain_time,1.0e-6*(double)num_samples/chain_time);
+	printf("find_rva_sample         %8.3f s  %8.2f Msamples/s\n",open_time,1.0e-6*(double)num_samples/open_time);
+	printf("speedup %.2fx\n",chain_time/open_time);
+//	the pointer sums only keep the timed lookups from being optimized away
+	if((chain_check == 0) || (open_check == 0))
+		errx(1,"no samples found");
+	return 0;
+}
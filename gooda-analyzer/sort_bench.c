@@ -0,0 +1,223 @@
+/*
+Copyright 2012 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+ */
+
+//	stand alone benchmark for gooda_sort.c. It builds function lists the
+//	size of a small library, libc, vmlinux and a large C++ binary, in symbol
+//	table order (mostly sorted) and shuffled, and times the old first element
+//	pivot quicksort from analyzer.c, libc qsort and radix_sort on one and on
+//	threads threads. The old quicksort is skipped where its recursion on
+//	sorted input would take minutes or overflow the stack.
+//
+//	make sort_bench
+//	./sort_bench [threads [records]]
+
+#include <sys/types.h>
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <err.h>
+#include "perf_event.h"
+#include "gooda.h"
+#include "perf_gooda.h"
+#include "gooda_util.h"
+
+#define OLD_SORT_LIMIT	20000	/* largest sorted input given to the old quicksort */
+
+int num_threads = 1;
+
+//	old quicksort, as it was in analyzer.c
+static void
+qsloc(function_loc_data *data, int left, int right)
+{
+	int l_old, r_old, piv_index;
+	function_loc_data piv;
+
+	l_old = left;
+	r_old = right;
+	piv = data[left];
+	while(left < right)
+		{
+		while((data[right].base >= piv.base) && (left < right))
+			right--;
+		if(left != right)
+			data[left++] = data[right];
+		while((data[left].base <= piv.base) && (left < right))
+			left++;
+		if(left != right)
+			data[right--] = data[left];
+		}
+	data[left] = piv;
+	piv_index = left;
+	left = l_old;
+	right = r_old;
+	if(left < piv_index)
+		qsloc(data, left, piv_index-1);
+	if(right > piv_index)
+		qsloc(data, piv_index+1, right);
+}
+
+static int
+loc_cmp(const void *a, const void *b)
+{
+	const function_loc_data *la = a, *lb = b;
+
+	if(la->base < lb->base)return -1;
+	if(la->base > lb->base)return 1;
+	return 0;
+}
+
+static double
+now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (double)tv.tv_sec + 1.0e-6*(double)tv.tv_usec;
+}
+
+static uint64_t
+next_rand(uint64_t *state)
+{
+	uint64_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+	return x;
+}
+
+//	symbol table order, ascending addresses with a few aliases and local
+//	symbols out of place, or a full shuffle
+static void
+make_list(function_loc_data *list, int count, int shuffle, uint64_t *state)
+{
+	uint64_t base = 0x400000;
+	function_loc_data tmp;
+	int i, j;
+
+	for(i = 0; i < count; i++)
+		{
+		list[i].this_function = NULL;
+		list[i].name = NULL;
+		list[i].bind = NULL;
+		list[i].len = 16 + (uint32_t)(next_rand(state) % 2000);
+		list[i].base = base;
+		if((next_rand(state) % 50) != 0)
+			base += list[i].len;
+		}
+	for(i = 0; i < count/100; i++)
+		{
+		j = (int)(next_rand(state) % (uint64_t)count);
+		tmp = list[i];
+		list[i] = list[j];
+		list[j] = tmp;
+		}
+	if(!shuffle)
+		return;
+	for(i = count - 1; i > 0; i--)
+		{
+		j = (int)(next_rand(state) % (uint64_t)(i + 1));
+		tmp = list[i];
+		list[i] = list[j];
+		list[j] = tmp;
+		}
+}
+
+static void
+check_sorted(function_loc_data *list, int count, const char *what)
+{
+	int i;
+
+	for(i = 1; i < count; i++)
+		if(list[i-1].base > list[i].base)
+			errx(1,"%s left record %d out of order",what,i);
+}
+
+int
+main(int argc, char **argv)
+{
+	function_loc_data *input, *work;
+	int sizes[] = {2000, 30000, 120000, 1000000, 0};
+	int threads = 4, count, shuffle, n;
+	uint64_t state = 0x2545F4914F6CDD1DULL;
+	double t0, t_old, t_qsort, t_radix, t_par;
+	char par_name[32];
+
+	if(argc > 1)threads = atoi(argv[1]);
+	if(argc > 2)
+		{
+		sizes[0] = atoi(argv[2]);
+		sizes[1] = 0;
+		}
+	if((threads < 1) || (sizes[0] < 1))
+		errx(1,"usage: %s [threads [records]]",argv[0]);
+
+	snprintf(par_name, sizeof(par_name), "radix x%d ms", threads);
+	printf("%10s %9s %12s %12s %12s %12s\n","records","order","old qs ms","qsort ms","radix ms",par_name);
+	for(n = 0; sizes[n] != 0; n++)
+		for(shuffle = 0; shuffle < 2; shuffle++)
+			{
+			count = sizes[n];
+			input = malloc(count*sizeof(function_loc_data));
+			work = malloc(count*sizeof(function_loc_data));
+			if((input == NULL) || (work == NULL))
+				err(1,"failed to allocate %d records",count);
+			make_list(input, count, shuffle, &state);
+
+			t_old = -1.0;
+			if(shuffle || (count <= OLD_SORT_LIMIT))
+				{
+				memcpy(work, input, count*sizeof(function_loc_data));
+				t0 = now();
+				qsloc(work, 0, count - 1);
+				t_old = now() - t0;
+				check_sorted(work, count, "old quicksort");
+				}
+
+			memcpy(work, input, count*sizeof(function_loc_data));
+			t0 = now();
+			qsort(work, count, sizeof(function_loc_data), loc_cmp);
+			t_qsort = now() - t0;
+			check_sorted(work, count, "qsort");
+
+			memcpy(work, input, count*sizeof(function_loc_data));
+			t0 = now();
+			radix_sort_threads(work, count, sizeof(function_loc_data), offsetof(function_loc_data, base), RADIX_KEY_U64, 1);
+			t_radix = now() - t0;
+			check_sorted(work, count, "radix_sort");
+
+			memcpy(work, input, count*sizeof(function_loc_data));
+			t0 = now();
+			radix_sort_threads(work, count, sizeof(function_loc_data), offsetof(function_loc_data, base), RADIX_KEY_U64, threads);
+			t_par = now() - t0;
+			check_sorted(work, count, "threaded radix_sort");
+
+			if(t_old < 0.0)
+				printf("%10d %9s %12s",count,shuffle ? "shuffled" : "symtab","skipped");
+			else
+				printf("%10d %9s %12.3f",count,shuffle ? "shuffled" : "symtab",1.0e3*t_old);
+			printf(" %12.3f %12.3f %12.3f\n",1.0e3*t_qsort,1.0e3*t_radix,1.0e3*t_par);
+			free(input);
+			free(work);
+			}
+	return 0;
+}